@@ -0,0 +1,141 @@
+#include "arena.h"
+#include <stdlib.h>
+#include <string.h>
+
+static inline size_t align8(size_t size) {
+    return (size + 7) & ~(size_t)7;
+}
+
+// ==================== ARENA ====================
+
+void arena_init(Arena* arena) {
+    memset(arena, 0, sizeof(*arena));
+}
+
+static ArenaChunk* new_chunk(Arena* arena, size_t capacity) {
+    ArenaChunk* chunk = (ArenaChunk*)malloc(sizeof(ArenaChunk) + capacity);
+    if (!chunk) {
+        return NULL;
+    }
+    chunk->next = NULL;
+    chunk->used = 0;
+    chunk->capacity = capacity;
+    arena->chunk_count++;
+    arena->bytes_reserved += capacity;
+    return chunk;
+}
+
+void* arena_alloc(Arena* arena, size_t size) {
+    size = align8(size > 0 ? size : 1);
+
+    ArenaChunk* chunk = arena->chunks;
+    if (!chunk || chunk->capacity - chunk->used < size) {
+        size_t standard = ARENA_CHUNK_SIZE;
+        if (arena->chunk_count < 6) {
+            standard = (size_t)ARENA_MIN_CHUNK << arena->chunk_count;
+        }
+        if (size > standard / 4) {
+            // Large blocks get a chunk of their own so the current one keeps filling
+            chunk = new_chunk(arena, size);
+            if (!chunk) {
+                return NULL;
+            }
+            if (arena->chunks) {
+                chunk->next = arena->chunks->next;
+                arena->chunks->next = chunk;
+            } else {
+                arena->chunks = chunk;
+            }
+        } else {
+            chunk = new_chunk(arena, standard);
+            if (!chunk) {
+                return NULL;
+            }
+            chunk->next = arena->chunks;
+            arena->chunks = chunk;
+        }
+    }
+
+    void* block = chunk->data + chunk->used;
+    chunk->used += size;
+    arena->bytes_used += size;
+    arena->allocations++;
+    return block;
+}
+
+char* arena_strndup(Arena* arena, const char* text, size_t length) {
+    char* copy = (char*)arena_alloc(arena, length + 1);
+    if (!copy) {
+        return NULL;
+    }
+    memcpy(copy, text, length);
+    copy[length] = '\0';
+    return copy;
+}
+
+void arena_release(Arena* arena) {
+    ArenaChunk* chunk = arena->chunks;
+    while (chunk) {
+        ArenaChunk* next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    memset(arena, 0, sizeof(*arena));
+}
+
+// ==================== SLAB POOL ====================
+
+void slab_pool_init(SlabPool* pool, size_t object_size) {
+    memset(pool, 0, sizeof(*pool));
+    pool->object_size = align8(object_size < sizeof(void*) ? sizeof(void*) : object_size);
+}
+
+void* slab_alloc(SlabPool* pool) {
+    if (!pool->free_list) {
+        size_t objects = SLAB_OBJECTS;
+        if (pool->slab_count < 3) {
+            objects = (size_t)SLAB_MIN_OBJECTS << pool->slab_count;
+        }
+        Slab* slab = (Slab*)malloc(sizeof(Slab) + pool->object_size * objects);
+        if (!slab) {
+            return NULL;
+        }
+        slab->next = pool->slabs;
+        pool->slabs = slab;
+        pool->slab_count++;
+        pool->bytes_reserved += sizeof(Slab) + pool->object_size * objects;
+
+        // Thread the new objects onto the free list, first object on top
+        for (size_t i = objects; i-- > 0;) {
+            void* object = slab->data + (size_t)i * pool->object_size;
+            *(void**)object = pool->free_list;
+            pool->free_list = object;
+        }
+    }
+
+    void* object = pool->free_list;
+    pool->free_list = *(void**)object;
+    memset(object, 0, pool->object_size);
+    pool->live++;
+    pool->allocations++;
+    return object;
+}
+
+void slab_free(SlabPool* pool, void* object) {
+    if (!object) {
+        return;
+    }
+    *(void**)object = pool->free_list;
+    pool->free_list = object;
+    pool->live--;
+}
+
+void slab_pool_release(SlabPool* pool) {
+    Slab* slab = pool->slabs;
+    while (slab) {
+        Slab* next = slab->next;
+        free(slab);
+        slab = next;
+    }
+    slab_pool_init(pool, pool->object_size);
+}
@@ -0,0 +1,62 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+// Region allocators for objects that share one owner's lifetime.
+//
+// An Arena hands out bump-allocated, 8-byte aligned blocks from chunks that
+// grow with the arena, so small owners stay small. Blocks are never freed
+// individually, only all at once by arena_release. A SlabPool serves
+// fixed-size objects from slabs (also growing, up to SLAB_OBJECTS objects)
+// and recycles freed objects through a free list; slab_pool_release returns
+// every slab at once, whether or not its objects were freed. Neither type
+// locks: the owner serializes access.
+
+#define ARENA_MIN_CHUNK 1024               // First chunk; each new one doubles...
+#define ARENA_CHUNK_SIZE (64 * 1024)       // ...up to this size
+#define SLAB_MIN_OBJECTS 8                 // First slab; each new one doubles...
+#define SLAB_OBJECTS 64                    // ...up to this many objects
+
+typedef struct ArenaChunk {
+    struct ArenaChunk* next;
+    size_t used;
+    size_t capacity;
+    unsigned char data[];
+} ArenaChunk;
+
+typedef struct Arena {
+    ArenaChunk* chunks;              // Allocation happens in the first chunk
+    size_t chunk_count;
+    size_t bytes_reserved;           // Sum of chunk capacities
+    size_t bytes_used;               // Handed out, including abandoned blocks
+    size_t allocations;
+} Arena;
+
+typedef struct Slab {
+    struct Slab* next;
+    unsigned char data[];
+} Slab;
+
+typedef struct SlabPool {
+    size_t object_size;              // Rounded up to 8 bytes
+    Slab* slabs;
+    void* free_list;                 // Freed objects, linked through their first word
+    size_t slab_count;
+    size_t bytes_reserved;           // Sum of slab sizes
+    size_t live;                     // Objects currently handed out
+    size_t allocations;
+} SlabPool;
+
+void arena_init(Arena* arena);
+void* arena_alloc(Arena* arena, size_t size);                        // NULL on OOM
+char* arena_strndup(Arena* arena, const char* text, size_t length);  // NUL-terminated copy
+void arena_release(Arena* arena);                                    // Frees every chunk
+
+void slab_pool_init(SlabPool* pool, size_t object_size);
+void* slab_alloc(SlabPool* pool);                                    // Zeroed; NULL on OOM
+void slab_free(SlabPool* pool, void* object);
+void slab_pool_release(SlabPool* pool);                              // Frees every slab
+
+#endif // ARENA_H
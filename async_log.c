@@ -0,0 +1,382 @@
+#include "async_log.h"
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+// ==================== FORMATTING ====================
+
+static void copy_field(char* dst, size_t size, const char* src) {
+    if (!src) {
+        dst[0] = '\0';
+        return;
+    }
+    size_t len = strnlen(src, size - 1);
+    memcpy(dst, src, len);
+    dst[len] = '\0';
+}
+
+static void format_stamp(char* stamp, size_t size, time_t when) {
+    struct tm tm_now;
+    localtime_r(&when, &tm_now);
+    strftime(stamp, size, "%Y-%m-%d %H:%M:%S", &tm_now);
+}
+
+// Writer thread only: entries in a batch mostly share the same second
+static const char* cached_stamp(AsyncLog* log, time_t when) {
+    if (when != log->stamp_time || log->stamp[0] == '\0') {
+        format_stamp(log->stamp, sizeof(log->stamp), when);
+        log->stamp_time = when;
+    }
+    return log->stamp;
+}
+
+typedef struct LogBuffer {
+    char* data;
+    size_t len;
+    size_t cap;
+} LogBuffer;
+
+static void buffer_printf(LogBuffer* buffer, const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+
+static void buffer_printf(LogBuffer* buffer, const char* fmt, ...) {
+    while (true) {
+        va_list ap;
+        va_start(ap, fmt);
+        int written = vsnprintf(buffer->data + buffer->len, buffer->cap - buffer->len, fmt, ap);
+        va_end(ap);
+        if (written < 0) {
+            return;
+        }
+        if ((size_t)written < buffer->cap - buffer->len) {
+            buffer->len += (size_t)written;
+            return;
+        }
+        size_t new_cap = buffer->cap ? buffer->cap * 2 : 16384;
+        while (new_cap - buffer->len <= (size_t)written) {
+            new_cap *= 2;
+        }
+        char* grown = (char*)realloc(buffer->data, new_cap);
+        if (!grown) {
+            return;
+        }
+        buffer->data = grown;
+        buffer->cap = new_cap;
+    }
+}
+
+static void format_entry(const char* stamp, const LogEntry* entry, LogBuffer* file_out, LogBuffer* echo_out) {
+    buffer_printf(file_out, "[%s] [%s] %sOp=%s Details=%s\n",
+                  stamp, entry->level, entry->context, entry->operation, entry->details);
+    if (echo_out) {
+        buffer_printf(echo_out, "[%s] [%s] %s - %s\n",
+                      stamp, entry->level, entry->operation, entry->details);
+    }
+}
+
+static void write_batch(AsyncLog* log, const LogBuffer* file_out, const LogBuffer* echo_out) {
+    if (log->file && file_out->len > 0) {
+        fwrite(file_out->data, 1, file_out->len, log->file);
+        if (log->durability >= LOG_DURABILITY_FLUSH) {
+            fflush(log->file);
+        }
+        if (log->durability == LOG_DURABILITY_FSYNC) {
+            fsync(fileno(log->file));
+        }
+    }
+    if (echo_out && echo_out->len > 0) {
+        fwrite(echo_out->data, 1, echo_out->len, stdout);
+        fflush(stdout);
+    }
+}
+
+// ==================== RING REGISTRATION ====================
+
+static void release_ring(void* arg) {
+    LogRing* ring = (LogRing*)arg;
+    atomic_store_explicit(&ring->abandoned, true, memory_order_release);
+}
+
+// Returns the calling thread's ring, or NULL once the log is closing
+static LogRing* thread_ring(AsyncLog* log) {
+    LogRing* ring = (LogRing*)pthread_getspecific(log->ring_key);
+    if (ring) {
+        return ring;
+    }
+
+    pthread_mutex_lock(&log->rings_lock);
+    if (!atomic_load(&log->running)) {
+        pthread_mutex_unlock(&log->rings_lock);
+        return NULL;
+    }
+    ring = log->free_rings;
+    if (ring) {
+        log->free_rings = ring->next_free;
+    } else {
+        ring = (LogRing*)calloc(1, sizeof(LogRing));
+        if (ring) {
+            ring->log = log;
+            ring->next = log->rings;
+            log->rings = ring;
+        }
+    }
+    if (ring) {
+        ring->in_use = true;
+        ring->next_free = NULL;
+        atomic_store(&ring->abandoned, false);
+    }
+    pthread_mutex_unlock(&log->rings_lock);
+
+    if (ring && pthread_setspecific(log->ring_key, ring) != 0) {
+        release_ring(ring);
+        return NULL;
+    }
+    return ring;
+}
+
+// ==================== PRODUCERS ====================
+
+static void fill_entry(LogEntry* entry, uint64_t seq, const char* level, const char* context,
+                       const char* operation, const char* details) {
+    entry->seq = seq;
+    entry->when = time(NULL);
+    copy_field(entry->level, sizeof(entry->level), level);
+    copy_field(entry->context, sizeof(entry->context), context);
+    copy_field(entry->operation, sizeof(entry->operation), operation);
+    copy_field(entry->details, sizeof(entry->details), details);
+}
+
+static void append_direct(AsyncLog* log, const char* level, const char* context,
+                          const char* operation, const char* details) {
+    LogEntry entry;
+    char stamp[32];
+    LogBuffer file_out = { NULL, 0, 0 };
+    LogBuffer echo_out = { NULL, 0, 0 };
+
+    pthread_mutex_lock(&log->sync_lock);
+    fill_entry(&entry, atomic_fetch_add(&log->next_seq, 1), level, context, operation, details);
+    format_stamp(stamp, sizeof(stamp), entry.when);
+    format_entry(stamp, &entry, &file_out, log->echo ? &echo_out : NULL);
+    write_batch(log, &file_out, log->echo ? &echo_out : NULL);
+    pthread_mutex_unlock(&log->sync_lock);
+
+    free(file_out.data);
+    free(echo_out.data);
+}
+
+void async_log_append(AsyncLog* log, const char* level, const char* context,
+                      const char* operation, const char* details) {
+    LogRing* ring = atomic_load_explicit(&log->running, memory_order_acquire) ? thread_ring(log) : NULL;
+    if (!ring) {
+        append_direct(log, level, context, operation, details);
+        return;
+    }
+
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    if (head - tail >= LOG_RING_ENTRIES) {
+        atomic_fetch_add_explicit(&log->dropped, 1, memory_order_relaxed);
+        return;
+    }
+
+    LogEntry* entry = &ring->entries[head & (LOG_RING_ENTRIES - 1)];
+    fill_entry(entry, atomic_fetch_add_explicit(&log->next_seq, 1, memory_order_relaxed),
+               level, context, operation, details);
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+
+    // Nudge the writer before the ring fills; a missed wakeup only costs one interval
+    if (head + 1 - tail == LOG_RING_ENTRIES / 2) {
+        pthread_cond_signal(&log->wake_cond);
+    }
+}
+
+uint64_t async_log_dropped(AsyncLog* log) {
+    return atomic_load_explicit(&log->dropped, memory_order_relaxed);
+}
+
+// ==================== WRITER ====================
+
+static int compare_entries(const void* a, const void* b) {
+    const LogEntry* left = *(const LogEntry* const*)a;
+    const LogEntry* right = *(const LogEntry* const*)b;
+    return (left->seq > right->seq) - (left->seq < right->seq);
+}
+
+// Writes everything published so far; returns the number of entries written
+static size_t drain_rings(AsyncLog* log, const LogEntry*** batch, size_t* batch_cap,
+                          LogBuffer* file_out, LogBuffer* echo_out) {
+    pthread_mutex_lock(&log->rings_lock);
+    LogRing* rings = log->rings;  // Rings are only ever prepended
+    pthread_mutex_unlock(&log->rings_lock);
+
+    size_t count = 0;
+    for (LogRing* ring = rings; ring; ring = ring->next) {
+        size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+        size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+        ring->drain_to = head;
+        if (count + (head - tail) > *batch_cap) {
+            size_t new_cap = *batch_cap ? *batch_cap : 256;
+            while (new_cap < count + (head - tail)) {
+                new_cap *= 2;
+            }
+            const LogEntry** grown = (const LogEntry**)realloc(*batch, new_cap * sizeof(LogEntry*));
+            if (!grown) {
+                ring->drain_to = tail;  // Retry this ring next round
+                continue;
+            }
+            *batch = grown;
+            *batch_cap = new_cap;
+        }
+        for (size_t i = tail; i != head; i++) {
+            (*batch)[count++] = &ring->entries[i & (LOG_RING_ENTRIES - 1)];
+        }
+    }
+
+    file_out->len = 0;
+    if (echo_out) {
+        echo_out->len = 0;
+    }
+    if (count > 1) {
+        qsort(*batch, count, sizeof(LogEntry*), compare_entries);
+    }
+    for (size_t i = 0; i < count; i++) {
+        format_entry(cached_stamp(log, (*batch)[i]->when), (*batch)[i], file_out, echo_out);
+    }
+
+    uint64_t dropped = atomic_load_explicit(&log->dropped, memory_order_relaxed);
+    if (dropped != log->dropped_reported) {
+        LogEntry notice;
+        char details[64];
+        snprintf(details, sizeof(details), "%llu entries dropped (ring full)",
+                 (unsigned long long)(dropped - log->dropped_reported));
+        fill_entry(&notice, 0, "WARN", NULL, "LOG_DROPPED", details);
+        format_entry(cached_stamp(log, notice.when), &notice, file_out, echo_out);
+        log->dropped_reported = dropped;
+    }
+
+    write_batch(log, file_out, echo_out);
+
+    // Hand the slots back, then recycle rings whose threads have exited
+    for (LogRing* ring = rings; ring; ring = ring->next) {
+        atomic_store_explicit(&ring->tail, ring->drain_to, memory_order_release);
+        if (atomic_load_explicit(&ring->abandoned, memory_order_acquire) &&
+            atomic_load_explicit(&ring->head, memory_order_acquire) == ring->drain_to) {
+            pthread_mutex_lock(&log->rings_lock);
+            if (ring->in_use) {
+                ring->in_use = false;
+                ring->next_free = log->free_rings;
+                log->free_rings = ring;
+            }
+            pthread_mutex_unlock(&log->rings_lock);
+        }
+    }
+    return count;
+}
+
+static void* log_writer(void* arg) {
+    AsyncLog* log = (AsyncLog*)arg;
+    const LogEntry** batch = NULL;
+    size_t batch_cap = 0;
+    LogBuffer file_out = { NULL, 0, 0 };
+    LogBuffer echo_out = { NULL, 0, 0 };
+
+    while (atomic_load(&log->running)) {
+        drain_rings(log, &batch, &batch_cap, &file_out, log->echo ? &echo_out : NULL);
+
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += LOG_FLUSH_INTERVAL_MS * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        pthread_mutex_lock(&log->wake_lock);
+        if (atomic_load(&log->running)) {
+            pthread_cond_timedwait(&log->wake_cond, &log->wake_lock, &deadline);
+        }
+        pthread_mutex_unlock(&log->wake_lock);
+    }
+
+    // Final drain after producers stopped using their rings
+    drain_rings(log, &batch, &batch_cap, &file_out, log->echo ? &echo_out : NULL);
+
+    free(batch);
+    free(file_out.data);
+    free(echo_out.data);
+    return NULL;
+}
+
+// ==================== LIFECYCLE ====================
+
+static LogDurability durability_from_env(void) {
+    const char* value = getenv("LOG_DURABILITY");
+    if (value && strcmp(value, "none") == 0) return LOG_DURABILITY_NONE;
+    if (value && strcmp(value, "fsync") == 0) return LOG_DURABILITY_FSYNC;
+    return LOG_DURABILITY_FLUSH;
+}
+
+bool async_log_open(AsyncLog* log, const char* path) {
+    memset(log, 0, sizeof(*log));
+    pthread_mutex_init(&log->sync_lock, NULL);
+    pthread_mutex_init(&log->rings_lock, NULL);
+    pthread_mutex_init(&log->wake_lock, NULL);
+    pthread_cond_init(&log->wake_cond, NULL);
+
+    const char* echo = getenv("LOG_ECHO");
+    log->echo = !(echo && strcmp(echo, "0") == 0);
+    log->durability = durability_from_env();
+
+    log->file = fopen(path, "a");
+    if (!log->file) {
+        return false;
+    }
+    if (pthread_key_create(&log->ring_key, release_ring) != 0) {
+        fclose(log->file);
+        log->file = NULL;
+        return false;
+    }
+
+    atomic_store(&log->running, true);
+    if (pthread_create(&log->writer, NULL, log_writer, log) != 0) {
+        // Fall back to synchronous writes
+        atomic_store(&log->running, false);
+    }
+    return true;
+}
+
+void async_log_close(AsyncLog* log) {
+    pthread_mutex_lock(&log->rings_lock);
+    bool was_running = atomic_exchange(&log->running, false);
+    pthread_mutex_unlock(&log->rings_lock);
+
+    if (was_running) {
+        pthread_mutex_lock(&log->wake_lock);
+        pthread_cond_signal(&log->wake_cond);
+        pthread_mutex_unlock(&log->wake_lock);
+        pthread_join(log->writer, NULL);
+    }
+
+    // Rings still owned by live threads stay allocated: those threads only
+    // ever reach them through their thread-specific pointer.
+    pthread_mutex_lock(&log->rings_lock);
+    LogRing** link = &log->rings;
+    while (*link) {
+        LogRing* ring = *link;
+        if (!ring->in_use) {
+            *link = ring->next;
+            free(ring);
+        } else {
+            link = &ring->next;
+        }
+    }
+    log->free_rings = NULL;
+    pthread_mutex_unlock(&log->rings_lock);
+
+    pthread_mutex_lock(&log->sync_lock);
+    if (log->file) {
+        fclose(log->file);
+        log->file = NULL;
+    }
+    pthread_mutex_unlock(&log->sync_lock);
+}
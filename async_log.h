@@ -0,0 +1,92 @@
+#ifndef ASYNC_LOG_H
+#define ASYNC_LOG_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
+
+// Asynchronous log shared by the Name Server and Storage Server.
+//
+// Each thread that logs gets its own single-producer/single-consumer ring,
+// so async_log_append never takes a lock: it copies the fields into the
+// next slot and publishes it. A background writer drains every ring on a
+// short interval (sooner when a ring passes half full), orders the batch by
+// sequence number, formats timestamps (cached per second) and issues one
+// write per batch. When a ring is full the entry is dropped and counted;
+// the writer reports drops in the log.
+//
+// Runtime switches (environment):
+//   LOG_ECHO=0                      Do not echo entries to stdout
+//   LOG_DURABILITY=none|flush|fsync After each batch: leave to stdio,
+//                                   fflush (default), or fflush + fsync
+
+#define LOG_RING_ENTRIES 128             // Per thread, power of two
+#define LOG_FLUSH_INTERVAL_MS 20
+#define LOG_LEVEL_LEN 8
+#define LOG_OPERATION_LEN 32
+#define LOG_CONTEXT_LEN 128
+#define LOG_DETAILS_LEN 384
+
+typedef enum {
+    LOG_DURABILITY_NONE,
+    LOG_DURABILITY_FLUSH,
+    LOG_DURABILITY_FSYNC
+} LogDurability;
+
+typedef struct LogEntry {
+    uint64_t seq;
+    time_t when;
+    char level[LOG_LEVEL_LEN];
+    char operation[LOG_OPERATION_LEN];
+    char context[LOG_CONTEXT_LEN];   // Component-specific prefix (e.g. "IP=... Port=... ")
+    char details[LOG_DETAILS_LEN];
+} LogEntry;
+
+typedef struct LogRing {
+    LogEntry entries[LOG_RING_ENTRIES];
+    _Atomic size_t head;             // Next slot the owning thread fills
+    _Atomic size_t tail;             // Next slot the writer reads
+    _Atomic bool abandoned;          // Owning thread has exited
+    bool in_use;                     // Guarded by rings_lock
+    size_t drain_to;                 // Writer-only: end of the current batch
+    struct AsyncLog* log;
+    struct LogRing* next;            // Every ring ever created
+    struct LogRing* next_free;       // Rings ready for reuse by a new thread
+} LogRing;
+
+typedef struct AsyncLog {
+    FILE* file;
+    bool echo;
+    LogDurability durability;
+    pthread_t writer;
+    _Atomic bool running;
+    pthread_mutex_t wake_lock;       // Wakes the writer early (close, filling ring)
+    pthread_cond_t wake_cond;
+
+    pthread_key_t ring_key;          // Calling thread's ring
+    pthread_mutex_t rings_lock;      // Ring registration and recycling only
+    LogRing* rings;
+    LogRing* free_rings;
+
+    _Atomic uint64_t next_seq;
+    _Atomic uint64_t dropped;
+    uint64_t dropped_reported;       // Writer-only
+
+    pthread_mutex_t sync_lock;       // Direct writes before open / after close
+    char stamp[32];                  // Writer-only timestamp cache
+    time_t stamp_time;
+} AsyncLog;
+
+bool async_log_open(AsyncLog* log, const char* path);
+void async_log_close(AsyncLog* log);   // Drains every ring, then closes the file
+
+// context may be NULL; operation and details are truncated to fit an entry
+void async_log_append(AsyncLog* log, const char* level, const char* context,
+                      const char* operation, const char* details);
+
+uint64_t async_log_dropped(AsyncLog* log);
+
+#endif // ASYNC_LOG_H
@@ -0,0 +1,195 @@
+// Command parsing and dispatch benchmark: command_parse plus a perfect-hash
+// command_table_find against the strtok_r/strdup parser and strcmp chain
+// they replaced. Correctness checks run first and fail the benchmark.
+//
+// Usage: bench/command_bench [iterations]
+
+#include "../command.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define BUFFER_SIZE 8192
+
+typedef struct {
+    const char* name;
+    int id;
+} BenchCommand;
+
+// Name Server client commands, in name_server_main.c's table order
+static const BenchCommand bench_commands[] = {
+    { "VIEW", 0 }, { "CREATE", 1 }, { "CREATEFOLDER", 2 }, { "DELETE", 3 },
+    { "MOVE", 4 }, { "VIEWFOLDER", 5 }, { "READ", 6 }, { "WRITE", 7 },
+    { "INFO", 8 }, { "STREAM", 9 }, { "EXEC", 10 }, { "UNDO", 11 },
+    { "LIST", 12 }, { "ADDACCESS", 13 }, { "REMACCESS", 14 }, { "CHECKPOINT", 15 },
+    { "VIEWCHECKPOINT", 16 }, { "REVERT", 17 }, { "LISTCHECKPOINTS", 18 },
+    { "REQACCESS", 19 }, { "LISTREQUESTS", 20 }, { "PROCESSREQUEST", 21 },
+    { "QUIT", 22 }, { "EXIT", 23 },
+};
+#define BENCH_COMMAND_COUNT ((int)(sizeof(bench_commands) / sizeof(bench_commands[0])))
+
+// ==================== PREVIOUS PARSER (REFERENCE) ====================
+
+// parse_command as it was before command.c: copy, strtok_r, strdup per arg
+static void old_parse_command(const char* command, char* cmd, char* args[], int* arg_count) {
+    char buffer[BUFFER_SIZE];
+    strncpy(buffer, command, BUFFER_SIZE - 1);
+    buffer[BUFFER_SIZE - 1] = '\0';
+
+    *arg_count = 0;
+    char* saveptr = NULL;
+    char* token = strtok_r(buffer, " \t\n", &saveptr);
+
+    if (token) {
+        strcpy(cmd, token);
+        token = strtok_r(NULL, " \t\n", &saveptr);
+
+        while (token && *arg_count < 10) {
+            args[*arg_count] = strdup(token);
+            (*arg_count)++;
+            token = strtok_r(NULL, " \t\n", &saveptr);
+        }
+    }
+}
+
+// The if/else strcmp chain, one comparison per command until a match
+static int old_dispatch(const char* cmd) {
+    for (int i = 0; i < BENCH_COMMAND_COUNT; i++) {
+        if (strcmp(cmd, bench_commands[i].name) == 0) {
+            return bench_commands[i].id;
+        }
+    }
+    return -1;
+}
+
+// ==================== CORRECTNESS ====================
+
+static int failures = 0;
+
+static void check(bool ok, const char* what) {
+    if (!ok) {
+        fprintf(stderr, "FAIL: %s\n", what);
+        failures++;
+    }
+}
+
+static void check_table(const CommandTable* table) {
+    for (int i = 0; i < BENCH_COMMAND_COUNT; i++) {
+        const BenchCommand* found = command_table_find(table, bench_commands[i].name);
+        check(found == &bench_commands[i], bench_commands[i].name);
+    }
+    const char* strangers[] = { "", "view", "VIEWX", "VIE", "CREATEFOLDERS", "READ ",
+                                "WRITE_FILE", "QUITE", "EXITS", "LISTCHECKPOINT" };
+    for (size_t i = 0; i < sizeof(strangers) / sizeof(strangers[0]); i++) {
+        check(command_table_find(table, strangers[i]) == NULL, strangers[i]);
+    }
+}
+
+static void check_parse(void) {
+    char message[BUFFER_SIZE];
+    Command command;
+
+    strcpy(message, "  \tWRITE   dir/file.txt\t3 \n");
+    check(command_parse(message, &command), "parse whitespace");
+    check(strcmp(command.name, "WRITE") == 0, "name after leading whitespace");
+    check(command.arg_count == 2, "arg count with mixed separators");
+    check(command.arg_count == 2 && strcmp(command.args[0], "dir/file.txt") == 0 &&
+          strcmp(command.args[1], "3") == 0, "args split on tabs and spaces");
+    command_free(&command);
+
+    strcpy(message, " \t\n ");
+    check(command_parse(message, &command), "parse blank");
+    check(command.name && command.name[0] == '\0' && command.arg_count == 0, "blank message");
+    command_free(&command);
+
+    // Enough arguments to spill past the inline array
+    int offset = snprintf(message, sizeof(message), "REGISTER_SS 127.0.0.1 9000 9001");
+    for (int i = 0; i < 100; i++) {
+        offset += snprintf(message + offset, sizeof(message) - offset, " file%03d.txt", i);
+    }
+    check(command_parse(message, &command), "parse long list");
+    check(command.arg_count == 103, "spilled arg count");
+    check(command.arg_count == 103 && strcmp(command.args[102], "file099.txt") == 0,
+          "last spilled arg");
+    command_free(&command);
+}
+
+// ==================== BENCHMARK ====================
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char* argv[]) {
+    int iterations = argc > 1 ? atoi(argv[1]) : 2000000;
+    if (iterations <= 0) {
+        fprintf(stderr, "Usage: %s [iterations]\n", argv[0]);
+        return 1;
+    }
+
+    CommandTable table;
+    check(command_table_init(&table, bench_commands, sizeof(BenchCommand), BENCH_COMMAND_COUNT),
+          "table init");
+    check_table(&table);
+    check_parse();
+    if (failures) {
+        return 1;
+    }
+
+    // A mix of early, late and unknown commands as clients send them
+    const char* messages[] = {
+        "READ dir/file.txt",
+        "WRITE dir/file.txt 3",
+        "VIEW -al",
+        "PROCESSREQUEST notes.txt bob approve",
+        "ADDACCESS -W notes.txt bob",
+        "EXIT",
+        "BOGUS command here",
+    };
+    int message_count = (int)(sizeof(messages) / sizeof(messages[0]));
+
+    long checksum_old = 0;
+    double start = now_seconds();
+    for (int i = 0; i < iterations; i++) {
+        char cmd[BUFFER_SIZE];
+        char* args[10];
+        int arg_count;
+        old_parse_command(messages[i % message_count], cmd, args, &arg_count);
+        checksum_old += old_dispatch(cmd) + arg_count;
+        for (int j = 0; j < arg_count; j++) {
+            free(args[j]);
+        }
+    }
+    double old_time = now_seconds() - start;
+
+    // The framed message is already in a writable buffer on the server;
+    // the copy here stands in for the wire read
+    long checksum_new = 0;
+    start = now_seconds();
+    for (int i = 0; i < iterations; i++) {
+        char buffer[BUFFER_SIZE];
+        strcpy(buffer, messages[i % message_count]);
+        Command command;
+        command_parse(buffer, &command);
+        const BenchCommand* entry = command_table_find(&table, command.name);
+        checksum_new += (entry ? entry->id : -1) + command.arg_count;
+        command_free(&command);
+    }
+    double new_time = now_seconds() - start;
+
+    if (checksum_old != checksum_new) {
+        fprintf(stderr, "FAIL: dispatch checksum mismatch (%ld vs %ld)\n", checksum_old, checksum_new);
+        return 1;
+    }
+
+    printf("command_bench: %d commands (%d-message mix)\n", iterations, message_count);
+    printf("  %-22s %10s %14s\n", "path", "ns/cmd", "commands/s");
+    printf("  %-22s %10.1f %14.0f\n", "strtok+strdup+strcmp",
+           old_time * 1e9 / iterations, iterations / old_time);
+    printf("  %-22s %10.1f %14.0f\n", "in-place+perfect-hash",
+           new_time * 1e9 / iterations, iterations / new_time);
+    return 0;
+}
@@ -0,0 +1,357 @@
+// Storage Server client-path benchmark: connections per second and READ
+// throughput against a real name_server + storage_server pair, which it
+// starts in a scratch directory on free loopback ports.
+//
+//   connect+READ+close   one connection per request (accept path, session
+//                        setup and teardown), small file
+//   persistent READ      one connection per client thread, large and small
+//                        file (reply path)
+//
+// Failed connects and short replies are counted, not retried. Pointing it
+// at the binaries of an older tree compares the two builds on one machine.
+//
+// Usage: bench/ss_client_bench [bin_dir] [seconds_per_run]
+
+#define _GNU_SOURCE
+#include "../wire.h"
+#include <arpa/inet.h>
+#include <ftw.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_CLIENTS 256
+#define BIG_FILE_WORDS 20000
+#define READY_TIMEOUT_MS 5000
+
+static double now_seconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+}
+
+// ==================== SERVERS ====================
+
+typedef struct {
+    char dir[64];
+    pid_t nm_pid;
+    pid_t ss_pid;
+    int nm_port;
+    int client_port;
+} Servers;
+
+// Asks the kernel for a port nobody is bound to
+static int free_port(void) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(addr);
+    int port = -1;
+    if (fd >= 0 && bind(fd, (struct sockaddr*)&addr, sizeof(addr)) == 0 &&
+        getsockname(fd, (struct sockaddr*)&addr, &len) == 0) {
+        port = ntohs(addr.sin_port);
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+    return port;
+}
+
+static bool write_text(const char* path, const char* text, size_t length) {
+    FILE* fp = fopen(path, "w");
+    if (!fp) {
+        return false;
+    }
+    bool ok = fwrite(text, 1, length, fp) == length;
+    return (fclose(fp) == 0) && ok;
+}
+
+static bool write_fixtures(const char* dir) {
+    char path[256];
+    snprintf(path, sizeof(path), "%s/ss/storage/small.txt", dir);
+    const char* small = "Hello world. Second.";
+    if (!write_text(path, small, strlen(small))) {
+        return false;
+    }
+
+    size_t capacity = (size_t)BIG_FILE_WORDS * 8;
+    char* big = malloc(capacity);
+    if (!big) {
+        return false;
+    }
+    size_t length = 0;
+    for (int i = 0; i < BIG_FILE_WORDS; i++) {
+        length += (size_t)snprintf(big + length, capacity - length, "%sw%d.", i ? " " : "", i);
+    }
+    snprintf(path, sizeof(path), "%s/ss/storage/big.txt", dir);
+    bool ok = write_text(path, big, length);
+    free(big);
+    return ok;
+}
+
+// Runs program with args in dir, output to dir/out
+static pid_t spawn(const char* dir, const char* program, char* const argv[]) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        if (chdir(dir) != 0) {
+            _exit(127);
+        }
+        FILE* out = freopen("out", "w", stdout);
+        if (out) {
+            dup2(fileno(out), STDERR_FILENO);
+        }
+        execv(program, argv);
+        _exit(127);
+    }
+    return pid;
+}
+
+static int connect_client_port(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return fd;
+}
+
+// READ filename on fd; the reply length, or -1 on failure
+static long read_file(int fd, const char* filename) {
+    char request[256];
+    snprintf(request, sizeof(request), "READ %s", filename);
+    if (!wire_send_text(fd, WIRE_OP_REQUEST, 0, request)) {
+        return -1;
+    }
+    WireMessage reply;
+    if (wire_recv(fd, &reply) != 1) {
+        return -1;
+    }
+    long length = strncmp(reply.payload, "ERROR", 5) == 0 ? -1 : (long)reply.length;
+    wire_message_free(&reply);
+    return length;
+}
+
+// Ready once the big file can be read back over the client port
+static bool wait_until_ready(const Servers* servers) {
+    for (int waited = 0; waited < READY_TIMEOUT_MS; waited += 50) {
+        int fd = connect_client_port(servers->client_port);
+        if (fd >= 0) {
+            long length = read_file(fd, "big.txt");
+            close(fd);
+            if (length > 0) {
+                return true;
+            }
+        }
+        struct timespec pause = { 0, 50 * 1000000L };
+        nanosleep(&pause, NULL);
+    }
+    return false;
+}
+
+static bool start_servers(Servers* servers, const char* bin_dir) {
+    memset(servers, 0, sizeof(*servers));
+    snprintf(servers->dir, sizeof(servers->dir), "/tmp/ss_client_bench.XXXXXX");
+    if (!mkdtemp(servers->dir)) {
+        perror("mkdtemp");
+        return false;
+    }
+    char path[256];
+    snprintf(path, sizeof(path), "%s/nm", servers->dir);
+    mkdir(path, 0700);
+    snprintf(path, sizeof(path), "%s/ss", servers->dir);
+    mkdir(path, 0700);
+    snprintf(path, sizeof(path), "%s/ss/storage", servers->dir);
+    mkdir(path, 0700);
+    if (!write_fixtures(servers->dir)) {
+        fprintf(stderr, "Failed to write fixtures in %s\n", servers->dir);
+        return false;
+    }
+
+    char nm_bin[256];
+    char ss_bin[256];
+    char* resolved = realpath(bin_dir, NULL);
+    if (!resolved) {
+        perror(bin_dir);
+        return false;
+    }
+    snprintf(nm_bin, sizeof(nm_bin), "%s/name_server", resolved);
+    snprintf(ss_bin, sizeof(ss_bin), "%s/storage_server", resolved);
+    free(resolved);
+
+    servers->nm_port = free_port();
+    servers->client_port = free_port();
+    char nm_port[16];
+    char client_port[16];
+    snprintf(nm_port, sizeof(nm_port), "%d", servers->nm_port);
+    snprintf(client_port, sizeof(client_port), "%d", servers->client_port);
+
+    char nm_dir[128];
+    char ss_dir[128];
+    snprintf(nm_dir, sizeof(nm_dir), "%s/nm", servers->dir);
+    snprintf(ss_dir, sizeof(ss_dir), "%s/ss", servers->dir);
+    char* nm_argv[] = { nm_bin, nm_port, NULL };
+    servers->nm_pid = spawn(nm_dir, nm_bin, nm_argv);
+    struct timespec pause = { 0, 300 * 1000000L };
+    nanosleep(&pause, NULL);
+    char* ss_argv[] = { ss_bin, "127.0.0.1", nm_port, client_port, NULL };
+    servers->ss_pid = spawn(ss_dir, ss_bin, ss_argv);
+
+    if (servers->nm_pid < 0 || servers->ss_pid < 0 || !wait_until_ready(servers)) {
+        fprintf(stderr, "Servers from %s did not come up (logs in %s)\n", bin_dir, servers->dir);
+        return false;
+    }
+    return true;
+}
+
+static int remove_entry(const char* path, const struct stat* st, int flag, struct FTW* ftw) {
+    (void)st;
+    (void)flag;
+    (void)ftw;
+    return remove(path);
+}
+
+static void stop_servers(Servers* servers, bool keep_dir) {
+    pid_t pids[2] = { servers->ss_pid, servers->nm_pid };
+    for (int i = 0; i < 2; i++) {
+        if (pids[i] > 0) {
+            kill(pids[i], SIGTERM);
+            waitpid(pids[i], NULL, 0);
+        }
+    }
+    if (!keep_dir && servers->dir[0]) {
+        nftw(servers->dir, remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+    }
+}
+
+// ==================== LOAD ====================
+
+typedef struct {
+    int port;
+    const char* filename;
+    bool reconnect;                  // One connection per request
+    double deadline;
+    atomic_long ops;
+    atomic_long bytes;
+    atomic_long failures;
+} Load;
+
+static void* load_worker(void* arg) {
+    Load* load = (Load*)arg;
+    int fd = -1;
+    while (now_seconds() < load->deadline) {
+        if (fd < 0) {
+            fd = connect_client_port(load->port);
+            if (fd < 0) {
+                atomic_fetch_add(&load->failures, 1);
+                continue;
+            }
+        }
+        long length = read_file(fd, load->filename);
+        if (length < 0) {
+            atomic_fetch_add(&load->failures, 1);
+            close(fd);
+            fd = -1;
+            continue;
+        }
+        atomic_fetch_add(&load->ops, 1);
+        atomic_fetch_add(&load->bytes, length);
+        if (load->reconnect) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+    return NULL;
+}
+
+// False if no request succeeded at all
+static bool run_load(const Servers* servers, const char* label, const char* filename,
+                     bool reconnect, int clients, int seconds) {
+    Load load;
+    memset(&load, 0, sizeof(load));
+    load.port = servers->client_port;
+    load.filename = filename;
+    load.reconnect = reconnect;
+    atomic_init(&load.ops, 0);
+    atomic_init(&load.bytes, 0);
+    atomic_init(&load.failures, 0);
+
+    pthread_t threads[MAX_CLIENTS];
+    double started = now_seconds();
+    load.deadline = started + seconds;
+    int running = 0;
+    for (; running < clients; running++) {
+        if (pthread_create(&threads[running], NULL, load_worker, &load) != 0) {
+            break;
+        }
+    }
+    for (int i = 0; i < running; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    double elapsed = now_seconds() - started;
+
+    printf("  %-22s %-10s %7d %10.0f %9.1f %8ld\n", label, filename, running,
+           (double)atomic_load(&load.ops) / elapsed,
+           (double)atomic_load(&load.bytes) / elapsed / 1e6, atomic_load(&load.failures));
+    fflush(stdout);
+    return atomic_load(&load.ops) > 0;
+}
+
+int main(int argc, char* argv[]) {
+    const char* bin_dir = argc > 1 ? argv[1] : ".";
+    int seconds = argc > 2 ? atoi(argv[2]) : 2;
+    if (seconds <= 0) {
+        seconds = 2;
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    Servers servers;
+    if (!start_servers(&servers, bin_dir)) {
+        stop_servers(&servers, true);
+        return 1;
+    }
+
+    printf("SS client benchmark (%s, %d s per run)\n", bin_dir, seconds);
+    printf("  %-22s %-10s %7s %10s %9s %8s\n", "mode", "file", "clients", "ops/s", "MB/s", "failed");
+    bool ok = true;
+    static const int connect_clients[] = { 8, 64, 256 };
+    for (size_t i = 0; i < sizeof(connect_clients) / sizeof(connect_clients[0]); i++) {
+        ok &= run_load(&servers, "connect+READ+close", "small.txt", true, connect_clients[i], seconds);
+    }
+    static const int read_clients[] = { 8, 64 };
+    for (size_t i = 0; i < sizeof(read_clients) / sizeof(read_clients[0]); i++) {
+        ok &= run_load(&servers, "persistent READ", "big.txt", false, read_clients[i], seconds);
+    }
+    ok &= run_load(&servers, "persistent READ", "small.txt", false, 64, seconds);
+
+    stop_servers(&servers, false);
+    if (!ok) {
+        fprintf(stderr, "FAIL: a run completed no READs\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,289 @@
+// Sentence tokenizer benchmark: tokenize_sentences (16-byte bitmask scan,
+// SSE2 where the compiler targets it) against the per-sentence strtok_r
+// parser it replaced. The outputs are compared first, on fuzzed
+// delimiter-dense input, on every alignment and length around the 16-byte
+// block boundary, and on sentences long enough to spill the inline word list.
+//
+// Usage: bench/tokenize_bench [document_mb] [fuzz_cases]
+
+#include "../storage_server.h"
+
+// ==================== OUTPUT CAPTURE ====================
+
+// Sentences are rendered as "word|word|<delimiter>\n" ('$' for none), so two
+// tokenizers agree exactly when their renderings are equal
+typedef struct {
+    char* data;
+    size_t length;
+    size_t capacity;
+    long sentences;
+    long words;
+} Rendering;
+
+static void render_bytes(Rendering* out, const char* bytes, size_t n) {
+    if (out->length + n + 1 > out->capacity) {
+        out->capacity = (out->length + n + 1) * 2;
+        out->data = realloc(out->data, out->capacity);
+        if (!out->data) {
+            perror("realloc");
+            exit(1);
+        }
+    }
+    memcpy(out->data + out->length, bytes, n);
+    out->length += n;
+    out->data[out->length] = '\0';
+}
+
+static void render_sentence(Rendering* out, char** words, int word_count, char delimiter) {
+    for (int i = 0; i < word_count; i++) {
+        render_bytes(out, words[i], strlen(words[i]));
+        render_bytes(out, "|", 1);
+    }
+    char tail[2] = { delimiter ? delimiter : '$', '\n' };
+    render_bytes(out, tail, 2);
+}
+
+static bool render_sink(char** words, int word_count, char delimiter, void* ctx) {
+    render_sentence((Rendering*)ctx, words, word_count, delimiter);
+    return true;
+}
+
+static bool count_sink(char** words, int word_count, char delimiter, void* ctx) {
+    (void)words;
+    (void)delimiter;
+    Rendering* out = (Rendering*)ctx;
+    out->sentences++;
+    out->words += word_count;
+    return true;
+}
+
+// ==================== PREVIOUS PARSER (REFERENCE) ====================
+
+// parse_sentences before the bitmask scan: find each delimiter, copy the
+// sentence out, then strtok_r it into words. Scalar and byte-at-a-time.
+typedef bool (*ReferenceSink)(char** words, int word_count, char delimiter, void* ctx);
+
+static void reference_tokenize(const char* content, size_t len, char* scratch,
+                               char** words, int max_words, ReferenceSink sink, void* ctx) {
+    size_t index = 0;
+    while (index < len) {
+        while (index < len && (content[index] == ' ' || content[index] == '\n' || content[index] == '\t')) {
+            index++;
+        }
+        if (index >= len) {
+            break;
+        }
+
+        size_t start = index;
+        while (index < len && !is_sentence_delimiter(content[index])) {
+            index++;
+        }
+
+        char delimiter = '\0';
+        if (index < len) {
+            delimiter = content[index];
+            index++;
+        }
+
+        size_t sentence_len = (delimiter != '\0') ? (index - start - 1) : (index - start);
+        memcpy(scratch, content + start, sentence_len);
+        scratch[sentence_len] = '\0';
+
+        int word_count = 0;
+        char* saveptr;
+        char* token = strtok_r(scratch, " \t\n", &saveptr);
+        while (token && word_count < max_words) {
+            words[word_count++] = token;
+            token = strtok_r(NULL, " \t\n", &saveptr);
+        }
+        sink(words, word_count, delimiter, ctx);
+    }
+}
+
+// ==================== CORRECTNESS ====================
+
+static uint64_t rng_state = 0x2545f4914f6cdd1dULL;
+
+static uint64_t next_random(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+#define TOKEN_ALIGN_SPAN 16
+
+static char* ref_scratch;
+static char** ref_words;
+static int ref_max_words;
+
+// Runs both tokenizers on text placed at the given offset into a buffer, so
+// the 16-byte blocks start at every alignment relative to the content
+static bool compare_on(const char* text, size_t len, size_t align) {
+    Rendering expected = {0};
+    Rendering actual = {0};
+    render_bytes(&expected, "", 0);
+    render_bytes(&actual, "", 0);
+    reference_tokenize(text, len, ref_scratch, ref_words, ref_max_words, render_sink, &expected);
+
+    char* buffer = malloc(len + align + 1);
+    memcpy(buffer + align, text, len);
+    buffer[align + len] = '\0';
+    tokenize_sentences(buffer + align, len, render_sink, &actual);
+
+    bool same = strcmp(expected.data, actual.data) == 0;
+    if (!same) {
+        fprintf(stderr, "FAIL: tokenizers disagree (len=%zu align=%zu) on \"%.*s\"\n"
+                        "expected:\n%s\nactual:\n%s\n",
+                len, align, (int)len, text, expected.data, actual.data);
+    }
+    free(buffer);
+    free(expected.data);
+    free(actual.data);
+    return same;
+}
+
+static void random_text(char* out, size_t len, const char* alphabet) {
+    size_t alphabet_len = strlen(alphabet);
+    for (size_t i = 0; i < len; i++) {
+        out[i] = alphabet[next_random() % alphabet_len];
+    }
+    out[len] = '\0';
+}
+
+static bool check_tokenizer(int fuzz_cases) {
+    char text[4096];
+    long cases = 0;
+
+    // Delimiter-dense: every other byte or more is a separator or delimiter
+    for (int i = 0; i < fuzz_cases; i++) {
+        size_t len = next_random() % 80;
+        random_text(text, len, "ab .!?\t\n..!?  ");
+        if (!compare_on(text, len, next_random() % TOKEN_ALIGN_SPAN)) return false;
+        cases++;
+    }
+
+    // Every length and alignment across the first few block boundaries,
+    // with a word or a delimiter straddling each boundary
+    const char* patterns[] = { "abcdefghijklmnopqrstuvwxyz", "a.b.c.d.e.f.g.h.i.j.k.l.m",
+                               "word  word\tword\nword!", "..!!??  \t\n..!!??" };
+    for (size_t p = 0; p < sizeof(patterns) / sizeof(patterns[0]); p++) {
+        size_t plen = strlen(patterns[p]);
+        for (size_t len = 0; len <= 3 * 16 + 1; len++) {
+            for (size_t i = 0; i < len; i++) {
+                text[i] = patterns[p][i % plen];
+            }
+            text[len] = '\0';
+            for (size_t align = 0; align < TOKEN_ALIGN_SPAN; align++) {
+                if (!compare_on(text, len, align)) return false;
+                cases++;
+            }
+        }
+    }
+
+    // Words longer than a block, and a sentence past the inline word list
+    random_text(text, 100, "abcdefghij");
+    text[40] = ' ';
+    text[99] = '?';
+    if (!compare_on(text, 100, 3)) return false;
+    size_t len = 0;
+    for (int i = 0; i < 600; i++) {
+        text[len++] = (char)('a' + i % 26);
+        text[len++] = ' ';
+    }
+    text[len++] = '.';
+    if (!compare_on(text, len, 0)) return false;
+    cases += 2;
+
+    printf("tokenize_bench: %ld correctness cases passed\n", cases);
+    return true;
+}
+
+// ==================== BENCHMARK ====================
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+// Prose-like text: short words, single spaces, a delimiter every ~12 words
+static void make_document(char* out, size_t len) {
+    size_t i = 0;
+    int words_in_sentence = 0;
+    while (i < len) {
+        int word_len = 1 + (int)(next_random() % 9);
+        for (int k = 0; k < word_len && i < len; k++) {
+            out[i++] = (char)('a' + next_random() % 26);
+        }
+        if (i >= len) break;
+        if (++words_in_sentence >= 12 && next_random() % 3 == 0) {
+            out[i++] = ".!?"[next_random() % 3];
+            words_in_sentence = 0;
+            if (i < len) out[i++] = next_random() % 8 == 0 ? '\n' : ' ';
+        } else {
+            out[i++] = ' ';
+        }
+    }
+    out[len] = '\0';
+}
+
+int main(int argc, char* argv[]) {
+    int document_mb = argc > 1 ? atoi(argv[1]) : 16;
+    int fuzz_cases = argc > 2 ? atoi(argv[2]) : 20000;
+    if (document_mb <= 0 || fuzz_cases < 0) {
+        fprintf(stderr, "Usage: %s [document_mb] [fuzz_cases]\n", argv[0]);
+        return 1;
+    }
+
+    size_t len = (size_t)document_mb << 20;
+    ref_max_words = (int)len;
+    ref_scratch = malloc(len + 1);
+    ref_words = malloc(sizeof(char*) * (len / 2 + 1));
+    char* document = malloc(len + 1);
+    char* work = malloc(len + 1);
+    if (!ref_scratch || !ref_words || !document || !work) {
+        perror("malloc");
+        return 1;
+    }
+
+    if (!check_tokenizer(fuzz_cases)) {
+        return 1;
+    }
+
+    make_document(document, len);
+
+    Rendering old_counts = {0};
+    double start = now_seconds();
+    reference_tokenize(document, len, ref_scratch, ref_words, ref_max_words, count_sink, &old_counts);
+    double old_time = now_seconds() - start;
+
+    // Tokenizing is destructive; the copy is outside the timed region
+    memcpy(work, document, len + 1);
+    Rendering new_counts = {0};
+    start = now_seconds();
+    tokenize_sentences(work, len, count_sink, &new_counts);
+    double new_time = now_seconds() - start;
+
+    if (old_counts.sentences != new_counts.sentences || old_counts.words != new_counts.words) {
+        fprintf(stderr, "FAIL: document counts differ (%ld/%ld vs %ld/%ld)\n",
+                old_counts.sentences, old_counts.words, new_counts.sentences, new_counts.words);
+        return 1;
+    }
+
+    printf("tokenize_bench: %d MB document, %ld sentences, %ld words\n",
+           document_mb, new_counts.sentences, new_counts.words);
+    printf("  %-22s %10s\n", "tokenizer", "MB/s");
+    printf("  %-22s %10.0f\n", "strtok_r per sentence", document_mb / old_time);
+#ifdef __SSE2__
+    printf("  %-22s %10.0f\n", "bitmask scan (SSE2)", document_mb / new_time);
+#else
+    printf("  %-22s %10.0f\n", "bitmask scan (scalar)", document_mb / new_time);
+#endif
+
+    free(ref_scratch);
+    free(ref_words);
+    free(document);
+    free(work);
+    return 0;
+}
@@ -0,0 +1,177 @@
+// Namespace trie benchmark: memory and lookup time of the adaptive radix
+// tree in name_server.c against the original 256-pointer trie.
+//
+// Usage: bench/trie_bench [file_count] [lookups]
+
+#include "../name_server.h"
+#include <malloc.h>
+
+// ==================== 256-POINTER TRIE (REFERENCE) ====================
+
+// The layout name_server.c used before the adaptive radix tree
+typedef struct OldTrieNode {
+    struct OldTrieNode* children[256];
+    bool is_end_of_word;
+    void* file_metadata;
+} OldTrieNode;
+
+static OldTrieNode* old_trie_create(void) {
+    return (OldTrieNode*)calloc(1, sizeof(OldTrieNode));
+}
+
+static void old_trie_insert(OldTrieNode* root, const char* filename, FileMetadata* metadata) {
+    OldTrieNode* current = root;
+    for (int i = 0; filename[i] != '\0'; i++) {
+        unsigned char index = (unsigned char)filename[i];
+        if (!current->children[index]) {
+            current->children[index] = old_trie_create();
+        }
+        current = current->children[index];
+    }
+    current->is_end_of_word = true;
+    current->file_metadata = metadata;
+}
+
+static FileMetadata* old_trie_search(OldTrieNode* root, const char* filename) {
+    OldTrieNode* current = root;
+    for (int i = 0; filename[i] != '\0'; i++) {
+        unsigned char index = (unsigned char)filename[i];
+        if (!current->children[index]) {
+            return NULL;
+        }
+        current = current->children[index];
+    }
+    return current->is_end_of_word ? (FileMetadata*)current->file_metadata : NULL;
+}
+
+static void old_trie_destroy(OldTrieNode* root) {
+    if (!root) return;
+    for (int i = 0; i < 256; i++) {
+        old_trie_destroy(root->children[i]);
+    }
+    free(root);
+}
+
+// ==================== HELPERS ====================
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static size_t heap_in_use(void) {
+    return mallinfo2().uordblks;
+}
+
+// Deterministic xorshift so runs are comparable
+static uint64_t rng_state = 0x9e3779b97f4a7c15ULL;
+
+static uint64_t next_random(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+// Names shaped like a user namespace: a few owners, nested folders, files
+static void make_name(char* out, size_t size, int i) {
+    snprintf(out, size, "user%02d/project%03d/src/file%05d.txt",
+             i % 37, (i / 37) % 211, i);
+}
+
+// ==================== BENCHMARK ====================
+
+int main(int argc, char* argv[]) {
+    int file_count = argc > 1 ? atoi(argv[1]) : 20000;
+    int lookups = argc > 2 ? atoi(argv[2]) : 2000000;
+    if (file_count <= 0 || lookups <= 0) {
+        fprintf(stderr, "Usage: %s [file_count] [lookups]\n", argv[0]);
+        return 1;
+    }
+
+    char** names = malloc(sizeof(char*) * file_count);
+    FileMetadata** metadata = malloc(sizeof(FileMetadata*) * file_count);
+    int* order = malloc(sizeof(int) * lookups);
+    if (!names || !metadata || !order) {
+        perror("malloc");
+        return 1;
+    }
+    for (int i = 0; i < file_count; i++) {
+        char name[MAX_FILENAME];
+        make_name(name, sizeof(name), i);
+        names[i] = strdup(name);
+        metadata[i] = calloc(1, sizeof(FileMetadata));
+    }
+    for (int i = 0; i < lookups; i++) {
+        order[i] = (int)(next_random() % (uint64_t)file_count);
+    }
+
+    // Metadata is allocated up front so the deltas count trie nodes only
+    size_t before = heap_in_use();
+    double start = now_seconds();
+    TrieNode* art = create_trie_node();
+    for (int i = 0; i < file_count; i++) {
+        insert_file_trie(art, names[i], metadata[i]);
+    }
+    double art_insert = now_seconds() - start;
+    size_t art_bytes = heap_in_use() - before;
+
+    before = heap_in_use();
+    start = now_seconds();
+    OldTrieNode* old = old_trie_create();
+    for (int i = 0; i < file_count; i++) {
+        old_trie_insert(old, names[i], metadata[i]);
+    }
+    double old_insert = now_seconds() - start;
+    size_t old_bytes = heap_in_use() - before;
+
+    // Both tries must agree before their timings mean anything
+    for (int i = 0; i < file_count; i++) {
+        if (search_file_trie(art, names[i]) != metadata[i] ||
+            old_trie_search(old, names[i]) != metadata[i]) {
+            fprintf(stderr, "FAIL: lookup mismatch for %s\n", names[i]);
+            return 1;
+        }
+    }
+    if (search_file_trie(art, "user00/project000/src") ||
+        search_file_trie(art, "user00/project000/src/file00000.txt.bak")) {
+        fprintf(stderr, "FAIL: ART matched a name that was never inserted\n");
+        return 1;
+    }
+
+    uintptr_t sink = 0;
+    start = now_seconds();
+    for (int i = 0; i < lookups; i++) {
+        sink += (uintptr_t)search_file_trie(art, names[order[i]]);
+    }
+    double art_lookup = now_seconds() - start;
+
+    start = now_seconds();
+    for (int i = 0; i < lookups; i++) {
+        sink -= (uintptr_t)old_trie_search(old, names[order[i]]);
+    }
+    double old_lookup = now_seconds() - start;
+
+    printf("trie_bench: %d files, %d random lookups\n", file_count, lookups);
+    printf("  %-10s %12s %12s %12s\n", "trie", "memory MB", "insert ms", "lookup ns");
+    printf("  %-10s %12.1f %12.1f %12.1f\n", "256-ptr",
+           old_bytes / 1048576.0, old_insert * 1e3, old_lookup * 1e9 / lookups);
+    printf("  %-10s %12.1f %12.1f %12.1f\n", "ART",
+           art_bytes / 1048576.0, art_insert * 1e3, art_lookup * 1e9 / lookups);
+    if (sink != 0) {
+        fprintf(stderr, "FAIL: lookup checksum mismatch\n");
+        return 1;
+    }
+
+    // destroy_trie frees the metadata; the reference trie only borrowed it
+    old_trie_destroy(old);
+    destroy_trie(art);
+    for (int i = 0; i < file_count; i++) {
+        free(names[i]);
+    }
+    free(names);
+    free(metadata);
+    free(order);
+    return 0;
+}
@@ -0,0 +1,207 @@
+// Concurrent namespace lookups under trie_lock: the writer-preferring
+// reader-writer lock the name server uses, glibc's default (reader-
+// preferring) rwlock, and the plain mutex trie_lock used to be. Reader threads run lookup loops, one
+// thread repeatedly walks the whole tree (a VIEW -a) and one writer creates
+// and deletes a file, all sharing the same lock.
+//
+// Usage: bench/trie_lock_bench [readers] [seconds] [file_count]
+
+#define _GNU_SOURCE  // pthread_rwlockattr_setkind_np
+#include "../name_server.h"
+
+typedef enum {
+    LOCK_MUTEX,
+    LOCK_RWLOCK_READER,              // glibc default
+    LOCK_RWLOCK_WRITER               // What name_server.c initializes
+} LockMode;
+
+static const char* lock_mode_name(LockMode mode) {
+    switch (mode) {
+        case LOCK_MUTEX: return "mutex";
+        case LOCK_RWLOCK_READER: return "rw-read";
+        default: return "rw-write";
+    }
+}
+
+typedef struct {
+    LockMode mode;
+    pthread_mutex_t mutex;
+    pthread_rwlock_t rwlock_reader;
+    pthread_rwlock_t rwlock_writer;
+    TrieNode* trie;
+    char** names;
+    int file_count;
+    volatile bool stop;
+} BenchState;
+
+typedef struct {
+    BenchState* state;
+    unsigned int seed;
+    uint64_t ops;
+} WorkerArgs;
+
+// ==================== LOCKING ====================
+
+static pthread_rwlock_t* bench_rwlock(BenchState* state) {
+    return state->mode == LOCK_RWLOCK_READER ? &state->rwlock_reader : &state->rwlock_writer;
+}
+
+static void bench_read_lock(BenchState* state) {
+    if (state->mode == LOCK_MUTEX) {
+        pthread_mutex_lock(&state->mutex);
+    } else {
+        pthread_rwlock_rdlock(bench_rwlock(state));
+    }
+}
+
+static void bench_write_lock(BenchState* state) {
+    if (state->mode == LOCK_MUTEX) {
+        pthread_mutex_lock(&state->mutex);
+    } else {
+        pthread_rwlock_wrlock(bench_rwlock(state));
+    }
+}
+
+static void bench_unlock(BenchState* state) {
+    if (state->mode == LOCK_MUTEX) {
+        pthread_mutex_unlock(&state->mutex);
+    } else {
+        pthread_rwlock_unlock(bench_rwlock(state));
+    }
+}
+
+// ==================== WORKERS ====================
+
+static void* reader_thread(void* arg) {
+    WorkerArgs* args = (WorkerArgs*)arg;
+    BenchState* state = args->state;
+    while (!state->stop) {
+        const char* name = state->names[rand_r(&args->seed) % state->file_count];
+        bench_read_lock(state);
+        FileMetadata* metadata = search_file_trie(state->trie, name);
+        bench_unlock(state);
+        if (!metadata) {
+            fprintf(stderr, "FAIL: %s missing\n", name);
+            exit(1);
+        }
+        args->ops++;
+    }
+    return NULL;
+}
+
+static void count_file(FileMetadata* metadata, void* ctx) {
+    (void)metadata;
+    (*(int*)ctx)++;
+}
+
+static void* viewer_thread(void* arg) {
+    WorkerArgs* args = (WorkerArgs*)arg;
+    BenchState* state = args->state;
+    while (!state->stop) {
+        int seen = 0;
+        bench_read_lock(state);
+        walk_file_trie(state->trie, "", count_file, &seen);
+        bench_unlock(state);
+        args->ops++;
+    }
+    return NULL;
+}
+
+static void* writer_thread(void* arg) {
+    WorkerArgs* args = (WorkerArgs*)arg;
+    BenchState* state = args->state;
+    while (!state->stop) {
+        bench_write_lock(state);
+        insert_file_trie(state->trie, "scratch/new_file.txt", calloc(1, sizeof(FileMetadata)));
+        bench_unlock(state);
+        usleep(1000);
+        bench_write_lock(state);
+        delete_file_trie(state->trie, "scratch/new_file.txt");
+        bench_unlock(state);
+        usleep(1000);
+        args->ops += 2;
+    }
+    return NULL;
+}
+
+// ==================== BENCHMARK ====================
+
+static void run_mode(BenchState* state, LockMode mode, int readers, int seconds) {
+    state->mode = mode;
+    state->stop = false;
+
+    int thread_count = readers + 2;
+    pthread_t* threads = malloc(sizeof(pthread_t) * thread_count);
+    WorkerArgs* args = calloc(thread_count, sizeof(WorkerArgs));
+    for (int i = 0; i < thread_count; i++) {
+        args[i].state = state;
+        args[i].seed = (unsigned int)(i + 1);
+        void* (*fn)(void*) = i < readers ? reader_thread
+                           : i == readers ? viewer_thread : writer_thread;
+        pthread_create(&threads[i], NULL, fn, &args[i]);
+    }
+    sleep(seconds);
+    state->stop = true;
+
+    uint64_t lookups = 0;
+    for (int i = 0; i < thread_count; i++) {
+        pthread_join(threads[i], NULL);
+        if (i < readers) {
+            lookups += args[i].ops;
+        }
+    }
+    printf("  %-8s %14.0f %12.1f %12.1f\n",
+           lock_mode_name(mode),
+           (double)lookups / seconds,
+           (double)args[readers].ops / seconds,
+           (double)args[readers + 1].ops / seconds);
+    free(threads);
+    free(args);
+}
+
+int main(int argc, char* argv[]) {
+    int readers = argc > 1 ? atoi(argv[1]) : 4;
+    int seconds = argc > 2 ? atoi(argv[2]) : 2;
+    int file_count = argc > 3 ? atoi(argv[3]) : 20000;
+    if (readers <= 0 || seconds <= 0 || file_count <= 0) {
+        fprintf(stderr, "Usage: %s [readers] [seconds] [file_count]\n", argv[0]);
+        return 1;
+    }
+
+    BenchState state;
+    memset(&state, 0, sizeof(state));
+    pthread_mutex_init(&state.mutex, NULL);
+    pthread_rwlock_init(&state.rwlock_reader, NULL);
+    pthread_rwlockattr_t attr;
+    pthread_rwlockattr_init(&attr);
+    pthread_rwlockattr_setkind_np(&attr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+    pthread_rwlock_init(&state.rwlock_writer, &attr);
+    pthread_rwlockattr_destroy(&attr);
+    state.trie = create_trie_node();
+    state.file_count = file_count;
+    state.names = malloc(sizeof(char*) * file_count);
+    for (int i = 0; i < file_count; i++) {
+        char name[MAX_FILENAME];
+        snprintf(name, sizeof(name), "user%02d/project%03d/src/file%05d.txt",
+                 i % 37, (i / 37) % 211, i);
+        state.names[i] = strdup(name);
+        insert_file_trie(state.trie, name, calloc(1, sizeof(FileMetadata)));
+    }
+
+    printf("trie_lock_bench: %d readers + 1 full-tree walker + 1 writer, %d files, %ds per mode, %ld cores\n",
+           readers, file_count, seconds, sysconf(_SC_NPROCESSORS_ONLN));
+    printf("  %-8s %14s %12s %12s\n", "lock", "lookups/s", "walks/s", "writes/s");
+    run_mode(&state, LOCK_MUTEX, readers, seconds);
+    run_mode(&state, LOCK_RWLOCK_READER, readers, seconds);
+    run_mode(&state, LOCK_RWLOCK_WRITER, readers, seconds);
+
+    destroy_trie(state.trie);
+    for (int i = 0; i < file_count; i++) {
+        free(state.names[i]);
+    }
+    free(state.names);
+    pthread_rwlock_destroy(&state.rwlock_reader);
+    pthread_rwlock_destroy(&state.rwlock_writer);
+    pthread_mutex_destroy(&state.mutex);
+    return 0;
+}
@@ -15,7 +15,7 @@ void print_help() {
     printf("  info <file>                   - Get file information\n");
     printf("  read <file>                   - Read file content (direct SS)\n");
     printf("  write <file> <sentence#>      - Write to file (direct SS, ETIRW protocol)\n");
-    printf("  stream <file>                 - Stream file word-by-word (direct SS)\n");
+    printf("  stream <file> [ms]            - Stream file word-by-word (direct SS)\n");
     printf("  exec <file>                   - Execute file as script\n");
     printf("  undo <file>                   - Undo last change\n");
     printf("  addaccess <R|W> <file> <user> - Grant access\n");
@@ -152,10 +152,11 @@ void interactive_mode(Client* client) {
         }
         else if (strcmp(cmd, "stream") == 0) {
             char* filename = strtok(NULL, " ");
+            char* interval = strtok(NULL, " ");
             if (!filename) {
-                printf("Usage: stream <filename>\n");
+                printf("Usage: stream <filename> [interval_ms]\n");
             } else {
-                cmd_stream_file(client, filename);
+                cmd_stream_file(client, filename, interval ? atoi(interval) : -1);
             }
         }
         else if (strcmp(cmd, "exec") == 0) {
@@ -12,6 +12,8 @@
 #include <errno.h>
 #include <ctype.h>
 
+#include "wire.h"
+
 #define BUFFER_SIZE 16384
 #define MAX_FILENAME 256
 #define MAX_USERNAME 64
@@ -68,7 +70,7 @@ void cmd_list_checkpoints(Client* client, const char* filename);
 // Direct Storage Server operations
 void cmd_read_file(Client* client, const char* filename);
 void cmd_write_file(Client* client, const char* filename, int sentence_num);
-void cmd_stream_file(Client* client, const char* filename);
+void cmd_stream_file(Client* client, const char* filename, int interval_ms);  // < 0: SS default
 
 // Helper functions
 bool get_ss_info(Client* client, const char* command, char* ss_ip, int* ss_port);
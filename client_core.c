@@ -3,6 +3,19 @@
 
 // ==================== CORE CLIENT FUNCTIONS ====================
 
+// Receives one framed reply into response (truncated to fit); returns its length or -1
+static int receive_reply(int socket_fd, char* response, size_t response_size) {
+    WireMessage msg;
+    if (wire_recv(socket_fd, &msg) <= 0) {
+        return -1;
+    }
+    size_t length = msg.length < response_size - 1 ? msg.length : response_size - 1;
+    memcpy(response, msg.payload, length);
+    response[length] = '\0';
+    wire_message_free(&msg);
+    return (int)length;
+}
+
 Client* create_client(const char* username, const char* nm_host, int nm_port) {
     Client* client = (Client*)malloc(sizeof(Client));
     if (!client) {
@@ -68,10 +81,10 @@ bool connect_to_nm(Client* client) {
     
     // Register with Name Server
     char register_cmd[256];
-    snprintf(register_cmd, sizeof(register_cmd), "REGISTER_CLIENT %s %d %d\n",
+    snprintf(register_cmd, sizeof(register_cmd), "REGISTER_CLIENT %s %d %d",
              client->username, client->client_nm_port, client->client_ss_port);
     
-    if (send(client->nm_socket, register_cmd, strlen(register_cmd), 0) < 0) {
+    if (!wire_send_text(client->nm_socket, WIRE_OP_REQUEST, 0, register_cmd)) {
         perror("Failed to send registration");
         close(client->nm_socket);
         client->nm_socket = -1;
@@ -80,14 +93,12 @@ bool connect_to_nm(Client* client) {
     
     // Receive registration response
     char response[BUFFER_SIZE];
-    ssize_t bytes = recv(client->nm_socket, response, sizeof(response) - 1, 0);
-    if (bytes <= 0) {
+    if (receive_reply(client->nm_socket, response, sizeof(response)) < 0) {
         perror("Failed to receive registration response");
         close(client->nm_socket);
         client->nm_socket = -1;
         return false;
     }
-    response[bytes] = '\0';
     
     // Parse response
     int error_code;
@@ -112,8 +123,7 @@ bool connect_to_nm(Client* client) {
 void disconnect_client(Client* client) {
     if (client->connected && client->nm_socket >= 0) {
         // Send QUIT command
-        const char* quit_cmd = "QUIT\n";
-        send(client->nm_socket, quit_cmd, strlen(quit_cmd), 0);
+        wire_send_text(client->nm_socket, WIRE_OP_REQUEST, 0, "QUIT");
         
         close(client->nm_socket);
         client->nm_socket = -1;
@@ -137,23 +147,15 @@ int send_nm_command(Client* client, const char* command, char* response, size_t
         return -1;
     }
     
-    // Send command with newline
-    char cmd_with_newline[BUFFER_SIZE];
-    snprintf(cmd_with_newline, sizeof(cmd_with_newline), "%s\n", command);
-    
-    if (send(client->nm_socket, cmd_with_newline, strlen(cmd_with_newline), 0) < 0) {
+    if (!wire_send_text(client->nm_socket, WIRE_OP_REQUEST, 0, command)) {
         snprintf(response, response_size, "99:Failed to send command");
         return -1;
     }
     
-    // Receive response
-    ssize_t bytes = recv(client->nm_socket, response, response_size - 1, 0);
-    if (bytes <= 0) {
+    int bytes = receive_reply(client->nm_socket, response, response_size);
+    if (bytes < 0) {
         snprintf(response, response_size, "99:Failed to receive response");
-        return -1;
     }
-    response[bytes] = '\0';
-    
     return bytes;
 }
 
@@ -211,23 +213,15 @@ int connect_to_ss(const char* ss_ip, int ss_port) {
 }
 
 int send_ss_command(int ss_socket, const char* command, char* response, size_t response_size) {
-    // Send command with newline
-    char cmd_with_newline[BUFFER_SIZE];
-    snprintf(cmd_with_newline, sizeof(cmd_with_newline), "%s\n", command);
-    
-    if (send(ss_socket, cmd_with_newline, strlen(cmd_with_newline), 0) < 0) {
+    if (!wire_send_text(ss_socket, WIRE_OP_REQUEST, 0, command)) {
         snprintf(response, response_size, "ERROR:Failed to send command");
         return -1;
     }
     
-    // Receive response
-    ssize_t bytes = recv(ss_socket, response, response_size - 1, 0);
-    if (bytes <= 0) {
+    int bytes = receive_reply(ss_socket, response, response_size);
+    if (bytes < 0) {
         snprintf(response, response_size, "ERROR:Failed to receive response");
-        return -1;
     }
-    response[bytes] = '\0';
-    
     return bytes;
 }
 
@@ -154,7 +154,7 @@ void cmd_write_file(Client* client, const char* filename, int sentence_num) {
     close(ss_socket);
 }
 
-void cmd_stream_file(Client* client, const char* filename) {
+void cmd_stream_file(Client* client, const char* filename, int interval_ms) {
     // Step 1: Get SS info from Name Server
     char command[512];
     snprintf(command, sizeof(command), "STREAM %s", filename);
@@ -176,24 +176,21 @@ void cmd_stream_file(Client* client, const char* filename) {
     
     // Step 3: Send STREAM command to SS
     char ss_command[512];
-    snprintf(ss_command, sizeof(ss_command), "STREAM %s", filename);
+    if (interval_ms >= 0) {
+        snprintf(ss_command, sizeof(ss_command), "STREAM %s %d", filename, interval_ms);
+    } else {
+        snprintf(ss_command, sizeof(ss_command), "STREAM %s", filename);
+    }
     
-    if (send(ss_socket, ss_command, strlen(ss_command), 0) < 0) {
+    if (!wire_send_text(ss_socket, WIRE_OP_REQUEST, 0, ss_command)) {
         perror("Failed to send STREAM command");
         close(ss_socket);
         return;
     }
     
-    // Don't add newline for STREAM - check SS implementation
-    const char* newline = "\n";
-    send(ss_socket, newline, 1, 0);
-    
     // Step 4: Receive and display words one by one
     printf("\n--- Streaming File ---\n");
 
-    char buffer[BUFFER_SIZE];
-    char pending[BUFFER_SIZE];
-    size_t pending_len = 0;
     bool saw_data = false;
     bool done = false;
     bool first_token = true;
@@ -201,77 +198,42 @@ void cmd_stream_file(Client* client, const char* filename) {
     int last_err = 0;
 
     while (!done) {
-        ssize_t bytes = recv(ss_socket, buffer, sizeof(buffer), 0);
+        WireMessage msg;
+        int status = wire_recv(ss_socket, &msg);
+        if (status <= 0) {
+            // 0 -> orderly shutdown by peer, -1 -> error or truncated frame
+            if (status < 0) {
+                last_err = errno;
+            }
+            break;
+        }
 
-        if (bytes > 0) {
+        if (msg.opcode == WIRE_OP_STREAM) {
             saw_data = true;
 
-            if (pending_len + (size_t)bytes >= sizeof(pending)) {
-                pending_len = 0;  // Prevent overflow by dropping stale partial data
+            // Words may still carry the old line terminator
+            if (msg.length > 0 && msg.payload[msg.length - 1] == '\n') {
+                msg.payload[--msg.length] = '\0';
             }
-
-            memcpy(pending + pending_len, buffer, (size_t)bytes);
-            pending_len += (size_t)bytes;
-
-            size_t processed = 0;
-            while (processed < pending_len) {
-                char* newline = memchr(pending + processed, '\n', pending_len - processed);
-                if (!newline) {
-                    break;  // Need more data for a complete line
-                }
-
-                size_t line_len = (size_t)(newline - (pending + processed));
-                char line[BUFFER_SIZE];
-                if (line_len >= sizeof(line)) {
-                    line_len = sizeof(line) - 1;
-                }
-                memcpy(line, pending + processed, line_len);
-                line[line_len] = '\0';
-
-                if (processed == 0 && strncmp(line, "ERROR:", 6) == 0) {
-                    printf("✗ %s\n", line + 6);
-                    done = true;
-                    break;
-                }
-
-                if (strcmp(line, "STOP") == 0) {
-                    done = true;
-                    break;
-                }
-
-                if (line_len > 0) {
-                    if (!first_token) {
-                        printf(" ");
-                    }
-
-                    printf("%s", line);
-                    fflush(stdout);
-                    first_token = false;
+            if (msg.length > 0) {
+                if (!first_token) {
+                    printf(" ");
                 }
 
-                processed = (size_t)(newline - pending) + 1;
-            }
-
-            if (processed > 0) {
-                memmove(pending, pending + processed, pending_len - processed);
-                pending_len -= processed;
+                printf("%s", msg.payload);
+                fflush(stdout);
+                first_token = false;
             }
-
-            continue;
-        }
-
-        // bytes <= 0 -> connection closed or error
-        if (bytes == 0) {
-            // orderly shutdown by peer
-            break;
+        } else if (strncmp(msg.payload, "ERROR:", 6) == 0) {
+            size_t len = strcspn(msg.payload + 6, "\n");
+            printf("✗ %.*s\n", (int)len, msg.payload + 6);
+            done = true;
         } else {
-            if (errno == EINTR) {
-                // Interrupted by signal, retry
-                continue;
-            }
-            last_err = errno;
-            break;
+            // STOP: the end-of-stream reply
+            done = true;
         }
+
+        wire_message_free(&msg);
     }
 
     if (!done) {
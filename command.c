@@ -0,0 +1,130 @@
+#include "command.h"
+#include <stdlib.h>
+#include <string.h>
+
+// ==================== TOKENIZER ====================
+
+static inline bool is_separator(char c) {
+    return c == ' ' || c == '\t' || c == '\n';
+}
+
+static bool push_arg(Command* command, char* token) {
+    if (command->arg_count == command->arg_capacity) {
+        int new_capacity = command->arg_capacity * 2;
+        char** grown;
+        if (command->args == command->inline_args) {
+            grown = (char**)malloc(sizeof(char*) * new_capacity);
+            if (grown) {
+                memcpy(grown, command->inline_args, sizeof(char*) * command->arg_count);
+            }
+        } else {
+            grown = (char**)realloc(command->args, sizeof(char*) * new_capacity);
+        }
+        if (!grown) {
+            return false;
+        }
+        command->args = grown;
+        command->arg_capacity = new_capacity;
+    }
+    command->args[command->arg_count++] = token;
+    return true;
+}
+
+bool command_parse(char* message, Command* command) {
+    command->name = NULL;
+    command->args = command->inline_args;
+    command->arg_count = 0;
+    command->arg_capacity = COMMAND_INLINE_ARGS;
+
+    char* p = message;
+    while (*p) {
+        while (is_separator(*p)) {
+            *p++ = '\0';
+        }
+        if (!*p) {
+            break;
+        }
+
+        char* token = p;
+        while (*p && !is_separator(*p)) {
+            p++;
+        }
+
+        if (!command->name) {
+            command->name = token;
+        } else if (!push_arg(command, token)) {
+            command_free(command);
+            return false;
+        }
+    }
+
+    if (!command->name) {
+        command->name = p;  // Empty string at the end of the message
+    }
+    return true;
+}
+
+void command_free(Command* command) {
+    if (command->args != command->inline_args) {
+        free(command->args);
+    }
+    command->args = command->inline_args;
+    command->arg_count = 0;
+    command->arg_capacity = COMMAND_INLINE_ARGS;
+}
+
+// ==================== PERFECT-HASH TABLE ====================
+
+static inline uint32_t hash_name(const char* name, uint32_t seed) {
+    uint32_t hash = 2166136261u ^ seed;  // FNV-1a
+    for (const unsigned char* p = (const unsigned char*)name; *p; p++) {
+        hash ^= *p;
+        hash *= 16777619u;
+    }
+    return (hash ^ (hash >> 15)) & (COMMAND_TABLE_SLOTS - 1);
+}
+
+static inline const char* entry_name(const CommandTable* table, int index) {
+    const char* const* name = (const char* const*)(table->entries + (size_t)index * table->entry_size);
+    return *name;
+}
+
+bool command_table_init(CommandTable* table, const void* entries, size_t entry_size, int count) {
+    memset(table->slots, -1, sizeof(table->slots));  // Failed tables match nothing
+    table->seed = 0;
+    if (count <= 0 || count > COMMAND_TABLE_SLOTS / 2) {
+        return false;
+    }
+
+    table->entries = (const char*)entries;
+    table->entry_size = entry_size;
+    table->count = count;
+
+    // A few dozen names in 128 slots needs only a handful of attempts
+    for (uint32_t seed = 0; seed < 100000; seed++) {
+        memset(table->slots, -1, sizeof(table->slots));
+        bool collision = false;
+        for (int i = 0; i < count && !collision; i++) {
+            uint32_t slot = hash_name(entry_name(table, i), seed);
+            if (table->slots[slot] >= 0) {
+                collision = true;
+            } else {
+                table->slots[slot] = (int8_t)i;
+            }
+        }
+        if (!collision) {
+            table->seed = seed;
+            return true;
+        }
+    }
+    memset(table->slots, -1, sizeof(table->slots));
+    return false;
+}
+
+const void* command_table_find(const CommandTable* table, const char* name) {
+    int index = table->slots[hash_name(name, table->seed)];
+    if (index < 0 || strcmp(entry_name(table, index), name) != 0) {
+        return NULL;
+    }
+    return table->entries + (size_t)index * table->entry_size;
+}
@@ -0,0 +1,46 @@
+#ifndef COMMAND_H
+#define COMMAND_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Text command parsing shared by the Name Server and Storage Server.
+//
+// command_parse tokenizes a message in place: whitespace is overwritten with
+// NULs and the name/args point straight into the message buffer, so the
+// buffer must stay alive (and unmodified) while the Command is in use.
+// Arguments live in an inline array and only spill to the heap for long
+// argument lists such as a REGISTER_SS file list; there is no argument cap.
+
+#define COMMAND_INLINE_ARGS 16
+#define COMMAND_TABLE_SLOTS 128
+
+typedef struct Command {
+    char* name;                      // First token ("" for a blank message)
+    char** args;                     // Remaining tokens
+    int arg_count;
+    int arg_capacity;
+    char* inline_args[COMMAND_INLINE_ARGS];
+} Command;
+
+// Perfect-hash lookup over a static table of entries. Every entry must start
+// with its `const char* name`; the hash seed is searched once at init so that
+// every name owns a distinct slot and a lookup is one hash plus one strcmp.
+typedef struct CommandTable {
+    const char* entries;
+    size_t entry_size;
+    int count;
+    uint32_t seed;
+    int8_t slots[COMMAND_TABLE_SLOTS];  // Entry index, -1 = empty
+} CommandTable;
+
+// Parsing: returns false only if a spilled argument array cannot be allocated
+bool command_parse(char* message, Command* command);
+void command_free(Command* command);
+
+// Lookup tables
+bool command_table_init(CommandTable* table, const void* entries, size_t entry_size, int count);
+const void* command_table_find(const CommandTable* table, const char* name);
+
+#endif // COMMAND_H
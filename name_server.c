@@ -1,3 +1,4 @@
+#define _GNU_SOURCE  // pthread_rwlockattr_setkind_np
 #include "name_server.h"
 #include <errno.h>
 #include <signal.h>
@@ -29,23 +30,10 @@ const char* error_to_string(ErrorCode error) {
 void log_message(NameServer* nm, const char* level, const char* client_ip, 
                 int client_port, const char* username, const char* operation, 
                 const char* details) {
-    pthread_mutex_lock(&nm->log_lock);
-    
-    time_t now = time(NULL);
-    char timestamp[64];
-    strftime(timestamp, sizeof(timestamp), "%Y-%m-%d %H:%M:%S", localtime(&now));
-    
-    // Log to file
-    fprintf(nm->log_file, "[%s] [%s] IP=%s Port=%d User=%s Op=%s Details=%s\n",
-            timestamp, level, client_ip ? client_ip : "N/A", client_port,
-            username ? username : "N/A", operation, details ? details : "");
-    fflush(nm->log_file);
-    
-    // Also print to terminal
-    printf("[%s] [%s] %s - %s\n", timestamp, level, operation, 
-           details ? details : "");
-    
-    pthread_mutex_unlock(&nm->log_lock);
+    char context[LOG_CONTEXT_LEN];
+    snprintf(context, sizeof(context), "IP=%s Port=%d User=%s ",
+             client_ip ? client_ip : "N/A", client_port, username ? username : "N/A");
+    async_log_append(&nm->log, level, context, operation, details);
 }
 
 // Persistence helpers (forward declarations)
@@ -75,171 +63,732 @@ static void free_access_requests(AccessRequest* head) {
     }
 }
 
-TrieNode* create_trie_node() {
-    TrieNode* node = (TrieNode*)calloc(1, sizeof(TrieNode));
+static void free_file_metadata(FileMetadata* metadata) {
+    if (!metadata) return;
+    free_acl_list(metadata->acl);
+    free_access_requests(metadata->pending_requests);
+    free(metadata);
+}
+
+// The trie's reference is implicit (refs == 0 means "only the trie"), so
+// metadata needs no initialization beyond calloc. Pins are taken under a
+// cache bucket lock or trie_lock, which deletion also takes before it
+// drops the trie's reference; whichever drop takes refs below zero frees.
+void release_metadata(FileMetadata* metadata) {
+    if (metadata && atomic_fetch_sub(&metadata->refs, 1) == 0) {
+        free_file_metadata(metadata);
+    }
+}
+
+static size_t trie_node_size(uint8_t type) {
+    switch (type) {
+        case TRIE_NODE4: return sizeof(TrieNode4);
+        case TRIE_NODE16: return sizeof(TrieNode16);
+        case TRIE_NODE48: return sizeof(TrieNode48);
+        default: return sizeof(TrieNode256);
+    }
+}
+
+static TrieNode* trie_alloc_node(uint8_t type) {
+    TrieNode* node = (TrieNode*)calloc(1, trie_node_size(type));
     if (!node) {
         perror("Failed to allocate trie node");
         return NULL;
     }
-    node->is_end_of_word = false;
-    node->file_metadata = NULL;
+    node->type = type;
     return node;
 }
 
-void insert_file_trie(TrieNode* root, const char* filename, FileMetadata* metadata) {
-    TrieNode* current = root;
-    for (int i = 0; filename[i] != '\0'; i++) {
-        unsigned char index = (unsigned char)filename[i];
-        if (!current->children[index]) {
-            current->children[index] = create_trie_node();
+static void trie_set_prefix(TrieNode* node, const char* data, size_t len) {
+    char* prefix = NULL;
+    if (len > 0) {
+        prefix = (char*)malloc(len);
+        if (!prefix) {
+            return;
         }
-        current = current->children[index];
+        memcpy(prefix, data, len);
     }
-    current->is_end_of_word = true;
-    current->file_metadata = metadata;
+    free(node->prefix);
+    node->prefix = prefix;
+    node->prefix_len = (uint16_t)len;
 }
 
-FileMetadata* search_file_trie(TrieNode* root, const char* filename) {
-    TrieNode* current = root;
-    for (int i = 0; filename[i] != '\0'; i++) {
-        unsigned char index = (unsigned char)filename[i];
-        if (!current->children[index]) {
+// Number of leading bytes of the node's segment that match key (stops at key's NUL)
+static size_t trie_prefix_match(const TrieNode* node, const char* key) {
+    size_t i = 0;
+    while (i < node->prefix_len && key[i] != '\0' && node->prefix[i] == key[i]) {
+        i++;
+    }
+    return i;
+}
+
+static TrieNode* trie_new_leaf(const char* suffix, FileMetadata* metadata) {
+    TrieNode* leaf = trie_alloc_node(TRIE_NODE4);
+    if (!leaf) return NULL;
+    trie_set_prefix(leaf, suffix, strlen(suffix));
+    leaf->file_metadata = metadata;
+    return leaf;
+}
+
+static TrieNode** trie_find_child(TrieNode* node, unsigned char c) {
+    switch (node->type) {
+        case TRIE_NODE4: {
+            TrieNode4* n = (TrieNode4*)node;
+            for (int i = 0; i < node->child_count; i++) {
+                if (n->keys[i] == c) return &n->children[i];
+            }
+            return NULL;
+        }
+        case TRIE_NODE16: {
+            TrieNode16* n = (TrieNode16*)node;
+            for (int i = 0; i < node->child_count; i++) {
+                if (n->keys[i] == c) return &n->children[i];
+            }
+            return NULL;
+        }
+        case TRIE_NODE48: {
+            TrieNode48* n = (TrieNode48*)node;
+            return n->child_index[c] ? &n->children[n->child_index[c] - 1] : NULL;
+        }
+        default: {
+            TrieNode256* n = (TrieNode256*)node;
+            return n->children[c] ? &n->children[c] : NULL;
+        }
+    }
+}
+
+// Moves header fields (segment, file, count) into a freshly allocated node of another size
+static TrieNode* trie_resize_node(TrieNode* node, uint8_t new_type) {
+    TrieNode* resized = trie_alloc_node(new_type);
+    if (!resized) return NULL;
+    resized->child_count = node->child_count;
+    resized->prefix_len = node->prefix_len;
+    resized->prefix = node->prefix;
+    resized->file_metadata = node->file_metadata;
+
+    unsigned char keys[256];
+    TrieNode* children[256];
+    int count = 0;
+    switch (node->type) {
+        case TRIE_NODE4: {
+            TrieNode4* n = (TrieNode4*)node;
+            for (int i = 0; i < node->child_count; i++) {
+                keys[count] = n->keys[i];
+                children[count++] = n->children[i];
+            }
+            break;
+        }
+        case TRIE_NODE16: {
+            TrieNode16* n = (TrieNode16*)node;
+            for (int i = 0; i < node->child_count; i++) {
+                keys[count] = n->keys[i];
+                children[count++] = n->children[i];
+            }
+            break;
+        }
+        case TRIE_NODE48: {
+            TrieNode48* n = (TrieNode48*)node;
+            for (int c = 0; c < 256; c++) {
+                if (n->child_index[c]) {
+                    keys[count] = (unsigned char)c;
+                    children[count++] = n->children[n->child_index[c] - 1];
+                }
+            }
+            break;
+        }
+        default: {
+            TrieNode256* n = (TrieNode256*)node;
+            for (int c = 0; c < 256; c++) {
+                if (n->children[c]) {
+                    keys[count] = (unsigned char)c;
+                    children[count++] = n->children[c];
+                }
+            }
+            break;
+        }
+    }
+
+    // Children were collected in byte order, so Node4/16 stay sorted
+    switch (new_type) {
+        case TRIE_NODE4: {
+            TrieNode4* n = (TrieNode4*)resized;
+            memcpy(n->keys, keys, count);
+            memcpy(n->children, children, count * sizeof(TrieNode*));
+            break;
+        }
+        case TRIE_NODE16: {
+            TrieNode16* n = (TrieNode16*)resized;
+            memcpy(n->keys, keys, count);
+            memcpy(n->children, children, count * sizeof(TrieNode*));
+            break;
+        }
+        case TRIE_NODE48: {
+            TrieNode48* n = (TrieNode48*)resized;
+            for (int i = 0; i < count; i++) {
+                n->children[i] = children[i];
+                n->child_index[keys[i]] = (unsigned char)(i + 1);
+            }
+            break;
+        }
+        default: {
+            TrieNode256* n = (TrieNode256*)resized;
+            for (int i = 0; i < count; i++) {
+                n->children[keys[i]] = children[i];
+            }
+            break;
+        }
+    }
+
+    free(node);
+    return resized;
+}
+
+static void trie_sorted_insert(unsigned char* keys, TrieNode** children, int count,
+                               unsigned char c, TrieNode* child) {
+    int pos = 0;
+    while (pos < count && keys[pos] < c) {
+        pos++;
+    }
+    memmove(keys + pos + 1, keys + pos, count - pos);
+    memmove(children + pos + 1, children + pos, (count - pos) * sizeof(TrieNode*));
+    keys[pos] = c;
+    children[pos] = child;
+}
+
+// Adds an edge, growing the node when full; *ref is updated if the node moves
+static void trie_add_child(TrieNode** ref, unsigned char c, TrieNode* child) {
+    TrieNode* node = *ref;
+    static const int capacity[] = { 4, 16, 48, 256 };
+    if (node->child_count >= capacity[node->type]) {
+        TrieNode* grown = trie_resize_node(node, (uint8_t)(node->type + 1));
+        if (!grown) return;
+        *ref = node = grown;
+    }
+
+    switch (node->type) {
+        case TRIE_NODE4: {
+            TrieNode4* n = (TrieNode4*)node;
+            trie_sorted_insert(n->keys, n->children, node->child_count, c, child);
+            break;
+        }
+        case TRIE_NODE16: {
+            TrieNode16* n = (TrieNode16*)node;
+            trie_sorted_insert(n->keys, n->children, node->child_count, c, child);
+            break;
+        }
+        case TRIE_NODE48: {
+            TrieNode48* n = (TrieNode48*)node;
+            int slot = 0;
+            while (n->children[slot]) {
+                slot++;
+            }
+            n->children[slot] = child;
+            n->child_index[c] = (unsigned char)(slot + 1);
+            break;
+        }
+        default:
+            ((TrieNode256*)node)->children[c] = child;
+            break;
+    }
+    node->child_count++;
+}
+
+// Removes an edge, shrinking underfull nodes (never the root)
+static void trie_remove_child(TrieNode** ref, unsigned char c, bool is_root) {
+    TrieNode* node = *ref;
+    switch (node->type) {
+        case TRIE_NODE4:
+        case TRIE_NODE16: {
+            unsigned char* keys = (node->type == TRIE_NODE4) ? ((TrieNode4*)node)->keys
+                                                             : ((TrieNode16*)node)->keys;
+            TrieNode** children = (node->type == TRIE_NODE4) ? ((TrieNode4*)node)->children
+                                                             : ((TrieNode16*)node)->children;
+            int pos = 0;
+            while (pos < node->child_count && keys[pos] != c) {
+                pos++;
+            }
+            if (pos == node->child_count) return;
+            memmove(keys + pos, keys + pos + 1, node->child_count - pos - 1);
+            memmove(children + pos, children + pos + 1,
+                    (node->child_count - pos - 1) * sizeof(TrieNode*));
+            break;
+        }
+        case TRIE_NODE48: {
+            TrieNode48* n = (TrieNode48*)node;
+            if (!n->child_index[c]) return;
+            n->children[n->child_index[c] - 1] = NULL;
+            n->child_index[c] = 0;
+            break;
+        }
+        default:
+            // The slot may already be cleared by the recursive delete
+            ((TrieNode256*)node)->children[c] = NULL;
+            break;
+    }
+    node->child_count--;
+
+    if (is_root) return;
+    static const int shrink_at[] = { 0, 3, 12, 37 };
+    if (node->type != TRIE_NODE4 && node->child_count <= shrink_at[node->type]) {
+        TrieNode* shrunk = trie_resize_node(node, (uint8_t)(node->type - 1));
+        if (shrunk) {
+            *ref = shrunk;
+        }
+    }
+}
+
+// Returns the single child of a node (used when collapsing a pass-through node)
+static TrieNode* trie_only_child(TrieNode* node, unsigned char* edge) {
+    switch (node->type) {
+        case TRIE_NODE4:
+            *edge = ((TrieNode4*)node)->keys[0];
+            return ((TrieNode4*)node)->children[0];
+        case TRIE_NODE16:
+            *edge = ((TrieNode16*)node)->keys[0];
+            return ((TrieNode16*)node)->children[0];
+        case TRIE_NODE48: {
+            TrieNode48* n = (TrieNode48*)node;
+            for (int c = 0; c < 256; c++) {
+                if (n->child_index[c]) {
+                    *edge = (unsigned char)c;
+                    return n->children[n->child_index[c] - 1];
+                }
+            }
             return NULL;
         }
-        current = current->children[index];
+        default: {
+            TrieNode256* n = (TrieNode256*)node;
+            for (int c = 0; c < 256; c++) {
+                if (n->children[c]) {
+                    *edge = (unsigned char)c;
+                    return n->children[c];
+                }
+            }
+            return NULL;
+        }
+    }
+}
+
+TrieNode* create_trie_node() {
+    // The root never moves (callers hold it by value), so it starts at full width
+    return trie_alloc_node(TRIE_NODE256);
+}
+
+static void trie_insert_at(TrieNode** ref, const char* key, FileMetadata* metadata) {
+    TrieNode* node = *ref;
+    size_t matched = trie_prefix_match(node, key);
+
+    if (matched < node->prefix_len) {
+        // Split the compressed segment at the first differing byte
+        TrieNode* split = trie_alloc_node(TRIE_NODE4);
+        if (!split) return;
+        trie_set_prefix(split, node->prefix, matched);
+        unsigned char edge = (unsigned char)node->prefix[matched];
+        trie_set_prefix(node, node->prefix + matched + 1, node->prefix_len - matched - 1);
+        trie_add_child(&split, edge, node);
+
+        if (key[matched] == '\0') {
+            split->file_metadata = metadata;
+        } else {
+            TrieNode* leaf = trie_new_leaf(key + matched + 1, metadata);
+            if (leaf) {
+                trie_add_child(&split, (unsigned char)key[matched], leaf);
+            }
+        }
+        *ref = split;
+        return;
     }
-    if (current->is_end_of_word) {
-        return (FileMetadata*)current->file_metadata;
+
+    key += node->prefix_len;
+    if (*key == '\0') {
+        node->file_metadata = metadata;
+        return;
+    }
+
+    TrieNode** child = trie_find_child(node, (unsigned char)*key);
+    if (child) {
+        trie_insert_at(child, key + 1, metadata);
+        return;
+    }
+
+    TrieNode* leaf = trie_new_leaf(key + 1, metadata);
+    if (leaf) {
+        trie_add_child(ref, (unsigned char)*key, leaf);
+    }
+}
+
+void insert_file_trie(TrieNode* root, const char* filename, FileMetadata* metadata) {
+    if (!root || !filename || *filename == '\0') return;
+    TrieNode* node = root;
+    TrieNode** child = trie_find_child(node, (unsigned char)filename[0]);
+    if (child) {
+        trie_insert_at(child, filename + 1, metadata);
+        return;
+    }
+    TrieNode* leaf = trie_new_leaf(filename + 1, metadata);
+    if (leaf) {
+        trie_add_child(&node, (unsigned char)filename[0], leaf);
+    }
+}
+
+FileMetadata* search_file_trie(TrieNode* root, const char* filename) {
+    TrieNode* node = root;
+    const char* key = filename;
+    while (node) {
+        size_t matched = trie_prefix_match(node, key);
+        if (matched < node->prefix_len) {
+            return NULL;
+        }
+        key += node->prefix_len;
+        if (*key == '\0') {
+            return (FileMetadata*)node->file_metadata;
+        }
+        TrieNode** child = trie_find_child(node, (unsigned char)*key);
+        if (!child) {
+            return NULL;
+        }
+        node = *child;
+        key++;
     }
     return NULL;
 }
 
-void delete_file_trie(TrieNode* root, const char* filename) {
-    TrieNode* current = root;
-    for (int i = 0; filename[i] != '\0'; i++) {
-        unsigned char index = (unsigned char)filename[i];
-        if (!current->children[index]) {
-            return;  // File not in trie
+static void trie_free_node(TrieNode* node) {
+    free(node->prefix);
+    free(node);
+}
+
+// Returns true if the key was found and removed; prunes empty and pass-through nodes
+static bool trie_delete_at(TrieNode** ref, const char* key, bool is_root) {
+    TrieNode* node = *ref;
+    size_t matched = trie_prefix_match(node, key);
+    if (matched < node->prefix_len) {
+        return false;
+    }
+    key += node->prefix_len;
+
+    if (*key == '\0') {
+        if (!node->file_metadata) {
+            return false;
+        }
+        release_metadata((FileMetadata*)node->file_metadata);  // The trie's reference
+        node->file_metadata = NULL;
+    } else {
+        unsigned char edge = (unsigned char)*key;
+        TrieNode** child = trie_find_child(node, edge);
+        if (!child || !trie_delete_at(child, key + 1, false)) {
+            return false;
         }
-        current = current->children[index];
+        if (*child == NULL) {
+            trie_remove_child(ref, edge, is_root);
+            node = *ref;
+        }
+    }
+
+    if (is_root || node->file_metadata) {
+        return true;
     }
-    if (current->is_end_of_word) {
-        current->is_end_of_word = false;
-        if (current->file_metadata) {
-            FileMetadata* metadata = (FileMetadata*)current->file_metadata;
-            free_acl_list(metadata->acl);
-            free_access_requests(metadata->pending_requests);
-            free(metadata);
-            current->file_metadata = NULL;
+
+    if (node->child_count == 0) {
+        trie_free_node(node);
+        *ref = NULL;
+    } else if (node->child_count == 1) {
+        // Fold this node's segment and edge byte into its only child
+        unsigned char edge = 0;
+        TrieNode* child = trie_only_child(node, &edge);
+        size_t merged_len = (size_t)node->prefix_len + 1 + child->prefix_len;
+        char* merged = (char*)malloc(merged_len);
+        if (merged) {
+            // Empty segments have a NULL prefix, which memcpy must not see
+            if (node->prefix_len > 0) {
+                memcpy(merged, node->prefix, node->prefix_len);
+            }
+            merged[node->prefix_len] = (char)edge;
+            if (child->prefix_len > 0) {
+                memcpy(merged + node->prefix_len + 1, child->prefix, child->prefix_len);
+            }
+            free(child->prefix);
+            child->prefix = merged;
+            child->prefix_len = (uint16_t)merged_len;
+            *ref = child;
+            trie_free_node(node);
         }
     }
+    return true;
 }
 
-void destroy_trie(TrieNode* root) {
-    if (!root) return;
-    for (int i = 0; i < 256; i++) {
-        if (root->children[i]) {
-            destroy_trie(root->children[i]);
+void delete_file_trie(TrieNode* root, const char* filename) {
+    if (!root || !filename) return;
+    TrieNode* node = root;
+    trie_delete_at(&node, filename, true);
+}
+
+static void trie_visit_subtree(TrieNode* node, TrieVisitor visit, void* ctx) {
+    if (node->file_metadata) {
+        visit((FileMetadata*)node->file_metadata, ctx);
+    }
+    switch (node->type) {
+        case TRIE_NODE4:
+            for (int i = 0; i < node->child_count; i++) {
+                trie_visit_subtree(((TrieNode4*)node)->children[i], visit, ctx);
+            }
+            break;
+        case TRIE_NODE16:
+            for (int i = 0; i < node->child_count; i++) {
+                trie_visit_subtree(((TrieNode16*)node)->children[i], visit, ctx);
+            }
+            break;
+        case TRIE_NODE48: {
+            TrieNode48* n = (TrieNode48*)node;
+            for (int c = 0; c < 256; c++) {
+                if (n->child_index[c]) {
+                    trie_visit_subtree(n->children[n->child_index[c] - 1], visit, ctx);
+                }
+            }
+            break;
+        }
+        default: {
+            TrieNode256* n = (TrieNode256*)node;
+            for (int c = 0; c < 256; c++) {
+                if (n->children[c]) {
+                    trie_visit_subtree(n->children[c], visit, ctx);
+                }
+            }
+            break;
         }
     }
-    if (root->file_metadata) {
-        FileMetadata* metadata = (FileMetadata*)root->file_metadata;
-        struct AccessEntry* entry = metadata->acl;
-        while (entry) {
-            struct AccessEntry* next = entry->next;
-            free(entry);
-            entry = next;
+}
+
+// Visits every file whose name starts with prefix, in byte order
+void walk_file_trie(TrieNode* root, const char* prefix, TrieVisitor visit, void* ctx) {
+    TrieNode* node = root;
+    const char* key = prefix ? prefix : "";
+    while (node) {
+        size_t matched = trie_prefix_match(node, key);
+        if (key[matched] == '\0') {
+            trie_visit_subtree(node, visit, ctx);
+            return;
+        }
+        if (matched < node->prefix_len) {
+            return;
+        }
+        key += node->prefix_len;
+        TrieNode** child = trie_find_child(node, (unsigned char)*key);
+        if (!child) {
+            return;
         }
-        free_access_requests(metadata->pending_requests);
-        free(metadata);
+        node = *child;
+        key++;
+    }
+}
+
+void destroy_trie(TrieNode* root) {
+    if (!root) return;
+    switch (root->type) {
+        case TRIE_NODE4:
+            for (int i = 0; i < root->child_count; i++) {
+                destroy_trie(((TrieNode4*)root)->children[i]);
+            }
+            break;
+        case TRIE_NODE16:
+            for (int i = 0; i < root->child_count; i++) {
+                destroy_trie(((TrieNode16*)root)->children[i]);
+            }
+            break;
+        case TRIE_NODE48:
+            for (int i = 0; i < 48; i++) {
+                destroy_trie(((TrieNode48*)root)->children[i]);
+            }
+            break;
+        default:
+            for (int c = 0; c < 256; c++) {
+                destroy_trie(((TrieNode256*)root)->children[c]);
+            }
+            break;
     }
-    free(root);
+    free_file_metadata((FileMetadata*)root->file_metadata);
+    trie_free_node(root);
 }
 
 // ==================== CACHE OPERATIONS ====================
 
-LRUCache* create_cache(int capacity) {
-    LRUCache* cache = (LRUCache*)malloc(sizeof(LRUCache));
-    cache->head = NULL;
-    cache->tail = NULL;
-    cache->size = 0;
-    cache->capacity = capacity;
-    pthread_mutex_init(&cache->lock, NULL);
+// FNV-1a over the filename; bucket index is the low bits
+static unsigned int hash_filename(const char* filename) {
+    unsigned int hash = 2166136261u;
+    for (const unsigned char* p = (const unsigned char*)filename; *p; p++) {
+        hash ^= *p;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static inline CacheBucket* cache_bucket(FileCache* cache, unsigned int hash) {
+    return &cache->buckets[hash & (CACHE_BUCKETS - 1)];
+}
+
+FileCache* create_cache(int capacity) {
+    FileCache* cache = (FileCache*)calloc(1, sizeof(FileCache));
+    if (!cache) {
+        perror("Failed to allocate cache");
+        return NULL;
+    }
+    cache->capacity = capacity > 0 ? capacity : 1;
+    cache->entries = (CacheEntry*)calloc(cache->capacity, sizeof(CacheEntry));
+    if (!cache->entries) {
+        perror("Failed to allocate cache");
+        free(cache);
+        return NULL;
+    }
+    cache->hand = 0;
+    for (int i = 0; i < CACHE_BUCKETS; i++) {
+        pthread_mutex_init(&cache->buckets[i].lock, NULL);
+    }
+    pthread_mutex_init(&cache->clock_lock, NULL);
     return cache;
 }
 
-void move_to_front(LRUCache* cache, CacheEntry* entry) {
-    if (cache->head == entry) return;
-    
-    // Remove from current position
-    if (entry->prev) entry->prev->next = entry->next;
-    if (entry->next) entry->next->prev = entry->prev;
-    if (cache->tail == entry) cache->tail = entry->prev;
-    
-    // Move to front
-    entry->next = cache->head;
-    entry->prev = NULL;
-    if (cache->head) cache->head->prev = entry;
-    cache->head = entry;
-    if (!cache->tail) cache->tail = entry;
+// Caller must hold the bucket's lock
+static CacheEntry* cache_find_locked(CacheBucket* bucket, const char* filename, unsigned int hash) {
+    for (CacheEntry* entry = bucket->head; entry; entry = entry->hash_next) {
+        if (entry->hash == hash && strcmp(entry->filename, filename) == 0) {
+            return entry;
+        }
+    }
+    return NULL;
 }
 
-void put_in_cache(LRUCache* cache, const char* filename, FileMetadata* metadata) {
-    pthread_mutex_lock(&cache->lock);
-    
-    // Check if already exists
-    CacheEntry* current = cache->head;
-    while (current) {
-        if (strcmp(current->filename, filename) == 0) {
-            current->metadata = metadata;
-            current->timestamp = time(NULL);
-            move_to_front(cache, current);
-            pthread_mutex_unlock(&cache->lock);
-            return;
+// Caller must hold the bucket's lock; the slot becomes free for the hand
+static void cache_unlink_locked(CacheBucket* bucket, CacheEntry* entry) {
+    CacheEntry** link = &bucket->head;
+    while (*link && *link != entry) {
+        link = &(*link)->hash_next;
+    }
+    if (*link) {
+        *link = entry->hash_next;
+    }
+    entry->hash_next = NULL;
+    entry->in_use = false;
+}
+
+// Caller holds clock_lock. Sweeps the ring: referenced slots get a second
+// chance, the first unreferenced (or empty) one is unlinked and returned.
+static CacheEntry* cache_claim_slot(FileCache* cache) {
+    for (;;) {
+        CacheEntry* candidate = &cache->entries[cache->hand];
+        cache->hand = (cache->hand + 1) % cache->capacity;
+
+        // A slot's hash only changes under clock_lock, so its bucket is stable
+        CacheBucket* home = cache_bucket(cache, candidate->hash);
+        pthread_mutex_lock(&home->lock);
+        bool claimed = false;
+        if (!candidate->in_use) {
+            claimed = true;
+        } else if (candidate->referenced) {
+            candidate->referenced = false;
+        } else {
+            cache_unlink_locked(home, candidate);
+            claimed = true;
+        }
+        pthread_mutex_unlock(&home->lock);
+        if (claimed) {
+            return candidate;
         }
-        current = current->next;
     }
-    
-    // Create new entry
-    CacheEntry* entry = (CacheEntry*)malloc(sizeof(CacheEntry));
+}
+
+void put_in_cache(FileCache* cache, const char* filename, FileMetadata* metadata) {
+    unsigned int hash = hash_filename(filename);
+    CacheBucket* bucket = cache_bucket(cache, hash);
+
+    // Inserts are serialized so two of them never claim slots for one name
+    pthread_mutex_lock(&cache->clock_lock);
+
+    pthread_mutex_lock(&bucket->lock);
+    CacheEntry* existing = cache_find_locked(bucket, filename, hash);
+    if (existing) {
+        existing->metadata = metadata;
+        existing->referenced = true;
+        pthread_mutex_unlock(&bucket->lock);
+        pthread_mutex_unlock(&cache->clock_lock);
+        return;
+    }
+    pthread_mutex_unlock(&bucket->lock);
+
+    // The claimed slot is unlinked, so no reader can see it being filled
+    CacheEntry* entry = cache_claim_slot(cache);
     strncpy(entry->filename, filename, MAX_FILENAME - 1);
     entry->filename[MAX_FILENAME - 1] = '\0';
     entry->metadata = metadata;
-    entry->timestamp = time(NULL);
-    entry->next = cache->head;
-    entry->prev = NULL;
-    
-    if (cache->head) cache->head->prev = entry;
-    cache->head = entry;
-    if (!cache->tail) cache->tail = entry;
-    
-    cache->size++;
-    
-    // Evict if necessary
-    if (cache->size > cache->capacity) {
-        CacheEntry* old_tail = cache->tail;
-        cache->tail = old_tail->prev;
-        if (cache->tail) cache->tail->next = NULL;
-        free(old_tail);
-        cache->size--;
+    entry->hash = hash;
+    entry->referenced = false;
+
+    pthread_mutex_lock(&bucket->lock);
+    entry->hash_next = bucket->head;
+    bucket->head = entry;
+    entry->in_use = true;
+    pthread_mutex_unlock(&bucket->lock);
+
+    pthread_mutex_unlock(&cache->clock_lock);
+}
+
+// A hit only sets the entry's reference bit; the result is pinned
+FileMetadata* get_from_cache(FileCache* cache, const char* filename) {
+    unsigned int hash = hash_filename(filename);
+    CacheBucket* bucket = cache_bucket(cache, hash);
+
+    pthread_mutex_lock(&bucket->lock);
+    CacheEntry* entry = cache_find_locked(bucket, filename, hash);
+    FileMetadata* metadata = NULL;
+    if (entry) {
+        entry->referenced = true;
+        metadata = entry->metadata;
+        atomic_fetch_add(&metadata->refs, 1);
     }
-    
-    pthread_mutex_unlock(&cache->lock);
+    pthread_mutex_unlock(&bucket->lock);
+
+    return metadata;
 }
 
-void destroy_cache(LRUCache* cache) {
-    pthread_mutex_lock(&cache->lock);
-    CacheEntry* current = cache->head;
-    while (current) {
-        CacheEntry* next = current->next;
-        free(current);
-        current = next;
+void remove_from_cache(FileCache* cache, const char* filename) {
+    unsigned int hash = hash_filename(filename);
+    CacheBucket* bucket = cache_bucket(cache, hash);
+
+    pthread_mutex_lock(&bucket->lock);
+    CacheEntry* entry = cache_find_locked(bucket, filename, hash);
+    if (entry) {
+        cache_unlink_locked(bucket, entry);
     }
-    pthread_mutex_unlock(&cache->lock);
-    pthread_mutex_destroy(&cache->lock);
+    pthread_mutex_unlock(&bucket->lock);
+}
+
+void destroy_cache(FileCache* cache) {
+    for (int i = 0; i < CACHE_BUCKETS; i++) {
+        pthread_mutex_destroy(&cache->buckets[i].lock);
+    }
+    pthread_mutex_destroy(&cache->clock_lock);
+    free(cache->entries);
     free(cache);
 }
 
+FileMetadata* lookup_file(NameServer* nm, const char* filename) {
+    FileMetadata* metadata = get_from_cache(nm->cache, filename);
+    if (metadata) {
+        return metadata;
+    }
+
+    // Populate while still holding trie_lock so a concurrent delete/move
+    // (which invalidates under the write lock) cannot leave a stale entry.
+    pthread_rwlock_rdlock(&nm->trie_lock);
+    metadata = search_file_trie(nm->file_trie, filename);
+    if (metadata) {
+        atomic_fetch_add(&metadata->refs, 1);
+        put_in_cache(nm->cache, filename, metadata);
+    }
+    pthread_rwlock_unlock(&nm->trie_lock);
+
+    return metadata;
+}
+
 // ==================== NAME SERVER INITIALIZATION ====================
 
 NameServer* init_name_server(int port) {
@@ -273,24 +822,40 @@ NameServer* init_name_server(int port) {
     // Initialize locks
     pthread_mutex_init(&nm->ss_lock, NULL);
     pthread_mutex_init(&nm->client_lock, NULL);
-    pthread_mutex_init(&nm->trie_lock, NULL);
-    pthread_mutex_init(&nm->log_lock, NULL);
+    // Writer-preferring: glibc's default lets a steady stream of lookups
+    // starve create/delete indefinitely. Nothing takes trie_lock for
+    // reading recursively, so this cannot self-deadlock.
+    pthread_rwlockattr_t trie_lock_attr;
+    pthread_rwlockattr_init(&trie_lock_attr);
+    pthread_rwlockattr_setkind_np(&trie_lock_attr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+    pthread_rwlock_init(&nm->trie_lock, &trie_lock_attr);
+    pthread_rwlockattr_destroy(&trie_lock_attr);
     pthread_mutex_init(&nm->registry_lock, NULL);
     pthread_mutex_init(&nm->persistence_lock, NULL);
+    pthread_mutex_init(&nm->journal_lock, NULL);
     
-    // Open log file
-    nm->log_file = fopen(LOG_FILE, "a");
-    if (!nm->log_file) {
+    // Open log file and start the log writer
+    if (!async_log_open(&nm->log, LOG_FILE)) {
         perror("Failed to open log file");
         free(nm);
         return NULL;
     }
     
+    // Rebuild the namespace from the metadata snapshot and journal
+    nm->journal = NULL;
+    nm->journal_generation = 0;
+    nm->journal_records = 0;
+    nm->journal_appended = 0;
+    nm->journal_synced = 0;
+    if (!journal_open(nm)) {
+        log_message(nm, "WARN", NULL, 0, NULL, "JOURNAL_OPEN", "Metadata changes will not be persisted");
+    }
+    
     // Create socket
     nm->socket_fd = socket(AF_INET, SOCK_STREAM, 0);
     if (nm->socket_fd < 0) {
         perror("Failed to create socket");
-        fclose(nm->log_file);
+        async_log_close(&nm->log);
         free(nm);
         return NULL;
     }
@@ -300,7 +865,7 @@ NameServer* init_name_server(int port) {
     if (setsockopt(nm->socket_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0) {
         perror("setsockopt failed");
         close(nm->socket_fd);
-        fclose(nm->log_file);
+        async_log_close(&nm->log);
         free(nm);
         return NULL;
     }
@@ -315,7 +880,7 @@ NameServer* init_name_server(int port) {
     if (bind(nm->socket_fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
         perror("Bind failed");
         close(nm->socket_fd);
-        fclose(nm->log_file);
+        async_log_close(&nm->log);
         free(nm);
         return NULL;
     }
@@ -324,7 +889,7 @@ NameServer* init_name_server(int port) {
     if (listen(nm->socket_fd, 10) < 0) {
         perror("Listen failed");
         close(nm->socket_fd);
-        fclose(nm->log_file);
+        async_log_close(&nm->log);
         free(nm);
         return NULL;
     }
@@ -342,6 +907,9 @@ void destroy_name_server(NameServer* nm) {
     
     nm->is_running = false;
     
+    // Write a final snapshot while the storage server records are still intact
+    journal_close(nm);
+    
     // Close all connections
     for (int i = 0; i < MAX_SS; i++) {
         if (nm->storage_servers[i]) {
@@ -353,6 +921,8 @@ void destroy_name_server(NameServer* nm) {
             }
             free(nm->storage_servers[i]->files);
             pthread_mutex_destroy(&nm->storage_servers[i]->lock);
+            pthread_mutex_destroy(&nm->storage_servers[i]->send_lock);
+            wire_reader_destroy(&nm->storage_servers[i]->rx);
             free(nm->storage_servers[i]);
         }
     }
@@ -375,10 +945,8 @@ void destroy_name_server(NameServer* nm) {
         close(nm->socket_fd);
     }
     
-    // Close log file
-    if (nm->log_file) {
-        fclose(nm->log_file);
-    }
+    // Drain pending log entries and close the log file
+    async_log_close(&nm->log);
     
     for (int i = 0; i < nm->registered_user_count; i++) {
         free(nm->user_registry[i]);
@@ -387,10 +955,10 @@ void destroy_name_server(NameServer* nm) {
     // Destroy locks
     pthread_mutex_destroy(&nm->ss_lock);
     pthread_mutex_destroy(&nm->client_lock);
-    pthread_mutex_destroy(&nm->trie_lock);
-    pthread_mutex_destroy(&nm->log_lock);
+    pthread_rwlock_destroy(&nm->trie_lock);
     pthread_mutex_destroy(&nm->registry_lock);
     pthread_mutex_destroy(&nm->persistence_lock);
+    pthread_mutex_destroy(&nm->journal_lock);
     
     free(nm);
     printf("Name Server destroyed\n");
@@ -398,6 +966,24 @@ void destroy_name_server(NameServer* nm) {
 
 // ==================== STORAGE SERVER MANAGEMENT ====================
 
+StorageServer* create_storage_server(int ss_id, const char* ip, int nm_port,
+                                     int client_port, int socket_fd) {
+    StorageServer* ss = (StorageServer*)calloc(1, sizeof(StorageServer));
+    if (!ss) {
+        return NULL;
+    }
+    ss->id = ss_id;
+    strncpy(ss->ip, ip, MAX_IP_LEN - 1);
+    ss->ip[MAX_IP_LEN - 1] = '\0';
+    ss->nm_port = nm_port;
+    ss->client_port = client_port;
+    ss->socket_fd = socket_fd;
+    ss->is_active = true;
+    pthread_mutex_init(&ss->lock, NULL);
+    pthread_mutex_init(&ss->send_lock, NULL);
+    return ss;
+}
+
 int register_storage_server(NameServer* nm, const char* ip, int nm_port, 
                             int client_port, char** files, int file_count, int socket_fd) {
     pthread_mutex_lock(&nm->ss_lock);
@@ -412,12 +998,17 @@ int register_storage_server(NameServer* nm, const char* ip, int nm_port,
             // Found existing SS - update it
             existing_ss->nm_port = nm_port;
             
-            // Close old socket if different
+            // Close old socket if different; requests in flight on it fail
+            pthread_mutex_lock(&existing_ss->send_lock);
+            pthread_mutex_lock(&existing_ss->lock);
             if (existing_ss->socket_fd >= 0 && existing_ss->socket_fd != socket_fd) {
                 close(existing_ss->socket_fd);
             }
+            ss_channel_reset(existing_ss);
             existing_ss->socket_fd = socket_fd;
             existing_ss->is_active = true;
+            pthread_mutex_unlock(&existing_ss->lock);
+            pthread_mutex_unlock(&existing_ss->send_lock);
             
             // Update files
             // Free old files
@@ -436,8 +1027,10 @@ int register_storage_server(NameServer* nm, const char* ip, int nm_port,
             int ss_id = existing_ss->id;
             pthread_mutex_unlock(&nm->ss_lock);
             
-            // Update trie for new files
-            pthread_mutex_lock(&nm->trie_lock);
+            // Update trie for new files; their records are journaled as one batch
+            FileMetadata** added = (FileMetadata**)malloc(sizeof(FileMetadata*) * (file_count + 1));
+            int added_count = 0;
+            pthread_rwlock_wrlock(&nm->trie_lock);
             for (int j = 0; j < file_count; j++) {
                 FileMetadata* metadata = search_file_trie(nm->file_trie, files[j]);
                 if (metadata) {
@@ -467,8 +1060,15 @@ int register_storage_server(NameServer* nm, const char* ip, int nm_port,
 
                 insert_file_trie(nm->file_trie, files[j], metadata);
                 put_in_cache(nm->cache, files[j], metadata);
+                if (added) {
+                    added[added_count++] = metadata;
+                } else {
+                    journal_put(nm, metadata);
+                }
             }
-            pthread_mutex_unlock(&nm->trie_lock);
+            journal_put_many(nm, added, added_count);
+            pthread_rwlock_unlock(&nm->trie_lock);
+            free(added);
             
             char details[256];
             snprintf(details, sizeof(details), "SS_ID=%d IP=%s NM_Port=%d Client_Port=%d Files=%d (Reconnected)",
@@ -487,14 +1087,11 @@ int register_storage_server(NameServer* nm, const char* ip, int nm_port,
         return -1;
     }
     
-    StorageServer* ss = (StorageServer*)malloc(sizeof(StorageServer));
-    ss->id = nm->ss_count;
-    strncpy(ss->ip, ip, MAX_IP_LEN - 1);
-    ss->ip[MAX_IP_LEN - 1] = '\0';
-    ss->nm_port = nm_port;
-    ss->client_port = client_port;
-    ss->socket_fd = socket_fd;
-    ss->is_active = true;
+    StorageServer* ss = create_storage_server(nm->ss_count, ip, nm_port, client_port, socket_fd);
+    if (!ss) {
+        pthread_mutex_unlock(&nm->ss_lock);
+        return -1;
+    }
     ss->file_count = file_count;
     ss->files = (char**)malloc(sizeof(char*) * file_count);
     
@@ -502,16 +1099,18 @@ int register_storage_server(NameServer* nm, const char* ip, int nm_port,
         ss->files[i] = strdup(files[i]);
     }
     
-    pthread_mutex_init(&ss->lock, NULL);
-    
     nm->storage_servers[nm->ss_count] = ss;
     int ss_id = nm->ss_count;
     nm->ss_count++;
     
     pthread_mutex_unlock(&nm->ss_lock);
+    journal_storage_server(nm, ss);
     
-    // Add files to trie (reuse existing metadata when available)
-    pthread_mutex_lock(&nm->trie_lock);
+    // Add files to trie (reuse existing metadata when available); new
+    // records are journaled as one batch
+    FileMetadata** added = (FileMetadata**)malloc(sizeof(FileMetadata*) * (file_count + 1));
+    int added_count = 0;
+    pthread_rwlock_wrlock(&nm->trie_lock);
     for (int i = 0; i < file_count; i++) {
         FileMetadata* metadata = search_file_trie(nm->file_trie, files[i]);
         if (metadata) {
@@ -541,8 +1140,15 @@ int register_storage_server(NameServer* nm, const char* ip, int nm_port,
 
         insert_file_trie(nm->file_trie, files[i], metadata);
         put_in_cache(nm->cache, files[i], metadata);
+        if (added) {
+            added[added_count++] = metadata;
+        } else {
+            journal_put(nm, metadata);
+        }
     }
-    pthread_mutex_unlock(&nm->trie_lock);
+    journal_put_many(nm, added, added_count);
+    pthread_rwlock_unlock(&nm->trie_lock);
+    free(added);
     
     char details[256];
     snprintf(details, sizeof(details), "SS_ID=%d IP=%s NM_Port=%d Client_Port=%d Files=%d",
@@ -573,11 +1179,17 @@ void deregister_storage_server_safe(NameServer* nm, int ss_id, int socket_fd) {
 
         ss->is_active = false;
         
-        // Close socket and invalidate it
+        // Close socket and invalidate it; waiters on this channel fail fast.
+        // send_lock keeps a sender from writing to the fd once it is reused.
+        pthread_mutex_lock(&ss->send_lock);
+        pthread_mutex_lock(&ss->lock);
         if (ss->socket_fd >= 0) {
             close(ss->socket_fd);
             ss->socket_fd = -1;
         }
+        ss_channel_reset(ss);
+        pthread_mutex_unlock(&ss->lock);
+        pthread_mutex_unlock(&ss->send_lock);
 
         char details[256];
         snprintf(details, sizeof(details), "SS_ID=%d IP=%s Client_Port=%d File_Count=%d", 
@@ -682,60 +1294,70 @@ bool is_owner(FileMetadata* metadata, const char* username) {
 
 ErrorCode add_access(NameServer* nm, Client* client, const char* filename, 
                     const char* username, AccessRight access) {
-    pthread_mutex_lock(&nm->trie_lock);
+    // Look the file up under the write lock: a cached pointer could be
+    // deleted or moved before we lock, and journal_put would resurrect it.
+    pthread_rwlock_wrlock(&nm->trie_lock);
     FileMetadata* metadata = search_file_trie(nm->file_trie, filename);
-    pthread_mutex_unlock(&nm->trie_lock);
     
     if (!metadata) {
+        pthread_rwlock_unlock(&nm->trie_lock);
         return ERR_FILE_NOT_FOUND;
     }
     
     if (!is_owner(metadata, client->username)) {
+        pthread_rwlock_unlock(&nm->trie_lock);
         return ERR_PERMISSION_DENIED;
     }
-    
+
     // Check if user already has access
+    bool updated = false;
     struct AccessEntry* entry = metadata->acl;
     while (entry) {
         if (strcmp(entry->username, username) == 0) {
             entry->access = access;  // Update access
-            char details[256];
-            snprintf(details, sizeof(details), "File=%s User=%s Access=%s",
-                    filename, username, access == ACCESS_READ ? "READ" : "WRITE");
-            log_message(nm, "INFO", client->ip, client->nm_port, client->username,
-                       "UPDATE_ACCESS", details);
-            return ERR_SUCCESS;
+            updated = true;
+            break;
         }
         entry = entry->next;
     }
     
-    // Add new entry
-    struct AccessEntry* new_entry = (struct AccessEntry*)malloc(sizeof(struct AccessEntry));
-    strncpy(new_entry->username, username, MAX_USERNAME - 1);
-    new_entry->username[MAX_USERNAME - 1] = '\0';
-    new_entry->access = access;
-    new_entry->next = metadata->acl;
-    metadata->acl = new_entry;
+    if (!updated) {
+        // Add new entry
+        struct AccessEntry* new_entry = (struct AccessEntry*)malloc(sizeof(struct AccessEntry));
+        if (!new_entry) {
+            pthread_rwlock_unlock(&nm->trie_lock);
+            return ERR_SYSTEM_ERROR;
+        }
+        strncpy(new_entry->username, username, MAX_USERNAME - 1);
+        new_entry->username[MAX_USERNAME - 1] = '\0';
+        new_entry->access = access;
+        new_entry->next = metadata->acl;
+        metadata->acl = new_entry;
+    }
+    journal_put(nm, metadata);
+
+    pthread_rwlock_unlock(&nm->trie_lock);
     
     char details[256];
     snprintf(details, sizeof(details), "File=%s User=%s Access=%s",
             filename, username, access == ACCESS_READ ? "READ" : "WRITE");
     log_message(nm, "INFO", client->ip, client->nm_port, client->username,
-               "ADD_ACCESS", details);
+               updated ? "UPDATE_ACCESS" : "ADD_ACCESS", details);
     
     return ERR_SUCCESS;
 }
-
 ErrorCode remove_access(NameServer* nm, Client* client, const char* filename, const char* username) {
-    pthread_mutex_lock(&nm->trie_lock);
+    // Same as add_access: find and check the file under the write lock
+    pthread_rwlock_wrlock(&nm->trie_lock);
     FileMetadata* metadata = search_file_trie(nm->file_trie, filename);
-    pthread_mutex_unlock(&nm->trie_lock);
     
     if (!metadata) {
+        pthread_rwlock_unlock(&nm->trie_lock);
         return ERR_FILE_NOT_FOUND;
     }
     
     if (!is_owner(metadata, client->username)) {
+        pthread_rwlock_unlock(&nm->trie_lock);
         return ERR_PERMISSION_DENIED;
     }
     
@@ -751,6 +1373,8 @@ ErrorCode remove_access(NameServer* nm, Client* client, const char* filename, co
                 metadata->acl = entry->next;
             }
             free(entry);
+            journal_put(nm, metadata);
+            pthread_rwlock_unlock(&nm->trie_lock);
             
             char details[256];
             snprintf(details, sizeof(details), "File=%s User=%s", filename, username);
@@ -761,6 +1385,7 @@ ErrorCode remove_access(NameServer* nm, Client* client, const char* filename, co
         prev = entry;
         entry = entry->next;
     }
+    pthread_rwlock_unlock(&nm->trie_lock);
     
     return ERR_UNAUTHORIZED;
 }
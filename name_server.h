@@ -11,6 +11,12 @@
 #include <arpa/inet.h>
 #include <time.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+#include "wire.h"
+#include "command.h"
+#include "async_log.h"
 
 // Constants
 #define MAX_FILENAME 256
@@ -19,13 +25,17 @@
 #define MAX_IP_LEN 16
 #define MAX_CLIENTS 100
 #define MAX_SS 50
-#define MAX_FILES_PER_SS 1000
 #define BUFFER_SIZE 4096
 #define LOG_FILE "nm_log.txt"
 #define CACHE_SIZE 100
+#define CACHE_BUCKETS 256  // Power of two; hash buckets of the lookup cache
 #define USER_REGISTRY_FILE "nm_users.dat"
+#define META_JOURNAL_FILE "nm_meta.wal"       // Namespace changes since the last snapshot
+#define META_SNAPSHOT_FILE "nm_meta.snap"
+#define META_COMPACT_RECORDS 1024            // Journal records between snapshots
 #define MAX_REGISTERED_USERS 500
 #define MAX_CHECKPOINT_TAG 64
+#define SS_RPC_TIMEOUT_MS 10000              // Deadline for one NM -> SS request
 
 // Error Codes
 typedef enum {
@@ -51,13 +61,47 @@ typedef enum {
     ACCESS_WRITE = 2  // Write implies read
 } AccessRight;
 
-// Trie Node for efficient file search
+// Adaptive radix tree for the file namespace. Every node carries a
+// compressed path segment and an optional file; the child array grows
+// 4 -> 16 -> 48 -> 256 slots as the fan-out increases.
+typedef enum {
+    TRIE_NODE4 = 0,
+    TRIE_NODE16,
+    TRIE_NODE48,
+    TRIE_NODE256
+} TrieNodeType;
+
 typedef struct TrieNode {
-    struct TrieNode* children[256];  // ASCII characters
-    bool is_end_of_word;
-    void* file_metadata;  // Pointer to FileMetadata
+    uint8_t type;                    // TrieNodeType
+    uint16_t child_count;
+    uint16_t prefix_len;
+    char* prefix;                    // Compressed path segment (not NUL terminated)
+    void* file_metadata;             // Pointer to FileMetadata if a file ends here
 } TrieNode;
 
+typedef struct TrieNode4 {
+    TrieNode base;
+    unsigned char keys[4];           // Sorted edge bytes
+    TrieNode* children[4];
+} TrieNode4;
+
+typedef struct TrieNode16 {
+    TrieNode base;
+    unsigned char keys[16];          // Sorted edge bytes
+    TrieNode* children[16];
+} TrieNode16;
+
+typedef struct TrieNode48 {
+    TrieNode base;
+    unsigned char child_index[256];  // Edge byte -> slot + 1 (0 = empty)
+    TrieNode* children[48];
+} TrieNode48;
+
+typedef struct TrieNode256 {
+    TrieNode base;
+    TrieNode* children[256];
+} TrieNode256;
+
 // File Metadata
 typedef struct RegisteredUser {
     char username[MAX_USERNAME];
@@ -94,8 +138,20 @@ typedef struct FileMetadata {
     bool is_directory;
     AccessEntry* acl;
     AccessRequest* pending_requests;
+    _Atomic int refs;                // lookup_file pins; see release_metadata
 } FileMetadata;
 
+// In-flight NM -> SS request waiting for the reply tagged with its ID
+typedef struct PendingRpc {
+    uint32_t request_id;
+    char* payload;                   // Reply handed over by the reader (heap)
+    size_t length;
+    bool done;
+    bool failed;                     // Channel reset before the reply arrived
+    pthread_cond_t cond;
+    struct PendingRpc* next;
+} PendingRpc;
+
 // Storage Server Info
 typedef struct StorageServer {
     int id;
@@ -106,7 +162,11 @@ typedef struct StorageServer {
     bool is_active;
     char** files;  // Array of file paths
     int file_count;
-    pthread_mutex_t lock;
+    pthread_mutex_t lock;            // Pending table, reply buffer and socket_fd swaps
+    pthread_mutex_t send_lock;       // Serializes request writes; held to close socket_fd
+    uint32_t next_request_id;
+    PendingRpc* pending;
+    WireReader rx;                   // Reply frames not yet matched to a request
 } StorageServer;
 
 // Client Info
@@ -121,23 +181,31 @@ typedef struct Client {
     time_t connected_time;
 } Client;
 
-// Cache Entry for recent searches
+// Cache entry for recent lookups; the entries form the CLOCK ring
 typedef struct CacheEntry {
     char filename[MAX_FILENAME];
     FileMetadata* metadata;
-    time_t timestamp;
-    struct CacheEntry* next;
-    struct CacheEntry* prev;
+    unsigned int hash;
+    bool in_use;                     // Linked into its bucket
+    bool referenced;                 // CLOCK bit: set by hits, cleared by the hand
+    struct CacheEntry* hash_next;    // Bucket chain
 } CacheEntry;
 
-// LRU Cache
-typedef struct LRUCache {
+typedef struct CacheBucket {
+    pthread_mutex_t lock;            // Guards the chain and its entries' fields
     CacheEntry* head;
-    CacheEntry* tail;
-    int size;
+} CacheBucket;
+
+// Lookup cache: hash buckets with their own locks and CLOCK eviction over a
+// fixed ring of entries. A hit only sets a reference bit, so lookups of
+// different files never share a lock.
+typedef struct FileCache {
+    CacheBucket buckets[CACHE_BUCKETS];
+    CacheEntry* entries;             // Ring of capacity slots
     int capacity;
-    pthread_mutex_t lock;
-} LRUCache;
+    int hand;                        // Next slot to consider; guarded by clock_lock
+    pthread_mutex_t clock_lock;      // Serializes inserts; taken before a bucket lock
+} FileCache;
 
 // Name Server
 typedef struct NameServer {
@@ -153,7 +221,7 @@ typedef struct NameServer {
     int next_ss_index;
     
     // Cache
-    LRUCache* cache;
+    FileCache* cache;
     
     // Persistence helpers
     RegisteredUser* user_registry[MAX_REGISTERED_USERS];
@@ -162,13 +230,20 @@ typedef struct NameServer {
     // Locks
     pthread_mutex_t ss_lock;
     pthread_mutex_t client_lock;
-    pthread_mutex_t trie_lock;
-    pthread_mutex_t log_lock;
+    pthread_rwlock_t trie_lock;      // Readers: lookups/VIEW; writers: namespace and ACL changes
     pthread_mutex_t registry_lock;
     pthread_mutex_t persistence_lock;
     
-    // Logging
-    FILE* log_file;
+    // Metadata journal (see name_server_journal.c)
+    FILE* journal;
+    unsigned long journal_generation;
+    int journal_records;
+    unsigned long journal_appended;  // Records written to the kernel
+    unsigned long journal_synced;    // Records known to be on disk
+    pthread_mutex_t journal_lock;
+    
+    // Logging (asynchronous; see async_log.h)
+    AsyncLog log;
     
     // Running state
     bool is_running;
@@ -182,24 +257,47 @@ void destroy_name_server(NameServer* nm);
 void start_name_server(NameServer* nm);
 
 // Trie operations
+typedef void (*TrieVisitor)(FileMetadata* metadata, void* ctx);
+
 TrieNode* create_trie_node();
 void insert_file_trie(TrieNode* root, const char* filename, FileMetadata* metadata);
 FileMetadata* search_file_trie(TrieNode* root, const char* filename);
 void delete_file_trie(TrieNode* root, const char* filename);
+void walk_file_trie(TrieNode* root, const char* prefix, TrieVisitor visit, void* ctx);
 void destroy_trie(TrieNode* root);
 
 // Cache operations
-LRUCache* create_cache(int capacity);
-void put_in_cache(LRUCache* cache, const char* filename, FileMetadata* metadata);
-void destroy_cache(LRUCache* cache);
+FileCache* create_cache(int capacity);
+void put_in_cache(FileCache* cache, const char* filename, FileMetadata* metadata);
+FileMetadata* get_from_cache(FileCache* cache, const char* filename);   // Pinned
+void remove_from_cache(FileCache* cache, const char* filename);
+void destroy_cache(FileCache* cache);
+
+// Namespace lookup: cache first, falls back to the trie and populates the
+// cache. The result is pinned: it stays valid after a concurrent delete
+// until the caller passes it to release_metadata.
+FileMetadata* lookup_file(NameServer* nm, const char* filename);
+void release_metadata(FileMetadata* metadata);
 
 // Storage Server management
+StorageServer* create_storage_server(int ss_id, const char* ip, int nm_port,
+                                     int client_port, int socket_fd);
 int register_storage_server(NameServer* nm, const char* ip, int nm_port, 
                             int client_port, char** files, int file_count, int socket_fd);
 StorageServer* get_storage_server(NameServer* nm, int ss_id);
 void deregister_storage_server(NameServer* nm, int ss_id);
 void deregister_storage_server_safe(NameServer* nm, int ss_id, int socket_fd);
 
+// Metadata journal (put/delete callers hold trie_lock for writing). Appends
+// are not synced; call journal_sync after unlocking and before replying.
+bool journal_open(NameServer* nm);
+void journal_close(NameServer* nm);
+void journal_put(NameServer* nm, const FileMetadata* metadata);
+void journal_put_many(NameServer* nm, FileMetadata* const* records, int count);
+void journal_delete(NameServer* nm, const char* filename);
+void journal_storage_server(NameServer* nm, const StorageServer* ss);
+void journal_sync(NameServer* nm);
+
 // Client management
 int register_client(NameServer* nm, const char* username, const char* ip, 
                    int nm_port, int ss_port, int socket_fd);
@@ -252,12 +350,13 @@ void log_message(NameServer* nm, const char* level, const char* client_ip,
                 const char* details);
 
 // Networking
-void* handle_connection(void* arg);
 void send_response(int socket_fd, ErrorCode error, const char* message);
 int forward_to_ss(NameServer* nm, int ss_id, const char* command, char* response);
+int forward_to_ss_alloc(NameServer* nm, int ss_id, const char* command, char** response);
+bool ss_channel_receive(NameServer* nm, int ss_id, int socket_fd);
+void ss_channel_reset(StorageServer* ss);
 
 // Utilities
 const char* error_to_string(ErrorCode error);
-void parse_command(const char* command, char* cmd, char* args[], int* arg_count);
 
 #endif // NAME_SERVER_H
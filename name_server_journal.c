@@ -0,0 +1,415 @@
+#include "name_server.h"
+#include <errno.h>
+#include <fcntl.h>
+
+// ==================== METADATA JOURNAL ====================
+// Namespace metadata (owners, ACLs, pending requests, folder flags, stats)
+// survives NM restarts through an append-only journal of whole-record
+// upserts and deletes, compacted into a snapshot every
+// META_COMPACT_RECORDS records and at startup/shutdown.
+//
+// Each line is "<fnv32 hex> <payload>\n"; replay stops at the first torn
+// or corrupt line. Names never contain whitespace, so payloads are plain
+// space-separated tokens (empty strings are written as "-"):
+//
+//   G <generation>                  First record of every file
+//   S <ss_id> <ip> <nm_port> <client_port>
+//   F <name> <owner> <ss_id> <is_dir> <created> <modified> <accessed>
+//     <accessed_by> <size> <words> <chars>
+//     <acl_count> {<user> <right>} <request_count> {<user> <right> <time>}
+//   D <name>
+//
+// A journal whose generation differs from the snapshot's predates the last
+// compaction and is ignored. All writers hold trie_lock for writing, which
+// orders records the same way the trie was changed.
+//
+// Appends only reach the kernel; journal_sync makes them durable after the
+// writer has dropped trie_lock, so one fdatasync covers every record
+// appended by concurrent writers before it.
+
+static uint32_t record_checksum(const char* payload, size_t length) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (unsigned char)payload[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static const char* field_or_dash(const char* value) {
+    return (value && *value) ? value : "-";
+}
+
+static void write_record(FILE* fp, const char* payload, size_t length) {
+    fprintf(fp, "%08x %.*s\n", record_checksum(payload, length), (int)length, payload);
+}
+
+// ==================== SERIALIZATION ====================
+
+static void format_metadata(FILE* out, const FileMetadata* metadata) {
+    fprintf(out, "F %s %s %d %d %ld %ld %ld %s %zu %d %d",
+            metadata->filename, field_or_dash(metadata->owner), metadata->ss_id,
+            metadata->is_directory ? 1 : 0, (long)metadata->created_time,
+            (long)metadata->last_modified, (long)metadata->last_accessed,
+            field_or_dash(metadata->last_accessed_by), metadata->file_size,
+            metadata->word_count, metadata->char_count);
+
+    int acl_count = 0;
+    for (AccessEntry* entry = metadata->acl; entry; entry = entry->next) acl_count++;
+    fprintf(out, " %d", acl_count);
+    for (AccessEntry* entry = metadata->acl; entry; entry = entry->next) {
+        fprintf(out, " %s %d", entry->username, (int)entry->access);
+    }
+
+    int request_count = 0;
+    for (AccessRequest* req = metadata->pending_requests; req; req = req->next) request_count++;
+    fprintf(out, " %d", request_count);
+    for (AccessRequest* req = metadata->pending_requests; req; req = req->next) {
+        fprintf(out, " %s %d %ld", req->username, (int)req->requested_access,
+                (long)req->requested_time);
+    }
+}
+
+// Formats one payload into a heap buffer via a memory stream
+typedef void (*PayloadWriter)(FILE* out, const void* arg);
+
+static char* build_payload(PayloadWriter writer, const void* arg, size_t* length) {
+    char* payload = NULL;
+    FILE* out = open_memstream(&payload, length);
+    if (!out) {
+        return NULL;
+    }
+    writer(out, arg);
+    if (fclose(out) != 0) {
+        free(payload);
+        return NULL;
+    }
+    return payload;
+}
+
+static void write_metadata_payload(FILE* out, const void* arg) {
+    format_metadata(out, (const FileMetadata*)arg);
+}
+
+static void write_delete_payload(FILE* out, const void* arg) {
+    fprintf(out, "D %s", (const char*)arg);
+}
+
+static void write_storage_server_payload(FILE* out, const void* arg) {
+    const StorageServer* ss = (const StorageServer*)arg;
+    fprintf(out, "S %d %s %d %d", ss->id, ss->ip, ss->nm_port, ss->client_port);
+}
+
+static void write_generation_payload(FILE* out, const void* arg) {
+    fprintf(out, "G %lu", *(const unsigned long*)arg);
+}
+
+static void emit_payload(FILE* fp, PayloadWriter writer, const void* arg) {
+    size_t length = 0;
+    char* payload = build_payload(writer, arg, &length);
+    if (payload) {
+        write_record(fp, payload, length);
+        free(payload);
+    }
+}
+
+// ==================== REPLAY ====================
+
+static FileMetadata* parse_metadata(char* args[], int arg_count) {
+    if (arg_count < 12) {
+        return NULL;
+    }
+    FileMetadata* metadata = (FileMetadata*)calloc(1, sizeof(FileMetadata));
+    if (!metadata) {
+        return NULL;
+    }
+
+    snprintf(metadata->filename, MAX_FILENAME, "%s", args[0]);
+    if (strcmp(args[1], "-") != 0) {
+        snprintf(metadata->owner, MAX_USERNAME, "%s", args[1]);
+    }
+    metadata->ss_id = atoi(args[2]);
+    metadata->is_directory = atoi(args[3]) != 0;
+    metadata->created_time = (time_t)atol(args[4]);
+    metadata->last_modified = (time_t)atol(args[5]);
+    metadata->last_accessed = (time_t)atol(args[6]);
+    if (strcmp(args[7], "-") != 0) {
+        snprintf(metadata->last_accessed_by, MAX_USERNAME, "%s", args[7]);
+    }
+    metadata->file_size = (size_t)strtoul(args[8], NULL, 10);
+    metadata->word_count = atoi(args[9]);
+    metadata->char_count = atoi(args[10]);
+
+    int pos = 11;
+    int acl_count = atoi(args[pos++]);
+    AccessEntry** acl_tail = &metadata->acl;
+    for (int i = 0; i < acl_count && pos + 1 < arg_count; i++, pos += 2) {
+        AccessEntry* entry = (AccessEntry*)calloc(1, sizeof(AccessEntry));
+        if (!entry) break;
+        snprintf(entry->username, MAX_USERNAME, "%s", args[pos]);
+        entry->access = (AccessRight)atoi(args[pos + 1]);
+        *acl_tail = entry;
+        acl_tail = &entry->next;
+    }
+
+    int request_count = pos < arg_count ? atoi(args[pos++]) : 0;
+    AccessRequest** request_tail = &metadata->pending_requests;
+    for (int i = 0; i < request_count && pos + 2 < arg_count; i++, pos += 3) {
+        AccessRequest* req = (AccessRequest*)calloc(1, sizeof(AccessRequest));
+        if (!req) break;
+        snprintf(req->username, MAX_USERNAME, "%s", args[pos]);
+        req->requested_access = (AccessRight)atoi(args[pos + 1]);
+        req->requested_time = (time_t)atol(args[pos + 2]);
+        *request_tail = req;
+        request_tail = &req->next;
+    }
+    return metadata;
+}
+
+static void apply_storage_server(NameServer* nm, char* args[], int arg_count) {
+    if (arg_count < 4) return;
+    int ss_id = atoi(args[0]);
+    if (ss_id < 0 || ss_id >= MAX_SS || nm->storage_servers[ss_id]) return;
+
+    // Known but not yet connected: keeps its ID so file placement stays valid
+    StorageServer* ss = create_storage_server(ss_id, args[1], atoi(args[2]), atoi(args[3]), -1);
+    if (!ss) return;
+    ss->is_active = false;
+    nm->storage_servers[ss_id] = ss;
+    if (nm->ss_count <= ss_id) {
+        nm->ss_count = ss_id + 1;
+    }
+}
+
+// Replays one file; returns its generation (G record) or -1 if it has none
+static long replay_file(NameServer* nm, const char* path, long expected_generation, int* applied) {
+    FILE* fp = fopen(path, "r");
+    if (!fp) {
+        return -1;
+    }
+
+    long generation = -1;
+    char* line = NULL;
+    size_t line_cap = 0;
+    ssize_t line_len;
+    bool first = true;
+
+    while ((line_len = getline(&line, &line_cap, fp)) > 0) {
+        if (line[line_len - 1] != '\n' || line_len < 10 || line[8] != ' ') {
+            break;  // Torn tail from a crash mid-append
+        }
+        line[--line_len] = '\0';
+        char* payload = line + 9;
+        uint32_t stored = (uint32_t)strtoul(line, NULL, 16);
+        if (stored != record_checksum(payload, (size_t)(line_len - 9))) {
+            break;
+        }
+
+        Command record;
+        if (!command_parse(payload, &record)) {
+            break;
+        }
+
+        if (strcmp(record.name, "G") == 0 && record.arg_count >= 1) {
+            generation = atol(record.args[0]);
+            if (first && expected_generation >= 0 && generation != expected_generation) {
+                command_free(&record);
+                break;  // Stale journal from before the last compaction
+            }
+        } else if (strcmp(record.name, "S") == 0) {
+            apply_storage_server(nm, record.args, record.arg_count);
+        } else if (strcmp(record.name, "F") == 0) {
+            FileMetadata* metadata = parse_metadata(record.args, record.arg_count);
+            if (metadata) {
+                delete_file_trie(nm->file_trie, metadata->filename);  // Upsert
+                insert_file_trie(nm->file_trie, metadata->filename, metadata);
+                (*applied)++;
+            }
+        } else if (strcmp(record.name, "D") == 0 && record.arg_count >= 1) {
+            delete_file_trie(nm->file_trie, record.args[0]);
+            (*applied)++;
+        }
+        command_free(&record);
+        first = false;
+    }
+
+    free(line);
+    fclose(fp);
+    return generation;
+}
+
+// ==================== COMPACTION ====================
+
+static void write_snapshot_entry(FileMetadata* metadata, void* ctx) {
+    emit_payload((FILE*)ctx, write_metadata_payload, metadata);
+}
+
+static bool sync_directory(void) {
+    int dir_fd = open(".", O_RDONLY);
+    if (dir_fd < 0) {
+        return false;
+    }
+    bool ok = fsync(dir_fd) == 0;
+    close(dir_fd);
+    return ok;
+}
+
+// Writes a snapshot of the whole namespace and starts a fresh journal.
+// Caller holds trie_lock for writing (or runs before the server starts).
+static bool compact_journal(NameServer* nm) {
+    unsigned long generation = nm->journal_generation + 1;
+    const char* tmp_path = META_SNAPSHOT_FILE ".tmp";
+
+    FILE* fp = fopen(tmp_path, "w");
+    if (!fp) {
+        return false;
+    }
+    emit_payload(fp, write_generation_payload, &generation);
+    pthread_mutex_lock(&nm->ss_lock);
+    for (int i = 0; i < nm->ss_count; i++) {
+        if (nm->storage_servers[i]) {
+            emit_payload(fp, write_storage_server_payload, nm->storage_servers[i]);
+        }
+    }
+    pthread_mutex_unlock(&nm->ss_lock);
+    walk_file_trie(nm->file_trie, "", write_snapshot_entry, fp);
+
+    bool ok = fflush(fp) == 0 && fsync(fileno(fp)) == 0;
+    ok = (fclose(fp) == 0) && ok;
+    if (!ok || rename(tmp_path, META_SNAPSHOT_FILE) != 0) {
+        unlink(tmp_path);
+        return false;
+    }
+    sync_directory();
+
+    // The snapshot now covers everything; restart the journal at the new generation
+    if (nm->journal) {
+        fclose(nm->journal);
+    }
+    nm->journal = fopen(META_JOURNAL_FILE, "w");
+    nm->journal_generation = generation;
+    nm->journal_records = 0;
+    if (!nm->journal) {
+        return false;
+    }
+    emit_payload(nm->journal, write_generation_payload, &generation);
+    fflush(nm->journal);
+    fdatasync(fileno(nm->journal));
+    nm->journal_synced = nm->journal_appended;  // The snapshot holds them all
+    return true;
+}
+
+// ==================== PUBLIC API ====================
+
+bool journal_open(NameServer* nm) {
+    int applied = 0;
+    long snapshot_generation = replay_file(nm, META_SNAPSHOT_FILE, -1, &applied);
+    int snapshot_records = applied;
+    replay_file(nm, META_JOURNAL_FILE, snapshot_generation < 0 ? 0 : snapshot_generation, &applied);
+    nm->journal_generation = snapshot_generation < 0 ? 0 : (unsigned long)snapshot_generation;
+
+    if (!compact_journal(nm)) {
+        perror("Failed to open metadata journal");
+        return false;
+    }
+
+    char details[256];
+    snprintf(details, sizeof(details), "Snapshot=%d Journal=%d Generation=%lu StorageServers=%d",
+             snapshot_records, applied - snapshot_records, nm->journal_generation, nm->ss_count);
+    log_message(nm, "INFO", NULL, 0, NULL, "JOURNAL_RECOVER", details);
+    return true;
+}
+
+void journal_close(NameServer* nm) {
+    pthread_rwlock_wrlock(&nm->trie_lock);
+    pthread_mutex_lock(&nm->journal_lock);
+    compact_journal(nm);
+    if (nm->journal) {
+        fclose(nm->journal);
+        nm->journal = NULL;
+    }
+    pthread_mutex_unlock(&nm->journal_lock);
+    pthread_rwlock_unlock(&nm->trie_lock);
+}
+
+// Caller holds journal_lock
+static void journal_maybe_compact(NameServer* nm) {
+    if (nm->journal_records >= META_COMPACT_RECORDS && !compact_journal(nm)) {
+        log_message(nm, "WARN", NULL, 0, NULL, "JOURNAL_COMPACT", "Snapshot failed");
+    }
+}
+
+static void journal_append(NameServer* nm, PayloadWriter writer, const void* arg, bool may_compact) {
+    pthread_mutex_lock(&nm->journal_lock);
+    if (nm->journal) {
+        emit_payload(nm->journal, writer, arg);
+        fflush(nm->journal);
+        nm->journal_records++;
+        nm->journal_appended++;
+        if (may_compact) {
+            journal_maybe_compact(nm);
+        }
+    }
+    pthread_mutex_unlock(&nm->journal_lock);
+}
+
+void journal_put(NameServer* nm, const FileMetadata* metadata) {
+    journal_append(nm, write_metadata_payload, metadata, true);
+}
+
+// One flush for the whole batch and at most one compaction, so registering
+// N files costs O(N) rather than a full-trie snapshot every
+// META_COMPACT_RECORDS files
+void journal_put_many(NameServer* nm, FileMetadata* const* records, int count) {
+    if (count <= 0) {
+        return;
+    }
+    pthread_mutex_lock(&nm->journal_lock);
+    if (nm->journal) {
+        for (int i = 0; i < count; i++) {
+            emit_payload(nm->journal, write_metadata_payload, records[i]);
+        }
+        fflush(nm->journal);
+        nm->journal_records += count;
+        nm->journal_appended += (unsigned long)count;
+        journal_maybe_compact(nm);
+    }
+    pthread_mutex_unlock(&nm->journal_lock);
+}
+
+void journal_delete(NameServer* nm, const char* filename) {
+    journal_append(nm, write_delete_payload, filename, true);
+}
+
+void journal_storage_server(NameServer* nm, const StorageServer* ss) {
+    // Called without trie_lock, so it must not walk the trie for a snapshot
+    journal_append(nm, write_storage_server_payload, ss, false);
+}
+
+// Makes every record appended so far durable. The fdatasync runs on a dup
+// outside journal_lock so writers holding trie_lock never wait on the disk;
+// a compaction that truncates the file meanwhile has synced everything.
+void journal_sync(NameServer* nm) {
+    pthread_mutex_lock(&nm->journal_lock);
+    unsigned long target = nm->journal_appended;
+    int fd = -1;
+    if (nm->journal && nm->journal_synced < target) {
+        fd = dup(fileno(nm->journal));
+    }
+    pthread_mutex_unlock(&nm->journal_lock);
+    if (fd < 0) {
+        return;
+    }
+
+    int error = fdatasync(fd) == 0 ? 0 : errno;
+    close(fd);
+
+    pthread_mutex_lock(&nm->journal_lock);
+    if (error == 0 && nm->journal_synced < target) {
+        nm->journal_synced = target;
+    }
+    pthread_mutex_unlock(&nm->journal_lock);
+    if (error != 0) {
+        log_message(nm, "WARN", NULL, 0, NULL, "JOURNAL_SYNC", strerror(error));
+    }
+}
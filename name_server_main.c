@@ -1,461 +1,683 @@
 #include "name_server.h"
 #include <signal.h>
-#include <poll.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
 
 // Global name server for signal handling
 extern NameServer* g_nm;
 
-// Thread argument structure
-typedef struct {
+// ==================== REACTOR STATE ====================
+
+#define REACTOR_MAX_EVENTS 64
+#define NM_MIN_WORKERS 4   // Handlers block on SS round-trips, so keep a floor on small hosts
+
+// SS sockets carry RPC replies (see ss_channel_receive); their epoll data is tagged
+// (ss_id << 32) | (fd << 1) | 1 so it never collides with a Session pointer.
+#define SS_EVENT_TAG 1ULL
+
+typedef enum {
+    SESSION_KEEP,
+    SESSION_CLOSE,
+    SESSION_DETACH   // fd handed over (SS registration); free the session only
+} SessionAction;
+
+typedef struct Session {
+    int fd;
+    int client_id;                   // -1 until REGISTER_CLIENT succeeds
+    char ip[MAX_IP_LEN];
+    WireReader rx;                   // Partial frames carried across reads
+    struct Session* next_ready;      // Worker queue linkage
+    struct Session* prev;            // All open sessions (freed at shutdown)
+    struct Session* next;
+} Session;
+
+typedef struct Reactor {
     NameServer* nm;
-    int socket_fd;
-    struct sockaddr_in addr;
-} ConnectionArgs;
+    int epoll_fd;
+    pthread_t* workers;
+    int worker_count;
+    Session* ready_head;
+    Session* ready_tail;
+    Session* sessions;
+    pthread_mutex_t lock;
+    pthread_cond_t ready_cond;
+    bool stopping;
+} Reactor;
+
+static Reactor g_reactor;
+
+// ==================== SESSION MANAGEMENT ====================
+
+static Session* session_create(Reactor* r, int fd, const struct sockaddr_in* addr) {
+    Session* s = (Session*)calloc(1, sizeof(Session));
+    if (!s) {
+        return NULL;
+    }
+    s->fd = fd;
+    s->client_id = -1;
+    wire_reader_init(&s->rx);
+    inet_ntop(AF_INET, &addr->sin_addr, s->ip, MAX_IP_LEN);
+
+    pthread_mutex_lock(&r->lock);
+    s->next = r->sessions;
+    if (r->sessions) {
+        r->sessions->prev = s;
+    }
+    r->sessions = s;
+    pthread_mutex_unlock(&r->lock);
+    return s;
+}
+
+static void session_free(Reactor* r, Session* s) {
+    pthread_mutex_lock(&r->lock);
+    if (s->prev) {
+        s->prev->next = s->next;
+    } else {
+        r->sessions = s->next;
+    }
+    if (s->next) {
+        s->next->prev = s->prev;
+    }
+    pthread_mutex_unlock(&r->lock);
+    wire_reader_destroy(&s->rx);
+    free(s);
+}
+
+static void session_close(Reactor* r, Session* s) {
+    epoll_ctl(r->epoll_fd, EPOLL_CTL_DEL, s->fd, NULL);
+    if (s->client_id >= 0) {
+        Client* client = get_client(r->nm, s->client_id);
+        if (client && client->is_active) {
+            deregister_client(r->nm, s->client_id);
+        }
+        if (client) {
+            pthread_mutex_lock(&r->nm->client_lock);
+            client->socket_fd = -1;  // destroy_name_server must not close a reused fd
+            pthread_mutex_unlock(&r->nm->client_lock);
+        }
+    }
+    close(s->fd);
+    session_free(r, s);
+}
+
+// One-shot arming guarantees a session is serviced by at most one worker at a time
+static bool session_arm(Reactor* r, Session* s, int op) {
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT;
+    ev.data.ptr = s;
+    return epoll_ctl(r->epoll_fd, op, s->fd, &ev) == 0;
+}
+
+static bool watch_storage_server(Reactor* r, int ss_id, int fd) {
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLRDHUP;  // Replies are consumed on the reactor thread
+    ev.data.u64 = ((uint64_t)ss_id << 32) | ((uint64_t)(uint32_t)fd << 1) | SS_EVENT_TAG;
+    return epoll_ctl(r->epoll_fd, EPOLL_CTL_MOD, fd, &ev) == 0;
+}
+
+// ==================== COMMAND DISPATCH ====================
+// Client commands are looked up in a perfect-hash table (see command.h);
+// each handler fills response with the message sent back alongside its code.
+
+typedef ErrorCode (*ClientCommandHandler)(NameServer* nm, Client* client, char* args[], int arg_count,
+                                          char* response, size_t response_size);
+
+typedef struct ClientCommand {
+    const char* name;                // Table key, must stay first
+    int min_args;
+    const char* usage;
+    ClientCommandHandler handler;    // NULL ends the session (QUIT/EXIT)
+} ClientCommand;
 
-// ==================== CONNECTION HANDLER ====================
+static ErrorCode cmd_view(NameServer* nm, Client* client, char* args[], int arg_count,
+                          char* response, size_t response_size) {
+    (void)response_size;
+    return handle_view_files(nm, client, arg_count > 0 ? args[0] : NULL, response);
+}
+
+static ErrorCode cmd_create(NameServer* nm, Client* client, char* args[], int arg_count,
+                            char* response, size_t response_size) {
+    (void)arg_count;
+    ErrorCode error = handle_create_file(nm, client, args[0]);
+    if (error == ERR_SUCCESS) {
+        snprintf(response, response_size, "File '%s' created successfully", args[0]);
+    }
+    return error;
+}
+
+static ErrorCode cmd_create_folder(NameServer* nm, Client* client, char* args[], int arg_count,
+                                   char* response, size_t response_size) {
+    (void)arg_count;
+    ErrorCode error = handle_create_folder(nm, client, args[0]);
+    if (error == ERR_SUCCESS) {
+        snprintf(response, response_size, "Folder '%s' created successfully", args[0]);
+    }
+    return error;
+}
+
+static ErrorCode cmd_delete(NameServer* nm, Client* client, char* args[], int arg_count,
+                            char* response, size_t response_size) {
+    (void)arg_count;
+    ErrorCode error = handle_delete_file(nm, client, args[0]);
+    if (error == ERR_SUCCESS) {
+        snprintf(response, response_size, "File '%s' deleted successfully", args[0]);
+    }
+    return error;
+}
+
+static ErrorCode cmd_move(NameServer* nm, Client* client, char* args[], int arg_count,
+                          char* response, size_t response_size) {
+    (void)arg_count;
+    ErrorCode error = handle_move_file(nm, client, args[0], args[1]);
+    if (error == ERR_SUCCESS) {
+        snprintf(response, response_size, "Moved '%s' to '%s' successfully", args[0], args[1]);
+    }
+    return error;
+}
+
+static ErrorCode cmd_view_folder(NameServer* nm, Client* client, char* args[], int arg_count,
+                                 char* response, size_t response_size) {
+    (void)arg_count; (void)response_size;
+    return handle_view_folder(nm, client, args[0], response);
+}
 
-void* handle_connection(void* arg) {
-    ConnectionArgs* conn_args = (ConnectionArgs*)arg;
-    NameServer* nm = conn_args->nm;
-    int socket_fd = conn_args->socket_fd;
-    struct sockaddr_in addr = conn_args->addr;
+static ErrorCode cmd_read(NameServer* nm, Client* client, char* args[], int arg_count,
+                          char* response, size_t response_size) {
+    (void)arg_count; (void)response_size;
+    return handle_read_file(nm, client, args[0], response);
+}
+
+static ErrorCode cmd_write(NameServer* nm, Client* client, char* args[], int arg_count,
+                           char* response, size_t response_size) {
+    (void)arg_count;
+    ErrorCode error = handle_write_file(nm, client, args[0], atoi(args[1]));
+    if (error == ERR_SUCCESS) {
+        // Get SS info for client
+        FileMetadata* metadata = lookup_file(nm, args[0]);
+        if (metadata) {
+            StorageServer* ss = get_storage_server(nm, metadata->ss_id);
+            if (ss) {
+                snprintf(response, response_size, "SS_INFO %s %d", ss->ip, ss->client_port);
+            }
+            release_metadata(metadata);
+        }
+    }
+    return error;
+}
+
+static ErrorCode cmd_info(NameServer* nm, Client* client, char* args[], int arg_count,
+                          char* response, size_t response_size) {
+    (void)arg_count; (void)response_size;
+    return handle_info_file(nm, client, args[0], response);
+}
+
+static ErrorCode cmd_stream(NameServer* nm, Client* client, char* args[], int arg_count,
+                            char* response, size_t response_size) {
+    (void)arg_count; (void)response_size;
+    return handle_stream_file(nm, client, args[0], response);
+}
+
+static ErrorCode cmd_exec(NameServer* nm, Client* client, char* args[], int arg_count,
+                          char* response, size_t response_size) {
+    (void)arg_count; (void)response_size;
+    return handle_exec_file(nm, client, args[0], response);
+}
+
+static ErrorCode cmd_undo(NameServer* nm, Client* client, char* args[], int arg_count,
+                          char* response, size_t response_size) {
+    (void)arg_count;
+    ErrorCode error = handle_undo_file(nm, client, args[0]);
+    if (error == ERR_SUCCESS) {
+        snprintf(response, response_size, "Last change to '%s' undone", args[0]);
+    }
+    return error;
+}
+
+static ErrorCode cmd_list(NameServer* nm, Client* client, char* args[], int arg_count,
+                          char* response, size_t response_size) {
+    (void)client; (void)args; (void)arg_count; (void)response_size;
+    return handle_list_users(nm, response);
+}
+
+static ErrorCode cmd_add_access(NameServer* nm, Client* client, char* args[], int arg_count,
+                                char* response, size_t response_size) {
+    (void)arg_count;
+    AccessRight access = (strcmp(args[0], "-W") == 0) ? ACCESS_WRITE : ACCESS_READ;
+    ErrorCode error = add_access(nm, client, args[1], args[2], access);
+    if (error == ERR_SUCCESS) {
+        snprintf(response, response_size, "Access granted to %s for file '%s'", args[2], args[1]);
+    }
+    return error;
+}
+
+static ErrorCode cmd_rem_access(NameServer* nm, Client* client, char* args[], int arg_count,
+                                char* response, size_t response_size) {
+    (void)arg_count;
+    ErrorCode error = remove_access(nm, client, args[0], args[1]);
+    if (error == ERR_SUCCESS) {
+        snprintf(response, response_size, "Access removed from %s for file '%s'", args[1], args[0]);
+    }
+    return error;
+}
+
+static ErrorCode cmd_checkpoint(NameServer* nm, Client* client, char* args[], int arg_count,
+                                char* response, size_t response_size) {
+    (void)arg_count; (void)response_size;
+    return handle_checkpoint(nm, client, args[0], args[1], response);
+}
+
+static ErrorCode cmd_view_checkpoint(NameServer* nm, Client* client, char* args[], int arg_count,
+                                     char* response, size_t response_size) {
+    (void)arg_count; (void)response_size;
+    return handle_view_checkpoint(nm, client, args[0], args[1], response);
+}
+
+static ErrorCode cmd_revert(NameServer* nm, Client* client, char* args[], int arg_count,
+                            char* response, size_t response_size) {
+    (void)arg_count; (void)response_size;
+    return handle_revert_checkpoint(nm, client, args[0], args[1], response);
+}
+
+static ErrorCode cmd_list_checkpoints(NameServer* nm, Client* client, char* args[], int arg_count,
+                                      char* response, size_t response_size) {
+    (void)arg_count; (void)response_size;
+    return handle_list_checkpoints(nm, client, args[0], response);
+}
+
+static ErrorCode cmd_req_access(NameServer* nm, Client* client, char* args[], int arg_count,
+                                char* response, size_t response_size) {
+    (void)arg_count; (void)response_size;
+    AccessRight requested = (strcmp(args[0], "-W") == 0) ? ACCESS_WRITE : ACCESS_READ;
+    return handle_request_access(nm, client, args[1], requested, response);
+}
+
+static ErrorCode cmd_list_requests(NameServer* nm, Client* client, char* args[], int arg_count,
+                                   char* response, size_t response_size) {
+    (void)arg_count; (void)response_size;
+    return handle_list_requests(nm, client, args[0], response);
+}
+
+static ErrorCode cmd_process_request(NameServer* nm, Client* client, char* args[], int arg_count,
+                                     char* response, size_t response_size) {
+    (void)arg_count;
+    bool approve;
+    if (strcmp(args[2], "APPROVE") == 0) {
+        approve = true;
+    } else if (strcmp(args[2], "DENY") == 0) {
+        approve = false;
+    } else {
+        snprintf(response, response_size, "Action must be APPROVE or DENY");
+        return ERR_INVALID_OPERATION;
+    }
+    return handle_process_request(nm, client, args[0], args[1], approve, response);
+}
+
+static const ClientCommand client_commands[] = {
+    { "VIEW",            0, NULL,                                  cmd_view },
+    { "CREATE",          1, "CREATE <filename>",                   cmd_create },
+    { "CREATEFOLDER",    1, "CREATEFOLDER <foldername>",           cmd_create_folder },
+    { "DELETE",          1, "DELETE <filename>",                   cmd_delete },
+    { "MOVE",            2, "MOVE <source> <destination>",         cmd_move },
+    { "VIEWFOLDER",      1, "VIEWFOLDER <foldername>",             cmd_view_folder },
+    { "READ",            1, "READ <filename>",                     cmd_read },
+    { "WRITE",           2, "WRITE <filename> <sentence_number>",  cmd_write },
+    { "INFO",            1, "INFO <filename>",                     cmd_info },
+    { "STREAM",          1, "STREAM <filename>",                   cmd_stream },
+    { "EXEC",            1, "EXEC <filename>",                     cmd_exec },
+    { "UNDO",            1, "UNDO <filename>",                     cmd_undo },
+    { "LIST",            0, NULL,                                  cmd_list },
+    { "ADDACCESS",       3, "ADDACCESS -R|-W <filename> <username>", cmd_add_access },
+    { "REMACCESS",       2, "REMACCESS <filename> <username>",     cmd_rem_access },
+    { "CHECKPOINT",      2, "CHECKPOINT <filename> <tag>",         cmd_checkpoint },
+    { "VIEWCHECKPOINT",  2, "VIEWCHECKPOINT <filename> <tag>",     cmd_view_checkpoint },
+    { "REVERT",          2, "REVERT <filename> <tag>",             cmd_revert },
+    { "LISTCHECKPOINTS", 1, "LISTCHECKPOINTS <filename>",          cmd_list_checkpoints },
+    { "REQACCESS",       2, "REQACCESS <-R|-W> <filename>",        cmd_req_access },
+    { "LISTREQUESTS",    1, "LISTREQUESTS <filename>",             cmd_list_requests },
+    { "PROCESSREQUEST",  3, "PROCESSREQUEST <filename> <username> <APPROVE|DENY>", cmd_process_request },
+    { "QUIT",            0, NULL,                                  NULL },
+    { "EXIT",            0, NULL,                                  NULL },
+};
+
+static CommandTable client_command_table;
+static pthread_once_t client_command_once = PTHREAD_ONCE_INIT;
+
+static void init_client_command_table(void) {
+    if (!command_table_init(&client_command_table, client_commands, sizeof(ClientCommand),
+                            (int)(sizeof(client_commands) / sizeof(client_commands[0])))) {
+        fprintf(stderr, "Failed to build client command table\n");
+    }
+}
+
+// Returns false when the client asked to end the session
+static bool dispatch_client_command(NameServer* nm, Client* client, int socket_fd,
+                                    const Command* command) {
+    ErrorCode error = ERR_SUCCESS;
+    char response_msg[BUFFER_SIZE * 4] = {0};
+
+    pthread_once(&client_command_once, init_client_command_table);
+    const ClientCommand* entry =
+        (const ClientCommand*)command_table_find(&client_command_table, command->name);
     
-    char client_ip[MAX_IP_LEN];
-    inet_ntop(AF_INET, &addr.sin_addr, client_ip, MAX_IP_LEN);
+    if (!entry) {
+        error = ERR_INVALID_OPERATION;
+        snprintf(response_msg, sizeof(response_msg), 
+                "Unknown command: %s", command->name);
+    }
+    else if (!entry->handler) {
+        strcpy(response_msg, "Goodbye!");
+        send_response(socket_fd, ERR_SUCCESS, response_msg);
+        deregister_client(nm, client->id);
+        return false;
+    }
+    else if (command->arg_count < entry->min_args) {
+        error = ERR_INVALID_OPERATION;
+        snprintf(response_msg, sizeof(response_msg), "Usage: %s", entry->usage);
+    }
+    else {
+        error = entry->handler(nm, client, command->args, command->arg_count,
+                               response_msg, sizeof(response_msg));
+    }
     
-    free(conn_args);
+    // Send response
+    if (error != ERR_SUCCESS && strlen(response_msg) == 0) {
+        strcpy(response_msg, error_to_string(error));
+    }
     
-    char buffer[BUFFER_SIZE];
-    int bytes = recv(socket_fd, buffer, BUFFER_SIZE - 1, 0);
+    // Metadata changes must be durable before the client hears about them
+    journal_sync(nm);
+    send_response(socket_fd, error, response_msg);
+    return true;
+}
+
+static SessionAction handle_register_ss(Reactor* r, Session* s, char* args[], int arg_count) {
+    NameServer* nm = r->nm;
+
+    // Format: REGISTER_SS <nm_port> <client_port> <file_count> <file1> <file2> ...
+    if (arg_count < 3) {
+        send_response(s->fd, ERR_INVALID_OPERATION, "Invalid SS registration");
+        return SESSION_CLOSE;
+    }
     
-    if (bytes <= 0) {
-        close(socket_fd);
-        return NULL;
+    int nm_port = atoi(args[0]);
+    int client_port = atoi(args[1]);
+    int file_count = atoi(args[2]);
+    if (file_count < 0) {
+        file_count = 0;
+    }
+    if (file_count > arg_count - 3) {
+        file_count = arg_count - 3;
+    }
+
+    // The file list is the tail of the argument slices
+    int ss_id = register_storage_server(nm, s->ip, nm_port, client_port,
+                                        args + 3, file_count, s->fd);
+
+    if (ss_id < 0) {
+        send_response(s->fd, ERR_SYSTEM_ERROR, "Failed to register SS");
+        return SESSION_CLOSE;
+    }
+    
+    journal_sync(nm);
+    char response[256];
+    snprintf(response, sizeof(response), "SS registered with ID %d", ss_id);
+    send_response(s->fd, ERR_SUCCESS, response);
+
+    // The socket now belongs to the StorageServer record; the reactor reads
+    // RPC replies from it and notices disconnects without a poll() thread.
+    if (!watch_storage_server(r, ss_id, s->fd)) {
+        deregister_storage_server_safe(nm, ss_id, s->fd);
+    }
+    return SESSION_DETACH;
+}
+
+static SessionAction handle_register_client(Reactor* r, Session* s, char* args[], int arg_count) {
+    // Format: REGISTER_CLIENT <username> <nm_port> <ss_port>
+    if (arg_count < 3) {
+        send_response(s->fd, ERR_INVALID_OPERATION, "Invalid client registration");
+        return SESSION_CLOSE;
     }
     
-    buffer[bytes] = '\0';
+    char* username = args[0];
+    int nm_port = atoi(args[1]);
+    int ss_port = atoi(args[2]);
     
-    // Parse initial message
-    char cmd[64];
-    char* args[10];
-    int arg_count;
-    parse_command(buffer, cmd, args, &arg_count);
+    int client_id = register_client(r->nm, username, s->ip, nm_port, ss_port, s->fd);
     
-    // Handle registration
-    if (strcmp(cmd, "REGISTER_SS") == 0) {
-        // Format: REGISTER_SS <nm_port> <client_port> <file_count> <file1> <file2> ...
-        if (arg_count < 3) {
-            send_response(socket_fd, ERR_INVALID_OPERATION, "Invalid SS registration");
-            close(socket_fd);
-            return NULL;
-        }
-        
-        int nm_port = atoi(args[0]);
-        int client_port = atoi(args[1]);
-        int file_count = atoi(args[2]);
-        
-        char** files = NULL;
-        if (file_count > 0 && arg_count >= 3 + file_count) {
-            files = (char**)malloc(sizeof(char*) * file_count);
-            for (int i = 0; i < file_count; i++) {
-                files[i] = strdup(args[3 + i]);
-            }
-        } else {
-            files = (char**)malloc(sizeof(char*) * 1);
-            file_count = 0;
+    if (client_id < 0) {
+        send_response(s->fd, ERR_SYSTEM_ERROR, "Failed to register client");
+        return SESSION_CLOSE;
+    }
+    
+    char response[256];
+    snprintf(response, sizeof(response), "Client registered with ID %d", client_id);
+    send_response(s->fd, ERR_SUCCESS, response);
+    s->client_id = client_id;
+    return SESSION_KEEP;
+}
+
+static SessionAction dispatch_message(Reactor* r, Session* s, char* message) {
+    Command command;
+    if (!command_parse(message, &command)) {
+        send_response(s->fd, ERR_SYSTEM_ERROR, "Out of memory");
+        return SESSION_KEEP;
+    }
+
+    SessionAction action = SESSION_KEEP;
+    if (s->client_id >= 0) {
+        Client* client = get_client(r->nm, s->client_id);
+        if (!client || !client->is_active ||
+            !dispatch_client_command(r->nm, client, s->fd, &command)) {
+            action = SESSION_CLOSE;
         }
-        
-        int ss_id = register_storage_server(nm, client_ip, nm_port, client_port, 
-                                            files, file_count, socket_fd);
-        
-        if (ss_id < 0) {
-            send_response(socket_fd, ERR_SYSTEM_ERROR, "Failed to register SS");
-            for (int i = 0; i < file_count; i++) free(files[i]);
-            free(files);
-            close(socket_fd);
-            return NULL;
+    } else if (strcmp(command.name, "REGISTER_SS") == 0) {
+        action = handle_register_ss(r, s, command.args, command.arg_count);
+    } else if (strcmp(command.name, "REGISTER_CLIENT") == 0) {
+        action = handle_register_client(r, s, command.args, command.arg_count);
+    } else {
+        send_response(s->fd, ERR_INVALID_OPERATION, "Invalid registration type");
+        action = SESSION_CLOSE;
+    }
+
+    command_free(&command);
+    return action;
+}
+
+// ==================== WORKER POOL ====================
+
+// Reads what is available and runs every complete framed command
+static SessionAction service_session(Reactor* r, Session* s) {
+    ssize_t bytes = wire_reader_fill(&s->rx, s->fd);
+    if (bytes == 0) {
+        return SESSION_CLOSE;
+    }
+    if (bytes < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+        return SESSION_CLOSE;
+    }
+
+    WireMessage msg;
+    int status;
+    while ((status = wire_reader_next(&s->rx, &msg)) == 1) {
+        SessionAction action = dispatch_message(r, s, msg.payload);
+        wire_message_free(&msg);
+        if (action != SESSION_KEEP) {
+            return action;
         }
-        
-        char response[256];
-        snprintf(response, sizeof(response), "SS registered with ID %d", ss_id);
-        send_response(socket_fd, ERR_SUCCESS, response);
+    }
+    return status < 0 ? SESSION_CLOSE : SESSION_KEEP;
+}
+
+static void* reactor_worker(void* arg) {
+    Reactor* r = (Reactor*)arg;
 
-        for (int i = 0; i < arg_count; i++) {
-            free(args[i]);
+    while (true) {
+        pthread_mutex_lock(&r->lock);
+        while (!r->ready_head && !r->stopping) {
+            pthread_cond_wait(&r->ready_cond, &r->lock);
         }
-        for (int i = 0; i < file_count; i++) {
-            free(files[i]);
+        if (r->stopping) {
+            pthread_mutex_unlock(&r->lock);
+            break;
         }
-        free(files);
-
-        // Monitor the socket for disconnect events without consuming SS replies.
-        struct pollfd pfd;
-        pfd.fd = socket_fd;
-        pfd.events = POLLERR | POLLHUP;
-
-        while (nm->is_running) {
-            int ret = poll(&pfd, 1, 1000);
-            if (ret < 0) {
-                if (errno == EINTR) {
-                    continue;
-                }
-                deregister_storage_server_safe(nm, ss_id, socket_fd);
-                break;
-            } else if (ret == 0) {
-                continue;
-            }
-
-            if (pfd.revents & (POLLERR | POLLHUP | POLLNVAL)) {
-                deregister_storage_server_safe(nm, ss_id, socket_fd);
-                break;
-            }
+        Session* s = r->ready_head;
+        r->ready_head = s->next_ready;
+        if (!r->ready_head) {
+            r->ready_tail = NULL;
         }
+        s->next_ready = NULL;
+        pthread_mutex_unlock(&r->lock);
 
-        return NULL;
-    }
-    else if (strcmp(cmd, "REGISTER_CLIENT") == 0) {
-        // Format: REGISTER_CLIENT <username> <nm_port> <ss_port>
-        if (arg_count < 3) {
-            send_response(socket_fd, ERR_INVALID_OPERATION, "Invalid client registration");
-            for (int i = 0; i < arg_count; i++) free(args[i]);
-            close(socket_fd);
-            return NULL;
+        SessionAction action = service_session(r, s);
+        if (action == SESSION_KEEP && !session_arm(r, s, EPOLL_CTL_MOD)) {
+            action = SESSION_CLOSE;
         }
-        
-        char* username = args[0];
-        int nm_port = atoi(args[1]);
-        int ss_port = atoi(args[2]);
-        
-        int client_id = register_client(nm, username, client_ip, nm_port, ss_port, socket_fd);
-        
-        if (client_id < 0) {
-            send_response(socket_fd, ERR_SYSTEM_ERROR, "Failed to register client");
-            for (int i = 0; i < arg_count; i++) free(args[i]);
-            close(socket_fd);
-            return NULL;
+        if (action == SESSION_CLOSE) {
+            session_close(r, s);
+        } else if (action == SESSION_DETACH) {
+            session_free(r, s);
         }
-        
-        char response[256];
-        snprintf(response, sizeof(response), "Client registered with ID %d", client_id);
-        send_response(socket_fd, ERR_SUCCESS, response);
-        
-        Client* client = get_client(nm, client_id);
-        
-        // Handle client commands in a loop
-        while (nm->is_running && client->is_active) {
-            bytes = recv(socket_fd, buffer, BUFFER_SIZE - 1, 0);
-            if (bytes <= 0) {
-                deregister_client(nm, client_id);
-                break;
-            }
-            
-            buffer[bytes] = '\0';
-            parse_command(buffer, cmd, args, &arg_count);
-            
-            ErrorCode error = ERR_SUCCESS;
-            char response_msg[BUFFER_SIZE * 4] = {0};
-            
-            // Handle different commands
-            if (strcmp(cmd, "VIEW") == 0) {
-                char* flags = (arg_count > 0) ? args[0] : NULL;
-                error = handle_view_files(nm, client, flags, response_msg);
-            }
-            else if (strcmp(cmd, "CREATE") == 0) {
-                if (arg_count < 1) {
-                    error = ERR_INVALID_OPERATION;
-                    strcpy(response_msg, "Usage: CREATE <filename>");
-                } else {
-                    error = handle_create_file(nm, client, args[0]);
-                    if (error == ERR_SUCCESS) {
-                        snprintf(response_msg, sizeof(response_msg), 
-                                "File '%s' created successfully", args[0]);
-                    }
-                }
-            }
-            else if (strcmp(cmd, "CREATEFOLDER") == 0) {
-                if (arg_count < 1) {
-                    error = ERR_INVALID_OPERATION;
-                    strcpy(response_msg, "Usage: CREATEFOLDER <foldername>");
-                } else {
-                    error = handle_create_folder(nm, client, args[0]);
-                    if (error == ERR_SUCCESS) {
-                        snprintf(response_msg, sizeof(response_msg), 
-                                "Folder '%s' created successfully", args[0]);
-                    }
-                }
-            }
-            else if (strcmp(cmd, "DELETE") == 0) {
-                if (arg_count < 1) {
-                    error = ERR_INVALID_OPERATION;
-                    strcpy(response_msg, "Usage: DELETE <filename>");
-                } else {
-                    error = handle_delete_file(nm, client, args[0]);
-                    if (error == ERR_SUCCESS) {
-                        snprintf(response_msg, sizeof(response_msg), 
-                                "File '%s' deleted successfully", args[0]);
-                    }
-                }
-            }
-            else if (strcmp(cmd, "MOVE") == 0) {
-                if (arg_count < 2) {
-                    error = ERR_INVALID_OPERATION;
-                    strcpy(response_msg, "Usage: MOVE <source> <destination>");
-                } else {
-                    error = handle_move_file(nm, client, args[0], args[1]);
-                    if (error == ERR_SUCCESS) {
-                        snprintf(response_msg, sizeof(response_msg), 
-                                "Moved '%s' to '%s' successfully", args[0], args[1]);
-                    }
-                }
-            }
-            else if (strcmp(cmd, "VIEWFOLDER") == 0) {
-                if (arg_count < 1) {
-                    error = ERR_INVALID_OPERATION;
-                    strcpy(response_msg, "Usage: VIEWFOLDER <foldername>");
-                } else {
-                    error = handle_view_folder(nm, client, args[0], response_msg);
-                }
-            }
-            else if (strcmp(cmd, "READ") == 0) {
-                if (arg_count < 1) {
-                    error = ERR_INVALID_OPERATION;
-                    strcpy(response_msg, "Usage: READ <filename>");
-                } else {
-                    error = handle_read_file(nm, client, args[0], response_msg);
-                }
-            }
-            else if (strcmp(cmd, "WRITE") == 0) {
-                if (arg_count < 2) {
-                    error = ERR_INVALID_OPERATION;
-                    strcpy(response_msg, "Usage: WRITE <filename> <sentence_number>");
-                } else {
-                    int sentence_num = atoi(args[1]);
-                    error = handle_write_file(nm, client, args[0], sentence_num);
-                    
-                    if (error == ERR_SUCCESS) {
-                        // Get SS info for client
-                        pthread_mutex_lock(&nm->trie_lock);
-                        FileMetadata* metadata = search_file_trie(nm->file_trie, args[0]);
-                        pthread_mutex_unlock(&nm->trie_lock);
-                        
-                        if (metadata) {
-                            StorageServer* ss = get_storage_server(nm, metadata->ss_id);
-                            if (ss) {
-                                snprintf(response_msg, sizeof(response_msg), 
-                                        "SS_INFO %s %d", ss->ip, ss->client_port);
-                            }
-                        }
-                    }
-                }
-            }
-            else if (strcmp(cmd, "INFO") == 0) {
-                if (arg_count < 1) {
-                    error = ERR_INVALID_OPERATION;
-                    strcpy(response_msg, "Usage: INFO <filename>");
-                } else {
-                    error = handle_info_file(nm, client, args[0], response_msg);
-                }
-            }
-            else if (strcmp(cmd, "STREAM") == 0) {
-                if (arg_count < 1) {
-                    error = ERR_INVALID_OPERATION;
-                    strcpy(response_msg, "Usage: STREAM <filename>");
-                } else {
-                    error = handle_stream_file(nm, client, args[0], response_msg);
-                }
-            }
-            else if (strcmp(cmd, "EXEC") == 0) {
-                if (arg_count < 1) {
-                    error = ERR_INVALID_OPERATION;
-                    strcpy(response_msg, "Usage: EXEC <filename>");
-                } else {
-                    error = handle_exec_file(nm, client, args[0], response_msg);
-                }
-            }
-            else if (strcmp(cmd, "UNDO") == 0) {
-                if (arg_count < 1) {
-                    error = ERR_INVALID_OPERATION;
-                    strcpy(response_msg, "Usage: UNDO <filename>");
-                } else {
-                    error = handle_undo_file(nm, client, args[0]);
-                    if (error == ERR_SUCCESS) {
-                        snprintf(response_msg, sizeof(response_msg), 
-                                "Last change to '%s' undone", args[0]);
-                    }
-                }
-            }
-            else if (strcmp(cmd, "LIST") == 0) {
-                error = handle_list_users(nm, response_msg);
-            }
-            else if (strcmp(cmd, "ADDACCESS") == 0) {
-                if (arg_count < 3) {
-                    error = ERR_INVALID_OPERATION;
-                    strcpy(response_msg, "Usage: ADDACCESS -R|-W <filename> <username>");
-                } else {
-                    AccessRight access = (strcmp(args[0], "-W") == 0) ? 
-                                        ACCESS_WRITE : ACCESS_READ;
-                    error = add_access(nm, client, args[1], args[2], access);
-                    if (error == ERR_SUCCESS) {
-                        snprintf(response_msg, sizeof(response_msg), 
-                                "Access granted to %s for file '%s'", args[2], args[1]);
-                    }
-                }
-            }
-            else if (strcmp(cmd, "REMACCESS") == 0) {
-                if (arg_count < 2) {
-                    error = ERR_INVALID_OPERATION;
-                    strcpy(response_msg, "Usage: REMACCESS <filename> <username>");
-                } else {
-                    error = remove_access(nm, client, args[0], args[1]);
-                    if (error == ERR_SUCCESS) {
-                        snprintf(response_msg, sizeof(response_msg), 
-                                "Access removed from %s for file '%s'", args[1], args[0]);
-                    }
-                }
-            }
-            else if (strcmp(cmd, "CHECKPOINT") == 0) {
-                if (arg_count < 2) {
-                    error = ERR_INVALID_OPERATION;
-                    strcpy(response_msg, "Usage: CHECKPOINT <filename> <tag>");
-                } else {
-                    error = handle_checkpoint(nm, client, args[0], args[1], response_msg);
-                }
-            }
-            else if (strcmp(cmd, "VIEWCHECKPOINT") == 0) {
-                if (arg_count < 2) {
-                    error = ERR_INVALID_OPERATION;
-                    strcpy(response_msg, "Usage: VIEWCHECKPOINT <filename> <tag>");
-                } else {
-                    error = handle_view_checkpoint(nm, client, args[0], args[1], response_msg);
-                }
-            }
-            else if (strcmp(cmd, "REVERT") == 0) {
-                if (arg_count < 2) {
-                    error = ERR_INVALID_OPERATION;
-                    strcpy(response_msg, "Usage: REVERT <filename> <tag>");
-                } else {
-                    error = handle_revert_checkpoint(nm, client, args[0], args[1], response_msg);
-                }
-            }
-            else if (strcmp(cmd, "LISTCHECKPOINTS") == 0) {
-                if (arg_count < 1) {
-                    error = ERR_INVALID_OPERATION;
-                    strcpy(response_msg, "Usage: LISTCHECKPOINTS <filename>");
-                } else {
-                    error = handle_list_checkpoints(nm, client, args[0], response_msg);
-                }
-            }
-            else if (strcmp(cmd, "REQACCESS") == 0) {
-                if (arg_count < 2) {
-                    error = ERR_INVALID_OPERATION;
-                    strcpy(response_msg, "Usage: REQACCESS <-R|-W> <filename>");
-                } else {
-                    AccessRight requested = (strcmp(args[0], "-W") == 0) ? 
-                                            ACCESS_WRITE : ACCESS_READ;
-                    error = handle_request_access(nm, client, args[1], requested, response_msg);
-                }
-            }
-            else if (strcmp(cmd, "LISTREQUESTS") == 0) {
-                if (arg_count < 1) {
-                    error = ERR_INVALID_OPERATION;
-                    strcpy(response_msg, "Usage: LISTREQUESTS <filename>");
-                } else {
-                    error = handle_list_requests(nm, client, args[0], response_msg);
-                }
-            }
-            else if (strcmp(cmd, "PROCESSREQUEST") == 0) {
-                if (arg_count < 3) {
-                    error = ERR_INVALID_OPERATION;
-                    strcpy(response_msg, "Usage: PROCESSREQUEST <filename> <username> <APPROVE|DENY>");
-                } else {
-                    bool approve;
-                    if (strcmp(args[2], "APPROVE") == 0) {
-                        approve = true;
-                    } else if (strcmp(args[2], "DENY") == 0) {
-                        approve = false;
-                    } else {
-                        error = ERR_INVALID_OPERATION;
-                        strcpy(response_msg, "Action must be APPROVE or DENY");
-                    }
-                    if (error == ERR_SUCCESS) {
-                        error = handle_process_request(nm, client, args[0], args[1], approve, response_msg);
-                    }
-                }
-            }
-            else if (strcmp(cmd, "QUIT") == 0 || strcmp(cmd, "EXIT") == 0) {
-                strcpy(response_msg, "Goodbye!");
-                send_response(socket_fd, ERR_SUCCESS, response_msg);
-                deregister_client(nm, client_id);
-                break;
-            }
-            else {
-                error = ERR_INVALID_OPERATION;
-                snprintf(response_msg, sizeof(response_msg), 
-                        "Unknown command: %s", cmd);
-            }
-            
-            // Send response
-            if (error != ERR_SUCCESS && strlen(response_msg) == 0) {
-                strcpy(response_msg, error_to_string(error));
-            }
-            
-            send_response(socket_fd, error, response_msg);
-            
-            // Free args
-            for (int i = 0; i < arg_count; i++) {
-                free(args[i]);
-            }
-        }
-        
-        close(socket_fd);
-        return NULL;
-    }
-    else {
-        send_response(socket_fd, ERR_INVALID_OPERATION, "Invalid registration type");
-        for (int i = 0; i < arg_count; i++) free(args[i]);
-        close(socket_fd);
-        return NULL;
     }
-    
     return NULL;
 }
 
-// ==================== MAIN NAME SERVER LOOP ====================
+static void enqueue_session(Reactor* r, Session* s) {
+    pthread_mutex_lock(&r->lock);
+    if (r->ready_tail) {
+        r->ready_tail->next_ready = s;
+    } else {
+        r->ready_head = s;
+    }
+    r->ready_tail = s;
+    pthread_cond_signal(&r->ready_cond);
+    pthread_mutex_unlock(&r->lock);
+}
 
-void start_name_server(NameServer* nm) {
-    printf("Name Server started on port %d\n", nm->nm_port);
-    printf("Waiting for connections...\n\n");
-    
+static void accept_connections(Reactor* r) {
+    NameServer* nm = r->nm;
     while (nm->is_running) {
         struct sockaddr_in client_addr;
         socklen_t client_len = sizeof(client_addr);
-        
         int client_fd = accept(nm->socket_fd, (struct sockaddr*)&client_addr, &client_len);
-        
         if (client_fd < 0) {
-            if (nm->is_running) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR && nm->is_running) {
                 perror("Accept failed");
             }
-            continue;
+            return;
         }
-        
-        // Create thread to handle connection
-        pthread_t thread;
-        ConnectionArgs* args = (ConnectionArgs*)malloc(sizeof(ConnectionArgs));
-        args->nm = nm;
-        args->socket_fd = client_fd;
-        args->addr = client_addr;
-        
-        if (pthread_create(&thread, NULL, handle_connection, args) != 0) {
-            perror("Failed to create thread");
-            free(args);
+
+        Session* s = session_create(r, client_fd, &client_addr);
+        if (!s) {
             close(client_fd);
             continue;
         }
-        
-        pthread_detach(thread);
+        if (!session_arm(r, s, EPOLL_CTL_ADD)) {
+            perror("Failed to watch connection");
+            close(client_fd);
+            session_free(r, s);
+        }
+    }
+}
+
+// ==================== MAIN NAME SERVER LOOP ====================
+
+void start_name_server(NameServer* nm) {
+    Reactor* r = &g_reactor;
+    memset(r, 0, sizeof(*r));
+    r->nm = nm;
+    pthread_mutex_init(&r->lock, NULL);
+    pthread_cond_init(&r->ready_cond, NULL);
+
+    r->epoll_fd = epoll_create1(0);
+    if (r->epoll_fd < 0) {
+        perror("Failed to create epoll instance");
+        return;
+    }
+
+    // Non-blocking listener so a burst of connections is drained per wakeup
+    int flags = fcntl(nm->socket_fd, F_GETFL, 0);
+    fcntl(nm->socket_fd, F_SETFL, flags | O_NONBLOCK);
+
+    struct epoll_event listen_ev;
+    listen_ev.events = EPOLLIN;
+    listen_ev.data.ptr = NULL;
+    if (epoll_ctl(r->epoll_fd, EPOLL_CTL_ADD, nm->socket_fd, &listen_ev) < 0) {
+        perror("Failed to watch listening socket");
+        close(r->epoll_fd);
+        return;
+    }
+
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    r->worker_count = cores > NM_MIN_WORKERS ? (int)cores : NM_MIN_WORKERS;
+    r->workers = (pthread_t*)calloc(r->worker_count, sizeof(pthread_t));
+    int started = 0;
+    for (int i = 0; r->workers && i < r->worker_count; i++) {
+        if (pthread_create(&r->workers[i], NULL, reactor_worker, r) != 0) {
+            perror("Failed to create worker thread");
+            break;
+        }
+        started++;
+    }
+    r->worker_count = started;
+    if (started == 0) {
+        fprintf(stderr, "No worker threads available\n");
+        free(r->workers);
+        close(r->epoll_fd);
+        return;
+    }
+
+    printf("Name Server started on port %d (%d workers)\n", nm->nm_port, r->worker_count);
+    printf("Waiting for connections...\n\n");
+    
+    struct epoll_event events[REACTOR_MAX_EVENTS];
+    while (nm->is_running) {
+        int n = epoll_wait(r->epoll_fd, events, REACTOR_MAX_EVENTS, 1000);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("epoll_wait failed");
+            break;
+        }
+
+        for (int i = 0; i < n; i++) {
+            uint64_t data = events[i].data.u64;
+            if (events[i].data.ptr == NULL) {
+                accept_connections(r);
+            } else if (data & SS_EVENT_TAG) {
+                int ss_id = (int)(data >> 32);
+                int fd = (int)((uint32_t)data >> 1);
+                bool alive = ss_channel_receive(nm, ss_id, fd);
+                if (!alive || (events[i].events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR))) {
+                    deregister_storage_server_safe(nm, ss_id, fd);
+                }
+            } else {
+                enqueue_session(r, (Session*)events[i].data.ptr);
+            }
+        }
+    }
+
+    // Stop workers; queued sessions are released with the session list below
+    pthread_mutex_lock(&r->lock);
+    r->stopping = true;
+    pthread_cond_broadcast(&r->ready_cond);
+    pthread_mutex_unlock(&r->lock);
+    for (int i = 0; i < r->worker_count; i++) {
+        pthread_join(r->workers[i], NULL);
+    }
+    free(r->workers);
+
+    while (r->sessions) {
+        Session* s = r->sessions;
+        r->sessions = s->next;
+        if (s->client_id < 0) {
+            close(s->fd);  // Registered clients' sockets are closed by destroy_name_server
+        }
+        free(s);
     }
+    close(r->epoll_fd);
+    pthread_cond_destroy(&r->ready_cond);
+    pthread_mutex_destroy(&r->lock);
 }
 
 // ==================== SIGNAL HANDLER ====================
@@ -1,5 +1,6 @@
 #include "name_server.h"
 #include <ctype.h>
+#include <errno.h>
 
 static void record_last_access(FileMetadata* metadata, const char* username) {
     if (!metadata) return;
@@ -42,39 +43,33 @@ typedef struct {
     Client* client;
 } ViewFilesContext;
 
-static void collect_files(TrieNode* node, char* prefix, int depth, ViewFilesContext* ctx) {
-    if (!node) return;
-    
-    if (node->is_end_of_word && node->file_metadata) {
-        FileMetadata* metadata = (FileMetadata*)node->file_metadata;
-        AccessRight access = check_access(metadata, ctx->client->username);
-        
-        if (ctx->show_all || access != ACCESS_NONE) {
-            if (ctx->detailed) {
-                char time_buf[64];
-                strftime(time_buf, sizeof(time_buf), "%Y-%m-%d %H:%M:%S", 
-                        localtime(&metadata->last_accessed));
-                *ctx->offset += snprintf(ctx->buffer + *ctx->offset, BUFFER_SIZE * 4 - *ctx->offset,
-                                 "%s %10zu %5d %5d %s %s\n",
-                                 metadata->owner[0] ? metadata->owner : "none",
-                                 metadata->file_size,
-                                 metadata->word_count,
-                                 metadata->char_count,
-                                 time_buf,
-                                 metadata->filename);
-            } else {
-                *ctx->offset += snprintf(ctx->buffer + *ctx->offset, BUFFER_SIZE * 4 - *ctx->offset,
-                                 "%s\n", metadata->filename);
-            }
-        }
+static void collect_files(FileMetadata* metadata, void* arg) {
+    ViewFilesContext* ctx = (ViewFilesContext*)arg;
+    if (*ctx->offset >= BUFFER_SIZE * 4 - 1) return;
+
+    AccessRight access = check_access(metadata, ctx->client->username);
+    if (!ctx->show_all && access == ACCESS_NONE) return;
+
+    int written;
+    if (ctx->detailed) {
+        char time_buf[64];
+        strftime(time_buf, sizeof(time_buf), "%Y-%m-%d %H:%M:%S", 
+                localtime(&metadata->last_accessed));
+        written = snprintf(ctx->buffer + *ctx->offset, BUFFER_SIZE * 4 - *ctx->offset,
+                         "%s %10zu %5d %5d %s %s\n",
+                         metadata->owner[0] ? metadata->owner : "none",
+                         metadata->file_size,
+                         metadata->word_count,
+                         metadata->char_count,
+                         time_buf,
+                         metadata->filename);
+    } else {
+        written = snprintf(ctx->buffer + *ctx->offset, BUFFER_SIZE * 4 - *ctx->offset,
+                         "%s\n", metadata->filename);
     }
-    
-    for (int i = 0; i < 256; i++) {
-        if (node->children[i]) {
-            prefix[depth] = (char)i;
-            prefix[depth + 1] = '\0';
-            collect_files(node->children[i], prefix, depth + 1, ctx);
-        }
+    *ctx->offset += written;
+    if (*ctx->offset > BUFFER_SIZE * 4 - 1) {
+        *ctx->offset = BUFFER_SIZE * 4 - 1;
     }
 }
 
@@ -85,11 +80,10 @@ ErrorCode handle_view_files(NameServer* nm, Client* client, const char* flags, c
     char buffer[BUFFER_SIZE * 4] = {0};
     int offset = 0;
     
-    pthread_mutex_lock(&nm->trie_lock);
+    pthread_rwlock_rdlock(&nm->trie_lock);
     
     ViewFilesContext ctx = { buffer, &offset, show_all, detailed, client };
     
-    char prefix[MAX_FILENAME] = {0};
     if (detailed) {
         offset += snprintf(buffer + offset, sizeof(buffer) - offset,
                          "%-10s %10s %5s %5s %19s %s\n",
@@ -98,9 +92,9 @@ ErrorCode handle_view_files(NameServer* nm, Client* client, const char* flags, c
                          "------------------------------------------------------------\n");
     }
     
-    collect_files(nm->file_trie, prefix, 0, &ctx);
+    walk_file_trie(nm->file_trie, "", collect_files, &ctx);
     
-    pthread_mutex_unlock(&nm->trie_lock);
+    pthread_rwlock_unlock(&nm->trie_lock);
     
     if (offset == 0 || (detailed && offset < 100)) {
         strcpy(response, "No files found\n");
@@ -122,11 +116,10 @@ ErrorCode handle_view_files(NameServer* nm, Client* client, const char* flags, c
 
 ErrorCode handle_create_file(NameServer* nm, Client* client, const char* filename) {
     // Check if file already exists
-    pthread_mutex_lock(&nm->trie_lock);
-    FileMetadata* existing = search_file_trie(nm->file_trie, filename);
-    pthread_mutex_unlock(&nm->trie_lock);
+    FileMetadata* existing = lookup_file(nm, filename);
     
     if (existing) {
+        release_metadata(existing);
         return ERR_FILE_EXISTS;
     }
     
@@ -134,28 +127,30 @@ ErrorCode handle_create_file(NameServer* nm, Client* client, const char* filenam
     // the same storage server that hosts the folder (no round-robin).
     char parent_folder[MAX_FILENAME] = {0};
     FileMetadata* parent_meta = NULL;
+    int parent_ss_id = -1;  // Set when the parent is a folder
     const char* last_slash = strrchr(filename, '/');
     if (last_slash) {
         size_t plen = (size_t)(last_slash - filename);
         if (plen > 0 && plen < sizeof(parent_folder)) {
             strncpy(parent_folder, filename, plen);
             parent_folder[plen] = '\0';
-            pthread_mutex_lock(&nm->trie_lock);
-            parent_meta = search_file_trie(nm->file_trie, parent_folder);
-            pthread_mutex_unlock(&nm->trie_lock);
+            parent_meta = lookup_file(nm, parent_folder);
         }
 
         if (!parent_meta) {
             return ERR_PARENT_NOT_FOUND;
         }
-        if (!parent_meta->is_directory) {
+        bool parent_is_folder = parent_meta->is_directory;
+        parent_ss_id = parent_meta->ss_id;
+        release_metadata(parent_meta);
+        if (!parent_is_folder) {
             return ERR_INVALID_OPERATION;
         }
     }
 
-    if (parent_meta && parent_meta->is_directory) {
+    if (parent_ss_id >= 0) {
         // Try to create file on the storage server that owns the folder
-        StorageServer* ss = get_storage_server(nm, parent_meta->ss_id);
+        StorageServer* ss = get_storage_server(nm, parent_ss_id);
         if (!ss || !ss->is_active) {
             return ERR_SS_NOT_FOUND;
         }
@@ -167,8 +162,8 @@ ErrorCode handle_create_file(NameServer* nm, Client* client, const char* filenam
         if (forward_to_ss(nm, ss->id, command, response) >= 0) {
             if (strncmp(response, "SUCCESS", 7) == 0) {
                 // Add to trie with the same ss_id as parent folder
-                pthread_mutex_lock(&nm->trie_lock);
-                FileMetadata* metadata = (FileMetadata*)malloc(sizeof(FileMetadata));
+                pthread_rwlock_wrlock(&nm->trie_lock);
+                FileMetadata* metadata = (FileMetadata*)calloc(1, sizeof(FileMetadata));
                 strncpy(metadata->filename, filename, MAX_FILENAME - 1);
                 metadata->filename[MAX_FILENAME - 1] = '\0';
                 strncpy(metadata->owner, client->username, MAX_USERNAME - 1);
@@ -189,7 +184,8 @@ ErrorCode handle_create_file(NameServer* nm, Client* client, const char* filenam
 
                 insert_file_trie(nm->file_trie, filename, metadata);
                 put_in_cache(nm->cache, filename, metadata);
-                pthread_mutex_unlock(&nm->trie_lock);
+                journal_put(nm, metadata);
+                pthread_rwlock_unlock(&nm->trie_lock);
 
                 char details[256];
                 snprintf(details, sizeof(details), "File=%s SS_ID=%d", filename, ss->id);
@@ -243,8 +239,8 @@ ErrorCode handle_create_file(NameServer* nm, Client* client, const char* filenam
                 // File created successfully!
 
                 // Add to trie
-                pthread_mutex_lock(&nm->trie_lock);
-                FileMetadata* metadata = (FileMetadata*)malloc(sizeof(FileMetadata));
+                pthread_rwlock_wrlock(&nm->trie_lock);
+                FileMetadata* metadata = (FileMetadata*)calloc(1, sizeof(FileMetadata));
                 strncpy(metadata->filename, filename, MAX_FILENAME - 1);
                 metadata->filename[MAX_FILENAME - 1] = '\0';
                 strncpy(metadata->owner, client->username, MAX_USERNAME - 1);
@@ -261,10 +257,12 @@ ErrorCode handle_create_file(NameServer* nm, Client* client, const char* filenam
                 metadata->char_count = 0;
                 metadata->acl = NULL;
                 metadata->pending_requests = NULL;
+                metadata->is_directory = false;
 
                 insert_file_trie(nm->file_trie, filename, metadata);
                 put_in_cache(nm->cache, filename, metadata);
-                pthread_mutex_unlock(&nm->trie_lock);
+                journal_put(nm, metadata);
+                pthread_rwlock_unlock(&nm->trie_lock);
 
                 char details[256];
                 snprintf(details, sizeof(details), "File=%s SS_ID=%d", filename, ss->id);
@@ -286,15 +284,8 @@ ErrorCode handle_create_file(NameServer* nm, Client* client, const char* filenam
     return ERR_SS_NOT_FOUND;
 }
 
-ErrorCode handle_delete_file(NameServer* nm, Client* client, const char* filename) {
-    pthread_mutex_lock(&nm->trie_lock);
-    FileMetadata* metadata = search_file_trie(nm->file_trie, filename);
-    pthread_mutex_unlock(&nm->trie_lock);
-    
-    if (!metadata) {
-        return ERR_FILE_NOT_FOUND;
-    }
-    
+static ErrorCode delete_file_pinned(NameServer* nm, Client* client, const char* filename,
+                                    FileMetadata* metadata) {
     if (!is_owner(metadata, client->username)) {
         return ERR_PERMISSION_DENIED;
     }
@@ -313,10 +304,12 @@ ErrorCode handle_delete_file(NameServer* nm, Client* client, const char* filenam
         return ERR_SS_DISCONNECTED;
     }
     
-    // Remove from trie
-    pthread_mutex_lock(&nm->trie_lock);
+    // Remove from trie (invalidate the cache first so new lookups cannot pin it)
+    pthread_rwlock_wrlock(&nm->trie_lock);
+    remove_from_cache(nm->cache, filename);
     delete_file_trie(nm->file_trie, filename);
-    pthread_mutex_unlock(&nm->trie_lock);
+    journal_delete(nm, filename);
+    pthread_rwlock_unlock(&nm->trie_lock);
     
     char details[256];
     snprintf(details, sizeof(details), "File=%s", filename);
@@ -326,15 +319,20 @@ ErrorCode handle_delete_file(NameServer* nm, Client* client, const char* filenam
     return ERR_SUCCESS;
 }
 
-ErrorCode handle_read_file(NameServer* nm, Client* client, const char* filename, char* response) {
-    pthread_mutex_lock(&nm->trie_lock);
-    FileMetadata* metadata = search_file_trie(nm->file_trie, filename);
-    pthread_mutex_unlock(&nm->trie_lock);
+ErrorCode handle_delete_file(NameServer* nm, Client* client, const char* filename) {
+    FileMetadata* metadata = lookup_file(nm, filename);
     
     if (!metadata) {
         return ERR_FILE_NOT_FOUND;
     }
-    
+
+    ErrorCode result = delete_file_pinned(nm, client, filename, metadata);
+    release_metadata(metadata);
+    return result;
+}
+
+static ErrorCode read_file_pinned(NameServer* nm, Client* client, const char* filename,
+                                  char* response, FileMetadata* metadata) {
     AccessRight access = check_access(metadata, client->username);
     if (access == ACCESS_NONE) {
         return ERR_UNAUTHORIZED;
@@ -359,15 +357,20 @@ ErrorCode handle_read_file(NameServer* nm, Client* client, const char* filename,
     return ERR_SUCCESS;
 }
 
-ErrorCode handle_write_file(NameServer* nm, Client* client, const char* filename, int sentence_num) {
-    pthread_mutex_lock(&nm->trie_lock);
-    FileMetadata* metadata = search_file_trie(nm->file_trie, filename);
-    pthread_mutex_unlock(&nm->trie_lock);
+ErrorCode handle_read_file(NameServer* nm, Client* client, const char* filename, char* response) {
+    FileMetadata* metadata = lookup_file(nm, filename);
     
     if (!metadata) {
         return ERR_FILE_NOT_FOUND;
     }
-    
+
+    ErrorCode result = read_file_pinned(nm, client, filename, response, metadata);
+    release_metadata(metadata);
+    return result;
+}
+
+static ErrorCode write_file_pinned(NameServer* nm, Client* client, const char* filename,
+                                   int sentence_num, FileMetadata* metadata) {
     AccessRight access = check_access(metadata, client->username);
     if (access != ACCESS_WRITE) {
         return ERR_PERMISSION_DENIED;
@@ -391,15 +394,20 @@ ErrorCode handle_write_file(NameServer* nm, Client* client, const char* filename
     return ERR_SUCCESS;
 }
 
-ErrorCode handle_info_file(NameServer* nm, Client* client, const char* filename, char* response) {
-    pthread_mutex_lock(&nm->trie_lock);
-    FileMetadata* metadata = search_file_trie(nm->file_trie, filename);
-    pthread_mutex_unlock(&nm->trie_lock);
+ErrorCode handle_write_file(NameServer* nm, Client* client, const char* filename, int sentence_num) {
+    FileMetadata* metadata = lookup_file(nm, filename);
     
     if (!metadata) {
         return ERR_FILE_NOT_FOUND;
     }
-    
+
+    ErrorCode result = write_file_pinned(nm, client, filename, sentence_num, metadata);
+    release_metadata(metadata);
+    return result;
+}
+
+static ErrorCode info_file_pinned(NameServer* nm, Client* client, const char* filename,
+                                  char* response, FileMetadata* metadata) {
     AccessRight access = check_access(metadata, client->username);
     if (access == ACCESS_NONE) {
         return ERR_UNAUTHORIZED;
@@ -489,15 +497,20 @@ ErrorCode handle_info_file(NameServer* nm, Client* client, const char* filename,
     return ERR_SUCCESS;
 }
 
-ErrorCode handle_stream_file(NameServer* nm, Client* client, const char* filename, char* response) {
-    pthread_mutex_lock(&nm->trie_lock);
-    FileMetadata* metadata = search_file_trie(nm->file_trie, filename);
-    pthread_mutex_unlock(&nm->trie_lock);
+ErrorCode handle_info_file(NameServer* nm, Client* client, const char* filename, char* response) {
+    FileMetadata* metadata = lookup_file(nm, filename);
     
     if (!metadata) {
         return ERR_FILE_NOT_FOUND;
     }
-    
+
+    ErrorCode result = info_file_pinned(nm, client, filename, response, metadata);
+    release_metadata(metadata);
+    return result;
+}
+
+static ErrorCode stream_file_pinned(NameServer* nm, Client* client, const char* filename,
+                                    char* response, FileMetadata* metadata) {
     AccessRight access = check_access(metadata, client->username);
     if (access == ACCESS_NONE) {
         return ERR_UNAUTHORIZED;
@@ -521,15 +534,20 @@ ErrorCode handle_stream_file(NameServer* nm, Client* client, const char* filenam
     return ERR_SUCCESS;
 }
 
-ErrorCode handle_exec_file(NameServer* nm, Client* client, const char* filename, char* response) {
-    pthread_mutex_lock(&nm->trie_lock);
-    FileMetadata* metadata = search_file_trie(nm->file_trie, filename);
-    pthread_mutex_unlock(&nm->trie_lock);
+ErrorCode handle_stream_file(NameServer* nm, Client* client, const char* filename, char* response) {
+    FileMetadata* metadata = lookup_file(nm, filename);
     
     if (!metadata) {
         return ERR_FILE_NOT_FOUND;
     }
-    
+
+    ErrorCode result = stream_file_pinned(nm, client, filename, response, metadata);
+    release_metadata(metadata);
+    return result;
+}
+
+static ErrorCode exec_file_pinned(NameServer* nm, Client* client, const char* filename,
+                                  char* response, FileMetadata* metadata) {
     AccessRight access = check_access(metadata, client->username);
     if (access == ACCESS_NONE) {
         return ERR_UNAUTHORIZED;
@@ -544,13 +562,14 @@ ErrorCode handle_exec_file(NameServer* nm, Client* client, const char* filename,
     char command[BUFFER_SIZE];
     snprintf(command, sizeof(command), "READ %s", filename);
     
-    char file_content[BUFFER_SIZE * 4];
-    if (forward_to_ss(nm, ss->id, command, file_content) < 0) {
+    char* file_content = NULL;
+    if (forward_to_ss_alloc(nm, ss->id, command, &file_content) < 0) {
         return ERR_SS_DISCONNECTED;
     }
     
     // Execute commands on name server
     FILE* fp = popen(file_content, "r");
+    free(file_content);
     if (!fp) {
         strcpy(response, "Error: Failed to execute commands");
         return ERR_SYSTEM_ERROR;
@@ -602,15 +621,20 @@ ErrorCode handle_exec_file(NameServer* nm, Client* client, const char* filename,
     return ERR_SUCCESS;
 }
 
-ErrorCode handle_undo_file(NameServer* nm, Client* client, const char* filename) {
-    pthread_mutex_lock(&nm->trie_lock);
-    FileMetadata* metadata = search_file_trie(nm->file_trie, filename);
-    pthread_mutex_unlock(&nm->trie_lock);
+ErrorCode handle_exec_file(NameServer* nm, Client* client, const char* filename, char* response) {
+    FileMetadata* metadata = lookup_file(nm, filename);
     
     if (!metadata) {
         return ERR_FILE_NOT_FOUND;
     }
-    
+
+    ErrorCode result = exec_file_pinned(nm, client, filename, response, metadata);
+    release_metadata(metadata);
+    return result;
+}
+
+static ErrorCode undo_file_pinned(NameServer* nm, Client* client, const char* filename,
+                                  FileMetadata* metadata) {
     AccessRight access = check_access(metadata, client->username);
     if (access != ACCESS_WRITE) {
         return ERR_PERMISSION_DENIED;
@@ -644,6 +668,18 @@ ErrorCode handle_undo_file(NameServer* nm, Client* client, const char* filename)
     return ERR_SUCCESS;
 }
 
+ErrorCode handle_undo_file(NameServer* nm, Client* client, const char* filename) {
+    FileMetadata* metadata = lookup_file(nm, filename);
+    
+    if (!metadata) {
+        return ERR_FILE_NOT_FOUND;
+    }
+
+    ErrorCode result = undo_file_pinned(nm, client, filename, metadata);
+    release_metadata(metadata);
+    return result;
+}
+
 // ==================== ACCESS REQUESTS ====================
 
 static bool has_sufficient_access(AccessRight current, AccessRight requested) {
@@ -653,16 +689,9 @@ static bool has_sufficient_access(AccessRight current, AccessRight requested) {
     return current == requested;
 }
 
-ErrorCode handle_request_access(NameServer* nm, Client* client, const char* filename,
-                               AccessRight requested_access, char* response) {
-    pthread_mutex_lock(&nm->trie_lock);
-    FileMetadata* metadata = search_file_trie(nm->file_trie, filename);
-    pthread_mutex_unlock(&nm->trie_lock);
-
-    if (!metadata) {
-        return ERR_FILE_NOT_FOUND;
-    }
-
+static ErrorCode request_access_pinned(NameServer* nm, Client* client, const char* filename,
+                                       AccessRight requested_access, char* response,
+                                       FileMetadata* metadata) {
     if (is_owner(metadata, client->username)) {
         strcpy(response, "You already own this file");
         return ERR_INVALID_OPERATION;
@@ -674,6 +703,7 @@ ErrorCode handle_request_access(NameServer* nm, Client* client, const char* file
         return ERR_INVALID_OPERATION;
     }
 
+    pthread_rwlock_wrlock(&nm->trie_lock);
     AccessRequest* existing = find_access_request(metadata, client->username, NULL);
     if (existing) {
         existing->requested_access = requested_access;
@@ -689,6 +719,8 @@ ErrorCode handle_request_access(NameServer* nm, Client* client, const char* file
         metadata->pending_requests = new_request;
         snprintf(response, BUFFER_SIZE, "Requested %s access", access_to_string(requested_access));
     }
+    journal_put(nm, metadata);
+    pthread_rwlock_unlock(&nm->trie_lock);
 
     char details[256];
     snprintf(details, sizeof(details), "File=%s Requested=%s", filename,
@@ -699,15 +731,23 @@ ErrorCode handle_request_access(NameServer* nm, Client* client, const char* file
     return ERR_SUCCESS;
 }
 
-ErrorCode handle_list_requests(NameServer* nm, Client* client, const char* filename, char* response) {
-    pthread_mutex_lock(&nm->trie_lock);
-    FileMetadata* metadata = search_file_trie(nm->file_trie, filename);
-    pthread_mutex_unlock(&nm->trie_lock);
+ErrorCode handle_request_access(NameServer* nm, Client* client, const char* filename,
+                               AccessRight requested_access, char* response) {
+    FileMetadata* metadata = lookup_file(nm, filename);
 
     if (!metadata) {
         return ERR_FILE_NOT_FOUND;
     }
 
+    ErrorCode result = request_access_pinned(nm, client, filename,
+                                             requested_access, response, metadata);
+    release_metadata(metadata);
+    return result;
+}
+
+static ErrorCode list_requests_pinned(NameServer* nm, Client* client, const char* filename,
+                                      char* response, FileMetadata* metadata) {
+    (void)nm;
     if (!is_owner(metadata, client->username)) {
         return ERR_PERMISSION_DENIED;
     }
@@ -747,16 +787,21 @@ ErrorCode handle_list_requests(NameServer* nm, Client* client, const char* filen
     return ERR_SUCCESS;
 }
 
-ErrorCode handle_process_request(NameServer* nm, Client* client, const char* filename,
-                                const char* target_user, bool approve, char* response) {
-    pthread_mutex_lock(&nm->trie_lock);
-    FileMetadata* metadata = search_file_trie(nm->file_trie, filename);
-    pthread_mutex_unlock(&nm->trie_lock);
+ErrorCode handle_list_requests(NameServer* nm, Client* client, const char* filename, char* response) {
+    FileMetadata* metadata = lookup_file(nm, filename);
 
     if (!metadata) {
         return ERR_FILE_NOT_FOUND;
     }
 
+    ErrorCode result = list_requests_pinned(nm, client, filename, response, metadata);
+    release_metadata(metadata);
+    return result;
+}
+
+static ErrorCode process_request_pinned(NameServer* nm, Client* client, const char* filename,
+                                        const char* target_user, bool approve, char* response,
+                                        FileMetadata* metadata) {
     if (!is_owner(metadata, client->username)) {
         return ERR_PERMISSION_DENIED;
     }
@@ -781,12 +826,19 @@ ErrorCode handle_process_request(NameServer* nm, Client* client, const char* fil
         snprintf(response, BUFFER_SIZE, "Denied access request from %s", target_user);
     }
 
-    if (prev) {
-        prev->next = request->next;
-    } else {
-        metadata->pending_requests = request->next;
+    // Re-find under the write lock; the list may have changed while granting
+    pthread_rwlock_wrlock(&nm->trie_lock);
+    request = find_access_request(metadata, target_user, &prev);
+    if (request) {
+        if (prev) {
+            prev->next = request->next;
+        } else {
+            metadata->pending_requests = request->next;
+        }
+        free(request);
+        journal_put(nm, metadata);
     }
-    free(request);
+    pthread_rwlock_unlock(&nm->trie_lock);
 
     char details[256];
     snprintf(details, sizeof(details), "File=%s User=%s Action=%s", filename,
@@ -797,6 +849,20 @@ ErrorCode handle_process_request(NameServer* nm, Client* client, const char* fil
     return ERR_SUCCESS;
 }
 
+ErrorCode handle_process_request(NameServer* nm, Client* client, const char* filename,
+                                const char* target_user, bool approve, char* response) {
+    FileMetadata* metadata = lookup_file(nm, filename);
+
+    if (!metadata) {
+        return ERR_FILE_NOT_FOUND;
+    }
+
+    ErrorCode result = process_request_pinned(nm, client, filename,
+                                              target_user, approve, response, metadata);
+    release_metadata(metadata);
+    return result;
+}
+
 // ==================== CHECKPOINT MANAGEMENT ====================
 
 static void trim_trailing_newlines(char* text) {
@@ -880,21 +946,8 @@ static ErrorCode parse_checkpoint_response(const char* ss_response, char* messag
     return ERR_SYSTEM_ERROR;
 }
 
-ErrorCode handle_checkpoint(NameServer* nm, Client* client, const char* filename,
-                            const char* tag, char* response) {
-    if (!validate_checkpoint_tag(tag)) {
-        strcpy(response, "Invalid checkpoint tag (use letters, numbers, '.', '-', '_')");
-        return ERR_INVALID_OPERATION;
-    }
-
-    pthread_mutex_lock(&nm->trie_lock);
-    FileMetadata* metadata = search_file_trie(nm->file_trie, filename);
-    pthread_mutex_unlock(&nm->trie_lock);
-
-    if (!metadata) {
-        return ERR_FILE_NOT_FOUND;
-    }
-
+static ErrorCode checkpoint_pinned(NameServer* nm, Client* client, const char* filename,
+                                   const char* tag, char* response, FileMetadata* metadata) {
     AccessRight access = check_access(metadata, client->username);
     if (access != ACCESS_WRITE) {
         return ERR_PERMISSION_DENIED;
@@ -923,21 +976,26 @@ ErrorCode handle_checkpoint(NameServer* nm, Client* client, const char* filename
     return result;
 }
 
-ErrorCode handle_view_checkpoint(NameServer* nm, Client* client, const char* filename,
-                                 const char* tag, char* response) {
+ErrorCode handle_checkpoint(NameServer* nm, Client* client, const char* filename,
+                            const char* tag, char* response) {
     if (!validate_checkpoint_tag(tag)) {
-        strcpy(response, "Invalid checkpoint tag");
+        strcpy(response, "Invalid checkpoint tag (use letters, numbers, '.', '-', '_')");
         return ERR_INVALID_OPERATION;
     }
 
-    pthread_mutex_lock(&nm->trie_lock);
-    FileMetadata* metadata = search_file_trie(nm->file_trie, filename);
-    pthread_mutex_unlock(&nm->trie_lock);
+    FileMetadata* metadata = lookup_file(nm, filename);
 
     if (!metadata) {
         return ERR_FILE_NOT_FOUND;
     }
 
+    ErrorCode result = checkpoint_pinned(nm, client, filename, tag, response, metadata);
+    release_metadata(metadata);
+    return result;
+}
+
+static ErrorCode view_checkpoint_pinned(NameServer* nm, Client* client, const char* filename,
+                                        const char* tag, char* response, FileMetadata* metadata) {
     AccessRight access = check_access(metadata, client->username);
     if (access == ACCESS_NONE) {
         return ERR_UNAUTHORIZED;
@@ -966,21 +1024,26 @@ ErrorCode handle_view_checkpoint(NameServer* nm, Client* client, const char* fil
     return result;
 }
 
-ErrorCode handle_revert_checkpoint(NameServer* nm, Client* client, const char* filename,
-                                   const char* tag, char* response) {
+ErrorCode handle_view_checkpoint(NameServer* nm, Client* client, const char* filename,
+                                 const char* tag, char* response) {
     if (!validate_checkpoint_tag(tag)) {
         strcpy(response, "Invalid checkpoint tag");
         return ERR_INVALID_OPERATION;
     }
 
-    pthread_mutex_lock(&nm->trie_lock);
-    FileMetadata* metadata = search_file_trie(nm->file_trie, filename);
-    pthread_mutex_unlock(&nm->trie_lock);
+    FileMetadata* metadata = lookup_file(nm, filename);
 
     if (!metadata) {
         return ERR_FILE_NOT_FOUND;
     }
 
+    ErrorCode result = view_checkpoint_pinned(nm, client, filename, tag, response, metadata);
+    release_metadata(metadata);
+    return result;
+}
+
+static ErrorCode revert_checkpoint_pinned(NameServer* nm, Client* client, const char* filename,
+                                          const char* tag, char* response, FileMetadata* metadata) {
     AccessRight access = check_access(metadata, client->username);
     if (access != ACCESS_WRITE) {
         return ERR_PERMISSION_DENIED;
@@ -1012,16 +1075,26 @@ ErrorCode handle_revert_checkpoint(NameServer* nm, Client* client, const char* f
     return result;
 }
 
-ErrorCode handle_list_checkpoints(NameServer* nm, Client* client, const char* filename,
-                                  char* response) {
-    pthread_mutex_lock(&nm->trie_lock);
-    FileMetadata* metadata = search_file_trie(nm->file_trie, filename);
-    pthread_mutex_unlock(&nm->trie_lock);
+ErrorCode handle_revert_checkpoint(NameServer* nm, Client* client, const char* filename,
+                                   const char* tag, char* response) {
+    if (!validate_checkpoint_tag(tag)) {
+        strcpy(response, "Invalid checkpoint tag");
+        return ERR_INVALID_OPERATION;
+    }
+
+    FileMetadata* metadata = lookup_file(nm, filename);
 
     if (!metadata) {
         return ERR_FILE_NOT_FOUND;
     }
 
+    ErrorCode result = revert_checkpoint_pinned(nm, client, filename, tag, response, metadata);
+    release_metadata(metadata);
+    return result;
+}
+
+static ErrorCode list_checkpoints_pinned(NameServer* nm, Client* client, const char* filename,
+                                         char* response, FileMetadata* metadata) {
     AccessRight access = check_access(metadata, client->username);
     if (access == ACCESS_NONE) {
         return ERR_UNAUTHORIZED;
@@ -1050,6 +1123,19 @@ ErrorCode handle_list_checkpoints(NameServer* nm, Client* client, const char* fi
     return result;
 }
 
+ErrorCode handle_list_checkpoints(NameServer* nm, Client* client, const char* filename,
+                                  char* response) {
+    FileMetadata* metadata = lookup_file(nm, filename);
+
+    if (!metadata) {
+        return ERR_FILE_NOT_FOUND;
+    }
+
+    ErrorCode result = list_checkpoints_pinned(nm, client, filename, response, metadata);
+    release_metadata(metadata);
+    return result;
+}
+
 // ==================== USER MANAGEMENT ====================
 
 ErrorCode handle_list_users(NameServer* nm, char* response) {
@@ -1100,68 +1186,227 @@ ErrorCode handle_list_users(NameServer* nm, char* response) {
 // ==================== NETWORKING ====================
 
 void send_response(int socket_fd, ErrorCode error, const char* message) {
-    char response[BUFFER_SIZE];
-    snprintf(response, sizeof(response), "%d:%s", error, message ? message : "");
-    send(socket_fd, response, strlen(response), 0);
+    const char* text = message ? message : "";
+    size_t length = strlen(text) + 16;
+    char* response = (char*)malloc(length);
+    if (!response) {
+        return;
+    }
+    int written = snprintf(response, length, "%d:%s", error, text);
+    wire_send(socket_fd, WIRE_OP_REPLY, 0, response, (size_t)written);
+    free(response);
 }
 
-int forward_to_ss(NameServer* nm, int ss_id, const char* command, char* response) {
+// ==================== SS RPC CHANNEL ====================
+// Requests and replies are wire frames tagged with a request ID, so many NM
+// threads can share one SS socket and the SS may answer in any order. The
+// reactor thread feeds reply frames into ss_channel_receive, which wakes the
+// matching waiter.
+
+static void unlink_pending(StorageServer* ss, PendingRpc* rpc) {
+    PendingRpc** link = &ss->pending;
+    while (*link) {
+        if (*link == rpc) {
+            *link = rpc->next;
+            return;
+        }
+        link = &(*link)->next;
+    }
+}
+
+// Caller holds ss->lock
+void ss_channel_reset(StorageServer* ss) {
+    PendingRpc* rpc = ss->pending;
+    while (rpc) {
+        PendingRpc* next = rpc->next;
+        rpc->failed = true;
+        pthread_cond_signal(&rpc->cond);
+        rpc = next;
+    }
+    ss->pending = NULL;
+    wire_reader_reset(&ss->rx);
+}
+
+// SO_SNDTIMEO for the time left until deadline; zero would mean "no limit"
+static void set_send_timeout(int socket_fd, const struct timespec* deadline) {
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    long long remaining_us = (long long)(deadline->tv_sec - now.tv_sec) * 1000000LL +
+                             (deadline->tv_nsec - now.tv_nsec) / 1000;
+    if (remaining_us < 1000) {
+        remaining_us = 1000;
+    }
+    struct timeval tv;
+    tv.tv_sec = (time_t)(remaining_us / 1000000LL);
+    tv.tv_usec = (suseconds_t)(remaining_us % 1000000LL);
+    setsockopt(socket_fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+}
+
+// Returns the reply length and hands over a heap payload, or -1
+int forward_to_ss_alloc(NameServer* nm, int ss_id, const char* command, char** response) {
+    *response = NULL;
     StorageServer* ss = get_storage_server(nm, ss_id);
     if (!ss || !ss->is_active) {
         return -1;
     }
-    
+
+    PendingRpc rpc;
+    memset(&rpc, 0, sizeof(rpc));
+    pthread_cond_init(&rpc.cond, NULL);
+
+    // Register before sending so a fast reply always finds its waiter
     pthread_mutex_lock(&ss->lock);
-    
-    // Send command
-    if (send(ss->socket_fd, command, strlen(command), 0) < 0) {
+    int socket_fd = ss->socket_fd;
+    if (socket_fd < 0) {
         pthread_mutex_unlock(&ss->lock);
-        deregister_storage_server(nm, ss_id);
+        pthread_cond_destroy(&rpc.cond);
         return -1;
     }
-    
-    // Receive response
-    int bytes = recv(ss->socket_fd, response, BUFFER_SIZE - 1, 0);
-    if (bytes <= 0) {
-        pthread_mutex_unlock(&ss->lock);
-        deregister_storage_server(nm, ss_id);
-        return -1;
+    if (++ss->next_request_id == 0) {
+        ss->next_request_id = 1;
     }
-    
-    response[bytes] = '\0';
+    rpc.request_id = ss->next_request_id;
+    rpc.next = ss->pending;
+    ss->pending = &rpc;
     pthread_mutex_unlock(&ss->lock);
-    
-    return bytes;
+
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += SS_RPC_TIMEOUT_MS / 1000;
+    deadline.tv_nsec += (long)(SS_RPC_TIMEOUT_MS % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+
+    // The fd is only closed under send_lock, so if it is still ours here it
+    // cannot be reused by another connection while the frame is written.
+    // Waiting for the lock and the write itself are both bounded by the
+    // deadline, so a stalled SS cannot pin workers or hold off deregistration.
+    bool locked = pthread_mutex_timedlock(&ss->send_lock, &deadline) == 0;
+    bool stale = locked && ss->socket_fd != socket_fd;
+    bool sent = false;
+    if (locked && !stale) {
+        set_send_timeout(socket_fd, &deadline);
+        sent = wire_send_text(socket_fd, WIRE_OP_REQUEST, rpc.request_id, command);
+    }
+    if (locked) {
+        pthread_mutex_unlock(&ss->send_lock);
+    }
+
+    pthread_mutex_lock(&ss->lock);
+    bool timed_out = false;
+    while (sent && !rpc.done && !rpc.failed) {
+        if (pthread_cond_timedwait(&rpc.cond, &ss->lock, &deadline) == ETIMEDOUT) {
+            timed_out = !rpc.done && !rpc.failed;
+            break;
+        }
+    }
+    unlink_pending(ss, &rpc);
+    pthread_mutex_unlock(&ss->lock);
+    pthread_cond_destroy(&rpc.cond);
+
+    if (stale) {
+        return -1;  // Channel was closed or replaced before the send
+    }
+    if (!locked) {
+        timed_out = true;  // Another sender held the channel past our deadline
+    } else if (!sent) {
+        // A short write leaves a torn frame, so the channel is unusable
+        deregister_storage_server_safe(nm, ss_id, socket_fd);
+        return -1;
+    }
+    if (timed_out) {
+        // A late reply for this ID is dropped by ss_channel_receive
+        char details[BUFFER_SIZE];
+        snprintf(details, sizeof(details), "SS_ID=%d Request=%u Command=%.200s",
+                 ss_id, rpc.request_id, command);
+        log_message(nm, "WARN", ss->ip, ss->nm_port, NULL, "SS_TIMEOUT", details);
+        return -1;
+    }
+    if (!rpc.done) {
+        return -1;
+    }
+    *response = rpc.payload;
+    return (int)rpc.length;
 }
 
-void parse_command(const char* command, char* cmd, char* args[], int* arg_count) {
-    char buffer[BUFFER_SIZE];
-    strncpy(buffer, command, BUFFER_SIZE - 1);
-    buffer[BUFFER_SIZE - 1] = '\0';
-    
-    *arg_count = 0;
-    char* token = strtok(buffer, " \t\n");
-    
-    if (token) {
-        strcpy(cmd, token);
-        token = strtok(NULL, " \t\n");
-        
-        while (token && *arg_count < 10) {
-            args[*arg_count] = strdup(token);
-            (*arg_count)++;
-            token = strtok(NULL, " \t\n");
+// Fixed-buffer variant: the reply is truncated to BUFFER_SIZE - 1 bytes
+int forward_to_ss(NameServer* nm, int ss_id, const char* command, char* response) {
+    char* payload = NULL;
+    int length = forward_to_ss_alloc(nm, ss_id, command, &payload);
+    if (length < 0) {
+        return -1;
+    }
+    if (length > BUFFER_SIZE - 1) {
+        length = BUFFER_SIZE - 1;
+    }
+    memcpy(response, payload, (size_t)length);
+    response[length] = '\0';
+    free(payload);
+    return length;
+}
+
+// Takes ownership of msg's payload when a waiter is found
+static void complete_pending(StorageServer* ss, WireMessage* msg) {
+    for (PendingRpc* rpc = ss->pending; rpc; rpc = rpc->next) {
+        if (rpc->request_id != msg->request_id) continue;
+
+        rpc->payload = msg->payload;
+        rpc->length = msg->length;
+        msg->payload = NULL;
+        rpc->done = true;
+        unlink_pending(ss, rpc);
+        pthread_cond_signal(&rpc->cond);
+        return;
+    }
+}
+
+// Drains the SS socket and completes every whole reply; false means the channel is dead
+bool ss_channel_receive(NameServer* nm, int ss_id, int socket_fd) {
+    StorageServer* ss = get_storage_server(nm, ss_id);
+    if (!ss) {
+        return false;
+    }
+
+    pthread_mutex_lock(&ss->lock);
+    if (ss->socket_fd != socket_fd) {
+        pthread_mutex_unlock(&ss->lock);
+        return true;  // Stale event for a replaced socket
+    }
+
+    bool alive = true;
+    while (alive) {
+        ssize_t bytes = wire_reader_fill(&ss->rx, socket_fd);
+        if (bytes == 0 || (bytes < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+            alive = false;
+        }
+
+        WireMessage msg;
+        int status;
+        while ((status = wire_reader_next(&ss->rx, &msg)) == 1) {
+            complete_pending(ss, &msg);
+            wire_message_free(&msg);
+        }
+        if (status < 0) {
+            alive = false;  // Corrupt frame
+        }
+        if (bytes < 0) {
+            break;
         }
     }
+
+    pthread_mutex_unlock(&ss->lock);
+    return alive;
 }
 
 // ==================== FOLDER OPERATIONS ====================
 
 ErrorCode handle_create_folder(NameServer* nm, Client* client, const char* foldername) {
     // Ensure folder does not already exist in trie
-    pthread_mutex_lock(&nm->trie_lock);
-    FileMetadata* existing = search_file_trie(nm->file_trie, foldername);
-    pthread_mutex_unlock(&nm->trie_lock);
+    FileMetadata* existing = lookup_file(nm, foldername);
     if (existing) {
+        release_metadata(existing);
         return ERR_FILE_EXISTS;
     }
 
@@ -1169,28 +1414,30 @@ ErrorCode handle_create_folder(NameServer* nm, Client* client, const char* folde
     // If so, we should try to place it on the same SS as the parent.
     char parent_folder[MAX_FILENAME] = {0};
     FileMetadata* parent_meta = NULL;
+    int parent_ss_id = -1;  // Set when the parent is a folder
     const char* last_slash = strrchr(foldername, '/');
     if (last_slash) {
         size_t plen = (size_t)(last_slash - foldername);
         if (plen > 0 && plen < sizeof(parent_folder)) {
             strncpy(parent_folder, foldername, plen);
             parent_folder[plen] = '\0';
-            pthread_mutex_lock(&nm->trie_lock);
-            parent_meta = search_file_trie(nm->file_trie, parent_folder);
-            pthread_mutex_unlock(&nm->trie_lock);
+            parent_meta = lookup_file(nm, parent_folder);
         }
         
         if (!parent_meta) {
             return ERR_PARENT_NOT_FOUND;
         }
-        if (!parent_meta->is_directory) {
+        bool parent_is_folder = parent_meta->is_directory;
+        parent_ss_id = parent_meta->ss_id;
+        release_metadata(parent_meta);
+        if (!parent_is_folder) {
             return ERR_INVALID_OPERATION;
         }
     }
 
     // If parent exists, try its SS first.
-    if (parent_meta && parent_meta->is_directory) {
-        StorageServer* ss = get_storage_server(nm, parent_meta->ss_id);
+    if (parent_ss_id >= 0) {
+        StorageServer* ss = get_storage_server(nm, parent_ss_id);
         if (ss && ss->is_active) {
             char command[BUFFER_SIZE];
             snprintf(command, sizeof(command), "CREATE_FOLDER %s", foldername);
@@ -1199,10 +1446,10 @@ ErrorCode handle_create_folder(NameServer* nm, Client* client, const char* folde
             if (forward_to_ss(nm, ss->id, command, response) >= 0) {
                 if (strncmp(response, "SUCCESS", 7) == 0) {
                     // Success on parent's SS
-                    pthread_mutex_lock(&nm->trie_lock);
+                    pthread_rwlock_wrlock(&nm->trie_lock);
                     // Double check
                     if (search_file_trie(nm->file_trie, foldername)) {
-                        pthread_mutex_unlock(&nm->trie_lock);
+                        pthread_rwlock_unlock(&nm->trie_lock);
                         return ERR_FILE_EXISTS;
                     }
 
@@ -1219,7 +1466,8 @@ ErrorCode handle_create_folder(NameServer* nm, Client* client, const char* folde
                     record_last_access(metadata, client->username);
 
                     insert_file_trie(nm->file_trie, foldername, metadata);
-                    pthread_mutex_unlock(&nm->trie_lock);
+                    journal_put(nm, metadata);
+                    pthread_rwlock_unlock(&nm->trie_lock);
 
                     char details[256];
                     snprintf(details, sizeof(details), "Folder=%s SS_ID=%d (Parent)", foldername, ss->id);
@@ -1269,11 +1517,11 @@ ErrorCode handle_create_folder(NameServer* nm, Client* client, const char* folde
         if (forward_to_ss(nm, ss->id, command, response) >= 0) {
             if (strncmp(response, "SUCCESS", 7) == 0) {
                 // Insert folder metadata pointing to this storage server
-                pthread_mutex_lock(&nm->trie_lock);
+                pthread_rwlock_wrlock(&nm->trie_lock);
                 // Double-check not inserted meanwhile
                 FileMetadata* double_check = search_file_trie(nm->file_trie, foldername);
                 if (double_check) {
-                    pthread_mutex_unlock(&nm->trie_lock);
+                    pthread_rwlock_unlock(&nm->trie_lock);
                     return ERR_FILE_EXISTS;
                 }
 
@@ -1290,7 +1538,8 @@ ErrorCode handle_create_folder(NameServer* nm, Client* client, const char* folde
                 record_last_access(metadata, client->username);
 
                 insert_file_trie(nm->file_trie, foldername, metadata);
-                pthread_mutex_unlock(&nm->trie_lock);
+                journal_put(nm, metadata);
+                pthread_rwlock_unlock(&nm->trie_lock);
 
                 char details[256];
                 snprintf(details, sizeof(details), "Folder=%s SS_ID=%d", foldername, ss->id);
@@ -1312,15 +1561,15 @@ ErrorCode handle_create_folder(NameServer* nm, Client* client, const char* folde
 }
 
 ErrorCode handle_move_file(NameServer* nm, Client* client, const char* source, const char* destination) {
-    pthread_mutex_lock(&nm->trie_lock);
+    pthread_rwlock_wrlock(&nm->trie_lock);
     FileMetadata* src_meta = search_file_trie(nm->file_trie, source);
     if (!src_meta) {
-        pthread_mutex_unlock(&nm->trie_lock);
+        pthread_rwlock_unlock(&nm->trie_lock);
         return ERR_FILE_NOT_FOUND;
     }
 
     if (!is_owner(src_meta, client->username)) {
-        pthread_mutex_unlock(&nm->trie_lock);
+        pthread_rwlock_unlock(&nm->trie_lock);
         return ERR_PERMISSION_DENIED;
     }
 
@@ -1340,7 +1589,7 @@ ErrorCode handle_move_file(NameServer* nm, Client* client, const char* source, c
     }
 
     if (search_file_trie(nm->file_trie, new_path)) {
-        pthread_mutex_unlock(&nm->trie_lock);
+        pthread_rwlock_unlock(&nm->trie_lock);
         return ERR_FILE_EXISTS;
     }
 
@@ -1348,7 +1597,7 @@ ErrorCode handle_move_file(NameServer* nm, Client* client, const char* source, c
     if (!src_meta->is_directory) {
         StorageServer* ss = get_storage_server(nm, src_meta->ss_id);
         if (!ss || !ss->is_active) {
-            pthread_mutex_unlock(&nm->trie_lock);
+            pthread_rwlock_unlock(&nm->trie_lock);
             return ERR_SS_NOT_FOUND;
         }
 
@@ -1357,7 +1606,7 @@ ErrorCode handle_move_file(NameServer* nm, Client* client, const char* source, c
         char response[BUFFER_SIZE];
         
         // Unlock trie while communicating with SS
-        pthread_mutex_unlock(&nm->trie_lock);
+        pthread_rwlock_unlock(&nm->trie_lock);
         
         if (forward_to_ss(nm, ss->id, command, response) < 0) {
             return ERR_SS_DISCONNECTED;
@@ -1368,11 +1617,11 @@ ErrorCode handle_move_file(NameServer* nm, Client* client, const char* source, c
         }
         
         // Re-lock trie to update metadata
-        pthread_mutex_lock(&nm->trie_lock);
+        pthread_rwlock_wrlock(&nm->trie_lock);
         // Re-search to be safe
         src_meta = search_file_trie(nm->file_trie, source);
         if (!src_meta) {
-            pthread_mutex_unlock(&nm->trie_lock);
+            pthread_rwlock_unlock(&nm->trie_lock);
             return ERR_FILE_NOT_FOUND;
         }
     }
@@ -1380,17 +1629,24 @@ ErrorCode handle_move_file(NameServer* nm, Client* client, const char* source, c
     // Update Trie
     FileMetadata* new_meta = (FileMetadata*)malloc(sizeof(FileMetadata));
     memcpy(new_meta, src_meta, sizeof(FileMetadata));
+    atomic_init(&new_meta->refs, 0);  // Pins stay with the old copy
     strncpy(new_meta->filename, new_path, MAX_FILENAME - 1);
     new_meta->filename[MAX_FILENAME - 1] = '\0';
     new_meta->last_modified = time(NULL);
     
     new_meta->acl = src_meta->acl;
     src_meta->acl = NULL; // Prevent free in delete_file_trie
+    new_meta->pending_requests = src_meta->pending_requests;
+    src_meta->pending_requests = NULL;
     
+    remove_from_cache(nm->cache, source);
     insert_file_trie(nm->file_trie, new_path, new_meta);
     delete_file_trie(nm->file_trie, source);
+    put_in_cache(nm->cache, new_path, new_meta);
+    journal_delete(nm, source);
+    journal_put(nm, new_meta);
     
-    pthread_mutex_unlock(&nm->trie_lock);
+    pthread_rwlock_unlock(&nm->trie_lock);
 
     char details[512];
     snprintf(details, sizeof(details), "Src=%s Dest=%s", source, new_path);
@@ -1404,63 +1660,48 @@ typedef struct {
     char* buffer;
     int* offset;
     const char* base_folder;
+    size_t base_len;
+    int matched;
 } ViewFolderContext;
 
-static void collect_folder_contents(TrieNode* node, char* prefix, int depth, ViewFolderContext* ctx) {
-    if (!node) return;
-    
-    if (node->is_end_of_word && node->file_metadata) {
-        FileMetadata* meta = (FileMetadata*)node->file_metadata;
-        size_t base_len = strlen(ctx->base_folder);
-        if (strncmp(meta->filename, ctx->base_folder, base_len) == 0) {
-            const char* relative = meta->filename + base_len;
-            if (*relative == '/') relative++;
-            
-            if (strchr(relative, '/') == NULL && strlen(relative) > 0) {
-                // Direct child
-                *ctx->offset += snprintf(ctx->buffer + *ctx->offset, BUFFER_SIZE * 4 - *ctx->offset,
-                                 "%s%s\n", meta->filename, meta->is_directory ? "/" : "");
-            }
-        }
-    }
-    
-    for (int i = 0; i < 256; i++) {
-        if (node->children[i]) {
-            prefix[depth] = (char)i;
-            prefix[depth + 1] = '\0';
-            collect_folder_contents(node->children[i], prefix, depth + 1, ctx);
+static void collect_folder_contents(FileMetadata* meta, void* arg) {
+    ViewFolderContext* ctx = (ViewFolderContext*)arg;
+    ctx->matched++;
+    if (*ctx->offset >= BUFFER_SIZE * 4 - 1) return;
+
+    const char* relative = meta->filename + ctx->base_len;
+    if (*relative == '/') relative++;
+
+    if (strchr(relative, '/') == NULL && strlen(relative) > 0) {
+        // Direct child
+        *ctx->offset += snprintf(ctx->buffer + *ctx->offset, BUFFER_SIZE * 4 - *ctx->offset,
+                         "%s%s\n", meta->filename, meta->is_directory ? "/" : "");
+        if (*ctx->offset > BUFFER_SIZE * 4 - 1) {
+            *ctx->offset = BUFFER_SIZE * 4 - 1;
         }
     }
 }
 
 ErrorCode handle_view_folder(NameServer* nm, Client* client, const char* foldername, char* response) {
-    pthread_mutex_lock(&nm->trie_lock);
-    
-    // Find the folder node
-    TrieNode* current = nm->file_trie;
-    for (int i = 0; foldername[i] != '\0'; i++) {
-        unsigned char index = (unsigned char)foldername[i];
-        if (!current->children[index]) {
-            pthread_mutex_unlock(&nm->trie_lock);
-            return ERR_FILE_NOT_FOUND;
-        }
-        current = current->children[index];
-    }
+    pthread_rwlock_rdlock(&nm->trie_lock);
     
-    if (current->is_end_of_word && current->file_metadata && !((FileMetadata*)current->file_metadata)->is_directory) {
-         pthread_mutex_unlock(&nm->trie_lock);
+    FileMetadata* folder_meta = search_file_trie(nm->file_trie, foldername);
+    if (folder_meta && !folder_meta->is_directory) {
+         pthread_rwlock_unlock(&nm->trie_lock);
          return ERR_INVALID_OPERATION; // Not a folder
     }
 
     char buffer[BUFFER_SIZE * 4] = {0};
     int offset = 0;
     
-    ViewFolderContext ctx = { buffer, &offset, foldername };
-    
-    char prefix[MAX_FILENAME] = {0};
-    collect_folder_contents(current, prefix, 0, &ctx);
+    ViewFolderContext ctx = { buffer, &offset, foldername, strlen(foldername), 0 };
+    walk_file_trie(nm->file_trie, foldername, collect_folder_contents, &ctx);
     
-    pthread_mutex_unlock(&nm->trie_lock);
+    pthread_rwlock_unlock(&nm->trie_lock);
+
+    if (ctx.matched == 0) {
+        return ERR_FILE_NOT_FOUND;
+    }
     
     if (offset == 0) {
         strcpy(response, "Folder is empty\n");
@@ -1,4 +1,7 @@
 #include "storage_server.h"
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #ifndef DT_REG
 #define DT_REG 8
@@ -22,40 +25,7 @@ const char* error_to_string(ErrorCode error) {
 
 void log_message(StorageServer* ss, const char* level, const char* operation, 
                 const char* details) {
-    pthread_mutex_lock(&ss->log_lock);
-    
-    time_t now = time(NULL);
-    char timestamp[64];
-    strftime(timestamp, sizeof(timestamp), "%Y-%m-%d %H:%M:%S", localtime(&now));
-    
-    fprintf(ss->log_file, "[%s] [%s] Op=%s Details=%s\n",
-            timestamp, level, operation, details ? details : "");
-    fflush(ss->log_file);
-    
-    printf("[%s] [%s] %s - %s\n", timestamp, level, operation, 
-           details ? details : "");
-    
-    pthread_mutex_unlock(&ss->log_lock);
-}
-
-void parse_command(const char* command, char* cmd, char* args[], int* arg_count) {
-    char buffer[BUFFER_SIZE];
-    strncpy(buffer, command, BUFFER_SIZE - 1);
-    buffer[BUFFER_SIZE - 1] = '\0';
-    
-    *arg_count = 0;
-    char* token = strtok(buffer, " \t\n");
-    
-    if (token) {
-        strcpy(cmd, token);
-        token = strtok(NULL, " \t\n");
-        
-        while (token && *arg_count < 10) {
-            args[*arg_count] = strdup(token);
-            (*arg_count)++;
-            token = strtok(NULL, " \t\n");
-        }
-    }
+    async_log_append(&ss->log, level, NULL, operation, details);
 }
 
 void ensure_storage_dir() {
@@ -65,6 +35,18 @@ void ensure_storage_dir() {
     }
 }
 
+void ensure_parent_directories(const char* path) {
+    char path_copy[MAX_PATH];
+    snprintf(path_copy, sizeof(path_copy), "%s", path);
+    for (char* p = path_copy + 1; *p; p++) {
+        if (*p == '/') {
+            *p = '\0';
+            mkdir(path_copy, 0700);
+            *p = '/';
+        }
+    }
+}
+
 bool build_undo_path(const FileEntry* file, char* buffer, size_t size) {
     if (!file || !buffer || size == 0) {
         return false;
@@ -115,116 +97,432 @@ bool is_sentence_delimiter(char c) {
     return (c == '.' || c == '!' || c == '?');
 }
 
-// ==================== SENTENCE NODE OPERATIONS (LINKED LIST) ====================
+// ==================== FILE MEMORY ====================
 
-SentenceNode* create_sentence_node(const char** word_array, int word_count, char delimiter) {
-    SentenceNode* node = (SentenceNode*)calloc(1, sizeof(SentenceNode));
-    if (!node) {
-        return NULL;
+void file_memory_init(FileEntry* file) {
+    pthread_mutex_init(&file->memory.lock, NULL);
+    arena_init(&file->memory.words);
+    file->memory.abandoned = 0;
+    slab_pool_init(&file->memory.sentences, sizeof(SentenceNode));
+    slab_pool_init(&file->memory.drafts, sizeof(DraftSentence));
+    slab_pool_init(&file->memory.undo_entries, sizeof(SentenceUndoEntry));
+}
+
+// Returns every chunk and slab at once. Sentence mutexes are default
+// mutexes with no resources of their own, so they are not destroyed one by one.
+void file_memory_release(FileEntry* file) {
+    pthread_mutex_lock(&file->memory.lock);
+    arena_release(&file->memory.words);
+    file->memory.abandoned = 0;
+    slab_pool_release(&file->memory.sentences);
+    slab_pool_release(&file->memory.drafts);
+    slab_pool_release(&file->memory.undo_entries);
+    pthread_mutex_unlock(&file->memory.lock);
+}
+
+char* file_memory_text(FileEntry* file, const char* text, size_t length) {
+    pthread_mutex_lock(&file->memory.lock);
+    char* copy = arena_strndup(&file->memory.words, text, length);
+    pthread_mutex_unlock(&file->memory.lock);
+    return copy;
+}
+
+static size_t word_array_bytes(int capacity) {
+    return sizeof(char*) * (size_t)(capacity > 0 ? capacity : 1);
+}
+
+char** file_memory_words(FileEntry* file, int capacity) {
+    size_t size = word_array_bytes(capacity);
+    pthread_mutex_lock(&file->memory.lock);
+    char** words = (char**)arena_alloc(&file->memory.words, size);
+    pthread_mutex_unlock(&file->memory.lock);
+    if (words) {
+        memset(words, 0, size);
     }
-    
-    node->word_count = word_count;
-    node->word_capacity = (word_count > 0) ? word_count : 4;
-    node->delimiter = delimiter;
-    node->is_locked = false;
-    node->lock_holder_id = -1;
-    node->next = NULL;
-    node->prev = NULL;
-    node->draft_head = NULL;
-    node->draft_dirty = false;
-    
-    pthread_mutex_init(&node->lock, NULL);
-    
-    // Allocate words array
-    if (node->word_capacity > 0) {
-        node->words = (char**)calloc(node->word_capacity, sizeof(char*));
-        if (!node->words) {
-            pthread_mutex_destroy(&node->lock);
-            free(node);
+    return words;
+}
+
+void file_memory_abandon_words(FileEntry* file, int capacity) {
+    pthread_mutex_lock(&file->memory.lock);
+    file->memory.abandoned += word_array_bytes(capacity);
+    pthread_mutex_unlock(&file->memory.lock);
+}
+
+void* file_memory_alloc(FileEntry* file, SlabPool* pool) {
+    pthread_mutex_lock(&file->memory.lock);
+    void* object = slab_alloc(pool);
+    pthread_mutex_unlock(&file->memory.lock);
+    return object;
+}
+
+void file_memory_free(FileEntry* file, SlabPool* pool, void* object) {
+    pthread_mutex_lock(&file->memory.lock);
+    slab_free(pool, object);
+    pthread_mutex_unlock(&file->memory.lock);
+}
+
+void format_file_memory(FileEntry* file, char* buffer, size_t size) {
+    FileMemory* memory = &file->memory;
+    pthread_mutex_lock(&memory->lock);
+    snprintf(buffer, size,
+             "Arena=%zu/%zuB Chunks=%zu Allocs=%zu Sentences=%zu/%zu Drafts=%zu/%zu Undo=%zu/%zu Slabs=%zu",
+             memory->words.bytes_used, memory->words.bytes_reserved,
+             memory->words.chunk_count, memory->words.allocations,
+             memory->sentences.live, memory->sentences.allocations,
+             memory->drafts.live, memory->drafts.allocations,
+             memory->undo_entries.live, memory->undo_entries.allocations,
+             memory->sentences.slab_count + memory->drafts.slab_count + memory->undo_entries.slab_count);
+    pthread_mutex_unlock(&memory->lock);
+}
+
+// What unloading the file would give back. Snapshot chunks still shared
+// with a reader's older version are counted here all the same.
+size_t file_resident_bytes(FileEntry* file) {
+    FileMemory* memory = &file->memory;
+    pthread_mutex_lock(&memory->lock);
+    size_t bytes = memory->words.bytes_reserved + memory->sentences.bytes_reserved +
+                   memory->drafts.bytes_reserved + memory->undo_entries.bytes_reserved;
+    pthread_mutex_unlock(&memory->lock);
+
+    pthread_mutex_lock(&file->render_lock);
+    const FileSnapshot* snapshot = file->snapshot;
+    if (snapshot) {
+        bytes += sizeof(FileSnapshot) + snapshot->length_bound +
+                 (size_t)snapshot->chunk_count * (sizeof(SnapshotChunk) + sizeof(SnapshotChunk*)) +
+                 (size_t)snapshot->sentence_count * (sizeof(SentenceText) + sizeof(SentenceText*));
+    }
+    if (file->rendered) {
+        bytes += sizeof(RenderedContent) + file->rendered->reply_length + 1;
+    }
+    pthread_mutex_unlock(&file->render_lock);
+    return bytes;
+}
+
+// ==================== ARENA REPACKING ====================
+// The arena only grows: a draft that outgrows its array, a commit, an undo
+// or a trimmed undo entry leaves the old word array behind, and abandoned
+// words are never reclaimed. file_memory_abandon_words counts the arrays
+// (a lower bound, as shared words are not tracked); once that exceeds what
+// is still live, write-back copies every referenced array and word into a
+// fresh arena and frees the old one. Sentence, draft and undo pointers stay
+// put, so locks, leases and undo history survive the move.
+
+// Visits every word array the file owns: sentences, their drafts and undo
+// snapshots. Caller holds file_lock for writing.
+typedef void (*WordArrayVisitor)(char*** words, int count, int capacity, void* ctx);
+
+static void foreach_word_array(FileEntry* file, WordArrayVisitor visit, void* ctx) {
+    for (SentenceNode* node = file->head; node; node = node->next) {
+        visit(&node->words, node->word_count, node->word_capacity, ctx);
+        for (DraftSentence* draft = node->draft_head; draft; draft = draft->next) {
+            if (draft->words) {
+                visit(&draft->words, draft->word_count, draft->word_capacity, ctx);
+            }
+        }
+    }
+    for (SentenceUndoEntry* entry = file->undo_head; entry; entry = entry->next) {
+        if (entry->word_count > 0) {
+            visit(&entry->words_snapshot, entry->word_count, entry->word_count, ctx);
+        }
+    }
+}
+
+typedef struct RepackState {
+    Arena arena;                     // The replacement
+    const char** from;               // Open-addressed map of old word -> copy;
+    char** to;                       // words are shared, so each is copied once
+    size_t mask;
+    char*** arrays;                  // New arrays in visiting order
+    size_t array_count;
+    size_t word_refs;
+    bool failed;
+} RepackState;
+
+static void count_word_array(char*** words, int count, int capacity, void* ctx) {
+    (void)words;
+    (void)capacity;
+    RepackState* state = (RepackState*)ctx;
+    state->array_count++;
+    state->word_refs += (size_t)count;
+}
+
+static char* relocate_word(RepackState* state, const char* word) {
+    size_t slot = (size_t)(((uintptr_t)word >> 3) * 0x9E3779B97F4A7C15ull) & state->mask;
+    while (state->from[slot] && state->from[slot] != word) {
+        slot = (slot + 1) & state->mask;
+    }
+    if (!state->from[slot]) {
+        char* copy = arena_strndup(&state->arena, word, strlen(word));
+        if (!copy) {
             return NULL;
         }
-        
-        // Copy words
-        for (int i = 0; i < word_count; i++) {
-            node->words[i] = strdup(word_array[i]);
-            if (!node->words[i]) {
-                // Cleanup on failure
-                for (int j = 0; j < i; j++) {
-                    free(node->words[j]);
-                }
-                free(node->words);
-                pthread_mutex_destroy(&node->lock);
-                free(node);
-                return NULL;
-            }
+        state->from[slot] = word;
+        state->to[slot] = copy;
+    }
+    return state->to[slot];
+}
+
+static void copy_word_array(char*** words, int count, int capacity, void* ctx) {
+    RepackState* state = (RepackState*)ctx;
+    if (state->failed) {
+        return;
+    }
+    char** copy = (char**)arena_alloc(&state->arena, word_array_bytes(capacity));
+    if (!copy) {
+        state->failed = true;
+        return;
+    }
+    memset(copy, 0, word_array_bytes(capacity));
+    for (int i = 0; i < count; i++) {
+        copy[i] = (*words)[i] ? relocate_word(state, (*words)[i]) : NULL;
+        if ((*words)[i] && !copy[i]) {
+            state->failed = true;
+            return;
         }
+    }
+    state->arrays[state->array_count++] = copy;
+}
+
+static void install_word_array(char*** words, int count, int capacity, void* ctx) {
+    (void)count;
+    (void)capacity;
+    RepackState* state = (RepackState*)ctx;
+    *words = state->arrays[state->array_count++];
+}
+
+bool file_memory_needs_repack(FileEntry* file) {
+    FileMemory* memory = &file->memory;
+    pthread_mutex_lock(&memory->lock);
+    size_t used = memory->words.bytes_used;
+    size_t abandoned = memory->abandoned < used ? memory->abandoned : used;
+    bool needed = abandoned >= ARENA_REPACK_MIN_BYTES && abandoned > used - abandoned;
+    pthread_mutex_unlock(&memory->lock);
+    return needed;
+}
+
+// Copies everything first and only then swaps pointers, so running out of
+// memory part way leaves the file untouched
+size_t file_memory_repack(FileEntry* file) {
+    RepackState state;
+    memset(&state, 0, sizeof(state));
+    arena_init(&state.arena);
+    foreach_word_array(file, count_word_array, &state);
+
+    size_t slots = 16;
+    while (slots < state.word_refs * 2) {
+        slots *= 2;
+    }
+    state.mask = slots - 1;
+    state.from = (const char**)calloc(slots, sizeof(*state.from));
+    state.to = (char**)calloc(slots, sizeof(*state.to));
+    state.arrays = (char***)malloc(sizeof(*state.arrays) * (state.array_count + 1));
+    state.failed = !state.from || !state.to || !state.arrays;
+
+    state.array_count = 0;
+    if (!state.failed) {
+        foreach_word_array(file, copy_word_array, &state);
+    }
+
+    size_t freed = 0;
+    if (!state.failed) {
+        state.array_count = 0;
+        foreach_word_array(file, install_word_array, &state);
+
+        pthread_mutex_lock(&file->memory.lock);
+        size_t before = file->memory.words.bytes_reserved;
+        arena_release(&file->memory.words);
+        file->memory.words = state.arena;
+        file->memory.abandoned = 0;
+        freed = before > state.arena.bytes_reserved ? before - state.arena.bytes_reserved : 0;
+        pthread_mutex_unlock(&file->memory.lock);
     } else {
-        node->words = NULL;
+        arena_release(&state.arena);
     }
-    
-    return node;
+
+    free(state.from);
+    free(state.to);
+    free(state.arrays);
+    return freed;
+}
+
+// ==================== SENTENCE NODE OPERATIONS ====================
+
+// Characters the sentence renders to: words, the spaces between them and
+// the delimiter
+static int sentence_length(char** words, int word_count, char delimiter) {
+    int length = word_count > 1 ? word_count - 1 : 0;
+    for (int i = 0; i < word_count; i++) {
+        length += (int)strlen(words[i]);
+    }
+    return length + (delimiter != '\0' ? 1 : 0);
+}
+
+// Adds (sign 1) or removes (sign -1) a linked sentence from the file totals
+static inline void account_sentence(FileEntry* file, const SentenceNode* node, int sign) {
+    file->stats.sentence_chars += (size_t)((long)sign * node->char_count);
+    file->stats.sentence_words += sign * node->word_count;
 }
 
-SentenceNode* create_empty_sentence_node() {
-    SentenceNode* node = (SentenceNode*)calloc(1, sizeof(SentenceNode));
+// word_array must already live in the file's arena; the pointers are shared
+SentenceNode* create_sentence_node(FileEntry* file, char** word_array, int word_count, char delimiter) {
+    SentenceNode* node = (SentenceNode*)file_memory_alloc(file, &file->memory.sentences);
     if (!node) {
         return NULL;
     }
     
-    node->word_count = 0;
-    node->word_capacity = 4;
-    node->delimiter = '\0';
+    node->word_count = word_count;
+    node->word_capacity = (word_count > 0) ? word_count : 4;
+    node->delimiter = delimiter;
+    node->char_count = sentence_length(word_array, word_count, delimiter);
     node->is_locked = false;
     node->lock_holder_id = -1;
+    node->lock_lease = 0;
     node->next = NULL;
     node->prev = NULL;
     node->draft_head = NULL;
     node->draft_dirty = false;
     
-    pthread_mutex_init(&node->lock, NULL);
-    
-    node->words = (char**)calloc(node->word_capacity, sizeof(char*));
+    node->words = file_memory_words(file, node->word_capacity);
     if (!node->words) {
-        pthread_mutex_destroy(&node->lock);
-        free(node);
+        file_memory_free(file, &file->memory.sentences, node);
         return NULL;
     }
+    if (word_count > 0) {
+        memcpy(node->words, word_array, sizeof(char*) * word_count);
+    }
     
+    pthread_mutex_init(&node->lock, NULL);
     return node;
 }
 
-void free_draft_sentences(DraftSentence* head) {
+SentenceNode* create_empty_sentence_node(FileEntry* file) {
+    return create_sentence_node(file, NULL, 0, '\0');
+}
+
+// Replaces a linked sentence's content; words must live in the file's arena.
+// Caller holds file_lock for writing.
+void set_sentence_words(FileEntry* file, SentenceNode* node, char** words, int word_capacity,
+                        int word_count, char delimiter) {
+    account_sentence(file, node, -1);
+    if (node->words && node->words != words) {
+        file_memory_abandon_words(file, node->word_capacity);
+    }
+    node->words = words;
+    node->word_capacity = word_capacity;
+    node->word_count = word_count;
+    node->delimiter = delimiter;
+    node->char_count = sentence_length(words, word_count, delimiter);
+    account_sentence(file, node, 1);
+}
+
+void free_draft_sentences(FileEntry* file, DraftSentence* head) {
     DraftSentence* current = head;
     while (current) {
-        for (int i = 0; i < current->word_count; i++) {
-            free(current->words[i]);
-        }
-        free(current->words);
         DraftSentence* next = current->next;
-        free(current);
+        if (current->words) {
+            file_memory_abandon_words(file, current->word_capacity);
+        }
+        file_memory_free(file, &file->memory.drafts, current);
         current = next;
     }
 }
 
-void free_sentence_node(SentenceNode* node) {
+void free_sentence_node(FileEntry* file, SentenceNode* node) {
     if (!node) return;
     
-    // Free all words
+    if (node->draft_head) {
+        free_draft_sentences(file, node->draft_head);
+    }
+    
+    pthread_mutex_destroy(&node->lock);
     if (node->words) {
-        for (int i = 0; i < node->word_count; i++) {
-            if (node->words[i]) {
-                free(node->words[i]);
-            }
+        file_memory_abandon_words(file, node->word_capacity);
+    }
+    file_memory_free(file, &file->memory.sentences, node);
+}
+
+// ==================== SENTENCE INDEX ====================
+
+// Sentences stay in a doubly linked list for in-order walks, and the same
+// nodes also form an implicit treap keyed by position: each node carries a
+// random heap priority and its subtree size, so lookups, inserts and deletes
+// by index are O(log n) expected. All index changes hold structure_lock.
+
+static inline int subtree_size(const SentenceNode* node) {
+    return node ? node->subtree_size : 0;
+}
+
+static inline void update_subtree_size(SentenceNode* node) {
+    node->subtree_size = subtree_size(node->left) + subtree_size(node->right) + 1;
+}
+
+static void reset_index_links(SentenceNode* node) {
+    node->left = NULL;
+    node->right = NULL;
+    node->parent = NULL;
+    node->priority = (uint32_t)random();
+    node->subtree_size = 1;
+}
+
+// Splits the first `count` sentences of `root` into *left and the rest into *right
+static void split_sentences(SentenceNode* root, int count, SentenceNode** left, SentenceNode** right) {
+    if (!root) {
+        *left = NULL;
+        *right = NULL;
+        return;
+    }
+    root->parent = NULL;
+    if (subtree_size(root->left) < count) {
+        split_sentences(root->right, count - subtree_size(root->left) - 1, &root->right, right);
+        if (root->right) {
+            root->right->parent = root;
         }
-        free(node->words);
+        *left = root;
+    } else {
+        split_sentences(root->left, count, left, &root->left);
+        if (root->left) {
+            root->left->parent = root;
+        }
+        *right = root;
     }
+    update_subtree_size(root);
+}
 
-    if (node->draft_head) {
-        free_draft_sentences(node->draft_head);
+// Concatenates two treaps; every sentence in `left` precedes every one in `right`
+static SentenceNode* merge_sentences(SentenceNode* left, SentenceNode* right) {
+    if (!left) return right;
+    if (!right) return left;
+
+    if (left->priority > right->priority) {
+        left->right = merge_sentences(left->right, right);
+        left->right->parent = left;
+        update_subtree_size(left);
+        return left;
+    }
+    right->left = merge_sentences(left, right->left);
+    right->left->parent = right;
+    update_subtree_size(right);
+    return right;
+}
+
+static void set_sentence_root(FileEntry* file, SentenceNode* root) {
+    file->sentence_root = root;
+    if (root) {
+        root->parent = NULL;
     }
-    
-    pthread_mutex_destroy(&node->lock);
-    free(node);
+}
+
+// Position of a node that is in some treap; sets *root to that treap's root
+static int sentence_rank(SentenceNode* node, SentenceNode** root) {
+    int rank = subtree_size(node->left);
+    while (node->parent) {
+        if (node == node->parent->right) {
+            rank += subtree_size(node->parent->left) + 1;
+        }
+        node = node->parent;
+    }
+    *root = node;
+    return rank;
 }
 
 void append_sentence(FileEntry* file, SentenceNode* node) {
@@ -247,11 +545,37 @@ void append_sentence(FileEntry* file, SentenceNode* node) {
         file->tail = node;
     }
     
+    reset_index_links(node);
+    set_sentence_root(file, merge_sentences(file->sentence_root, node));
     file->sentence_count++;
+    account_sentence(file, node, 1);
     
     pthread_mutex_unlock(&file->structure_lock);
 }
 
+void insert_sentence_after(FileEntry* file, SentenceNode* anchor, SentenceNode* node) {
+    if (!file || !anchor || !node) return;
+
+    node->next = anchor->next;
+    node->prev = anchor;
+    if (anchor->next) {
+        anchor->next->prev = node;
+    } else {
+        file->tail = node;
+    }
+    anchor->next = node;
+
+    SentenceNode* root;
+    int position = sentence_rank(anchor, &root) + 1;
+    SentenceNode* before;
+    SentenceNode* after;
+    split_sentences(file->sentence_root, position, &before, &after);
+    reset_index_links(node);
+    set_sentence_root(file, merge_sentences(merge_sentences(before, node), after));
+    file->sentence_count++;
+    account_sentence(file, node, 1);
+}
+
 void delete_sentence_node(FileEntry* file, SentenceNode* node) {
     if (!file || !node) return;
     
@@ -272,12 +596,24 @@ void delete_sentence_node(FileEntry* file, SentenceNode* node) {
         file->tail = node->prev;
     }
     
+    // Cut the node out of the index
+    SentenceNode* root;
+    int position = sentence_rank(node, &root);
+    SentenceNode* before;
+    SentenceNode* rest;
+    SentenceNode* removed;
+    SentenceNode* after;
+    split_sentences(file->sentence_root, position, &before, &rest);
+    split_sentences(rest, 1, &removed, &after);
+    set_sentence_root(file, merge_sentences(before, after));
+    
     file->sentence_count--;
+    account_sentence(file, node, -1);
     
     pthread_mutex_unlock(&file->structure_lock);
     
     // Free the node (done outside structure lock to avoid holding lock too long)
-    free_sentence_node(node);
+    free_sentence_node(file, node);
 }
 
 SentenceNode* get_sentence_by_index(FileEntry* file, int index) {
@@ -285,12 +621,17 @@ SentenceNode* get_sentence_by_index(FileEntry* file, int index) {
     
     pthread_mutex_lock(&file->structure_lock);
     
-    SentenceNode* current = file->head;
-    int i = 0;
-    
-    while (current && i < index) {
-        current = current->next;
-        i++;
+    SentenceNode* current = file->sentence_root;
+    while (current) {
+        int left_size = subtree_size(current->left);
+        if (index < left_size) {
+            current = current->left;
+        } else if (index == left_size) {
+            break;
+        } else {
+            index -= left_size + 1;
+            current = current->right;
+        }
     }
     
     pthread_mutex_unlock(&file->structure_lock);
@@ -298,141 +639,196 @@ SentenceNode* get_sentence_by_index(FileEntry* file, int index) {
     return current;
 }
 
+int get_sentence_index(FileEntry* file, SentenceNode* node) {
+    if (!file || !node) return -1;
+
+    pthread_mutex_lock(&file->structure_lock);
+    SentenceNode* root;
+    int index = sentence_rank(node, &root);
+    if (root != file->sentence_root) {
+        index = -1;
+    }
+    pthread_mutex_unlock(&file->structure_lock);
+
+    return index;
+}
+
 void free_all_sentences(FileEntry* file) {
     if (!file) return;
     
     pthread_mutex_lock(&file->structure_lock);
     
-    SentenceNode* current = file->head;
-    while (current) {
-        SentenceNode* next = current->next;
-        free_sentence_node(current);
-        current = next;
-    }
-    
+    // Undo entries point at sentences and share their words, so they go too
     file->head = NULL;
     file->tail = NULL;
+    file->sentence_root = NULL;
     file->sentence_count = 0;
+    file->stats.sentence_chars = 0;
+    file->stats.sentence_words = 0;
+    file->undo_head = NULL;
+    file->undo_depth = 0;
+    file_memory_release(file);
     
     pthread_mutex_unlock(&file->structure_lock);
 }
 
-void clear_file_undo_history(FileEntry* file) {
-    if (!file) {
-        return;
-    }
+// ==================== SENTENCE TOKENIZER ====================
 
-    SentenceUndoEntry* current = file->undo_head;
-    while (current) {
-        SentenceUndoEntry* next = current->next;
-        if (current->words_snapshot) {
-            for (int i = 0; i < current->word_count; i++) {
-                free(current->words_snapshot[i]);
-            }
-            free(current->words_snapshot);
-        }
-        free(current);
-        current = next;
-    }
+// One pass over the text: every space, tab, newline and sentence delimiter
+// is found with a 16-byte bitmask (SSE2 where available), overwritten with
+// a NUL, and the bytes between two of them form a word. Words are therefore
+// slices of the caller's buffer; nothing is copied.
 
-    file->undo_head = NULL;
-    file->undo_depth = 0;
+#define TOKEN_BLOCK 16
+#define TOKEN_INLINE_WORDS 256
+
+static inline bool is_word_separator(char c) {
+    return c == ' ' || c == '\t' || c == '\n';
 }
 
-void parse_sentences(FileEntry* file, const char* content) {
-    if (!file) return;
-    
-    // Clear existing sentences
-    clear_file_undo_history(file);
-    free_all_sentences(file);
-    
-    if (!content || strlen(content) == 0) {
-        // Create one empty sentence for new files
-        SentenceNode* node = create_empty_sentence_node();
-        if (node) {
-            append_sentence(file, node);
+static inline uint32_t special_mask_scalar(const char* p, size_t n) {
+    uint32_t mask = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (is_word_separator(p[i]) || is_sentence_delimiter(p[i])) {
+            mask |= 1u << i;
         }
-        file->total_size = 0;
-        file->total_words = 0;
-        file->total_chars = 0;
-        return;
     }
-    
-    size_t len = strlen(content);
-    size_t index = 0;
-    
-    while (index < len) {
-        // Skip leading whitespace
-        while (index < len && (content[index] == ' ' || content[index] == '\n' || content[index] == '\t')) {
-            index++;
-        }
+    return mask;
+}
 
-        if (index >= len) {
-            break;
+#ifdef __SSE2__
+static inline uint32_t special_mask_block(const char* p) {
+    __m128i bytes = _mm_loadu_si128((const __m128i*)p);
+    __m128i hits = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(' ')),
+                     _mm_cmpeq_epi8(bytes, _mm_set1_epi8('\t'))),
+        _mm_or_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8('\n')),
+                     _mm_cmpeq_epi8(bytes, _mm_set1_epi8('.'))));
+    hits = _mm_or_si128(hits,
+        _mm_or_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8('!')),
+                     _mm_cmpeq_epi8(bytes, _mm_set1_epi8('?'))));
+    return (uint32_t)_mm_movemask_epi8(hits);
+}
+#else
+static inline uint32_t special_mask_block(const char* p) {
+    return special_mask_scalar(p, TOKEN_BLOCK);
+}
+#endif
+
+typedef struct TokenWords {
+    char** words;
+    int count;
+    int capacity;
+    char* inline_words[TOKEN_INLINE_WORDS];
+} TokenWords;
+
+static bool push_token_word(TokenWords* list, char* word) {
+    if (list->count == list->capacity) {
+        int new_capacity = list->capacity * 2;
+        char** grown;
+        if (list->words == list->inline_words) {
+            grown = (char**)malloc(sizeof(char*) * new_capacity);
+            if (grown) {
+                memcpy(grown, list->inline_words, sizeof(char*) * list->count);
+            }
+        } else {
+            grown = (char**)realloc(list->words, sizeof(char*) * new_capacity);
         }
+        if (!grown) {
+            return false;
+        }
+        list->words = grown;
+        list->capacity = new_capacity;
+    }
+    list->words[list->count++] = word;
+    return true;
+}
 
-        size_t start = index;
+bool tokenize_sentences(char* text, size_t length, SentenceSink sink, void* ctx) {
+    TokenWords list;
+    list.words = list.inline_words;
+    list.count = 0;
+    list.capacity = TOKEN_INLINE_WORDS;
+
+    bool ok = true;
+    size_t word_start = 0;
+    for (size_t base = 0; base < length && ok; base += TOKEN_BLOCK) {
+        size_t block = length - base < TOKEN_BLOCK ? length - base : TOKEN_BLOCK;
+        uint32_t mask = block == TOKEN_BLOCK ? special_mask_block(text + base)
+                                             : special_mask_scalar(text + base, block);
+        while (mask && ok) {
+            size_t at = base + (size_t)__builtin_ctz(mask);
+            mask &= mask - 1;
+
+            char c = text[at];
+            text[at] = '\0';
+            if (at > word_start) {
+                ok = push_token_word(&list, text + word_start);
+            }
+            word_start = at + 1;
 
-        // Find next delimiter or end of string
-        while (index < len && !is_sentence_delimiter(content[index])) {
-            index++;
+            if (ok && is_sentence_delimiter(c)) {
+                ok = sink(list.words, list.count, c, ctx);
+                list.count = 0;
+            }
         }
+    }
 
-        char delimiter = '\0';
-        if (index < len && is_sentence_delimiter(content[index])) {
-            delimiter = content[index];
-            index++; // Move past delimiter
-        }
+    // Trailing words without a delimiter form a final open sentence
+    if (ok && length > word_start) {
+        ok = push_token_word(&list, text + word_start);
+    }
+    if (ok && list.count > 0) {
+        ok = sink(list.words, list.count, '\0', ctx);
+    }
 
-        // Extract sentence text (without delimiter)
-        size_t sentence_len = (delimiter != '\0') ? (index - start - 1) : (index - start);
-        
-        // Extract and parse words from sentence
-        char sentence_text[MAX_CONTENT_SIZE];
-        if (sentence_len >= MAX_CONTENT_SIZE) {
-            sentence_len = MAX_CONTENT_SIZE - 1;
-        }
-        memcpy(sentence_text, content + start, sentence_len);
-        sentence_text[sentence_len] = '\0';
+    if (list.words != list.inline_words) {
+        free(list.words);
+    }
+    return ok;
+}
 
-        // Parse into words
-        char* words[1000];
-        int word_count = 0;
-        
-        char sentence_copy[MAX_CONTENT_SIZE];
-        strncpy(sentence_copy, sentence_text, MAX_CONTENT_SIZE - 1);
-        sentence_copy[MAX_CONTENT_SIZE - 1] = '\0';
-        
-        char* token = strtok(sentence_copy, " \t\n");
-        while (token && word_count < 1000) {
-            words[word_count++] = token;
-            token = strtok(NULL, " \t\n");
-        }
+static bool append_parsed_sentence(char** words, int word_count, char delimiter, void* ctx) {
+    FileEntry* file = (FileEntry*)ctx;
+    SentenceNode* node = create_sentence_node(file, words, word_count, delimiter);
+    if (!node) {
+        return false;
+    }
+    append_sentence(file, node);
+    return true;
+}
 
-        // Create sentence node
-        SentenceNode* node = create_sentence_node((const char**)words, word_count, delimiter);
-        if (node) {
-            append_sentence(file, node);
-        }
+void parse_sentences(FileEntry* file, const char* content) {
+    if (!file) return;
+    
+    // Clear existing sentences (and with them the undo history and arena)
+    free_all_sentences(file);
+    
+    // Copy the content into the arena once; words are tokenized in place
+    size_t len = content ? strlen(content) : 0;
+    char* text = len > 0 ? file_memory_text(file, content, len) : NULL;
+    if (text) {
+        tokenize_sentences(text, len, append_parsed_sentence, file);
     }
 
     // If the last sentence has a delimiter, append an empty sentence
     if (file->tail && file->tail->delimiter != '\0') {
-        SentenceNode* node = create_empty_sentence_node();
+        SentenceNode* node = create_empty_sentence_node(file);
         if (node) {
             append_sentence(file, node);
         }
     }
 
-    // If no sentences were parsed, create one empty sentence
+    // If no sentences were parsed (e.g. a new file), create one empty sentence
     if (file->sentence_count == 0) {
-        SentenceNode* node = create_empty_sentence_node();
+        SentenceNode* node = create_empty_sentence_node(file);
         if (node) {
             append_sentence(file, node);
         }
     }
 
-    refresh_file_stats(file);
+    publish_file_stats(file);
+    refresh_file_snapshot(file);
 }
 
 void rebuild_file_content(FileEntry* file, char* content) {
@@ -485,128 +881,507 @@ void rebuild_file_content(FileEntry* file, char* content) {
     content[offset] = '\0';
 }
 
-void refresh_file_stats(FileEntry* file) {
+// ==================== FILE STATISTICS ====================
+
+static void init_file_stats(FileEntry* file) {
+    file->stats.sentence_chars = 0;
+    file->stats.sentence_words = 0;
+    atomic_init(&file->stats.sequence, 0);
+    atomic_init(&file->stats.total_size, 0);
+    atomic_init(&file->stats.total_words, 0);
+    atomic_init(&file->stats.total_chars, 0);
+}
+
+// Called by the (single) writer once a change is complete
+void publish_file_stats(FileEntry* file) {
     if (!file) return;
+
+    FileStats* stats = &file->stats;
+    size_t chars = stats->sentence_chars;
+    if (file->sentence_count > 1) {
+        chars += (size_t)(file->sentence_count - 1);   // Space before each later sentence
+    }
+
+    unsigned sequence = atomic_load_explicit(&stats->sequence, memory_order_relaxed);
+    atomic_store_explicit(&stats->sequence, sequence + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&stats->total_size, chars, memory_order_relaxed);
+    atomic_store_explicit(&stats->total_words, stats->sentence_words, memory_order_relaxed);
+    atomic_store_explicit(&stats->total_chars, (int)chars, memory_order_relaxed);
+    atomic_store_explicit(&stats->sequence, sequence + 2, memory_order_release);
+}
+
+void read_file_stats(FileEntry* file, size_t* size, int* words, int* chars) {
+    FileStats* stats = &file->stats;
+    for (;;) {
+        unsigned before = atomic_load_explicit(&stats->sequence, memory_order_acquire);
+        if (before & 1) {
+            continue;
+        }
+        *size = atomic_load_explicit(&stats->total_size, memory_order_relaxed);
+        *words = atomic_load_explicit(&stats->total_words, memory_order_relaxed);
+        *chars = atomic_load_explicit(&stats->total_chars, memory_order_relaxed);
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&stats->sequence, memory_order_relaxed) == before) {
+            return;
+        }
+    }
+}
+
+// ==================== RENDERED CONTENT ====================
+// READ serves an immutable copy of the file's content. Every change
+// publishes a new snapshot and drops the copy; the next READ pins the
+// snapshot and renders it once, without any file lock. Full saves install
+// exactly what they wrote if the content has not moved on.
+
+// data holds length bytes of content and has room for two more
+static void finish_rendered_content(RenderedContent* content, size_t length, uint64_t version) {
+    atomic_init(&content->refs, 1);
+    content->version = version;
+    content->length = length;
+
+    // Client READ always ends with a newline, even for empty files
+    content->reply_length = length;
+    if ((length == 0 || content->data[length - 1] != '\n') && length + 1 < MAX_CONTENT_SIZE) {
+        content->data[content->reply_length++] = '\n';
+    }
+    content->data[content->reply_length] = '\0';
+}
+
+static RenderedContent* render_content(const char* data, size_t length, uint64_t version) {
+    RenderedContent* content = (RenderedContent*)malloc(sizeof(RenderedContent) + length + 2);
+    if (!content) {
+        return NULL;
+    }
+    memcpy(content->data, data, length);
+    finish_rendered_content(content, length, version);
+    return content;
+}
+
+// Renders a pinned snapshot; needs no file lock
+static RenderedContent* render_snapshot_content(const FileSnapshot* snapshot) {
+    RenderedContent* content = (RenderedContent*)malloc(sizeof(RenderedContent) +
+                                                        snapshot->length_bound + 2);
+    if (!content) {
+        return NULL;
+    }
+    size_t length = snapshot_render(snapshot, content->data);
+    finish_rendered_content(content, length, snapshot->version);
+    return content;
+}
+
+void release_rendered_content(RenderedContent* content) {
+    if (content && atomic_fetch_sub(&content->refs, 1) == 1) {
+        free(content);
+    }
+}
+
+// Makes snapshot (NULL if it could not be built) the next content version
+// and drops the rendering of the previous one. Caller holds file_lock for
+// writing.
+static void publish_snapshot(FileEntry* file, FileSnapshot* snapshot) {
+    pthread_mutex_lock(&file->render_lock);
+    file->content_version++;
+    if (snapshot) {
+        snapshot->version = file->content_version;
+    }
+    FileSnapshot* old_snapshot = file->snapshot;
+    RenderedContent* old = file->rendered;
+    file->snapshot = snapshot;
+    file->rendered = NULL;
+    pthread_mutex_unlock(&file->render_lock);
+    snapshot_release(old_snapshot);
+    release_rendered_content(old);
+}
+
+void refresh_file_snapshot(FileEntry* file) {
+    publish_snapshot(file, snapshot_build(file));
+}
+
+// Publishes the version after a commit or undo; see save_sentence_edit
+static void publish_sentence_edit(FileEntry* file, SentenceNode* first, int removed, int inserted) {
+    FileSnapshot* snapshot = snapshot_apply_edit(file->snapshot, get_sentence_index(file, first),
+                                                 removed, first, inserted);
+    publish_snapshot(file, snapshot ? snapshot : snapshot_build(file));
+}
+
+// Install a rendering of the content as of version, unless it changed since.
+static void install_rendered_content(FileEntry* file, const char* data, size_t length,
+                                     uint64_t version) {
+    RenderedContent* old = NULL;
+    pthread_mutex_lock(&file->render_lock);
+    if (file->content_version == version) {
+        old = file->rendered;
+        file->rendered = render_content(data, length, version);
+    }
+    pthread_mutex_unlock(&file->render_lock);
+    release_rendered_content(old);
+}
+
+static void init_rendered_content(FileEntry* file) {
+    pthread_mutex_init(&file->render_lock, NULL);
+    file->rendered = NULL;
+    file->snapshot = NULL;
+    file->content_version = 0;
+}
+
+static void destroy_rendered_content(FileEntry* file) {
+    release_rendered_content(file->rendered);
+    file->rendered = NULL;
+    snapshot_release(file->snapshot);
+    file->snapshot = NULL;
+    pthread_mutex_destroy(&file->render_lock);
+}
+
+// ==================== FILE PERSISTENCE ====================
+
+// Renders the file, writes it over the text file and starts the edit log
+// over. Runs on the write-back thread (or at shutdown) and takes its own
+// locks: readers and committers only wait for the render, not the disk.
+bool save_file_to_disk(StorageServer* ss, FileEntry* file) {
+    char* content = (char*)malloc(MAX_CONTENT_SIZE);
+    if (!content) {
+        return false;
+    }
+
+    pthread_rwlock_rdlock(&file->file_lock);
+    if (!atomic_load(&file->loaded)) {
+        // Not parsed (yet or any more): the text file and log are all there is
+        pthread_rwlock_unlock(&file->file_lock);
+        free(content);
+        return true;
+    }
+    rebuild_file_content(file, content);
+    size_t length = strlen(content);
+    char* layout = NULL;
+    size_t layout_length = 0;
+    if (!edit_log_format_layout(file, content, length, &layout, &layout_length)) {
+        pthread_rwlock_unlock(&file->file_lock);
+        free(content);
+        return false;
+    }
+    pthread_mutex_lock(&file->render_lock);
+    uint64_t version = file->content_version;
+    pthread_mutex_unlock(&file->render_lock);
+
+    // Everything queued so far is in this rendering
+    writeback_drop_edits(ss, file);
+    pthread_mutex_lock(&file->dirty.persist_lock);
+    pthread_rwlock_unlock(&file->file_lock);
+
+    // Never truncate the live file: a crash leaves the old or the new text
+    char temp_path[MAX_PATH];
+    int written = snprintf(temp_path, sizeof(temp_path), "%s/%s.tmp", EDIT_LOG_BASE_DIR,
+                           file->filename);
+    bool ok = written > 0 && (size_t)written < sizeof(temp_path) &&
+              durability_replace(ss, file->filepath, temp_path, content, length);
+    if (ok) {
+        // The text now holds every edit, so the log starts over
+        ok = edit_log_reset(ss, file, content, length, layout, layout_length);
+    }
+    // Otherwise the edit log still describes the changes on top of its base
+    pthread_mutex_unlock(&file->dirty.persist_lock);
+
+    if (ok) {
+        install_rendered_content(file, content, length, version);
+    }
+    free(layout);
+    free(content);
+
+    // A good moment to drop abandoned arena blocks; a busy file waits for
+    // its next save rather than stalling write-back
+    if (ok && file_memory_needs_repack(file) && pthread_rwlock_trywrlock(&file->file_lock) == 0) {
+        if (atomic_load(&file->loaded)) {
+            size_t freed = file_memory_repack(file);
+            char memory[192];
+            format_file_memory(file, memory, sizeof(memory));
+            char details[512];
+            snprintf(details, sizeof(details), "File=%s Freed=%zuB %s", file->filename, freed, memory);
+            log_message(ss, "INFO", "REPACK", details);
+        }
+        pthread_rwlock_unlock(&file->file_lock);
+    }
+    return ok;
+}
+
+// Queues a commit or undo that replaced sentences first .. first+inserted-1
+// (formerly `removed` sentences) for the write-back thread and returns its
+// sequence number for writeback_wait. Caller holds file_lock for writing.
+uint64_t save_sentence_edit(StorageServer* ss, FileEntry* file, SentenceNode* first,
+                            int removed, int inserted) {
+    publish_sentence_edit(file, first, removed, inserted);
+    size_t length = 0;
+    char* record = edit_log_format_edit(file, first, removed, inserted, &length);
+    if (record) {
+        return writeback_queue_edit(ss, file, record, length);
+    }
+    return writeback_queue_rewrite(ss, file);
+}
+
+// ==================== LAZY LOADING ====================
+// Startup only scans the storage directory: each file gets a FileEntry with
+// its name and timestamps, which is all registration with the NM needs. The
+// text is read, parsed and its edit log replayed by the first find_file
+// that needs it, or earlier by the pre-warm pool. The memory budget may
+// unload an idle file again (unload_file); it then loads the same way.
+
+static int64_t elapsed_ms_since(const struct timespec* started) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)(now.tv_sec - started->tv_sec) * 1000 +
+           (now.tv_nsec - started->tv_nsec) / 1000000;
+}
+
+bool register_file_from_disk(StorageServer* ss, const char* filename) {
+    char filepath[MAX_PATH];
+    snprintf(filepath, sizeof(filepath), "%s/%s", STORAGE_DIR, filename);
     
-    size_t total_chars = 0;
-    int total_words = 0;
+    struct stat st;
+    if (stat(filepath, &st) != 0) {
+        return false;
+    }
     
-    pthread_mutex_lock(&file->structure_lock);
+    // Create file entry
+    FileEntry* file = (FileEntry*)malloc(sizeof(FileEntry));
+    if (!file) {
+        return false;
+    }
+    strncpy(file->filename, filename, MAX_FILENAME - 1);
+    file->filename[MAX_FILENAME - 1] = '\0';
+    strncpy(file->filepath, filepath, MAX_PATH - 1);
+    file->filepath[MAX_PATH - 1] = '\0';
     
-    SentenceNode* current = file->head;
-    bool first = true;
+    pthread_rwlock_init(&file->file_lock, NULL);
+    pthread_mutex_init(&file->structure_lock, NULL);
+    pthread_mutex_init(&file->load_lock, NULL);
+    atomic_init(&file->loaded, false);
+    atomic_init(&file->pins, 0);
+    atomic_init(&file->referenced, false);
+    file->evicted = false;
+    file_memory_init(file);
+    init_rendered_content(file);
+    dirty_state_init(file);
+    edit_log_init(file, "", 0);
+    file->head = NULL;
+    file->tail = NULL;
+    file->sentence_root = NULL;
+    file->sentence_count = 0;
+    init_file_stats(file);
+    file->undo_head = NULL;
+    file->undo_depth = 0;
+    file->last_modified = st.st_mtime;
+    file->last_accessed = st.st_atime;
     
-    while (current) {
-        // Count space before sentence (except first)
-        if (!first) {
-            total_chars += 1;
+    // Add to file table
+    if (!file_table_insert(&ss->files, file)) {
+        destroy_file_entry(file);
+        return false;
+    }
+    return true;
+}
+
+// Reads, parses and replays the file. Caller holds load_lock.
+static bool load_file_contents(StorageServer* ss, FileEntry* file) {
+    FILE* fp = fopen(file->filepath, "r");
+    if (!fp) {
+        return false;
+    }
+    
+    // Read file content
+    char* content = (char*)malloc(MAX_CONTENT_SIZE);
+    if (!content) {
+        fclose(fp);
+        return false;
+    }
+    size_t bytes_read = fread(content, 1, MAX_CONTENT_SIZE - 1, fp);
+    content[bytes_read] = '\0';
+    fclose(fp);
+    
+    // Parse sentences, then apply edits not yet folded into the text
+    pthread_rwlock_wrlock(&file->file_lock);
+    parse_sentences(file, content);
+    int edits = edit_log_replay(file, content, bytes_read);
+    pthread_rwlock_unlock(&file->file_lock);
+    free(content);
+    
+    char memory[192];
+    format_file_memory(file, memory, sizeof(memory));
+    char details[512];
+    snprintf(details, sizeof(details), "File=%s Sentences=%d Edits=%d %s",
+             file->filename, file->sentence_count, edits, memory);
+    log_message(ss, edits < 0 ? "WARN" : "INFO", "LOAD", details);
+    return true;
+}
+
+bool ensure_file_loaded(StorageServer* ss, FileEntry* file) {
+    if (atomic_load_explicit(&file->loaded, memory_order_acquire)) {
+        return true;
+    }
+    pthread_mutex_lock(&file->load_lock);
+    bool loaded = atomic_load_explicit(&file->loaded, memory_order_relaxed);
+    if (!loaded) {
+        loaded = load_file_contents(ss, file);
+        if (loaded) {
+            atomic_store_explicit(&file->loaded, true, memory_order_release);
+            memory_budget_note_load(ss, file->evicted);
+        } else {
+            char details[MAX_FILENAME + 16];
+            snprintf(details, sizeof(details), "File=%s", file->filename);
+            log_message(ss, "ERROR", "LOAD", details);
         }
-        first = false;
-        
-        pthread_mutex_lock(&current->lock);
-        
-        // Count words and characters
-        total_words += current->word_count;
-        
-        for (int i = 0; i < current->word_count; i++) {
-            if (i > 0) {
-                total_chars += 1; // Space between words
-            }
-            total_chars += strlen(current->words[i]);
+    }
+    pthread_mutex_unlock(&file->load_lock);
+    return loaded;
+}
+
+// Memory holds nothing the text file and edit log do not: no pending or
+// unfolded edits, locked sentences or drafts. Caller holds file_lock.
+static bool file_is_unloadable(StorageServer* ss, FileEntry* file) {
+    if (atomic_load(&file->edit_log.records) > 0) {
+        return false;
+    }
+    WriteBack* wb = &ss->writeback;
+    pthread_mutex_lock(&wb->lock);
+    bool clean = !file->dirty.queued && !file->dirty.in_round && !file->dirty.rewrite;
+    pthread_mutex_unlock(&wb->lock);
+    if (!clean) {
+        return false;
+    }
+    for (SentenceNode* node = file->head; node; node = node->next) {
+        if (node->is_locked || node->draft_head) {
+            return false;
         }
-        
-        // Count delimiter
-        if (current->delimiter != '\0') {
-            total_chars += 1;
+    }
+    return true;
+}
+
+// find_file counts its pin before it checks loaded, and this clears loaded
+// before it checks the pins, so a caller that raced us either shows up in
+// pins or finds the file unloaded and waits on load_lock to parse it again.
+// Undo history goes with the sentences, as it does on a restart.
+size_t unload_file(StorageServer* ss, FileEntry* file) {
+    size_t released = 0;
+    pthread_mutex_lock(&file->load_lock);
+    if (!atomic_load(&file->loaded)) {
+        pthread_mutex_unlock(&file->load_lock);
+        return 0;
+    }
+    atomic_store(&file->loaded, false);
+    if (atomic_load(&file->pins) == 0 && pthread_rwlock_trywrlock(&file->file_lock) == 0) {
+        if (file_is_unloadable(ss, file)) {
+            released = file_resident_bytes(file);
+            free_all_sentences(file);
+            // Published totals stay valid; they are what the text file holds
+            publish_snapshot(file, NULL);
+            file->evicted = true;
         }
-        
-        pthread_mutex_unlock(&current->lock);
-        
-        current = current->next;
+        pthread_rwlock_unlock(&file->file_lock);
     }
-    
-    pthread_mutex_unlock(&file->structure_lock);
-    
-    file->total_chars = (int)total_chars;
-    file->total_size = total_chars;
-    file->total_words = total_words;
+    if (released == 0) {
+        atomic_store(&file->loaded, true);
+    }
+    pthread_mutex_unlock(&file->load_lock);
+    return released;
 }
 
-// ==================== FILE PERSISTENCE ====================
+typedef struct ScannedNames {
+    char (*names)[MAX_FILENAME];
+    size_t count;
+    size_t capacity;
+} ScannedNames;
 
-static bool write_content_to_path(FileEntry* file, const char* path) {
-    char content[MAX_CONTENT_SIZE];
-    rebuild_file_content(file, content);
+static void collect_scanned_name(FileEntry* file, void* ctx) {
+    ScannedNames* list = (ScannedNames*)ctx;
+    if (list->count == list->capacity) {
+        return;
+    }
+    snprintf(list->names[list->count++], MAX_FILENAME, "%s", file->filename);
+}
 
-    FILE* fp = fopen(path, "w");
-    if (!fp) {
-        return false;
+static void* prewarm_main(void* arg) {
+    StorageServer* ss = (StorageServer*)arg;
+    Prewarm* prewarm = &ss->prewarm;
+    while (!atomic_load(&prewarm->stop)) {
+        size_t index = atomic_fetch_add(&prewarm->next, 1);
+        if (index >= prewarm->count) {
+            break;
+        }
+        FileEntry* file = find_file(ss, prewarm->names[index]);
+        if (file) {
+            release_file(file);
+        }
     }
 
-    fwrite(content, 1, strlen(content), fp);
-    fclose(fp);
-    return true;
+    // The last thread out reports
+    if (atomic_fetch_sub(&prewarm->running, 1) == 1 && !atomic_load(&prewarm->stop)) {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        int64_t now_ms = (int64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+        char details[128];
+        snprintf(details, sizeof(details), "Files=%zu Threads=%d Ms=%lld", prewarm->count,
+                 prewarm->thread_count, (long long)(now_ms - prewarm->started_ms));
+        log_message(ss, "INFO", "PREWARM", details);
+    }
+    return NULL;
 }
 
-bool save_file_to_disk(FileEntry* file) {
-    return write_content_to_path(file, file->filepath);
+static int prewarm_threads_from_env(void) {
+    const char* value = getenv("SS_PREWARM_THREADS");
+    if (value) {
+        int threads = atoi(value);
+        return threads > 0 ? threads : 0;
+    }
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    return cores > 0 ? (int)cores : 1;
 }
 
-bool load_file_from_disk(StorageServer* ss, const char* filename) {
-    char filepath[MAX_PATH];
-    snprintf(filepath, sizeof(filepath), "%s/%s", STORAGE_DIR, filename);
-    
-    FILE* fp = fopen(filepath, "r");
-    if (!fp) {
-        return false;
+static void prewarm_start(StorageServer* ss) {
+    Prewarm* prewarm = &ss->prewarm;
+    int threads = prewarm_threads_from_env();
+    size_t count = file_table_count(&ss->files);
+    if (threads == 0 || count == 0) {
+        return;
     }
-    
-    // Read file content
-    char content[MAX_CONTENT_SIZE];
-    size_t bytes_read = fread(content, 1, MAX_CONTENT_SIZE - 1, fp);
-    content[bytes_read] = '\0';
-    fclose(fp);
-    
-    // Create file entry
-    FileEntry* file = (FileEntry*)malloc(sizeof(FileEntry));
-    strncpy(file->filename, filename, MAX_FILENAME - 1);
-    file->filename[MAX_FILENAME - 1] = '\0';
-    strncpy(file->filepath, filepath, MAX_PATH - 1);
-    file->filepath[MAX_PATH - 1] = '\0';
-    
-    pthread_rwlock_init(&file->file_lock, NULL);
-    pthread_mutex_init(&file->structure_lock, NULL);
-    file->head = NULL;
-    file->tail = NULL;
-    file->sentence_count = 0;
-    file->total_size = 0;
-    file->total_words = 0;
-    file->total_chars = 0;
-    file->undo_head = NULL;
-    file->undo_depth = 0;
-    
-    struct stat st;
-    if (stat(filepath, &st) == 0) {
-        file->last_modified = st.st_mtime;
-        file->last_accessed = st.st_atime;
-    } else {
-        file->last_modified = time(NULL);
-        file->last_accessed = time(NULL);
+    if ((size_t)threads > count) {
+        threads = (int)count;
     }
-    
-    // Parse sentences
-    parse_sentences(file, content);
-    
-    // Add to file list
-    pthread_mutex_lock(&ss->files_lock);
-    if (ss->file_count < MAX_FILES) {
-        ss->files[ss->file_count++] = file;
-        pthread_mutex_unlock(&ss->files_lock);
-        return true;
+
+    ScannedNames list = { calloc(count, MAX_FILENAME), 0, count };
+    prewarm->threads = (pthread_t*)calloc((size_t)threads, sizeof(pthread_t));
+    if (!list.names || !prewarm->threads) {
+        free(list.names);
+        free(prewarm->threads);
+        prewarm->threads = NULL;
+        return;
     }
-    pthread_mutex_unlock(&ss->files_lock);
-    
-    return false;
+    file_table_foreach(&ss->files, collect_scanned_name, &list);
+    prewarm->names = list.names;
+    prewarm->count = list.count;
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    prewarm->started_ms = (int64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+    atomic_store(&prewarm->running, threads);
+    for (int i = 0; i < threads; i++) {
+        if (pthread_create(&prewarm->threads[i], NULL, prewarm_main, ss) != 0) {
+            atomic_fetch_sub(&prewarm->running, threads - i);
+            break;
+        }
+        prewarm->thread_count++;
+    }
+}
+
+void prewarm_stop(StorageServer* ss) {
+    Prewarm* prewarm = &ss->prewarm;
+    atomic_store(&prewarm->stop, true);
+    for (int i = 0; i < prewarm->thread_count; i++) {
+        pthread_join(prewarm->threads[i], NULL);
+    }
+    free(prewarm->threads);
+    free(prewarm->names);
+    prewarm->threads = NULL;
+    prewarm->names = NULL;
+    prewarm->thread_count = 0;
 }
 
 void load_files_recursive(StorageServer* ss, const char* base_path, const char* relative_path) {
@@ -633,16 +1408,36 @@ void load_files_recursive(StorageServer* ss, const char* base_path, const char*
         }
 
         if (entry->d_type == DT_DIR) {
+            if (strcmp(entry_rel_path, EDIT_LOG_DIR_NAME) == 0) continue;
             load_files_recursive(ss, base_path, entry_rel_path);
         } else if (entry->d_type == DT_REG) {
-            load_file_from_disk(ss, entry_rel_path);
+            register_file_from_disk(ss, entry_rel_path);
         }
     }
     closedir(dir);
 }
 
 void load_all_files(StorageServer* ss) {
+    struct timespec started;
+    clock_gettime(CLOCK_MONOTONIC, &started);
+
+    Prewarm* prewarm = &ss->prewarm;
+    prewarm->threads = NULL;
+    prewarm->thread_count = 0;
+    prewarm->names = NULL;
+    prewarm->count = 0;
+    atomic_init(&prewarm->next, 0);
+    atomic_init(&prewarm->running, 0);
+    atomic_init(&prewarm->stop, false);
+
     load_files_recursive(ss, STORAGE_DIR, "");
+    prewarm_start(ss);
+
+    char details[128];
+    snprintf(details, sizeof(details), "Files=%zu ScanMs=%lld PrewarmThreads=%d",
+             file_table_count(&ss->files), (long long)elapsed_ms_since(&started),
+             prewarm->thread_count);
+    log_message(ss, "INFO", "STARTUP", details);
 }
 
 // ==================== CHECKPOINT MANAGEMENT ====================
@@ -713,8 +1508,7 @@ static bool ensure_checkpoint_directory(const char* filename) {
 }
 
 ErrorCode create_checkpoint(StorageServer* ss, const char* filename, const char* tag) {
-    FileEntry* file = find_file(ss, filename);
-    if (!file) {
+    if (!file_table_find(&ss->files, filename)) {
         return ERR_FILE_NOT_FOUND;
     }
     if (!ensure_checkpoint_directory(filename)) {
@@ -731,19 +1525,20 @@ ErrorCode create_checkpoint(StorageServer* ss, const char* filename, const char*
         return ERR_FILE_EXISTS;
     }
 
-    char content[MAX_CONTENT_SIZE];
-    size_t size = 0;
-    ErrorCode read_err = read_file(ss, filename, content, &size);
-    if (read_err != ERR_SUCCESS) {
+    ErrorCode read_err;
+    RenderedContent* content = acquire_rendered_content(ss, filename, &read_err);
+    if (!content) {
         return read_err;
     }
 
     FILE* fp = fopen(checkpoint_path, "w");
     if (!fp) {
+        release_rendered_content(content);
         return ERR_SYSTEM_ERROR;
     }
-    fwrite(content, 1, size, fp);
+    fwrite(content->data, 1, content->length, fp);
     fclose(fp);
+    release_rendered_content(content);
 
     char details[256];
     snprintf(details, sizeof(details), "File=%s Tag=%s", filename, tag);
@@ -757,8 +1552,7 @@ ErrorCode view_checkpoint(StorageServer* ss, const char* filename, const char* t
     if (!buffer || buffer_size == 0) {
         return ERR_INVALID_OPERATION;
     }
-    FileEntry* file = find_file(ss, filename);
-    if (!file) {
+    if (!file_table_find(&ss->files, filename)) {
         return ERR_FILE_NOT_FOUND;
     }
 
@@ -791,12 +1585,8 @@ ErrorCode view_checkpoint(StorageServer* ss, const char* filename, const char* t
     return ERR_SUCCESS;
 }
 
-ErrorCode revert_to_checkpoint(StorageServer* ss, const char* filename, const char* tag) {
-    FileEntry* file = find_file(ss, filename);
-    if (!file) {
-        return ERR_FILE_NOT_FOUND;
-    }
-
+static ErrorCode revert_file_to_checkpoint(StorageServer* ss, FileEntry* file,
+                                           const char* filename, const char* tag) {
     char checkpoint_path[MAX_PATH];
     if (!build_checkpoint_path(checkpoint_path, sizeof(checkpoint_path), filename, tag)) {
         return ERR_INVALID_OPERATION;
@@ -812,21 +1602,39 @@ ErrorCode revert_to_checkpoint(StorageServer* ss, const char* filename, const ch
     snapshot[bytes_read] = '\0';
     fclose(fp);
 
-    pthread_rwlock_wrlock(&file->file_lock);
-
     char undo_path[MAX_PATH];
-    if (!build_undo_path(file, undo_path, sizeof(undo_path)) ||
-        copy_file_contents(file->filepath, undo_path) != ERR_SUCCESS) {
-        pthread_rwlock_unlock(&file->file_lock);
+    char* previous = (char*)malloc(MAX_CONTENT_SIZE);
+    if (!previous || !build_undo_path(file, undo_path, sizeof(undo_path))) {
+        free(previous);
         return ERR_SYSTEM_ERROR;
     }
 
+    // The undo copy is rendered from memory, which may be ahead of the disk
+    pthread_rwlock_wrlock(&file->file_lock);
+    rebuild_file_content(file, previous);
     parse_sentences(file, snapshot);
     file->last_modified = time(NULL);
     file->last_accessed = file->last_modified;
-    save_file_to_disk(file);
+    uint64_t seq = writeback_queue_rewrite(ss, file);
     pthread_rwlock_unlock(&file->file_lock);
 
+    ErrorCode result = ERR_SUCCESS;
+    fp = fopen(undo_path, "w");
+    if (!fp || fwrite(previous, 1, strlen(previous), fp) != strlen(previous)) {
+        result = ERR_SYSTEM_ERROR;
+    }
+    if (fp && fclose(fp) != 0) {
+        result = ERR_SYSTEM_ERROR;
+    }
+    free(previous);
+    ErrorCode persisted = writeback_wait(ss, file, seq);
+    if (result == ERR_SUCCESS) {
+        result = persisted;
+    }
+    if (result != ERR_SUCCESS) {
+        return result;
+    }
+
     char details[256];
     snprintf(details, sizeof(details), "File=%s Tag=%s", filename, tag);
     log_message(ss, "INFO", "CHECKPOINT_REVERT", details);
@@ -834,13 +1642,22 @@ ErrorCode revert_to_checkpoint(StorageServer* ss, const char* filename, const ch
     return ERR_SUCCESS;
 }
 
+ErrorCode revert_to_checkpoint(StorageServer* ss, const char* filename, const char* tag) {
+    FileEntry* file = find_file(ss, filename);
+    if (!file) {
+        return ERR_FILE_NOT_FOUND;
+    }
+    ErrorCode result = revert_file_to_checkpoint(ss, file, filename, tag);
+    release_file(file);
+    return result;
+}
+
 ErrorCode list_checkpoints(StorageServer* ss, const char* filename, char* buffer, size_t buffer_size) {
     if (!buffer || buffer_size == 0) {
         return ERR_INVALID_OPERATION;
     }
 
-    FileEntry* file = find_file(ss, filename);
-    if (!file) {
+    if (!file_table_find(&ss->files, filename)) {
         return ERR_FILE_NOT_FOUND;
     }
 
@@ -938,37 +1755,262 @@ void remove_all_checkpoints(const char* filename) {
     rmdir(dir_path);
 }
 
-// ==================== FILE OPERATIONS ====================
+// ==================== FILE TABLE ====================
 
-FileEntry* find_file(StorageServer* ss, const char* filename) {
-    pthread_mutex_lock(&ss->files_lock);
-    
-    for (int i = 0; i < ss->file_count; i++) {
-        if (ss->files[i] && strcmp(ss->files[i]->filename, filename) == 0) {
-            pthread_mutex_unlock(&ss->files_lock);
-            return ss->files[i];
+static uint32_t hash_filename(const char* filename) {
+    uint32_t hash = 2166136261u;  // FNV-1a
+    for (const unsigned char* p = (const unsigned char*)filename; *p; p++) {
+        hash ^= *p;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static inline size_t bucket_index(const FileTable* table, uint32_t hash) {
+    return hash & (table->bucket_count - 1);
+}
+
+static inline pthread_mutex_t* bucket_stripe(FileTable* table, size_t bucket) {
+    return &table->stripes[bucket & (FILE_TABLE_STRIPES - 1)];
+}
+
+// Caller holds the bucket's stripe lock (or table_lock exclusively)
+static FileEntry* find_in_bucket(FileEntry* chain, const char* filename, uint32_t hash) {
+    for (FileEntry* file = chain; file; file = file->hash_next) {
+        if (file->name_hash == hash && strcmp(file->filename, filename) == 0) {
+            return file;
         }
     }
-    
-    pthread_mutex_unlock(&ss->files_lock);
     return NULL;
 }
 
-FileEntry* create_file(StorageServer* ss, const char* filename) {
-    // Check if file already exists
-    if (find_file(ss, filename)) {
+bool file_table_init(FileTable* table) {
+    table->buckets = (FileEntry**)calloc(FILE_TABLE_INITIAL_BUCKETS, sizeof(FileEntry*));
+    if (!table->buckets) {
+        return false;
+    }
+    table->bucket_count = FILE_TABLE_INITIAL_BUCKETS;
+    atomic_init(&table->count, 0);
+    pthread_rwlock_init(&table->table_lock, NULL);
+    for (int i = 0; i < FILE_TABLE_STRIPES; i++) {
+        pthread_mutex_init(&table->stripes[i], NULL);
+    }
+    return true;
+}
+
+void file_table_destroy(FileTable* table) {
+    free(table->buckets);
+    table->buckets = NULL;
+    table->bucket_count = 0;
+    pthread_rwlock_destroy(&table->table_lock);
+    for (int i = 0; i < FILE_TABLE_STRIPES; i++) {
+        pthread_mutex_destroy(&table->stripes[i]);
+    }
+}
+
+FileEntry* file_table_find(FileTable* table, const char* filename) {
+    uint32_t hash = hash_filename(filename);
+
+    pthread_rwlock_rdlock(&table->table_lock);
+    size_t bucket = bucket_index(table, hash);
+    pthread_mutex_t* stripe = bucket_stripe(table, bucket);
+    pthread_mutex_lock(stripe);
+    FileEntry* file = find_in_bucket(table->buckets[bucket], filename, hash);
+    pthread_mutex_unlock(stripe);
+    pthread_rwlock_unlock(&table->table_lock);
+
+    return file;
+}
+
+// Like file_table_find, but counts a pin before the stripe lock is dropped,
+// so delete_file (which removes under that lock) either sees the pin or
+// the lookup misses
+FileEntry* file_table_pin(FileTable* table, const char* filename) {
+    uint32_t hash = hash_filename(filename);
+
+    pthread_rwlock_rdlock(&table->table_lock);
+    size_t bucket = bucket_index(table, hash);
+    pthread_mutex_t* stripe = bucket_stripe(table, bucket);
+    pthread_mutex_lock(stripe);
+    FileEntry* file = find_in_bucket(table->buckets[bucket], filename, hash);
+    if (file) {
+        atomic_fetch_add(&file->pins, 1);
+    }
+    pthread_mutex_unlock(stripe);
+    pthread_rwlock_unlock(&table->table_lock);
+
+    return file;
+}
+
+// Doubles the bucket array once chains average more than two entries
+static void grow_table(FileTable* table) {
+    pthread_rwlock_wrlock(&table->table_lock);
+    if (atomic_load(&table->count) > table->bucket_count * 2) {
+        size_t new_count = table->bucket_count * 2;
+        FileEntry** grown = (FileEntry**)calloc(new_count, sizeof(FileEntry*));
+        if (grown) {
+            for (size_t i = 0; i < table->bucket_count; i++) {
+                FileEntry* file = table->buckets[i];
+                while (file) {
+                    FileEntry* next = file->hash_next;
+                    size_t bucket = file->name_hash & (new_count - 1);
+                    file->hash_next = grown[bucket];
+                    grown[bucket] = file;
+                    file = next;
+                }
+            }
+            free(table->buckets);
+            table->buckets = grown;
+            table->bucket_count = new_count;
+        }
+    }
+    pthread_rwlock_unlock(&table->table_lock);
+}
+
+bool file_table_insert(FileTable* table, FileEntry* file) {
+    file->name_hash = hash_filename(file->filename);
+
+    pthread_rwlock_rdlock(&table->table_lock);
+    size_t bucket = bucket_index(table, file->name_hash);
+    pthread_mutex_t* stripe = bucket_stripe(table, bucket);
+    pthread_mutex_lock(stripe);
+    bool inserted = !find_in_bucket(table->buckets[bucket], file->filename, file->name_hash);
+    if (inserted) {
+        file->hash_next = table->buckets[bucket];
+        table->buckets[bucket] = file;
+    }
+    pthread_mutex_unlock(stripe);
+    bool crowded = inserted && atomic_fetch_add(&table->count, 1) + 1 > table->bucket_count * 2;
+    pthread_rwlock_unlock(&table->table_lock);
+
+    if (crowded) {
+        grow_table(table);
+    }
+    return inserted;
+}
+
+FileEntry* file_table_remove(FileTable* table, const char* filename) {
+    uint32_t hash = hash_filename(filename);
+
+    pthread_rwlock_rdlock(&table->table_lock);
+    size_t bucket = bucket_index(table, hash);
+    pthread_mutex_t* stripe = bucket_stripe(table, bucket);
+    pthread_mutex_lock(stripe);
+    FileEntry* removed = NULL;
+    for (FileEntry** link = &table->buckets[bucket]; *link; link = &(*link)->hash_next) {
+        FileEntry* file = *link;
+        if (file->name_hash == hash && strcmp(file->filename, filename) == 0) {
+            *link = file->hash_next;
+            file->hash_next = NULL;
+            removed = file;
+            break;
+        }
+    }
+    pthread_mutex_unlock(stripe);
+    if (removed) {
+        atomic_fetch_sub(&table->count, 1);
+    }
+    pthread_rwlock_unlock(&table->table_lock);
+
+    return removed;
+}
+
+bool file_table_rename(FileTable* table, FileEntry* file, const char* new_filename,
+                       const char* new_filepath) {
+    uint32_t new_hash = hash_filename(new_filename);
+
+    // Exclusive: the entry changes buckets and its name is read by lookups
+    pthread_rwlock_wrlock(&table->table_lock);
+    size_t new_bucket = bucket_index(table, new_hash);
+    if (find_in_bucket(table->buckets[new_bucket], new_filename, new_hash)) {
+        pthread_rwlock_unlock(&table->table_lock);
+        return false;
+    }
+
+    for (FileEntry** link = &table->buckets[bucket_index(table, file->name_hash)]; *link;
+         link = &(*link)->hash_next) {
+        if (*link == file) {
+            *link = file->hash_next;
+            break;
+        }
+    }
+
+    strncpy(file->filename, new_filename, MAX_FILENAME - 1);
+    file->filename[MAX_FILENAME - 1] = '\0';
+    strncpy(file->filepath, new_filepath, MAX_PATH - 1);
+    file->filepath[MAX_PATH - 1] = '\0';
+    file->name_hash = new_hash;
+    file->hash_next = table->buckets[new_bucket];
+    table->buckets[new_bucket] = file;
+
+    pthread_rwlock_unlock(&table->table_lock);
+    return true;
+}
+
+// The callback runs with a stripe lock held and must not call back into the
+// table; it may free the entry it is given.
+void file_table_foreach(FileTable* table, void (*callback)(FileEntry*, void*), void* ctx) {
+    pthread_rwlock_rdlock(&table->table_lock);
+    for (size_t i = 0; i < table->bucket_count; i++) {
+        pthread_mutex_t* stripe = bucket_stripe(table, i);
+        pthread_mutex_lock(stripe);
+        FileEntry* file = table->buckets[i];
+        while (file) {
+            FileEntry* next = file->hash_next;
+            callback(file, ctx);
+            file = next;
+        }
+        pthread_mutex_unlock(stripe);
+    }
+    pthread_rwlock_unlock(&table->table_lock);
+}
+
+size_t file_table_count(FileTable* table) {
+    return atomic_load(&table->count);
+}
+
+// ==================== FILE OPERATIONS ====================
+
+void destroy_file_entry(FileEntry* file) {
+    free_all_sentences(file);
+    pthread_rwlock_destroy(&file->file_lock);
+    pthread_mutex_destroy(&file->structure_lock);
+    pthread_mutex_destroy(&file->load_lock);
+    pthread_mutex_destroy(&file->memory.lock);
+    destroy_rendered_content(file);
+    dirty_state_destroy(file);
+    free(file);
+}
+
+// The entry stays parsed until release_file; see unload_file
+FileEntry* find_file(StorageServer* ss, const char* filename) {
+    FileEntry* file = file_table_pin(&ss->files, filename);
+    if (!file) {
         return NULL;
     }
-    
-    pthread_mutex_lock(&ss->files_lock);
-    
-    if (ss->file_count >= MAX_FILES) {
-        pthread_mutex_unlock(&ss->files_lock);
+    atomic_store_explicit(&file->referenced, true, memory_order_relaxed);
+    if (!atomic_load(&file->loaded) && !ensure_file_loaded(ss, file)) {
+        release_file(file);
+        return NULL;
+    }
+    return file;
+}
+
+void release_file(FileEntry* file) {
+    atomic_fetch_sub(&file->pins, 1);
+}
+
+FileEntry* create_file(StorageServer* ss, const char* filename) {
+    // Check if file already exists
+    if (file_table_find(&ss->files, filename)) {
         return NULL;
     }
     
     // Create file entry
     FileEntry* file = (FileEntry*)malloc(sizeof(FileEntry));
+    if (!file) {
+        return NULL;
+    }
     strncpy(file->filename, filename, MAX_FILENAME - 1);
     file->filename[MAX_FILENAME - 1] = '\0';
     
@@ -977,11 +2019,10 @@ FileEntry* create_file(StorageServer* ss, const char* filename) {
     // Initialize empty linked list
     file->head = NULL;
     file->tail = NULL;
+    file->sentence_root = NULL;
     file->sentence_count = 0;
     
-    file->total_size = 0;
-    file->total_words = 0;
-    file->total_chars = 0;
+    init_file_stats(file);
     file->last_modified = time(NULL);
     file->last_accessed = time(NULL);
     file->undo_head = NULL;
@@ -989,12 +2030,28 @@ FileEntry* create_file(StorageServer* ss, const char* filename) {
     
     pthread_rwlock_init(&file->file_lock, NULL);
     pthread_mutex_init(&file->structure_lock, NULL);
+    pthread_mutex_init(&file->load_lock, NULL);
+    atomic_init(&file->loaded, true);
+    atomic_init(&file->pins, 0);
+    atomic_init(&file->referenced, true);
+    file->evicted = false;
+    file_memory_init(file);
+    init_rendered_content(file);
+    edit_log_init(file, "", 0);
+    dirty_state_init(file);
     
     // Create one empty sentence
-    SentenceNode* empty_node = create_empty_sentence_node();
+    SentenceNode* empty_node = create_empty_sentence_node(file);
     if (empty_node) {
         append_sentence(file, empty_node);
     }
+    refresh_file_snapshot(file);
+    
+    // Publish before touching the disk so a racing create cannot truncate it
+    if (!file_table_insert(&ss->files, file)) {
+        destroy_file_entry(file);
+        return NULL;
+    }
     
     // Create empty file on disk
     // Ensure parent directory exists
@@ -1018,10 +2075,8 @@ FileEntry* create_file(StorageServer* ss, const char* filename) {
     if (fp) {
         fclose(fp);
     }
-    
-    ss->files[ss->file_count++] = file;
-    
-    pthread_mutex_unlock(&ss->files_lock);
+    // A log left behind by an earlier file of this name must not replay
+    edit_log_remove(filename);
     
     char details[256];
     snprintf(details, sizeof(details), "File=%s", filename);
@@ -1067,80 +2122,108 @@ ErrorCode create_folder(StorageServer* ss, const char* foldername) {
 }
 
 ErrorCode delete_file(StorageServer* ss, const char* filename) {
-    pthread_mutex_lock(&ss->files_lock);
+    FileEntry* file = file_table_remove(&ss->files, filename);
+    if (!file) {
+        return ERR_FILE_NOT_FOUND;
+    }
     
-    for (int i = 0; i < ss->file_count; i++) {
-        if (ss->files[i] && strcmp(ss->files[i]->filename, filename) == 0) {
-            FileEntry* file = ss->files[i];
-            
-            // Delete file from disk
-            unlink(file->filepath);
-            char undo_path[MAX_PATH];
-            if (build_undo_path(file, undo_path, sizeof(undo_path))) {
-                unlink(undo_path);
-            }
-            remove_all_checkpoints(filename);
-            
-            // Free all sentences in linked list
-            free_all_sentences(file);
-            clear_file_undo_history(file);
-            
-            pthread_rwlock_destroy(&file->file_lock);
-            pthread_mutex_destroy(&file->structure_lock);
-            free(file);
-            
-            // Shift array
-            for (int j = i; j < ss->file_count - 1; j++) {
-                ss->files[j] = ss->files[j + 1];
-            }
-            ss->file_count--;
-            
-            pthread_mutex_unlock(&ss->files_lock);
-            
-            char details[256];
-            snprintf(details, sizeof(details), "File=%s", filename);
-            log_message(ss, "INFO", "DELETE", details);
-            
-            return ERR_SUCCESS;
-        }
+    // Delete file from disk
+    unlink(file->filepath);
+    char undo_path[MAX_PATH];
+    if (build_undo_path(file, undo_path, sizeof(undo_path))) {
+        unlink(undo_path);
     }
+    edit_log_remove(filename);
+    remove_all_checkpoints(filename);
+    writeback_forget(ss, file);
+
+    // Out of the table, so no new pins; wait for the holders to finish
+    // (they hold it for one operation) before freeing the entry
+    while (atomic_load(&file->pins) > 0) {
+        struct timespec pause = { 0, 1000000 };
+        nanosleep(&pause, NULL);
+    }
+    
+    char memory[192];
+    format_file_memory(file, memory, sizeof(memory));
+    char details[512];
+    snprintf(details, sizeof(details), "File=%s %s", filename, memory);
+    
+    // Sentences, drafts, undo entries and words go with the file's arena and slabs
+    destroy_file_entry(file);
     
-    pthread_mutex_unlock(&ss->files_lock);
-    return ERR_FILE_NOT_FOUND;
+    log_message(ss, "INFO", "DELETE", details);
+    
+    return ERR_SUCCESS;
 }
 
-ErrorCode read_file(StorageServer* ss, const char* filename, char* content, size_t* size) {
+RenderedContent* acquire_rendered_content(StorageServer* ss, const char* filename, ErrorCode* error) {
     FileEntry* file = find_file(ss, filename);
     if (!file) {
-        return ERR_FILE_NOT_FOUND;
+        *error = ERR_FILE_NOT_FOUND;
+        return NULL;
     }
+    file->last_accessed = time(NULL);
     
-    pthread_rwlock_rdlock(&file->file_lock);
-    
-    FILE* fp = fopen(file->filepath, "r");
-    if (!fp) {
-        pthread_rwlock_unlock(&file->file_lock);
-        return ERR_SYSTEM_ERROR;
+    // Pin the current version; commits publish new ones without waiting for us
+    pthread_mutex_lock(&file->render_lock);
+    RenderedContent* content = file->rendered;
+    FileSnapshot* snapshot = file->snapshot;
+    if (content) {
+        atomic_fetch_add(&content->refs, 1);
+    } else if (snapshot) {
+        atomic_fetch_add(&snapshot->refs, 1);
+    }
+    pthread_mutex_unlock(&file->render_lock);
+    if (content) {
+        release_file(file);
+        *error = ERR_SUCCESS;
+        return content;
+    }
+
+    if (snapshot) {
+        // Cache miss: render the pinned version once and keep it for later READs
+        content = render_snapshot_content(snapshot);
+        snapshot_release(snapshot);
+    } else {
+        // No snapshot (building one ran out of memory): render the sentences
+        char* buffer = (char*)malloc(MAX_CONTENT_SIZE);
+        if (buffer) {
+            pthread_rwlock_rdlock(&file->file_lock);
+            pthread_mutex_lock(&file->render_lock);
+            uint64_t version = file->content_version;
+            pthread_mutex_unlock(&file->render_lock);
+            rebuild_file_content(file, buffer);
+            pthread_rwlock_unlock(&file->file_lock);
+            content = render_content(buffer, strlen(buffer), version);
+            free(buffer);
+        }
+    }
+    if (!content) {
+        release_file(file);
+        *error = ERR_SYSTEM_ERROR;
+        return NULL;
     }
 
-    size_t bytes_read = fread(content, 1, MAX_CONTENT_SIZE - 1, fp);
-    content[bytes_read] = '\0';
-    *size = bytes_read;
-    
-    fclose(fp);
-    
-    file->last_accessed = time(NULL);
-    
-    pthread_rwlock_unlock(&file->file_lock);
+    // Install unless another reader beat us to it or the content moved on
+    pthread_mutex_lock(&file->render_lock);
+    if (!file->rendered && file->content_version == content->version) {
+        atomic_fetch_add(&content->refs, 1);
+        file->rendered = content;
+    }
+    pthread_mutex_unlock(&file->render_lock);
+    release_file(file);
     
-    return ERR_SUCCESS;
+    *error = ERR_SUCCESS;
+    return content;
 }
 
 ErrorCode rename_file(StorageServer* ss, const char* old_filename, const char* new_filename) {
-    FileEntry* file = find_file(ss, old_filename);
+    // Renaming touches no sentences, so an unloaded file stays unloaded
+    FileEntry* file = file_table_find(&ss->files, old_filename);
     if (!file) return ERR_FILE_NOT_FOUND;
     
-    if (find_file(ss, new_filename)) return ERR_FILE_EXISTS;
+    if (file_table_find(&ss->files, new_filename)) return ERR_FILE_EXISTS;
 
     char old_path[MAX_PATH];
     char new_path[MAX_PATH];
@@ -1167,17 +2250,33 @@ ErrorCode rename_file(StorageServer* ss, const char* old_filename, const char* n
         mkdir(path_copy, 0700);
     }
 
+    // Held so neither a commit, a load nor the write-back thread touches the
+    // files while they change name
+    pthread_mutex_lock(&file->load_lock);
+    pthread_rwlock_wrlock(&file->file_lock);
+    pthread_mutex_lock(&file->dirty.persist_lock);
+
     if (rename(old_path, new_path) != 0) {
+        pthread_mutex_unlock(&file->dirty.persist_lock);
+        pthread_rwlock_unlock(&file->file_lock);
+        pthread_mutex_unlock(&file->load_lock);
         return ERR_SYSTEM_ERROR;
     }
 
-    // Update FileEntry
-    pthread_mutex_lock(&ss->files_lock);
-    strncpy(file->filename, new_filename, MAX_FILENAME - 1);
-    file->filename[MAX_FILENAME - 1] = '\0';
-    strncpy(file->filepath, new_path, MAX_PATH - 1);
-    file->filepath[MAX_PATH - 1] = '\0';
-    pthread_mutex_unlock(&ss->files_lock);
+    // Re-key the FileEntry under its new name
+    if (!file_table_rename(&ss->files, file, new_filename, new_path)) {
+        rename(new_path, old_path);
+        pthread_mutex_unlock(&file->dirty.persist_lock);
+        pthread_rwlock_unlock(&file->file_lock);
+        pthread_mutex_unlock(&file->load_lock);
+        return ERR_FILE_EXISTS;
+    }
+    edit_log_rename(old_filename, new_filename);
+    lease_rename_file(ss, old_filename, new_filename);
+
+    pthread_mutex_unlock(&file->dirty.persist_lock);
+    pthread_rwlock_unlock(&file->file_lock);
+    pthread_mutex_unlock(&file->load_lock);
 
     if (has_old_undo) {
         char new_undo_path[MAX_PATH];
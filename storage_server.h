@@ -11,15 +11,23 @@
 #include <arpa/inet.h>
 #include <time.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <stdatomic.h>
 #include <sys/stat.h>
 #include <dirent.h>
 #include <errno.h>
 #include <ctype.h>
 
+#include "wire.h"
+#include "command.h"
+#include "async_log.h"
+#include "arena.h"
+
 // Constants
 #define MAX_FILENAME 256
 #define MAX_PATH 512
-#define MAX_FILES 1000
+#define FILE_TABLE_INITIAL_BUCKETS 64   // Power of two; doubles as files are added
+#define FILE_TABLE_STRIPES 64           // Bucket locks (bucket i uses stripe i % STRIPES)
 #define MAX_SENTENCE_LOCKS 1000
 #define BUFFER_SIZE 4096
 #define MAX_CONTENT_SIZE (1024 * 1024)  // 1MB max file size
@@ -27,7 +35,36 @@
 #define STORAGE_DIR "./storage"
 #define CHECKPOINT_BASE_DIR STORAGE_DIR "/checkpoints"
 #define MAX_CHECKPOINT_TAG 64
+#define EDIT_LOG_DIR_NAME "editlogs"
+#define EDIT_LOG_BASE_DIR STORAGE_DIR "/" EDIT_LOG_DIR_NAME
+#define EDIT_LOG_COMPACT_RECORDS 256     // Fold the log into the text file after this many edits...
+#define EDIT_LOG_COMPACT_BYTES (64 * 1024)  // ...or once the log is this large...
+#define EDIT_LOG_IDLE_SECONDS 2          // ...or when the file has been quiet this long
+#define EDIT_LOG_SCAN_SECONDS 1          // How often write-back looks for logs to compact
+#define DURABILITY_REPORT_SECONDS 30     // Commit latency / fsync summary interval
+#define WRITEBACK_INTERVAL_MS 50         // Default SS_FLUSH_INTERVAL_MS
+#define WRITEBACK_MAX_DIRTY_AGE_MS 500   // Default SS_MAX_DIRTY_AGE_MS
+#define STREAM_INTERVAL_MS 100           // Default pause between streamed words
+#define STREAM_MAX_INTERVAL_MS 10000
+#define STREAM_WORKERS 4                 // Threads serving every active stream
+#define STREAM_TICK_MS 10                // Timer wheel resolution
+#define STREAM_WHEEL_SLOTS 256
+#define STREAM_BATCH_WORDS 64            // Most words coalesced into one writev
 #define SENTENCE_UNDO_HISTORY 50
+#define ARENA_REPACK_MIN_BYTES (16 * 1024)  // Abandoned arena bytes worth a repack
+#define SNAPSHOT_CHUNK 64                // Sentences per snapshot chunk (at most)
+#define MEMORY_SCAN_MS 250               // How often resident memory is totalled
+#define MEMORY_REPORT_SECONDS 30         // Resident memory / eviction summary interval
+#define SS_LISTEN_BACKLOG 128            // Default SS_LISTEN_BACKLOG
+#define SS_MIN_WORKERS 4                 // Floor for SS_CLIENT_WORKERS (handlers can block)
+#define SS_IO_BUFFER_SIZE WIRE_MAX_FRAME  // Pooled per-session receive buffer
+#define SS_NM_WORKERS 8                  // Default SS_NM_WORKERS (NM command pool)
+#define LOCK_LEASE_SECONDS 300           // Default SS_LOCK_LEASE_SECONDS; renewed by each WRITE
+#define LEASE_TICK_MS 1000               // Lease wheel resolution
+#define LEASE_WHEEL_SLOTS 64
+#define LEASE_INDEX_BUCKETS 256          // Lease lookup by (holder, file); power of two
+#define LOCK_HOLD_BUCKETS 24             // Hold-time histogram: bucket i holds [2^i, 2^(i+1)) ms
+#define LOCK_REPORT_SECONDS 30           // Lock hold summary interval
 
 // Error Codes (matching NM)
 typedef enum {
@@ -45,7 +82,7 @@ typedef enum {
 struct SentenceNode;
 
 typedef struct DraftSentence {
-    char** words;                    // Staged words before commit
+    char** words;                    // Staged words before commit (file arena)
     int word_count;
     int word_capacity;
     char delimiter;
@@ -54,7 +91,7 @@ typedef struct DraftSentence {
 
 typedef struct SentenceUndoEntry {
     struct SentenceNode* sentence;   // Target sentence for this snapshot
-    char** words_snapshot;           // Deep copy of words before commit
+    char** words_snapshot;           // Words before commit (shared with the sentence)
     int word_count;
     char delimiter;
     int appended_sentences;          // Sentences created during the commit
@@ -62,37 +99,282 @@ typedef struct SentenceUndoEntry {
 } SentenceUndoEntry;
 
 typedef struct SentenceNode {
-    char** words;                    // Dynamic array of words
+    char** words;                    // Word pointers into the file arena
     int word_count;                  // Number of words in sentence
     int word_capacity;               // Allocated capacity for words array
     char delimiter;                  // Sentence ending: '.', '!', '?', or '\0'
+    int char_count;                  // Rendered length, without the space before it
     pthread_mutex_t lock;            // Sentence-level lock for concurrent access
     bool is_locked;
-    int lock_holder_id;              // Client ID holding the lock
+    int lock_holder_id;              // Holder ID of the session holding the lock
+    uint64_t lock_lease;             // Serial of the lease covering the lock (0 = none)
     struct SentenceNode* next;       // Next sentence in list
     struct SentenceNode* prev;       // Previous sentence in list
+    struct SentenceNode* left;       // Index: implicit treap ordered by position
+    struct SentenceNode* right;
+    struct SentenceNode* parent;
+    uint32_t priority;               // Index: random heap priority
+    int subtree_size;                // Index: sentences in this subtree
     DraftSentence* draft_head;       // Pending staged edits (linked list per delimiter)
     bool draft_dirty;                // True if staged edits differ from live data
 } SentenceNode;
 
+// Per-file memory. Word bytes and word arrays come from the arena and are
+// immutable once stored, so drafts, undo snapshots and committed sentences
+// share word pointers instead of copying strings; a replaced array or word
+// is simply abandoned. Sentences, drafts and undo entries come from slabs.
+// Everything is returned at once when the file is re-parsed or freed; in
+// between, write-back repacks the arena once abandoned bytes outweigh live.
+typedef struct FileMemory {
+    pthread_mutex_t lock;            // Leaf lock; concurrent writers allocate drafts
+    Arena words;
+    size_t abandoned;                // Arena bytes known to be unreferenced (word arrays)
+    SlabPool sentences;
+    SlabPool drafts;
+    SlabPool undo_entries;
+} FileMemory;
+
+// Immutable rendering of a file's content, shared by concurrent READs.
+// Holders keep it alive with a reference, so a reply can be sent without
+// holding any file lock while a commit installs a newer version.
+typedef struct RenderedContent {
+    _Atomic int refs;
+    uint64_t version;                // FileEntry content_version it was built from
+    size_t length;                   // Content bytes
+    size_t reply_length;             // length + 1 when a trailing '\n' was added for READ
+    char data[];                     // Content, optional '\n', then NUL
+} RenderedContent;
+
+// Immutable, reference-counted view of a file's sentences at one content
+// version (see storage_server_snapshot.c). Each sentence is rendered once
+// into a SentenceText and sentences are grouped into chunks; a commit builds
+// the next snapshot sharing every chunk it did not touch. Readers pin a
+// snapshot and render it without taking file_lock.
+typedef struct SentenceText {
+    _Atomic int refs;
+    size_t length;
+    char text[];                     // Rendered sentence, not NUL-terminated
+} SentenceText;
+
+typedef struct SnapshotChunk {
+    _Atomic int refs;
+    int count;
+    size_t length;                   // Sum of the sentences' lengths
+    SentenceText* sentences[];
+} SnapshotChunk;
+
+typedef struct FileSnapshot {
+    _Atomic int refs;
+    uint64_t version;                // FileEntry content_version it belongs to
+    int sentence_count;
+    size_t length_bound;             // Rendered length, separators included, at most
+    int chunk_count;
+    SnapshotChunk* chunks[];
+} FileSnapshot;
+
+// Sentence-level edits not yet folded into the file's text (see
+// storage_server_editlog.c). Guarded by file_lock; the counters are atomic
+// so the compactor can pick candidates without taking it.
+typedef struct EditLogState {
+    _Atomic size_t bytes;            // Size of the log; 0 when there is none
+    _Atomic int records;             // Edits since the text file was last written
+    size_t base_length;              // Text file the log applies to
+    uint32_t base_checksum;
+} EditLogState;
+
+// Changes waiting for the write-back thread. Everything but persist_lock is
+// guarded by the SS's writeback.lock.
+typedef struct DirtyState {
+    char* edits;                     // Framed edit-log records, oldest first
+    size_t length;
+    size_t capacity;
+    int records;
+    bool rewrite;                    // Rewrite the text file instead (revert, failed append)
+    bool queued;                     // On the dirty queue
+    bool in_round;                   // Being written by the current round
+    bool evicting;                   // Being unparsed by the memory budget
+    int64_t since_ms;                // When the oldest pending change was made
+    uint64_t last_seq;               // Sequence of the newest queued change
+    uint64_t failed_seq;             // Newest change a failed round did not persist
+    struct FileEntry* next;          // Dirty queue link
+    pthread_mutex_t persist_lock;    // Serializes this file's log writes and rewrites
+} DirtyState;
+
+// File totals. The running sums change by deltas as sentences join, leave
+// or are rewritten, under the same locks as the sentence list;
+// publish_file_stats copies them out under a seqlock so get_file_info can
+// read a consistent set without taking file_lock.
+typedef struct FileStats {
+    size_t sentence_chars;           // Sum of char_count
+    int sentence_words;              // Sum of word_count
+    _Atomic unsigned sequence;       // Odd while a publish is in progress
+    _Atomic size_t total_size;
+    _Atomic int total_words;
+    _Atomic int total_chars;
+} FileStats;
+
 // File structure with Linked List
 typedef struct FileEntry {
     char filename[MAX_FILENAME];
     char filepath[MAX_PATH];
     SentenceNode* head;              // First sentence (linked list head)
     SentenceNode* tail;              // Last sentence (linked list tail)
+    SentenceNode* sentence_root;     // Positional index over the same nodes
     int sentence_count;              // Total number of sentences
-    size_t total_size;
-    int total_words;
-    int total_chars;
+    FileStats stats;
     pthread_rwlock_t file_lock;      // Reader-writer lock for file-level operations
     pthread_mutex_t structure_lock;  // Protects linked list structure modifications
     time_t last_modified;
     time_t last_accessed;
     SentenceUndoEntry* undo_head;    // Stack of sentence-level undo entries
     int undo_depth;
+    uint32_t name_hash;              // File table: hash of filename
+    struct FileEntry* hash_next;     // File table: bucket chain
+    FileMemory memory;
+    pthread_mutex_t render_lock;     // Guards rendered and snapshot (swap and acquire only)
+    RenderedContent* rendered;       // NULL until the first READ after load/create
+    FileSnapshot* snapshot;          // Current version; NULL only if building it failed
+    uint64_t content_version;        // Bumped whenever the content changes
+    EditLogState edit_log;
+    DirtyState dirty;
+    _Atomic bool loaded;             // Sentences parsed; files found at startup load lazily
+    pthread_mutex_t load_lock;       // Serializes loading and unloading
+    _Atomic int pins;                // find_file callers that have not released it
+    _Atomic bool referenced;         // CLOCK bit, set by find_file
+    bool evicted;                    // Unloaded at least once (guarded by load_lock)
 } FileEntry;
 
+// Concurrent filename -> FileEntry map. Lookups, inserts and removes hold
+// table_lock shared plus the lock of their bucket's stripe, so operations on
+// different buckets run in parallel; growing the table and renames take
+// table_lock exclusively.
+typedef struct FileTable {
+    FileEntry** buckets;
+    size_t bucket_count;             // Power of two
+    _Atomic size_t count;
+    pthread_rwlock_t table_lock;
+    pthread_mutex_t stripes[FILE_TABLE_STRIPES];
+} FileTable;
+
+// How commits reach stable storage, set per SS with
+// SS_DURABILITY=none|batched|strict (default batched):
+//   none     Return once the edit is queued; write-back flushes it within
+//            the max dirty age and never fsyncs
+//   batched  Wait for the next write-back round; every log a round touched
+//            is made durable by one fsync (group commit)
+//   strict   Wait for the next round, which fsyncs each log on its own
+typedef enum {
+    DURABILITY_NONE,
+    DURABILITY_BATCHED,
+    DURABILITY_STRICT
+} DurabilityMode;
+
+typedef struct GroupCommit {
+    DurabilityMode mode;
+    _Atomic uint64_t commits;
+    _Atomic uint64_t commit_latency_us;   // Sum over commits
+    _Atomic uint64_t max_latency_us;
+    _Atomic uint64_t fsyncs;
+    _Atomic uint64_t batches;
+    _Atomic uint64_t batched_requests;
+    uint64_t reported_commits;       // Write-back thread only
+} GroupCommit;
+
+// Dirty-file queue drained by one background thread. Commits only mutate
+// memory and queue a record under the file lock; the thread appends queued
+// records to the edit logs every SS_FLUSH_INTERVAL_MS (sooner when a
+// committer is waiting), leaving a file to collect more edits until its
+// oldest one is SS_MAX_DIRTY_AGE_MS old. It also rewrites files after a
+// revert and compacts long edit logs.
+typedef struct WriteBack {
+    int interval_ms;
+    int max_dirty_age_ms;
+    pthread_t thread;
+    bool running;                    // Guarded by lock
+    pthread_mutex_t lock;
+    pthread_cond_t work_cond;        // Wakes the thread early
+    pthread_cond_t done_cond;        // Signalled after every round
+    struct FileEntry* dirty_head;
+    struct FileEntry* dirty_tail;
+    uint64_t next_seq;               // Sequence of the last queued change
+    uint64_t flushed_seq;            // Every change up to here has been written
+    int waiters;                     // Committers waiting on flushed_seq
+} WriteBack;
+
+// Paced STREAM replies (see storage_server_stream.c). Active streams wait in
+// a hashed timer wheel until their next word is due; a timer thread moves
+// due streams to the ready list and a small pool of workers sends them.
+struct StreamJob;
+typedef struct StreamEngine {
+    pthread_mutex_t lock;
+    pthread_cond_t ready_cond;
+    pthread_t timer;
+    pthread_t workers[STREAM_WORKERS];
+    int worker_count;
+    bool running;                    // Guarded by lock
+    struct StreamJob* wheel[STREAM_WHEEL_SLOTS];
+    struct StreamJob* ready_head;
+    struct StreamJob* ready_tail;
+    uint64_t tick;                   // Ticks the timer has processed
+    int64_t start_ms;                // Monotonic time of tick 0
+    int active;                      // Streams in flight
+} StreamEngine;
+
+// Files registered by the startup scan are parsed on first access; a pool of
+// SS_PREWARM_THREADS (default: one per core, 0 to disable) parses the rest
+// in the background.
+typedef struct Prewarm {
+    pthread_t* threads;
+    int thread_count;
+    char (*names)[MAX_FILENAME];     // Files found by the scan
+    size_t count;
+    _Atomic size_t next;             // Next name to load
+    _Atomic int running;             // Threads not yet finished
+    _Atomic bool stop;
+    int64_t started_ms;
+} Prewarm;
+
+// Resident memory of parsed files (see storage_server_memory.c). With
+// SS_MEMORY_BUDGET_MB set, cold files are unparsed back to their on-disk
+// form whenever the total goes over it; 0 (the default) only keeps count.
+typedef struct MemoryBudget {
+    size_t budget_bytes;
+    pthread_t thread;
+    bool running;                    // Guarded by lock
+    pthread_mutex_t lock;
+    pthread_cond_t wake_cond;        // A load may have pushed the total over
+    size_t hand;                     // CLOCK position (memory thread only)
+    _Atomic size_t resident_bytes;   // As of the last scan
+    _Atomic size_t resident_files;
+    _Atomic uint64_t evictions;
+    _Atomic uint64_t evicted_bytes;
+    _Atomic uint64_t reloads;        // Loads of files that had been evicted
+} MemoryBudget;
+
+// Sentence locks are leases (see storage_server_lease.c): one per holder and
+// file, renewed by the holder's writes, released on ETIRW, when the session
+// closes, or by the lease timer once SS_LOCK_LEASE_SECONDS pass unused.
+struct SentenceLease;
+typedef struct LeaseTable {
+    pthread_mutex_t lock;
+    pthread_cond_t wake_cond;
+    pthread_t timer;
+    bool running;                    // Guarded by lock
+    int64_t lease_ms;
+    struct SentenceLease* wheel[LEASE_WHEEL_SLOTS];
+    struct SentenceLease* index[LEASE_INDEX_BUCKETS];
+    uint64_t tick;                   // Ticks the timer has processed
+    int64_t start_ms;                // Monotonic time of tick 0
+    int active;                      // Leases outstanding
+    uint64_t next_serial;            // Last lease serial handed out
+    _Atomic int next_holder;         // Holder IDs are never reused
+    _Atomic uint64_t hold_histogram[LOCK_HOLD_BUCKETS];
+    _Atomic uint64_t released;       // Ended by ETIRW
+    _Atomic uint64_t expired;
+    _Atomic uint64_t disconnected;
+    _Atomic uint64_t max_hold_ms;
+} LeaseTable;
+
 // Storage Server
 typedef struct StorageServer {
     int ss_id;
@@ -103,25 +385,34 @@ typedef struct StorageServer {
     int client_socket_fd;
     
     // File management
-    FileEntry* files[MAX_FILES];
-    int file_count;
-    pthread_mutex_t files_lock;
+    FileTable files;
     
-    // Logging
-    FILE* log_file;
-    pthread_mutex_t log_lock;
+    // Logging (asynchronous; see async_log.h)
+    AsyncLog log;
+
+    // Tagged NM replies are written by concurrent request threads
+    pthread_mutex_t nm_send_lock;
+    
+    // Write-back of dirty files; each round is one group commit
+    GroupCommit durability;
+    WriteBack writeback;
+    
+    // STREAM pacing
+    StreamEngine streams;
+    
+    // Background loading of files found at startup
+    Prewarm prewarm;
+    
+    // Eviction of cold parsed files
+    MemoryBudget memory;
+    
+    // Sentence lock leases
+    LeaseTable leases;
     
     // Running state
     bool is_running;
 } StorageServer;
 
-// Connection thread arguments
-typedef struct ConnectionArgs {
-    StorageServer* ss;
-    int socket_fd;
-    struct sockaddr_in addr;
-} ConnectionArgs;
-
 // Function Declarations
 
 // Initialization
@@ -130,31 +421,68 @@ void destroy_storage_server(StorageServer* ss);
 bool register_with_nm(StorageServer* ss);
 void start_client_server(StorageServer* ss);
 
+// File table
+bool file_table_init(FileTable* table);
+void file_table_destroy(FileTable* table);   // Frees the table, not the entries
+FileEntry* file_table_find(FileTable* table, const char* filename);
+FileEntry* file_table_pin(FileTable* table, const char* filename);   // Pins under the stripe lock
+bool file_table_insert(FileTable* table, FileEntry* file);   // false if the name exists
+FileEntry* file_table_remove(FileTable* table, const char* filename);
+bool file_table_rename(FileTable* table, FileEntry* file, const char* new_filename,
+                       const char* new_filepath);           // false if new name exists
+void file_table_foreach(FileTable* table, void (*callback)(FileEntry*, void*), void* ctx);
+size_t file_table_count(FileTable* table);
+
 // File operations
+void destroy_file_entry(FileEntry* file);    // Entry must already be out of the file table
 FileEntry* create_file(StorageServer* ss, const char* filename);
 ErrorCode create_folder(StorageServer* ss, const char* foldername);
-FileEntry* find_file(StorageServer* ss, const char* filename);
+FileEntry* find_file(StorageServer* ss, const char* filename);   // Loaded and pinned
+void release_file(FileEntry* file);          // Unpins; every find_file needs one
 ErrorCode delete_file(StorageServer* ss, const char* filename);
-ErrorCode read_file(StorageServer* ss, const char* filename, char* content, size_t* size);
+RenderedContent* acquire_rendered_content(StorageServer* ss, const char* filename, ErrorCode* error);
+void release_rendered_content(RenderedContent* content);
 ErrorCode write_sentence(StorageServer* ss, const char* filename, int sentence_num, 
                         int word_index, const char* new_content, int client_id);
 ErrorCode lock_sentence(StorageServer* ss, const char* filename, int sentence_num, int client_id);
 ErrorCode unlock_sentence(StorageServer* ss, const char* filename, int sentence_num, int client_id);
 ErrorCode rename_file(StorageServer* ss, const char* old_filename, const char* new_filename);
 
-// Sentence Node Operations (Linked List)
-SentenceNode* create_sentence_node(const char** word_array, int word_count, char delimiter);
-SentenceNode* create_empty_sentence_node();
+// File memory
+void file_memory_init(FileEntry* file);
+void file_memory_release(FileEntry* file);   // Frees every sentence, draft, undo entry and word
+char* file_memory_text(FileEntry* file, const char* text, size_t length);
+char** file_memory_words(FileEntry* file, int capacity);   // Zeroed word pointer array
+void file_memory_abandon_words(FileEntry* file, int capacity);   // An array is no longer referenced
+bool file_memory_needs_repack(FileEntry* file);
+size_t file_memory_repack(FileEntry* file);   // Caller holds file_lock for writing; bytes freed
+void* file_memory_alloc(FileEntry* file, SlabPool* pool);
+void file_memory_free(FileEntry* file, SlabPool* pool, void* object);
+void format_file_memory(FileEntry* file, char* buffer, size_t size);
+size_t file_resident_bytes(FileEntry* file);   // Parsed form, snapshot and READ copy
+
+// Sentence Node Operations (linked list for traversal, treap for O(log n) indexing)
+SentenceNode* create_sentence_node(FileEntry* file, char** word_array, int word_count, char delimiter);
+SentenceNode* create_empty_sentence_node(FileEntry* file);
 void append_sentence(FileEntry* file, SentenceNode* node);
+void insert_sentence_after(FileEntry* file, SentenceNode* anchor, SentenceNode* node);  // Caller holds structure_lock
 void delete_sentence_node(FileEntry* file, SentenceNode* node);
 SentenceNode* get_sentence_by_index(FileEntry* file, int index);
-void free_sentence_node(SentenceNode* node);
-void free_all_sentences(FileEntry* file);
+int get_sentence_index(FileEntry* file, SentenceNode* node);  // -1 if not in this file
+void free_sentence_node(FileEntry* file, SentenceNode* node);
+void set_sentence_words(FileEntry* file, SentenceNode* node, char** words, int word_capacity,
+                        int word_count, char delimiter);   // Rewrites a linked sentence
+void free_all_sentences(FileEntry* file);    // Also drops undo history and the file's memory
 
-// Sentence parsing
+// Sentence parsing. tokenize_sentences splits text in place (text[length]
+// must be NUL) and hands each sentence's words to the sink; the word
+// pointers point into text. A sink returning false stops the scan.
+typedef bool (*SentenceSink)(char** words, int word_count, char delimiter, void* ctx);
+bool tokenize_sentences(char* text, size_t length, SentenceSink sink, void* ctx);
 void parse_sentences(FileEntry* file, const char* content);
 void rebuild_file_content(FileEntry* file, char* content);
-void refresh_file_stats(FileEntry* file);
+void publish_file_stats(FileEntry* file);
+void read_file_stats(FileEntry* file, size_t* size, int* words, int* chars);
 int count_words(const char* text);
 bool is_sentence_delimiter(char c);
 
@@ -166,17 +494,99 @@ ErrorCode handle_undo(StorageServer* ss, const char* filename);
 bool build_undo_path(const FileEntry* file, char* buffer, size_t size);
 ErrorCode copy_file_contents(const char* src_path, const char* dst_path);
 
-// Streaming
-ErrorCode stream_file(StorageServer* ss, int client_fd, const char* filename);
+// Snapshots (storage_server_snapshot.c). Builders run under file_lock held
+// for writing (or on a file no one else can see yet).
+FileSnapshot* snapshot_build(FileEntry* file);
+FileSnapshot* snapshot_apply_edit(const FileSnapshot* base, int index, int removed,
+                                  SentenceNode* first, int inserted);
+size_t snapshot_render(const FileSnapshot* snapshot, char* out);   // out holds length_bound
+void snapshot_release(FileSnapshot* snapshot);
+void refresh_file_snapshot(FileEntry* file);   // Rebuilds from the sentences and publishes
+
+// Streaming (storage_server_stream.c). On ERR_SUCCESS the stream owns
+// client_fd until done runs on an engine thread; completed is false if the
+// client went away or the server is shutting down.
+typedef void (*StreamDone)(StorageServer* ss, void* ctx, bool completed);
+bool stream_engine_start(StorageServer* ss);
+void stream_engine_stop(StorageServer* ss);   // Ends every stream (completed = false)
+ErrorCode stream_file(StorageServer* ss, int client_fd, const char* filename, int interval_ms,
+                      StreamDone done, void* ctx);
 
 // File info
 ErrorCode get_file_info(StorageServer* ss, const char* filename, 
                        size_t* size, int* words, int* chars, time_t* last_accessed);
 
 // Persistence
-bool save_file_to_disk(FileEntry* file);
-bool load_file_from_disk(StorageServer* ss, const char* filename);
-void load_all_files(StorageServer* ss);
+bool save_file_to_disk(StorageServer* ss, FileEntry* file);   // Rewrites the text, folds in the edit log
+uint64_t save_sentence_edit(StorageServer* ss, FileEntry* file, SentenceNode* first,
+                            int removed, int inserted);        // Queues it; returns its sequence
+bool register_file_from_disk(StorageServer* ss, const char* filename);   // Parsed lazily
+bool ensure_file_loaded(StorageServer* ss, FileEntry* file);
+void load_all_files(StorageServer* ss);       // Scans, then starts the pre-warm pool
+void prewarm_stop(StorageServer* ss);
+size_t unload_file(StorageServer* ss, FileEntry* file);   // Bytes released; 0 if in use
+
+// Memory budget (storage_server_memory.c)
+bool memory_budget_start(StorageServer* ss);
+void memory_budget_stop(StorageServer* ss);
+void memory_budget_note_load(StorageServer* ss, bool reload);
+void format_memory_stats(StorageServer* ss, char* buffer, size_t size);
+
+// Sentence lock leases (storage_server_lease.c)
+typedef enum {
+    LEASE_RELEASED,                  // ETIRW
+    LEASE_EXPIRED,
+    LEASE_DISCONNECTED
+} LeaseEnd;
+
+bool lease_table_start(StorageServer* ss);
+void lease_table_stop(StorageServer* ss);    // Drops leases; the locks go with the files
+int lease_new_holder(StorageServer* ss);
+// lease_acquire and lease_release run under the sentence's lock (sentence
+// lock -> lease lock); the returned serial is stamped on the sentence
+uint64_t lease_acquire(StorageServer* ss, int holder_id, const char* filename, uint64_t covered);
+void lease_renew(StorageServer* ss, int holder_id, const char* filename);
+void lease_release(StorageServer* ss, int holder_id, const char* filename, uint64_t serial);
+void lease_release_holder(StorageServer* ss, int holder_id, LeaseEnd reason);
+void lease_rename_file(StorageServer* ss, const char* old_filename, const char* new_filename);
+void format_lock_stats(StorageServer* ss, char* buffer, size_t size);
+
+// Edit log: sentence-level changes appended per commit, replayed at load
+// and compacted into the text file in the background
+void edit_log_init(FileEntry* file, const char* content, size_t length);
+char* edit_log_format_edit(FileEntry* file, SentenceNode* first, int removed, int inserted,
+                           size_t* length);
+int edit_log_write(StorageServer* ss, FileEntry* file, const char* records, size_t length,
+                   int count);
+bool edit_log_format_layout(FileEntry* file, const char* content, size_t length,
+                            char** record, size_t* record_length);
+bool edit_log_reset(StorageServer* ss, FileEntry* file, const char* content, size_t length,
+                    const char* layout, size_t layout_length);
+int edit_log_replay(FileEntry* file, const char* content, size_t length);
+void edit_log_remove(const char* filename);
+void edit_log_rename(const char* old_filename, const char* new_filename);
+
+// Write-back (storage_server_writeback.c)
+void dirty_state_init(FileEntry* file);
+void dirty_state_destroy(FileEntry* file);
+bool writeback_start(StorageServer* ss);
+void writeback_stop(StorageServer* ss);      // Flushes and compacts every file
+uint64_t writeback_queue_edit(StorageServer* ss, FileEntry* file, char* record, size_t length);
+uint64_t writeback_queue_rewrite(StorageServer* ss, FileEntry* file);
+ErrorCode writeback_wait(StorageServer* ss, FileEntry* file, uint64_t seq);   // Per durability mode
+void writeback_forget(StorageServer* ss, FileEntry* file);   // Before the entry is freed
+void writeback_drop_edits(StorageServer* ss, FileEntry* file);
+
+// Durability (storage_server_durability.c)
+void durability_init(StorageServer* ss);
+bool durability_sync_batch(StorageServer* ss, const int* fds, size_t count);
+bool durability_sync_parent(StorageServer* ss, const char* path);
+bool durability_write_all(int fd, const char* data, size_t length);
+bool durability_replace(StorageServer* ss, const char* path, const char* temp_path,
+                        const char* data, size_t length);   // Temp file, fsync, rename
+void durability_note_commit(StorageServer* ss, const struct timespec* started);
+void durability_report(StorageServer* ss);
+void format_durability_stats(StorageServer* ss, char* buffer, size_t size);
 
 // Checkpoints
 ErrorCode create_checkpoint(StorageServer* ss, const char* filename, const char* tag);
@@ -185,15 +595,16 @@ ErrorCode view_checkpoint(StorageServer* ss, const char* filename, const char* t
 ErrorCode revert_to_checkpoint(StorageServer* ss, const char* filename, const char* tag);
 ErrorCode list_checkpoints(StorageServer* ss, const char* filename, char* buffer, size_t buffer_size);
 void remove_all_checkpoints(const char* filename);
-void clear_file_undo_history(FileEntry* file);
 
 // Draft management
-void free_draft_sentences(DraftSentence* head);
-ErrorCode commit_sentence_drafts(StorageServer* ss, const char* filename, int sentence_num);
+void free_draft_sentences(FileEntry* file, DraftSentence* head);
+ErrorCode commit_sentence_drafts(StorageServer* ss, const char* filename, int sentence_num,
+                                 int client_id);   // Only the lock holder commits
+int release_holder_locks(StorageServer* ss, const char* filename, int client_id,
+                         uint64_t lease_serial);   // Sentences freed
 
 // Networking
 void* handle_nm_connection(void* arg);
-void* handle_client_connection(void* arg);
 void send_response(int socket_fd, const char* message);
 
 // Logging
@@ -202,7 +613,7 @@ void log_message(StorageServer* ss, const char* level, const char* operation,
 
 // Utilities
 const char* error_to_string(ErrorCode error);
-void parse_command(const char* command, char* cmd, char* args[], int* arg_count);
 void ensure_storage_dir();
+void ensure_parent_directories(const char* path);
 
 #endif // STORAGE_SERVER_H
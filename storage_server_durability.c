@@ -0,0 +1,160 @@
+#define _GNU_SOURCE  // syncfs
+#include "storage_server.h"
+#include <fcntl.h>
+#include <libgen.h>
+
+// ==================== DURABILITY ====================
+// Whole-file saves never truncate the live file: the new text goes to a
+// temp file that is fsynced and renamed over it, so a crash leaves either
+// the old or the new version. Edit-log appends are written by the write-back
+// thread one round at a time, and each round is one group commit: every log
+// it appended to is made durable together according to the SS's
+// DurabilityMode. A batched round spanning several files is flushed with a
+// single syncfs() on the storage filesystem instead of one fdatasync() per log.
+
+static DurabilityMode durability_from_env(void) {
+    const char* value = getenv("SS_DURABILITY");
+    if (value && strcmp(value, "none") == 0) return DURABILITY_NONE;
+    if (value && strcmp(value, "strict") == 0) return DURABILITY_STRICT;
+    return DURABILITY_BATCHED;
+}
+
+static const char* durability_name(DurabilityMode mode) {
+    switch (mode) {
+        case DURABILITY_NONE: return "none";
+        case DURABILITY_STRICT: return "strict";
+        default: return "batched";
+    }
+}
+
+static bool counted_fsync(GroupCommit* group, int fd) {
+    atomic_fetch_add(&group->fsyncs, 1);
+    return fdatasync(fd) == 0;
+}
+
+void durability_init(StorageServer* ss) {
+    GroupCommit* group = &ss->durability;
+    group->mode = durability_from_env();
+    group->reported_commits = 0;
+    atomic_init(&group->commits, 0);
+    atomic_init(&group->commit_latency_us, 0);
+    atomic_init(&group->max_latency_us, 0);
+    atomic_init(&group->fsyncs, 0);
+    atomic_init(&group->batches, 0);
+    atomic_init(&group->batched_requests, 0);
+}
+
+// ==================== SYNC ====================
+
+// Makes one write-back round durable. Descriptors stay open; the caller
+// closes them.
+bool durability_sync_batch(StorageServer* ss, const int* fds, size_t count) {
+    GroupCommit* group = &ss->durability;
+    if (count == 0 || group->mode == DURABILITY_NONE) {
+        return true;
+    }
+    atomic_fetch_add(&group->batches, 1);
+    atomic_fetch_add(&group->batched_requests, count);
+
+    bool ok = true;
+    if (group->mode == DURABILITY_STRICT || count == 1) {
+        for (size_t i = 0; i < count; i++) {
+            if (!counted_fsync(group, fds[i])) {
+                ok = false;
+            }
+        }
+    } else {
+        atomic_fetch_add(&group->fsyncs, 1);
+        ok = syncfs(fds[0]) == 0;
+    }
+    return ok;
+}
+
+// Makes a new or renamed directory entry under path's parent durable
+bool durability_sync_parent(StorageServer* ss, const char* path) {
+    if (ss->durability.mode == DURABILITY_NONE) {
+        return true;
+    }
+    char copy[MAX_PATH];
+    snprintf(copy, sizeof(copy), "%s", path);
+    int fd = open(dirname(copy), O_RDONLY | O_DIRECTORY);
+    if (fd < 0) {
+        return false;
+    }
+    atomic_fetch_add(&ss->durability.fsyncs, 1);
+    bool ok = fsync(fd) == 0;
+    close(fd);
+    return ok;
+}
+
+bool durability_write_all(int fd, const char* data, size_t length) {
+    while (length > 0) {
+        ssize_t written = write(fd, data, length);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += written;
+        length -= (size_t)written;
+    }
+    return true;
+}
+
+// Whole-file rewrites run on the write-back thread and sync inline
+bool durability_replace(StorageServer* ss, const char* path, const char* temp_path,
+                        const char* data, size_t length) {
+    ensure_parent_directories(temp_path);
+    int fd = open(temp_path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0) {
+        return false;
+    }
+    bool ok = durability_write_all(fd, data, length);
+    if (ok && ss->durability.mode != DURABILITY_NONE) {
+        ok = counted_fsync(&ss->durability, fd);
+    }
+    if (close(fd) != 0) {
+        ok = false;
+    }
+    if (!ok || rename(temp_path, path) != 0) {
+        unlink(temp_path);
+        return false;
+    }
+    return durability_sync_parent(ss, path);
+}
+
+// ==================== STATISTICS ====================
+
+void durability_report(StorageServer* ss) {
+    char details[256];
+    format_durability_stats(ss, details, sizeof(details));
+    log_message(ss, "INFO", "DURABILITY", details);
+}
+
+void durability_note_commit(StorageServer* ss, const struct timespec* started) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    int64_t elapsed = (int64_t)(now.tv_sec - started->tv_sec) * 1000000 +
+                      (now.tv_nsec - started->tv_nsec) / 1000;
+    uint64_t latency = elapsed > 0 ? (uint64_t)elapsed : 0;
+
+    GroupCommit* group = &ss->durability;
+    atomic_fetch_add(&group->commits, 1);
+    atomic_fetch_add(&group->commit_latency_us, latency);
+    uint64_t max = atomic_load(&group->max_latency_us);
+    while (latency > max && !atomic_compare_exchange_weak(&group->max_latency_us, &max, latency)) {
+    }
+}
+
+void format_durability_stats(StorageServer* ss, char* buffer, size_t size) {
+    GroupCommit* group = &ss->durability;
+    uint64_t commits = atomic_load(&group->commits);
+    uint64_t batches = atomic_load(&group->batches);
+    snprintf(buffer, size,
+             "Mode=%s Commits=%llu AvgLatency=%lluus MaxLatency=%lluus Fsyncs=%llu "
+             "Batches=%llu AvgBatch=%.1f",
+             durability_name(group->mode), (unsigned long long)commits,
+             (unsigned long long)(commits ? atomic_load(&group->commit_latency_us) / commits : 0),
+             (unsigned long long)atomic_load(&group->max_latency_us),
+             (unsigned long long)atomic_load(&group->fsyncs), (unsigned long long)batches,
+             batches ? (double)atomic_load(&group->batched_requests) / (double)batches : 0.0);
+}
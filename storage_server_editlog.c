@@ -0,0 +1,554 @@
+#include "storage_server.h"
+#include <fcntl.h>
+
+// ==================== SENTENCE EDIT LOG ====================
+// A commit or undo changes a handful of adjacent sentences, so instead of
+// rewriting the whole text file it queues one record describing them, which
+// the write-back thread appends to EDIT_LOG_BASE_DIR/<filename>.log. Loading
+// a file parses its text and then replays the log; the write-back thread
+// folds the log back into the text file (save_file_to_disk) once it grows or
+// the file goes quiet.
+//
+// Each record is "<fnv32 hex> <payload length>\n<payload>\n"; replay stops
+// at the first torn or corrupt record. Words are length-prefixed, so any
+// byte may appear in them:
+//
+//   B <length> <fnv32>              Text file the log applies to (first record)
+//   E <index> <removed> <inserted> {<sentence>}
+//                                   Sentence <index> and the removed - 1
+//                                   after it become the inserted sentences
+//   L <count> {<sentence>}          Replace every sentence
+//
+//   <sentence> = <delimiter code> <word count> {<length>:<word>}
+//
+// A log whose B record does not match the text predates the last rewrite
+// and is dropped. Text whose re-parse would not reproduce the in-memory
+// sentences (e.g. an undelimited sentence in the middle) keeps an L record
+// in the log after compaction, so later indices stay valid.
+
+static uint32_t edit_checksum(const char* data, size_t length) {
+    uint32_t hash = 2166136261u;  // FNV-1a
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (unsigned char)data[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static bool build_edit_log_path(const char* filename, char* buffer, size_t size) {
+    int written = snprintf(buffer, size, "%s/%s.log", EDIT_LOG_BASE_DIR, filename);
+    return written > 0 && (size_t)written < size;
+}
+
+// Temp files for atomic rewrites live beside the logs, out of the loader's way
+static bool build_temp_path(const char* path, char* buffer, size_t size) {
+    int written = snprintf(buffer, size, "%s.tmp", path);
+    return written > 0 && (size_t)written < size;
+}
+
+// ==================== SERIALIZATION ====================
+
+static void emit_record(FILE* out, const char* payload, size_t length) {
+    fprintf(out, "%08x %zu\n", edit_checksum(payload, length), length);
+    fwrite(payload, 1, length, out);
+    fputc('\n', out);
+}
+
+// Caller holds structure_lock
+static void format_sentence(FILE* out, SentenceNode* node) {
+    pthread_mutex_lock(&node->lock);
+    fprintf(out, " %d %d", (unsigned char)node->delimiter, node->word_count);
+    for (int i = 0; i < node->word_count; i++) {
+        fprintf(out, " %zu:%s", strlen(node->words[i]), node->words[i]);
+    }
+    pthread_mutex_unlock(&node->lock);
+}
+
+// Formats "<tag and header fields>{<sentence>}" for count sentences from first
+static char* build_sentence_payload(FileEntry* file, const char* header, SentenceNode* first,
+                                    int count, size_t* length) {
+    char* payload = NULL;
+    FILE* out = open_memstream(&payload, length);
+    if (!out) {
+        return NULL;
+    }
+    fputs(header, out);
+
+    pthread_mutex_lock(&file->structure_lock);
+    int written = 0;
+    for (SentenceNode* node = first; node && written < count; node = node->next) {
+        format_sentence(out, node);
+        written++;
+    }
+    pthread_mutex_unlock(&file->structure_lock);
+
+    if (fclose(out) != 0 || written < count) {
+        free(payload);
+        return NULL;
+    }
+    return payload;
+}
+
+static void emit_base_record(FILE* out, const EditLogState* log) {
+    char payload[64];
+    int length = snprintf(payload, sizeof(payload), "B %zu %08x",
+                          log->base_length, log->base_checksum);
+    emit_record(out, payload, (size_t)length);
+}
+
+// ==================== APPEND ====================
+
+void edit_log_init(FileEntry* file, const char* content, size_t length) {
+    atomic_init(&file->edit_log.bytes, 0);
+    atomic_init(&file->edit_log.records, 0);
+    file->edit_log.base_length = length;
+    file->edit_log.base_checksum = edit_checksum(content ? content : "", length);
+}
+
+static char* frame_record(const char* payload, size_t payload_length, size_t* length) {
+    char* record = NULL;
+    FILE* out = open_memstream(&record, length);
+    if (!out) {
+        return NULL;
+    }
+    emit_record(out, payload, payload_length);
+    if (fclose(out) != 0) {
+        free(record);
+        return NULL;
+    }
+    return record;
+}
+
+// Caller holds file_lock for writing and has already applied the edit
+char* edit_log_format_edit(FileEntry* file, SentenceNode* first, int removed, int inserted,
+                           size_t* length) {
+    int index = get_sentence_index(file, first);
+    if (index < 0 || removed < 1 || inserted < 1) {
+        return NULL;
+    }
+
+    char header[64];
+    snprintf(header, sizeof(header), "E %d %d %d", index, removed, inserted);
+    size_t payload_length = 0;
+    char* payload = build_sentence_payload(file, header, first, inserted, &payload_length);
+    if (!payload) {
+        return NULL;
+    }
+    char* record = frame_record(payload, payload_length, length);
+    free(payload);
+    return record;
+}
+
+// Appends framed records, starting a new log with its base record after a
+// rewrite. Caller holds dirty.persist_lock. Returns the open descriptor for
+// the caller to sync and close, or -1.
+int edit_log_write(StorageServer* ss, FileEntry* file, const char* records, size_t length,
+                   int count) {
+    char path[MAX_PATH];
+    if (!build_edit_log_path(file->filename, path, sizeof(path))) {
+        return -1;
+    }
+
+    bool fresh = atomic_load(&file->edit_log.bytes) == 0;
+    char* base = NULL;
+    size_t base_length = 0;
+    if (fresh) {
+        FILE* out = open_memstream(&base, &base_length);
+        if (!out) {
+            return -1;
+        }
+        emit_base_record(out, &file->edit_log);
+        if (fclose(out) != 0) {
+            free(base);
+            return -1;
+        }
+        ensure_parent_directories(path);
+    }
+
+    int fd = open(path, O_WRONLY | O_CREAT | O_APPEND | (fresh ? O_TRUNC : 0), 0600);
+    bool ok = fd >= 0 &&
+              durability_write_all(fd, base, base_length) &&
+              durability_write_all(fd, records, length) &&
+              (!fresh || durability_sync_parent(ss, path));
+    free(base);
+    if (!ok) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return -1;
+    }
+
+    atomic_fetch_add(&file->edit_log.bytes, base_length + length);
+    atomic_fetch_add(&file->edit_log.records, count);
+    return fd;
+}
+
+// ==================== COMPACTION ====================
+
+typedef struct LayoutCheck {
+    SentenceNode* node;              // Next in-memory sentence to compare
+    bool matches;
+    bool last_delimited;             // Whether the last parsed sentence had a delimiter
+    int parsed;
+} LayoutCheck;
+
+static bool compare_parsed_sentence(char** words, int word_count, char delimiter, void* ctx) {
+    LayoutCheck* check = (LayoutCheck*)ctx;
+    SentenceNode* node = check->node;
+    check->parsed++;
+    check->last_delimited = delimiter != '\0';
+    if (!node || node->word_count != word_count || node->delimiter != delimiter) {
+        check->matches = false;
+        return false;
+    }
+    for (int i = 0; i < word_count; i++) {
+        if (strcmp(node->words[i], words[i]) != 0) {
+            check->matches = false;
+            return false;
+        }
+    }
+    check->node = node->next;
+    return true;
+}
+
+// True if parse_sentences(content) would rebuild exactly the current
+// sentences. Caller holds file_lock.
+static bool layout_round_trips(FileEntry* file, const char* content, size_t length) {
+    char* text = (char*)malloc(length + 1);
+    if (!text) {
+        return false;
+    }
+    memcpy(text, content, length);
+    text[length] = '\0';
+
+    pthread_mutex_lock(&file->structure_lock);
+    LayoutCheck check = { file->head, true, false, 0 };
+    tokenize_sentences(text, length, compare_parsed_sentence, &check);
+
+    // parse_sentences adds one empty sentence after a delimited tail, or to
+    // an empty file
+    if (check.matches && (check.parsed == 0 || check.last_delimited)) {
+        SentenceNode* node = check.node;
+        check.matches = node && node->word_count == 0 && node->delimiter == '\0';
+        check.node = node ? node->next : NULL;
+    }
+    bool matches = check.matches && check.node == NULL;
+    pthread_mutex_unlock(&file->structure_lock);
+
+    free(text);
+    return matches;
+}
+
+// Frames the L record a rewrite of content needs, or sets *record to NULL
+// when re-parsing content reproduces the sentences. Caller holds file_lock.
+bool edit_log_format_layout(FileEntry* file, const char* content, size_t length,
+                            char** record, size_t* record_length) {
+    *record = NULL;
+    *record_length = 0;
+    if (layout_round_trips(file, content, length)) {
+        return true;
+    }
+
+    char header[32];
+    snprintf(header, sizeof(header), "L %d", file->sentence_count);
+    size_t payload_length = 0;
+    char* payload = build_sentence_payload(file, header, file->head, file->sentence_count,
+                                           &payload_length);
+    if (!payload) {
+        return false;
+    }
+    *record = frame_record(payload, payload_length, record_length);
+    free(payload);
+    return *record != NULL;
+}
+
+// Called once the text file durably holds content; layout is the record
+// from edit_log_format_layout (NULL if none). Caller holds dirty.persist_lock.
+bool edit_log_reset(StorageServer* ss, FileEntry* file, const char* content, size_t length,
+                    const char* layout, size_t layout_length) {
+    char path[MAX_PATH];
+    if (!build_edit_log_path(file->filename, path, sizeof(path))) {
+        return false;
+    }
+
+    file->edit_log.base_length = length;
+    file->edit_log.base_checksum = edit_checksum(content, length);
+    atomic_store(&file->edit_log.records, 0);
+
+    if (!layout) {
+        unlink(path);
+        atomic_store(&file->edit_log.bytes, 0);
+        return true;
+    }
+
+    char* log = NULL;
+    size_t log_length = 0;
+    FILE* out = open_memstream(&log, &log_length);
+    bool ok = out != NULL;
+    if (out) {
+        emit_base_record(out, &file->edit_log);
+        fwrite(layout, 1, layout_length, out);
+        ok = fclose(out) == 0;
+    }
+
+    char temp_path[MAX_PATH];
+    ok = ok && build_temp_path(path, temp_path, sizeof(temp_path)) &&
+         durability_replace(ss, path, temp_path, log, log_length);
+    free(log);
+    if (!ok) {
+        unlink(path);
+    }
+    atomic_store(&file->edit_log.bytes, ok ? log_length : 0);
+    return ok;
+}
+
+// ==================== REPLAY ====================
+
+typedef struct RecordCursor {
+    const char* pos;
+    const char* end;
+} RecordCursor;
+
+static bool read_number(RecordCursor* cursor, long* value) {
+    while (cursor->pos < cursor->end && *cursor->pos == ' ') {
+        cursor->pos++;
+    }
+    long result = 0;
+    const char* start = cursor->pos;
+    while (cursor->pos < cursor->end && *cursor->pos >= '0' && *cursor->pos <= '9') {
+        result = result * 10 + (*cursor->pos - '0');
+        if (result > MAX_CONTENT_SIZE) {
+            return false;
+        }
+        cursor->pos++;
+    }
+    *value = result;
+    return cursor->pos > start;
+}
+
+static bool read_tag(RecordCursor* cursor, char tag) {
+    if (cursor->pos >= cursor->end || *cursor->pos != tag) {
+        return false;
+    }
+    cursor->pos++;
+    return true;
+}
+
+// Reads one <sentence> into arena-owned words
+static bool read_sentence(FileEntry* file, RecordCursor* cursor, char*** words,
+                          int* word_count, char* delimiter) {
+    long code;
+    long count;
+    if (!read_number(cursor, &code) || code > 255 || !read_number(cursor, &count)) {
+        return false;
+    }
+    char** array = file_memory_words(file, count > 0 ? (int)count : 4);
+    if (!array) {
+        return false;
+    }
+    for (long i = 0; i < count; i++) {
+        long length;
+        if (!read_number(cursor, &length) || !read_tag(cursor, ':') ||
+            cursor->end - cursor->pos < length) {
+            return false;
+        }
+        array[i] = file_memory_text(file, cursor->pos, (size_t)length);
+        if (!array[i]) {
+            return false;
+        }
+        cursor->pos += length;
+    }
+    *words = array;
+    *word_count = (int)count;
+    *delimiter = (char)code;
+    return true;
+}
+
+static bool replay_edit(FileEntry* file, RecordCursor* cursor) {
+    long index;
+    long removed;
+    long inserted;
+    if (!read_number(cursor, &index) || !read_number(cursor, &removed) ||
+        !read_number(cursor, &inserted) || removed < 1 || inserted < 1) {
+        return false;
+    }
+    SentenceNode* node = get_sentence_by_index(file, (int)index);
+    if (!node) {
+        return false;
+    }
+
+    // The first sentence is rewritten in place, as commit and undo do
+    char** words;
+    int word_count;
+    char delimiter;
+    if (!read_sentence(file, cursor, &words, &word_count, &delimiter)) {
+        return false;
+    }
+    set_sentence_words(file, node, words, word_count > 0 ? word_count : 4, word_count, delimiter);
+
+    for (long i = 1; i < removed; i++) {
+        if (!node->next) {
+            return false;
+        }
+        delete_sentence_node(file, node->next);
+    }
+
+    SentenceNode* anchor = node;
+    for (long i = 1; i < inserted; i++) {
+        if (!read_sentence(file, cursor, &words, &word_count, &delimiter)) {
+            return false;
+        }
+        SentenceNode* added = create_sentence_node(file, words, word_count, delimiter);
+        if (!added) {
+            return false;
+        }
+        pthread_mutex_lock(&file->structure_lock);
+        insert_sentence_after(file, anchor, added);
+        pthread_mutex_unlock(&file->structure_lock);
+        anchor = added;
+    }
+    return true;
+}
+
+static bool replay_layout(FileEntry* file, RecordCursor* cursor) {
+    long count;
+    if (!read_number(cursor, &count) || count < 1) {
+        return false;
+    }
+    free_all_sentences(file);
+    for (long i = 0; i < count; i++) {
+        char** words;
+        int word_count;
+        char delimiter;
+        if (!read_sentence(file, cursor, &words, &word_count, &delimiter)) {
+            return false;
+        }
+        SentenceNode* node = create_sentence_node(file, words, word_count, delimiter);
+        if (!node) {
+            return false;
+        }
+        append_sentence(file, node);
+    }
+    return true;
+}
+
+// Applies the file's edit log on top of the parsed text. Returns the number
+// of edits replayed, or -1 if the log was stale or damaged (whatever replayed
+// before the damage is kept and the file is marked for compaction).
+int edit_log_replay(FileEntry* file, const char* content, size_t length) {
+    edit_log_init(file, content, length);
+
+    char path[MAX_PATH];
+    if (!build_edit_log_path(file->filename, path, sizeof(path))) {
+        return 0;
+    }
+    FILE* fp = fopen(path, "r");
+    if (!fp) {
+        return 0;
+    }
+    struct stat st;
+    char* data = NULL;
+    size_t size = 0;
+    if (fstat(fileno(fp), &st) == 0 && st.st_size > 0) {
+        data = (char*)malloc((size_t)st.st_size);
+        size = data ? fread(data, 1, (size_t)st.st_size, fp) : 0;
+    }
+    fclose(fp);
+
+    int applied = 0;
+    bool damaged = false;
+    bool based = false;
+    size_t offset = 0;
+    while (offset < size) {
+        // Header: "<checksum> <length>\n"
+        char* header_end = memchr(data + offset, '\n', size - offset);
+        unsigned int checksum;
+        size_t payload_length;
+        if (!header_end || sscanf(data + offset, "%x %zu", &checksum, &payload_length) != 2 ||
+            payload_length >= size - (size_t)(header_end + 1 - data)) {
+            damaged = true;
+            break;
+        }
+        const char* payload = header_end + 1;
+        if (payload[payload_length] != '\n' ||
+            edit_checksum(payload, payload_length) != checksum) {
+            damaged = true;
+            break;
+        }
+        offset = (size_t)(payload + payload_length + 1 - data);
+
+        RecordCursor cursor = { payload + 1, payload + payload_length };
+        bool ok;
+        if (payload_length > 0 && payload[0] == 'B' && !based) {
+            // A log written against other text predates the last rewrite
+            long base_length;
+            unsigned int base_checksum;
+            ok = read_number(&cursor, &base_length) &&
+                 sscanf(cursor.pos, " %x", &base_checksum) == 1 &&
+                 (size_t)base_length == file->edit_log.base_length &&
+                 base_checksum == file->edit_log.base_checksum;
+            if (!ok) {
+                free(data);
+                unlink(path);
+                return -1;
+            }
+            based = true;
+        } else if (payload_length > 0 && payload[0] == 'E' && based) {
+            ok = replay_edit(file, &cursor);
+        } else if (payload_length > 0 && payload[0] == 'L' && based) {
+            ok = replay_layout(file, &cursor);
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            damaged = true;
+            break;
+        }
+        if (payload[0] != 'B') {
+            applied++;
+        }
+    }
+    free(data);
+
+    if (applied > 0) {
+        publish_file_stats(file);
+        refresh_file_snapshot(file);
+    }
+    // Appends are O_APPEND, so a damaged tail left in place would sit in
+    // front of every later record and hide it from the next replay. Cut it
+    // off now; should that fail, the next compaction rewrites the log.
+    if (damaged && offset > 0) {
+        int fd = open(path, O_WRONLY);
+        if (fd >= 0) {
+            if (ftruncate(fd, (off_t)offset) == 0) {
+                fdatasync(fd);
+            }
+            close(fd);
+        }
+    }
+    atomic_store(&file->edit_log.bytes, offset);
+    atomic_store(&file->edit_log.records, applied + (damaged ? 1 : 0));
+    return damaged ? -1 : applied;
+}
+
+// ==================== LIFECYCLE ====================
+
+void edit_log_remove(const char* filename) {
+    char path[MAX_PATH];
+    if (build_edit_log_path(filename, path, sizeof(path))) {
+        unlink(path);
+    }
+}
+
+void edit_log_rename(const char* old_filename, const char* new_filename) {
+    char old_path[MAX_PATH];
+    char new_path[MAX_PATH];
+    if (!build_edit_log_path(old_filename, old_path, sizeof(old_path)) ||
+        !build_edit_log_path(new_filename, new_path, sizeof(new_path))) {
+        return;
+    }
+    if (access(old_path, F_OK) == 0) {
+        ensure_parent_directories(new_path);
+        rename(old_path, new_path);
+    }
+}
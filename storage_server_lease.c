@@ -0,0 +1,454 @@
+#include "storage_server.h"
+
+// ==================== SENTENCE LOCK LEASES ====================
+// A session gets a holder ID that is never reused, so a lock cannot pass to
+// whoever gets the socket fd next. Every sentence a holder locks in a file
+// is covered by one lease for that (holder, file), counting the sentences,
+// and is stamped with the lease's serial. Writes by the holder push the
+// lease's expiry out by SS_LOCK_LEASE_SECONDS. Leases are found through a
+// hash index on (holder, file) and wait in a timer wheel of LEASE_TICK_MS
+// slots; when a lease's slot comes round the timer either moves it to its
+// new expiry or, if it went unused, unlocks the sentences still stamped
+// with its serial. A lock the holder takes after the lease was unlinked
+// gets a new lease and serial, so it survives the unlock. Closing a session
+// does the same for every lease it holds. Hold times go into a histogram
+// that is logged with the lock counters.
+
+typedef struct SentenceLease {
+    uint64_t serial;                 // Stamped on the sentences it covers
+    int holder_id;
+    char filename[MAX_FILENAME];
+    int sentences;                   // Locked under this lease
+    int64_t acquired_ms;
+    int64_t expires_ms;
+    uint64_t due_tick;               // Wheel tick the lease waits for
+    struct SentenceLease* next;      // Wheel slot linkage
+    struct SentenceLease** pprev;
+    uint32_t key_hash;               // Hash of (holder_id, filename)
+    struct SentenceLease* index_next;    // Index bucket linkage
+    struct SentenceLease** index_pprev;
+} SentenceLease;
+
+static int64_t monotonic_ms(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+static int64_t lease_from_env(void) {
+    const char* value = getenv("SS_LOCK_LEASE_SECONDS");
+    long long seconds = value ? atoll(value) : 0;
+    return (seconds > 0 ? seconds : LOCK_LEASE_SECONDS) * 1000LL;
+}
+
+// ==================== WHEEL ====================
+
+// Caller holds leases->lock
+static void schedule_lease(LeaseTable* leases, SentenceLease* lease) {
+    int64_t offset = lease->expires_ms - leases->start_ms;
+    uint64_t tick = offset > 0 ? (uint64_t)((offset + LEASE_TICK_MS - 1) / LEASE_TICK_MS) : 0;
+    if (tick <= leases->tick) {
+        tick = leases->tick + 1;
+    }
+    lease->due_tick = tick;
+    SentenceLease** slot = &leases->wheel[tick % LEASE_WHEEL_SLOTS];
+    lease->next = *slot;
+    lease->pprev = slot;
+    if (*slot) {
+        (*slot)->pprev = &lease->next;
+    }
+    *slot = lease;
+}
+
+// Caller holds leases->lock
+static void unlink_lease(SentenceLease* lease) {
+    *lease->pprev = lease->next;
+    if (lease->next) {
+        lease->next->pprev = lease->pprev;
+    }
+}
+
+// ==================== INDEX ====================
+
+static uint32_t lease_key_hash(int holder_id, const char* filename) {
+    uint32_t hash = 2166136261u ^ (uint32_t)holder_id * 2654435761u;  // FNV-1a
+    for (const unsigned char* p = (const unsigned char*)filename; *p; p++) {
+        hash ^= *p;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// Caller holds leases->lock
+static void index_lease(LeaseTable* leases, SentenceLease* lease) {
+    lease->key_hash = lease_key_hash(lease->holder_id, lease->filename);
+    SentenceLease** bucket = &leases->index[lease->key_hash & (LEASE_INDEX_BUCKETS - 1)];
+    lease->index_next = *bucket;
+    lease->index_pprev = bucket;
+    if (*bucket) {
+        (*bucket)->index_pprev = &lease->index_next;
+    }
+    *bucket = lease;
+}
+
+// Caller holds leases->lock
+static void unindex_lease(SentenceLease* lease) {
+    *lease->index_pprev = lease->index_next;
+    if (lease->index_next) {
+        lease->index_next->index_pprev = lease->index_pprev;
+    }
+}
+
+// Caller holds leases->lock
+static SentenceLease* find_lease(LeaseTable* leases, int holder_id, const char* filename) {
+    uint32_t hash = lease_key_hash(holder_id, filename);
+    SentenceLease* lease = leases->index[hash & (LEASE_INDEX_BUCKETS - 1)];
+    for (; lease; lease = lease->index_next) {
+        if (lease->key_hash == hash && lease->holder_id == holder_id &&
+            strcmp(lease->filename, filename) == 0) {
+            return lease;
+        }
+    }
+    return NULL;
+}
+
+// Caller holds leases->lock. The lease leaves both the wheel and the index.
+static void remove_lease(LeaseTable* leases, SentenceLease* lease) {
+    unlink_lease(lease);
+    unindex_lease(lease);
+    leases->active--;
+}
+
+// ==================== ENDING LEASES ====================
+
+static void record_hold(LeaseTable* leases, int64_t hold_ms, LeaseEnd reason) {
+    uint64_t held = hold_ms > 0 ? (uint64_t)hold_ms : 0;
+    int bucket = 0;
+    while (bucket < LOCK_HOLD_BUCKETS - 1 && held >= (2ULL << bucket)) {
+        bucket++;
+    }
+    atomic_fetch_add(&leases->hold_histogram[bucket], 1);
+    switch (reason) {
+        case LEASE_EXPIRED: atomic_fetch_add(&leases->expired, 1); break;
+        case LEASE_DISCONNECTED: atomic_fetch_add(&leases->disconnected, 1); break;
+        default: atomic_fetch_add(&leases->released, 1); break;
+    }
+    uint64_t max = atomic_load(&leases->max_hold_ms);
+    while (held > max && !atomic_compare_exchange_weak(&leases->max_hold_ms, &max, held)) {
+    }
+}
+
+// Unlocks what the leases covered and frees them; no lease lock held
+static void end_leases(StorageServer* ss, SentenceLease* list, LeaseEnd reason) {
+    int64_t now = monotonic_ms();
+    while (list) {
+        SentenceLease* lease = list;
+        list = lease->next;
+        int unlocked = release_holder_locks(ss, lease->filename, lease->holder_id, lease->serial);
+        int64_t held = now - lease->acquired_ms;
+        record_hold(&ss->leases, held, reason);
+
+        char details[MAX_FILENAME + 96];
+        snprintf(details, sizeof(details), "File=%s Holder=%d Sentences=%d Held=%lldms",
+                 lease->filename, lease->holder_id, unlocked, (long long)held);
+        log_message(ss, "WARN", reason == LEASE_EXPIRED ? "LOCK_EXPIRED" : "LOCK_DISCONNECT",
+                    details);
+        free(lease);
+    }
+}
+
+// ==================== TIMER ====================
+
+// Caller holds leases->lock. Leases that were renewed move to their new
+// expiry; the rest are appended to *expired.
+static void expire_slot(LeaseTable* leases, uint64_t tick, int64_t now, SentenceLease** expired) {
+    SentenceLease* lease = leases->wheel[tick % LEASE_WHEEL_SLOTS];
+    while (lease) {
+        SentenceLease* next = lease->next;
+        if (lease->due_tick <= tick) {
+            if (lease->expires_ms > now) {
+                unlink_lease(lease);
+                schedule_lease(leases, lease);
+            } else {
+                remove_lease(leases, lease);
+                lease->next = *expired;
+                *expired = lease;
+            }
+        }
+        lease = next;
+    }
+}
+
+static void lock_report(StorageServer* ss) {
+    char details[256];
+    format_lock_stats(ss, details, sizeof(details));
+    log_message(ss, "INFO", "LOCKS", details);
+}
+
+static uint64_t leases_ended(LeaseTable* leases) {
+    return atomic_load(&leases->released) + atomic_load(&leases->expired) +
+           atomic_load(&leases->disconnected);
+}
+
+static void* lease_timer_main(void* arg) {
+    StorageServer* ss = (StorageServer*)arg;
+    LeaseTable* leases = &ss->leases;
+    time_t last_report = time(NULL);
+    uint64_t reported = 0;
+
+    pthread_mutex_lock(&leases->lock);
+    while (leases->running) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += LEASE_TICK_MS / 1000;
+        deadline.tv_nsec += (LEASE_TICK_MS % 1000) * 1000000L;
+        deadline.tv_sec += deadline.tv_nsec / 1000000000L;
+        deadline.tv_nsec %= 1000000000L;
+        pthread_cond_timedwait(&leases->wake_cond, &leases->lock, &deadline);
+        if (!leases->running) {
+            break;
+        }
+
+        // Catch up on every tick that has passed, one slot each
+        int64_t now = monotonic_ms();
+        uint64_t now_tick = (uint64_t)((now - leases->start_ms) / LEASE_TICK_MS);
+        SentenceLease* expired = NULL;
+        while (leases->tick < now_tick) {
+            leases->tick++;
+            expire_slot(leases, leases->tick, now, &expired);
+        }
+        pthread_mutex_unlock(&leases->lock);
+
+        end_leases(ss, expired, LEASE_EXPIRED);
+
+        time_t wall = time(NULL);
+        uint64_t ended = leases_ended(leases);
+        if (wall - last_report >= LOCK_REPORT_SECONDS && ended != reported) {
+            reported = ended;
+            last_report = wall;
+            lock_report(ss);
+        }
+
+        pthread_mutex_lock(&leases->lock);
+    }
+    pthread_mutex_unlock(&leases->lock);
+    return NULL;
+}
+
+// ==================== LIFECYCLE ====================
+
+bool lease_table_start(StorageServer* ss) {
+    LeaseTable* leases = &ss->leases;
+    memset(leases->wheel, 0, sizeof(leases->wheel));
+    memset(leases->index, 0, sizeof(leases->index));
+    leases->lease_ms = lease_from_env();
+    leases->tick = 0;
+    leases->start_ms = monotonic_ms();
+    leases->active = 0;
+    leases->next_serial = 0;
+    atomic_init(&leases->next_holder, 1);
+    for (int i = 0; i < LOCK_HOLD_BUCKETS; i++) {
+        atomic_init(&leases->hold_histogram[i], 0);
+    }
+    atomic_init(&leases->released, 0);
+    atomic_init(&leases->expired, 0);
+    atomic_init(&leases->disconnected, 0);
+    atomic_init(&leases->max_hold_ms, 0);
+    pthread_mutex_init(&leases->lock, NULL);
+    pthread_cond_init(&leases->wake_cond, NULL);
+
+    leases->running = true;
+    if (pthread_create(&leases->timer, NULL, lease_timer_main, ss) != 0) {
+        leases->running = false;
+        pthread_cond_destroy(&leases->wake_cond);
+        pthread_mutex_destroy(&leases->lock);
+        return false;
+    }
+    return true;
+}
+
+void lease_table_stop(StorageServer* ss) {
+    LeaseTable* leases = &ss->leases;
+    pthread_mutex_lock(&leases->lock);
+    leases->running = false;
+    pthread_cond_signal(&leases->wake_cond);
+    pthread_mutex_unlock(&leases->lock);
+    pthread_join(leases->timer, NULL);
+
+    for (int slot = 0; slot < LEASE_WHEEL_SLOTS; slot++) {
+        SentenceLease* lease = leases->wheel[slot];
+        while (lease) {
+            SentenceLease* next = lease->next;
+            free(lease);
+            lease = next;
+        }
+        leases->wheel[slot] = NULL;
+    }
+    memset(leases->index, 0, sizeof(leases->index));
+    lock_report(ss);
+
+    pthread_cond_destroy(&leases->wake_cond);
+    pthread_mutex_destroy(&leases->lock);
+}
+
+// ==================== HOLDERS ====================
+
+int lease_new_holder(StorageServer* ss) {
+    return atomic_fetch_add(&ss->leases.next_holder, 1);
+}
+
+// holder_id locked a sentence, or re-locked one stamped `covered`. A
+// sentence whose lease already ended joins the live lease, or a new one.
+uint64_t lease_acquire(StorageServer* ss, int holder_id, const char* filename, uint64_t covered) {
+    LeaseTable* leases = &ss->leases;
+    int64_t now = monotonic_ms();
+    pthread_mutex_lock(&leases->lock);
+    SentenceLease* lease = find_lease(leases, holder_id, filename);
+    if (lease) {
+        if (lease->serial != covered) {
+            lease->sentences++;
+        }
+        lease->expires_ms = now + leases->lease_ms;
+        uint64_t serial = lease->serial;
+        pthread_mutex_unlock(&leases->lock);
+        return serial;
+    }
+
+    lease = (SentenceLease*)calloc(1, sizeof(SentenceLease));
+    if (!lease) {
+        // The lock stays until ETIRW; it just cannot expire
+        pthread_mutex_unlock(&leases->lock);
+        return 0;
+    }
+    lease->serial = ++leases->next_serial;
+    lease->holder_id = holder_id;
+    snprintf(lease->filename, sizeof(lease->filename), "%s", filename);
+    lease->sentences = 1;
+    lease->acquired_ms = now;
+    lease->expires_ms = now + leases->lease_ms;
+    schedule_lease(leases, lease);
+    index_lease(leases, lease);
+    leases->active++;
+    uint64_t serial = lease->serial;
+    pthread_mutex_unlock(&leases->lock);
+    return serial;
+}
+
+void lease_renew(StorageServer* ss, int holder_id, const char* filename) {
+    LeaseTable* leases = &ss->leases;
+    int64_t now = monotonic_ms();
+    pthread_mutex_lock(&leases->lock);
+    SentenceLease* lease = find_lease(leases, holder_id, filename);
+    if (lease) {
+        // The timer moves it when its current slot comes round
+        lease->expires_ms = now + leases->lease_ms;
+    }
+    pthread_mutex_unlock(&leases->lock);
+}
+
+// A sentence stamped with serial was unlocked by its holder; a stamp from
+// a lease that already ended does not count against the live one
+void lease_release(StorageServer* ss, int holder_id, const char* filename, uint64_t serial) {
+    LeaseTable* leases = &ss->leases;
+    pthread_mutex_lock(&leases->lock);
+    SentenceLease* lease = find_lease(leases, holder_id, filename);
+    if (!lease || lease->serial != serial || --lease->sentences > 0) {
+        pthread_mutex_unlock(&leases->lock);
+        return;
+    }
+    remove_lease(leases, lease);
+    pthread_mutex_unlock(&leases->lock);
+
+    record_hold(leases, monotonic_ms() - lease->acquired_ms, LEASE_RELEASED);
+    free(lease);
+}
+
+// The holder's session closed: unlock everything it still holds
+void lease_release_holder(StorageServer* ss, int holder_id, LeaseEnd reason) {
+    LeaseTable* leases = &ss->leases;
+    SentenceLease* ended = NULL;
+    pthread_mutex_lock(&leases->lock);
+    for (int bucket = 0; bucket < LEASE_INDEX_BUCKETS; bucket++) {
+        SentenceLease* lease = leases->index[bucket];
+        while (lease) {
+            SentenceLease* next = lease->index_next;
+            if (lease->holder_id == holder_id) {
+                remove_lease(leases, lease);
+                lease->next = ended;
+                ended = lease;
+            }
+            lease = next;
+        }
+    }
+    pthread_mutex_unlock(&leases->lock);
+
+    end_leases(ss, ended, reason);
+}
+
+void lease_rename_file(StorageServer* ss, const char* old_filename, const char* new_filename) {
+    LeaseTable* leases = &ss->leases;
+    SentenceLease* renamed = NULL;
+    pthread_mutex_lock(&leases->lock);
+    for (int bucket = 0; bucket < LEASE_INDEX_BUCKETS; bucket++) {
+        SentenceLease* lease = leases->index[bucket];
+        while (lease) {
+            SentenceLease* next = lease->index_next;
+            if (strcmp(lease->filename, old_filename) == 0) {
+                unindex_lease(lease);
+                lease->index_next = renamed;
+                renamed = lease;
+            }
+            lease = next;
+        }
+    }
+    // Re-hashed only after the scan so no lease is visited twice
+    while (renamed) {
+        SentenceLease* lease = renamed;
+        renamed = lease->index_next;
+        snprintf(lease->filename, sizeof(lease->filename), "%s", new_filename);
+        index_lease(leases, lease);
+    }
+    pthread_mutex_unlock(&leases->lock);
+}
+
+// ==================== STATISTICS ====================
+
+// Upper bound of the bucket holding the given fraction of hold times
+static uint64_t hold_percentile(const uint64_t* counts, uint64_t total, double fraction) {
+    uint64_t target = (uint64_t)((double)total * fraction);
+    uint64_t seen = 0;
+    for (int i = 0; i < LOCK_HOLD_BUCKETS; i++) {
+        seen += counts[i];
+        if (seen > target) {
+            return 2ULL << i;
+        }
+    }
+    return 2ULL << (LOCK_HOLD_BUCKETS - 1);
+}
+
+void format_lock_stats(StorageServer* ss, char* buffer, size_t size) {
+    LeaseTable* leases = &ss->leases;
+    uint64_t counts[LOCK_HOLD_BUCKETS];
+    uint64_t total = 0;
+    for (int i = 0; i < LOCK_HOLD_BUCKETS; i++) {
+        counts[i] = atomic_load(&leases->hold_histogram[i]);
+        total += counts[i];
+    }
+    pthread_mutex_lock(&leases->lock);
+    int active = leases->active;
+    pthread_mutex_unlock(&leases->lock);
+
+    int offset = snprintf(buffer, size,
+                          "Active=%d Released=%llu Expired=%llu Disconnected=%llu MaxHold=%llums",
+                          active, (unsigned long long)atomic_load(&leases->released),
+                          (unsigned long long)atomic_load(&leases->expired),
+                          (unsigned long long)atomic_load(&leases->disconnected),
+                          (unsigned long long)atomic_load(&leases->max_hold_ms));
+    if (total > 0 && offset > 0 && (size_t)offset < size) {
+        snprintf(buffer + offset, size - (size_t)offset,
+                 " HoldP50<%llums HoldP90<%llums HoldP99<%llums",
+                 (unsigned long long)hold_percentile(counts, total, 0.50),
+                 (unsigned long long)hold_percentile(counts, total, 0.90),
+                 (unsigned long long)hold_percentile(counts, total, 0.99));
+    }
+}
@@ -1,9 +1,25 @@
 #include "storage_server.h"
+#include <fcntl.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
 
 // ==================== NETWORKING ====================
 
 void send_response(int socket_fd, const char* message) {
-    send(socket_fd, message, strlen(message), 0);
+    wire_send_text(socket_fd, WIRE_OP_REPLY, 0, message);
+}
+
+typedef struct RegistrationList {
+    FILE* out;
+    int count;
+    char* names;                     // " name1 name2 ..." once out is closed
+    size_t length;
+} RegistrationList;
+
+static void append_registered_file(FileEntry* file, void* ctx) {
+    RegistrationList* list = (RegistrationList*)ctx;
+    fprintf(list->out, " %s", file->filename);
+    list->count++;
 }
 
 bool register_with_nm(StorageServer* ss) {
@@ -33,35 +49,51 @@ bool register_with_nm(StorageServer* ss) {
         return false;
     }
     
-    // Build registration message
-    char reg_msg[BUFFER_SIZE * 4];
-    int offset = snprintf(reg_msg, sizeof(reg_msg), "REGISTER_SS %d %d %d", 
-                         ss->nm_port, ss->client_port, ss->file_count);
-    
-    // Add file list
-    for (int i = 0; i < ss->file_count && offset < (int)sizeof(reg_msg) - 256; i++) {
-        offset += snprintf(reg_msg + offset, sizeof(reg_msg) - offset, 
-                          " %s", ss->files[i]->filename);
+    // Replies from the NM command workers are small frames sent back to
+    // back; without this, Nagle holds each one until the previous is acked
+    int nodelay = 1;
+    setsockopt(ss->nm_socket_fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+
+    // Build registration message (sized for the full file list; frames carry any length)
+    RegistrationList list = {NULL, 0, NULL, 0};
+    list.out = open_memstream(&list.names, &list.length);
+    if (!list.out) {
+        close(ss->nm_socket_fd);
+        return false;
     }
+    file_table_foreach(&ss->files, append_registered_file, &list);
+    fclose(list.out);
     
-    strcat(reg_msg, "\n");
+    size_t reg_size = 64 + list.length;
+    char* reg_msg = (char*)malloc(reg_size);
+    if (!reg_msg) {
+        free(list.names);
+        close(ss->nm_socket_fd);
+        return false;
+    }
+    size_t offset = (size_t)snprintf(reg_msg, reg_size, "REGISTER_SS %d %d %d%s", 
+                                     ss->nm_port, ss->client_port, list.count, list.names);
+    free(list.names);
     
     // Send registration
-    if (send(ss->nm_socket_fd, reg_msg, strlen(reg_msg), 0) < 0) {
+    bool sent = wire_send(ss->nm_socket_fd, WIRE_OP_REQUEST, 0, reg_msg, offset);
+    free(reg_msg);
+    if (!sent) {
         perror("Failed to send registration");
         close(ss->nm_socket_fd);
         return false;
     }
     
     // Receive response
-    char response[BUFFER_SIZE];
-    int bytes = recv(ss->nm_socket_fd, response, BUFFER_SIZE - 1, 0);
-    if (bytes <= 0) {
+    WireMessage reply;
+    if (wire_recv(ss->nm_socket_fd, &reply) <= 0) {
         perror("Failed to receive registration response");
         close(ss->nm_socket_fd);
         return false;
     }
-    response[bytes] = '\0';
+    char response[BUFFER_SIZE];
+    snprintf(response, sizeof(response), "%s", reply.payload);
+    wire_message_free(&reply);
     
     // Parse response
     int error_code;
@@ -84,327 +116,1006 @@ bool register_with_nm(StorageServer* ss) {
     return false;
 }
 
+static int env_count(const char* name, int fallback) {
+    const char* value = getenv(name);
+    int parsed = value ? atoi(value) : 0;
+    return parsed > 0 ? parsed : fallback;
+}
+
 // ==================== NM CONNECTION HANDLER ====================
+// The NM multiplexes framed requests tagged with request IDs. Requests are
+// queued by the file they name and run on a fixed pool of workers: those for
+// one file run one at a time in arrival order, while other files proceed on
+// the remaining workers, so a slow checkpoint does not hold up an INFO for
+// another file. RENAME names two files and is queued on both, running once
+// it heads each queue. Each reply frame carries the request's ID.
 
-void* handle_nm_connection(void* arg) {
-    StorageServer* ss = (StorageServer*)arg;
-    char buffer[BUFFER_SIZE];
-    
-    while (ss->is_running) {
-        int bytes = recv(ss->nm_socket_fd, buffer, BUFFER_SIZE - 1, 0);
-        if (bytes <= 0) {
-            if (ss->is_running) {
-                printf("Name Server disconnected\n");
-                log_message(ss, "WARN", "NM_DISCONNECT", "Connection lost");
-            }
-            break;
+typedef struct NmReply {
+    char* data;
+    size_t len;
+    size_t cap;
+} NmReply;
+
+typedef struct NmRequest {
+    unsigned int request_id;
+    char* command;
+    struct NmFileQueue* queues[2];   // Queues it is on; [1] only for RENAME
+    struct NmRequest* next[2];       // Successor in queues[i]
+    int waiting;                     // Queues it has yet to reach the head of
+} NmRequest;
+
+// Pending requests for one file; exists while any are queued or running
+typedef struct NmFileQueue {
+    char key[MAX_FILENAME];
+    NmRequest* head;
+    NmRequest* tail;
+    struct NmFileQueue* next_ready;
+    struct NmFileQueue* hash_next;
+} NmFileQueue;
+
+#define NM_QUEUE_BUCKETS 64
+
+typedef struct NmCommandPool {
+    StorageServer* ss;
+    pthread_t* workers;
+    int worker_count;
+    NmFileQueue* buckets[NM_QUEUE_BUCKETS];
+    NmFileQueue* ready_head;         // Files with a request no worker has taken
+    NmFileQueue* ready_tail;
+    pthread_mutex_t lock;
+    pthread_cond_t ready_cond;
+    bool stopping;
+} NmCommandPool;
+
+static NmCommandPool g_nm_pool;
+
+static void reply_append_bytes(NmReply* reply, const char* bytes, size_t add) {
+    if (reply->len + add + 1 > reply->cap) {
+        size_t new_cap = reply->cap ? reply->cap : BUFFER_SIZE;
+        while (new_cap < reply->len + add + 1) {
+            new_cap *= 2;
         }
-        
-        buffer[bytes] = '\0';
-        
-        char cmd[64];
-        char* args[10];
-        int arg_count;
-        parse_command(buffer, cmd, args, &arg_count);
-        
+        char* grown = (char*)realloc(reply->data, new_cap);
+        if (!grown) {
+            return;
+        }
+        reply->data = grown;
+        reply->cap = new_cap;
+    }
+    memcpy(reply->data + reply->len, bytes, add);
+    reply->len += add;
+    reply->data[reply->len] = '\0';
+}
+
+static void reply_append(NmReply* reply, const char* text) {
+    reply_append_bytes(reply, text, strlen(text));
+}
+
+static void send_nm_reply(StorageServer* ss, unsigned int request_id, const NmReply* reply) {
+    // Frames of one reply must not interleave with another thread's reply
+    pthread_mutex_lock(&ss->nm_send_lock);
+    wire_send(ss->nm_socket_fd, WIRE_OP_REPLY, request_id, reply->data, reply->len);
+    pthread_mutex_unlock(&ss->nm_send_lock);
+}
+
+// Each NM command handler appends its whole reply; args are checked against
+// min_args before the call.
+typedef void (*NmCommandHandler)(StorageServer* ss, char* args[], NmReply* reply);
+
+typedef struct NmCommand {
+    const char* name;                // Table key, must stay first
+    int min_args;
+    NmCommandHandler handler;
+} NmCommand;
+
+static void reply_status(NmReply* reply, ErrorCode err) {
+    char response[256];
+    if (err == ERR_SUCCESS) {
+        strcpy(response, "SUCCESS\n");
+    } else {
+        snprintf(response, sizeof(response), "ERROR:%s\n", error_to_string(err));
+    }
+    reply_append(reply, response);
+}
+
+// Checkpoint commands report errors as "ERROR:<code>:<text>"
+static void reply_checkpoint_error(NmReply* reply, ErrorCode err) {
+    char response[256];
+    snprintf(response, sizeof(response), "ERROR:%d:%s\n", err, error_to_string(err));
+    reply_append(reply, response);
+}
+
+static void nm_create(StorageServer* ss, char* args[], NmReply* reply) {
+    FileEntry* file = create_file(ss, args[0]);
+    reply_append(reply, file ? "SUCCESS\n" : "ERROR:File already exists\n");
+}
+
+static void nm_create_folder(StorageServer* ss, char* args[], NmReply* reply) {
+    ErrorCode err = create_folder(ss, args[0]);
+    if (err == ERR_FILE_EXISTS) {
+        reply_append(reply, "ERROR:Folder already exists\n");
+    } else {
+        reply_status(reply, err);
+    }
+}
+
+static void nm_delete(StorageServer* ss, char* args[], NmReply* reply) {
+    reply_status(reply, delete_file(ss, args[0]));
+}
+
+static void nm_info(StorageServer* ss, char* args[], NmReply* reply) {
+    size_t size;
+    int words, chars;
+    time_t last_accessed;
+    ErrorCode err = get_file_info(ss, args[0], &size, &words, &chars, &last_accessed);
+    if (err == ERR_SUCCESS) {
         char response[BUFFER_SIZE];
-        
-        if (strcmp(cmd, "CREATE") == 0 && arg_count >= 1) {
-            FileEntry* file = create_file(ss, args[0]);
-            if (file) {
-                strcpy(response, "SUCCESS\n");
-            } else {
-                strcpy(response, "ERROR:File already exists\n");
-            }
-            send_response(ss->nm_socket_fd, response);
-        }
-        else if (strcmp(cmd, "CREATE_FOLDER") == 0 && arg_count >= 1) {
-            ErrorCode err = create_folder(ss, args[0]);
-            if (err == ERR_SUCCESS) {
-                strcpy(response, "SUCCESS\n");
-            } else if (err == ERR_FILE_EXISTS) {
-                strcpy(response, "ERROR:Folder already exists\n");
-            } else {
-                snprintf(response, sizeof(response), "ERROR:%s\n", error_to_string(err));
-            }
-            send_response(ss->nm_socket_fd, response);
+        snprintf(response, sizeof(response), "SIZE:%zu WORDS:%d CHARS:%d LAST_ACCESS:%ld\n",
+                size, words, chars, (long)last_accessed);
+        reply_append(reply, response);
+    } else {
+        reply_status(reply, err);
+    }
+}
+
+static void nm_read(StorageServer* ss, char* args[], NmReply* reply) {
+    ErrorCode err;
+    RenderedContent* content = acquire_rendered_content(ss, args[0], &err);
+    if (content) {
+        reply_append_bytes(reply, content->data, strnlen(content->data, content->length));
+        reply_append(reply, "\n");
+        release_rendered_content(content);
+    } else {
+        reply_status(reply, err);
+    }
+}
+
+static void nm_undo(StorageServer* ss, char* args[], NmReply* reply) {
+    reply_status(reply, handle_undo(ss, args[0]));
+}
+
+static void nm_checkpoint(StorageServer* ss, char* args[], NmReply* reply) {
+    ErrorCode err = create_checkpoint(ss, args[0], args[1]);
+    if (err == ERR_SUCCESS) {
+        char response[BUFFER_SIZE];
+        snprintf(response, sizeof(response), "SUCCESS:Checkpoint '%s' saved\n", args[1]);
+        reply_append(reply, response);
+    } else {
+        reply_checkpoint_error(reply, err);
+    }
+}
+
+static void nm_view_checkpoint(StorageServer* ss, char* args[], NmReply* reply) {
+    char payload[BUFFER_SIZE];
+    ErrorCode err = view_checkpoint(ss, args[0], args[1], payload, sizeof(payload));
+    if (err == ERR_SUCCESS) {
+        reply_append(reply, "SUCCESS:");
+        reply_append(reply, payload);
+    } else {
+        reply_checkpoint_error(reply, err);
+    }
+}
+
+static void nm_revert(StorageServer* ss, char* args[], NmReply* reply) {
+    ErrorCode err = revert_to_checkpoint(ss, args[0], args[1]);
+    if (err == ERR_SUCCESS) {
+        char response[BUFFER_SIZE];
+        snprintf(response, sizeof(response), "SUCCESS:File reverted to '%s'\n", args[1]);
+        reply_append(reply, response);
+    } else {
+        reply_checkpoint_error(reply, err);
+    }
+}
+
+static void nm_list_checkpoints(StorageServer* ss, char* args[], NmReply* reply) {
+    char listing[BUFFER_SIZE];
+    ErrorCode err = list_checkpoints(ss, args[0], listing, sizeof(listing));
+    if (err == ERR_SUCCESS) {
+        reply_append(reply, "SUCCESS:");
+        reply_append(reply, listing);
+    } else {
+        reply_checkpoint_error(reply, err);
+    }
+}
+
+static void nm_rename(StorageServer* ss, char* args[], NmReply* reply) {
+    reply_status(reply, rename_file(ss, args[0], args[1]));
+}
+
+static const NmCommand nm_commands[] = {
+    { "CREATE",          1, nm_create },
+    { "CREATE_FOLDER",   1, nm_create_folder },
+    { "DELETE",          1, nm_delete },
+    { "INFO",            1, nm_info },
+    { "READ",            1, nm_read },
+    { "UNDO",            1, nm_undo },
+    { "CHECKPOINT",      2, nm_checkpoint },
+    { "VIEWCHECKPOINT",  2, nm_view_checkpoint },
+    { "REVERT",          2, nm_revert },
+    { "LISTCHECKPOINTS", 1, nm_list_checkpoints },
+    { "RENAME",          2, nm_rename },
+};
+
+static CommandTable nm_command_table;
+static pthread_once_t nm_command_once = PTHREAD_ONCE_INIT;
+
+static void init_nm_command_table(void) {
+    if (!command_table_init(&nm_command_table, nm_commands, sizeof(NmCommand),
+                            (int)(sizeof(nm_commands) / sizeof(nm_commands[0])))) {
+        fprintf(stderr, "Failed to build NM command table\n");
+    }
+}
+
+static void execute_nm_command(StorageServer* ss, char* message, NmReply* reply) {
+    Command command;
+    if (!command_parse(message, &command)) {
+        reply_append(reply, "ERROR:Out of memory\n");
+        return;
+    }
+
+    pthread_once(&nm_command_once, init_nm_command_table);
+    const NmCommand* entry = (const NmCommand*)command_table_find(&nm_command_table, command.name);
+    if (entry && command.arg_count >= entry->min_args) {
+        entry->handler(ss, command.args, reply);
+    } else {
+        reply_append(reply, "ERROR:Unknown command\n");
+    }
+
+    command_free(&command);
+}
+
+// ==================== NM COMMAND POOL ====================
+
+static uint32_t hash_filename(const char* filename) {
+    uint32_t hash = 2166136261u;  // FNV-1a
+    for (const unsigned char* p = (const unsigned char*)filename; *p; p++) {
+        hash ^= *p;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// Copies the word at *cursor into key and advances past it
+static void nm_next_word(const char** cursor, char* key, size_t size) {
+    const char* start = *cursor;
+    while (*start == ' ') {
+        start++;
+    }
+    size_t length = strcspn(start, " \n");
+    *cursor = start + length;
+    if (length >= size) {
+        length = size - 1;
+    }
+    memcpy(key, start, length);
+    key[length] = '\0';
+}
+
+// The files a request is ordered by: its first argument, and for RENAME also
+// the target name. Returns the number of keys (1 or 2).
+static int nm_request_keys(const char* command, char keys[2][MAX_FILENAME]) {
+    char name[32];
+    const char* cursor = command;
+    nm_next_word(&cursor, name, sizeof(name));
+    nm_next_word(&cursor, keys[0], MAX_FILENAME);
+    if (strcmp(name, "RENAME") != 0) {
+        return 1;
+    }
+    nm_next_word(&cursor, keys[1], MAX_FILENAME);
+    return (keys[1][0] && strcmp(keys[0], keys[1]) != 0) ? 2 : 1;
+}
+
+static void ready_push(NmCommandPool* pool, NmFileQueue* queue) {
+    queue->next_ready = NULL;
+    if (pool->ready_tail) {
+        pool->ready_tail->next_ready = queue;
+    } else {
+        pool->ready_head = queue;
+    }
+    pool->ready_tail = queue;
+    pthread_cond_signal(&pool->ready_cond);
+}
+
+// The existing queue for key, or a new empty one (*created set); NULL if out
+// of memory
+static NmFileQueue* nm_queue_get(NmCommandPool* pool, const char* key, bool* created) {
+    NmFileQueue** bucket = &pool->buckets[hash_filename(key) % NM_QUEUE_BUCKETS];
+    NmFileQueue* queue = *bucket;
+    while (queue && strcmp(queue->key, key) != 0) {
+        queue = queue->hash_next;
+    }
+    *created = false;
+    if (queue) {
+        return queue;
+    }
+    queue = (NmFileQueue*)calloc(1, sizeof(NmFileQueue));
+    if (!queue) {
+        return NULL;
+    }
+    snprintf(queue->key, sizeof(queue->key), "%.*s", MAX_FILENAME - 1, key);
+    queue->hash_next = *bucket;
+    *bucket = queue;
+    *created = true;
+    return queue;
+}
+
+// Once a request has run: back on the ready list if more are queued,
+// otherwise the queue goes away
+static void nm_queue_settle(NmCommandPool* pool, NmFileQueue* queue) {
+    if (queue->head) {
+        // Behind the other files so a busy file cannot starve them
+        ready_push(pool, queue);
+        return;
+    }
+    NmFileQueue** link = &pool->buckets[hash_filename(queue->key) % NM_QUEUE_BUCKETS];
+    while (*link != queue) {
+        link = &(*link)->hash_next;
+    }
+    *link = queue->hash_next;
+    free(queue);
+}
+
+static void nm_queue_append(NmFileQueue* queue, NmRequest* request, int slot) {
+    request->queues[slot] = queue;
+    if (queue->tail) {
+        NmRequest* tail = queue->tail;
+        tail->next[tail->queues[0] == queue ? 0 : 1] = request;
+    } else {
+        queue->head = request;
+    }
+    queue->tail = request;
+}
+
+static void process_nm_request(StorageServer* ss, NmRequest* request) {
+    NmReply reply = { NULL, 0, 0 };
+
+    execute_nm_command(ss, request->command, &reply);
+    send_nm_reply(ss, request->request_id, &reply);
+
+    free(reply.data);
+    free(request->command);
+    free(request);
+}
+
+// Runs the head request of one file at a time. The file is off the ready
+// list while its request runs, which is what keeps its requests in order.
+// A RENAME at the head of one of its queues parks that queue until it also
+// heads the other, so it runs after everything earlier on either name and
+// before everything later.
+static void* nm_worker(void* arg) {
+    NmCommandPool* pool = (NmCommandPool*)arg;
+
+    pthread_mutex_lock(&pool->lock);
+    while (true) {
+        while (!pool->ready_head && !pool->stopping) {
+            pthread_cond_wait(&pool->ready_cond, &pool->lock);
         }
-        else if (strcmp(cmd, "DELETE") == 0 && arg_count >= 1) {
-            ErrorCode err = delete_file(ss, args[0]);
-            if (err == ERR_SUCCESS) {
-                strcpy(response, "SUCCESS\n");
-            } else {
-                snprintf(response, sizeof(response), "ERROR:%s\n", error_to_string(err));
-            }
-            send_response(ss->nm_socket_fd, response);
-        }
-        else if (strcmp(cmd, "INFO") == 0 && arg_count >= 1) {
-            size_t size;
-            int words, chars;
-            time_t last_accessed;
-            ErrorCode err = get_file_info(ss, args[0], &size, &words, &chars, &last_accessed);
-            if (err == ERR_SUCCESS) {
-                snprintf(response, sizeof(response), "SIZE:%zu WORDS:%d CHARS:%d LAST_ACCESS:%ld\n",
-                        size, words, chars, (long)last_accessed);
-            } else {
-                snprintf(response, sizeof(response), "ERROR:%s\n", error_to_string(err));
-            }
-            send_response(ss->nm_socket_fd, response);
-        }
-        else if (strcmp(cmd, "READ") == 0 && arg_count >= 1) {
-            char content[MAX_CONTENT_SIZE];
-            size_t size;
-            ErrorCode err = read_file(ss, args[0], content, &size);
-            if (err == ERR_SUCCESS) {
-                send_response(ss->nm_socket_fd, content);
-                send_response(ss->nm_socket_fd, "\n");
-            } else {
-                snprintf(response, sizeof(response), "ERROR:%s\n", error_to_string(err));
-                send_response(ss->nm_socket_fd, response);
-            }
+        // Queued requests still run at shutdown
+        if (!pool->ready_head) {
+            break;
         }
-        else if (strcmp(cmd, "UNDO") == 0 && arg_count >= 1) {
-            ErrorCode err = handle_undo(ss, args[0]);
-            if (err == ERR_SUCCESS) {
-                strcpy(response, "SUCCESS\n");
-            } else {
-                snprintf(response, sizeof(response), "ERROR:%s\n", error_to_string(err));
-            }
-            send_response(ss->nm_socket_fd, response);
+        NmFileQueue* queue = pool->ready_head;
+        pool->ready_head = queue->next_ready;
+        if (!pool->ready_head) {
+            pool->ready_tail = NULL;
         }
-        else if (strcmp(cmd, "CHECKPOINT") == 0 && arg_count >= 2) {
-            ErrorCode err = create_checkpoint(ss, args[0], args[1]);
-            if (err == ERR_SUCCESS) {
-                snprintf(response, sizeof(response), "SUCCESS:Checkpoint '%s' saved\n", args[1]);
-            } else {
-                snprintf(response, sizeof(response), "ERROR:%d:%s\n", err, error_to_string(err));
-            }
-            send_response(ss->nm_socket_fd, response);
-        }
-        else if (strcmp(cmd, "VIEWCHECKPOINT") == 0 && arg_count >= 2) {
-            char payload[BUFFER_SIZE];
-            ErrorCode err = view_checkpoint(ss, args[0], args[1], payload, sizeof(payload));
-            if (err == ERR_SUCCESS) {
-                strncpy(response, "SUCCESS:", sizeof(response) - 1);
-                response[sizeof(response) - 1] = '\0';
-                size_t current = strlen(response);
-                size_t remaining = sizeof(response) - current - 1;
-                size_t payload_len = strnlen(payload, sizeof(payload));
-                if (payload_len > remaining) {
-                    payload_len = remaining;
-                }
-                memcpy(response + current, payload, payload_len);
-                response[current + payload_len] = '\0';
-            } else {
-                snprintf(response, sizeof(response), "ERROR:%d:%s\n", err, error_to_string(err));
-            }
-            send_response(ss->nm_socket_fd, response);
+        NmRequest* request = queue->head;
+        if (--request->waiting > 0) {
+            continue;  // Parked; the other queue's worker runs it
         }
-        else if (strcmp(cmd, "REVERT") == 0 && arg_count >= 2) {
-            ErrorCode err = revert_to_checkpoint(ss, args[0], args[1]);
-            if (err == ERR_SUCCESS) {
-                snprintf(response, sizeof(response), "SUCCESS:File reverted to '%s'\n", args[1]);
-            } else {
-                snprintf(response, sizeof(response), "ERROR:%d:%s\n", err, error_to_string(err));
+        NmFileQueue* queues[2] = { request->queues[0], request->queues[1] };
+        for (int i = 0; i < 2 && queues[i]; i++) {
+            queues[i]->head = request->next[i];
+            if (!queues[i]->head) {
+                queues[i]->tail = NULL;
             }
-            send_response(ss->nm_socket_fd, response);
-        }
-        else if (strcmp(cmd, "LISTCHECKPOINTS") == 0 && arg_count >= 1) {
-            char listing[BUFFER_SIZE];
-            ErrorCode err = list_checkpoints(ss, args[0], listing, sizeof(listing));
-            if (err == ERR_SUCCESS) {
-                strncpy(response, "SUCCESS:", sizeof(response) - 1);
-                response[sizeof(response) - 1] = '\0';
-                size_t current = strlen(response);
-                size_t remaining = sizeof(response) - current - 1;
-                size_t listing_len = strnlen(listing, sizeof(listing));
-                if (listing_len > remaining) {
-                    listing_len = remaining;
-                }
-                memcpy(response + current, listing, listing_len);
-                response[current + listing_len] = '\0';
-            } else {
-                snprintf(response, sizeof(response), "ERROR:%d:%s\n", err, error_to_string(err));
-            }
-            send_response(ss->nm_socket_fd, response);
         }
-        else if (strcmp(cmd, "RENAME") == 0 && arg_count >= 2) {
-            ErrorCode err = rename_file(ss, args[0], args[1]);
-            if (err == ERR_SUCCESS) {
-                strcpy(response, "SUCCESS\n");
-            } else {
-                snprintf(response, sizeof(response), "ERROR:%s\n", error_to_string(err));
+        pthread_mutex_unlock(&pool->lock);
+
+        process_nm_request(pool->ss, request);
+
+        pthread_mutex_lock(&pool->lock);
+        for (int i = 0; i < 2 && queues[i]; i++) {
+            nm_queue_settle(pool, queues[i]);
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+static bool nm_pool_start(NmCommandPool* pool, StorageServer* ss) {
+    memset(pool, 0, sizeof(*pool));
+    pool->ss = ss;
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->ready_cond, NULL);
+
+    int workers = env_count("SS_NM_WORKERS", SS_NM_WORKERS);
+    pool->workers = (pthread_t*)calloc(workers, sizeof(pthread_t));
+    for (int i = 0; pool->workers && i < workers; i++) {
+        if (pthread_create(&pool->workers[i], NULL, nm_worker, pool) != 0) {
+            break;
+        }
+        pool->worker_count++;
+    }
+    if (pool->worker_count == 0) {
+        free(pool->workers);
+        pthread_cond_destroy(&pool->ready_cond);
+        pthread_mutex_destroy(&pool->lock);
+        return false;
+    }
+
+    char details[64];
+    snprintf(details, sizeof(details), "Workers=%d", pool->worker_count);
+    log_message(ss, "INFO", "NM_POOL_START", details);
+    return true;
+}
+
+static void nm_pool_stop(NmCommandPool* pool) {
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = true;
+    pthread_cond_broadcast(&pool->ready_cond);
+    pthread_mutex_unlock(&pool->lock);
+    for (int i = 0; i < pool->worker_count; i++) {
+        pthread_join(pool->workers[i], NULL);
+    }
+    free(pool->workers);
+    pthread_cond_destroy(&pool->ready_cond);
+    pthread_mutex_destroy(&pool->lock);
+}
+
+static void dispatch_nm_request(NmCommandPool* pool, WireMessage* msg) {
+    NmRequest* request = (NmRequest*)malloc(sizeof(NmRequest));
+    if (!request) {
+        return;
+    }
+    memset(request, 0, sizeof(*request));
+    request->request_id = msg->request_id;
+    request->command = msg->payload;  // Ownership moves to the request
+    msg->payload = NULL;
+
+    char keys[2][MAX_FILENAME];
+    int key_count = nm_request_keys(request->command, keys);
+
+    pthread_mutex_lock(&pool->lock);
+    NmFileQueue* queues[2] = { NULL, NULL };
+    bool created[2] = { false, false };
+    for (int i = 0; i < key_count; i++) {
+        queues[i] = nm_queue_get(pool, keys[i], &created[i]);
+        if (!queues[i]) {
+            if (i == 1 && created[0]) {
+                nm_queue_settle(pool, queues[0]);  // Still empty; drops it
             }
-            send_response(ss->nm_socket_fd, response);
+            pthread_mutex_unlock(&pool->lock);
+            process_nm_request(pool->ss, request);  // Degrade to in-line processing
+            return;
         }
-        else {
-            strcpy(response, "ERROR:Unknown command\n");
-            send_response(ss->nm_socket_fd, response);
+    }
+
+    // Existing queues are running, parked or already on the ready list and
+    // pick the request up in turn; new ones are scheduled here
+    request->waiting = key_count;
+    for (int i = 0; i < key_count; i++) {
+        nm_queue_append(queues[i], request, i);
+        if (created[i]) {
+            ready_push(pool, queues[i]);
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void* handle_nm_connection(void* arg) {
+    StorageServer* ss = (StorageServer*)arg;
+    NmCommandPool* pool = &g_nm_pool;
+    if (!nm_pool_start(pool, ss)) {
+        fprintf(stderr, "Failed to start NM command workers\n");
+        return NULL;
+    }
+    
+    while (ss->is_running) {
+        WireMessage msg;
+        if (wire_recv(ss->nm_socket_fd, &msg) <= 0) {
+            if (ss->is_running) {
+                printf("Name Server disconnected\n");
+                log_message(ss, "WARN", "NM_DISCONNECT", "Connection lost");
+            }
+            break;
         }
-        
-        // Free args
-        for (int i = 0; i < arg_count; i++) {
-            free(args[i]);
+
+        if (msg.opcode == WIRE_OP_REQUEST) {
+            dispatch_nm_request(pool, &msg);
         }
+        wire_message_free(&msg);
     }
     
+    nm_pool_stop(pool);
     return NULL;
 }
 
-// ==================== CLIENT CONNECTION HANDLER ====================
+// ==================== CLIENT REACTOR STATE ====================
 
-void* handle_client_connection(void* arg) {
-    ConnectionArgs* conn_args = (ConnectionArgs*)arg;
-    StorageServer* ss = conn_args->ss;
-    int client_fd = conn_args->socket_fd;
-    
-    char client_ip[16];
-    inet_ntop(AF_INET, &conn_args->addr.sin_addr, client_ip, sizeof(client_ip));
-    
-    free(conn_args);
-    
-    char buffer[BUFFER_SIZE];
-    int client_id = client_fd;  // Use socket FD as client ID for simplicity
-    
-    // Track current write session
-    bool in_write_mode = false;
+#define REACTOR_MAX_EVENTS 64
+
+typedef enum {
+    SESSION_KEEP,
+    SESSION_CLOSE,
+    SESSION_STREAMING   // The stream engine owns the socket until client_stream_done
+} SessionAction;
+
+// Per-connection state; a WRITE session spans several messages. While a
+// STREAM runs the session belongs to the stream engine; it stays in epoll,
+// disarmed, and goes back on the ready queue when the stream ends.
+typedef struct ClientSession {
+    StorageServer* ss;
+    int client_fd;
+    int client_id;
+    bool in_write_mode;
     char write_filename[MAX_FILENAME];
-    int write_sentence_num = -1;
+    int write_sentence_num;
+    bool stream_requested;           // Set by STREAM, started once the request is done
+    char stream_filename[MAX_FILENAME];
+    int stream_interval_ms;
+    WireReader rx;                   // Partial frames carried across reads
+    bool streaming;                  // Owned by the stream engine (reactor lock)
+    bool resume;                     // Back from a stream: decode rx before reading
+    struct ClientSession* next_ready;   // Worker queue linkage
+    struct ClientSession* prev;      // All open sessions (freed at shutdown)
+    struct ClientSession* next;
+} ClientSession;
+
+// Receive buffers are taken from the pool when a session has bytes to read
+// and given back once they are all decoded, so idle connections hold none.
+typedef struct IoBufferPool {
+    pthread_mutex_t lock;
+    void* free_list;                 // Linked through each buffer's first word
+    int idle;
+    int max_idle;
+} IoBufferPool;
+
+typedef struct ClientReactor {
+    StorageServer* ss;
+    int epoll_fd;
+    pthread_t* workers;
+    int worker_count;
+    ClientSession* ready_head;
+    ClientSession* ready_tail;
+    ClientSession* sessions;
+    pthread_mutex_t lock;
+    pthread_cond_t ready_cond;
+    bool stopping;
+    IoBufferPool buffers;
+} ClientReactor;
+
+static ClientReactor g_reactor;
+
+// ==================== I/O BUFFERS ====================
+
+static void io_buffer_pool_init(IoBufferPool* pool, int max_idle) {
+    pthread_mutex_init(&pool->lock, NULL);
+    pool->free_list = NULL;
+    pool->idle = 0;
+    pool->max_idle = max_idle;
+}
+
+static void io_buffer_pool_destroy(IoBufferPool* pool) {
+    while (pool->free_list) {
+        void* buffer = pool->free_list;
+        pool->free_list = *(void**)buffer;
+        free(buffer);
+    }
+    pthread_mutex_destroy(&pool->lock);
+}
+
+static bool session_take_buffer(IoBufferPool* pool, ClientSession* session) {
+    if (session->rx.buf) {
+        return true;
+    }
+    pthread_mutex_lock(&pool->lock);
+    void* buffer = pool->free_list;
+    if (buffer) {
+        pool->free_list = *(void**)buffer;
+        pool->idle--;
+    }
+    pthread_mutex_unlock(&pool->lock);
+    if (!buffer) {
+        buffer = malloc(SS_IO_BUFFER_SIZE);
+        if (!buffer) {
+            return false;
+        }
+    }
+    session->rx.buf = (char*)buffer;
+    session->rx.cap = SS_IO_BUFFER_SIZE;
+    session->rx.len = 0;
+    return true;
+}
+
+static void session_return_buffer(IoBufferPool* pool, ClientSession* session) {
+    void* buffer = session->rx.buf;
+    if (!buffer || session->rx.len > 0) {
+        return;
+    }
+    // A buffer the reader grew for a large message is not pooled
+    bool pooled_size = session->rx.cap == SS_IO_BUFFER_SIZE;
+    session->rx.buf = NULL;
+    session->rx.cap = 0;
+    pthread_mutex_lock(&pool->lock);
+    bool keep = pooled_size && pool->idle < pool->max_idle;
+    if (keep) {
+        *(void**)buffer = pool->free_list;
+        pool->free_list = buffer;
+        pool->idle++;
+    }
+    pthread_mutex_unlock(&pool->lock);
+    if (!keep) {
+        free(buffer);
+    }
+}
+
+// ==================== CLIENT COMMANDS ====================
+
+typedef void (*ClientCommandHandler)(StorageServer* ss, ClientSession* session,
+                                     char* args[], int arg_count);
+
+typedef struct ClientCommand {
+    const char* name;                // Table key, must stay first
+    int min_args;
+    ClientCommandHandler handler;
+} ClientCommand;
+
+static void send_error(int client_fd, ErrorCode err) {
+    char error_msg[256];
+    snprintf(error_msg, sizeof(error_msg), "ERROR:%s\n", error_to_string(err));
+    send_response(client_fd, error_msg);
+}
+
+static void client_read(StorageServer* ss, ClientSession* session, char* args[], int arg_count) {
+    (void)arg_count;
+    ErrorCode err;
+    RenderedContent* content = acquire_rendered_content(ss, args[0], &err);
+    if (content) {
+        // Sent straight from the shared rendering; no copy, no file lock held
+        wire_send(session->client_fd, WIRE_OP_REPLY, 0, content->data, content->reply_length);
+        release_rendered_content(content);
+    } else {
+        send_error(session->client_fd, err);
+    }
+}
+
+// STREAM <filename> [interval_ms]
+static void client_stream(StorageServer* ss, ClientSession* session, char* args[], int arg_count) {
+    (void)ss;
+    snprintf(session->stream_filename, sizeof(session->stream_filename), "%s", args[0]);
+    session->stream_interval_ms = arg_count > 1 ? atoi(args[1]) : STREAM_INTERVAL_MS;
+    session->stream_requested = true;
+}
+
+static void client_write(StorageServer* ss, ClientSession* session, char* args[], int arg_count) {
+    (void)arg_count;
+    // WRITE <filename> <sentence_num> - Locks the sentence for writing
+    strncpy(session->write_filename, args[0], MAX_FILENAME - 1);
+    session->write_filename[MAX_FILENAME - 1] = '\0';
+    session->write_sentence_num = atoi(args[1]);
     
-    while (ss->is_running) {
-        int bytes = recv(client_fd, buffer, BUFFER_SIZE - 1, 0);
-        if (bytes <= 0) {
+    ErrorCode err = lock_sentence(ss, session->write_filename, session->write_sentence_num,
+                                  session->client_id);
+    if (err == ERR_SUCCESS) {
+        session->in_write_mode = true;
+        send_response(session->client_fd, "LOCKED\n");
+    } else {
+        send_error(session->client_fd, err);
+    }
+}
+
+static void client_etirw(StorageServer* ss, ClientSession* session, char* args[], int arg_count) {
+    (void)args; (void)arg_count;
+    // Finalize changes and unlock
+    if (!session->in_write_mode) {
+        send_response(session->client_fd, "ERROR:Not in write mode\n");
+        return;
+    }
+
+    ErrorCode commit_err = commit_sentence_drafts(ss, session->write_filename,
+                                                  session->write_sentence_num,
+                                                  session->client_id);
+    if (commit_err != ERR_SUCCESS) {
+        send_error(session->client_fd, commit_err);
+        unlock_sentence(ss, session->write_filename, session->write_sentence_num, session->client_id);
+        session->in_write_mode = false;
+        session->write_sentence_num = -1;
+        return;
+    }
+
+    ErrorCode err = unlock_sentence(ss, session->write_filename, session->write_sentence_num,
+                                    session->client_id);
+    if (err == ERR_SUCCESS) {
+        send_response(session->client_fd, "SUCCESS\n");
+        session->in_write_mode = false;
+        session->write_sentence_num = -1;
+    } else {
+        send_error(session->client_fd, err);
+    }
+}
+
+// In write mode: <word_index> <content>
+static void client_write_words(StorageServer* ss, ClientSession* session, const Command* command) {
+    char* endptr;
+    long word_index = strtol(command->name, &endptr, 10);
+    if (*endptr != '\0' || command->arg_count < 1) {
+        send_response(session->client_fd, "ERROR:Invalid format. Use: <word_index> <content>\n");
+        return;
+    }
+
+    // Reconstruct content from all args
+    char content[BUFFER_SIZE];
+    size_t used = 0;
+    content[0] = '\0';
+    for (int i = 0; i < command->arg_count; i++) {
+        int written = snprintf(content + used, sizeof(content) - used, "%s%s",
+                               i > 0 ? " " : "", command->args[i]);
+        if (written < 0 || (size_t)written >= sizeof(content) - used) {
             break;
         }
-        
-        buffer[bytes] = '\0';
-        
-        char cmd[64];
-        char* args[10];
-        int arg_count;
-        parse_command(buffer, cmd, args, &arg_count);
-        
-        if (strcmp(cmd, "READ") == 0 && arg_count >= 1) {
-            char content[MAX_CONTENT_SIZE];
-            size_t size;
-            ErrorCode err = read_file(ss, args[0], content, &size);
-            if (err == ERR_SUCCESS) {
-                // Always send content with newline, even for empty files
-                if (size > 0) {
-                    send_response(client_fd, content);
-                    // Add newline if content doesn't end with one
-                    if (content[size - 1] != '\n') {
-                        send_response(client_fd, "\n");
-                    }
-                } else {
-                    // Empty file - send just a newline so client knows we responded
-                    send_response(client_fd, "\n");
-                }
-            } else {
-                char error_msg[256];
-                snprintf(error_msg, sizeof(error_msg), "ERROR:%s\n", error_to_string(err));
-                send_response(client_fd, error_msg);
-            }
+        used += (size_t)written;
+    }
+    
+    ErrorCode err = write_sentence(ss, session->write_filename, session->write_sentence_num, 
+                                   (int)word_index, content, session->client_id);
+    if (err == ERR_SUCCESS) {
+        send_response(session->client_fd, "SUCCESS\n");
+    } else {
+        send_error(session->client_fd, err);
+    }
+}
+
+static const ClientCommand client_commands[] = {
+    { "READ",   1, client_read },
+    { "STREAM", 1, client_stream },
+    { "WRITE",  2, client_write },
+    { "ETIRW",  0, client_etirw },
+};
+
+static CommandTable client_command_table;
+static pthread_once_t client_command_once = PTHREAD_ONCE_INIT;
+
+static void init_client_command_table(void) {
+    if (!command_table_init(&client_command_table, client_commands, sizeof(ClientCommand),
+                            (int)(sizeof(client_commands) / sizeof(client_commands[0])))) {
+        fprintf(stderr, "Failed to build client command table\n");
+    }
+}
+
+// ==================== SESSION MANAGEMENT ====================
+
+static ClientSession* session_create(ClientReactor* r, int fd) {
+    ClientSession* session = (ClientSession*)calloc(1, sizeof(ClientSession));
+    if (!session) {
+        return NULL;
+    }
+    session->ss = r->ss;
+    session->client_fd = fd;
+    session->client_id = lease_new_holder(r->ss);   // Unique; fds are reused
+    session->write_sentence_num = -1;
+    wire_reader_init(&session->rx);
+
+    pthread_mutex_lock(&r->lock);
+    session->next = r->sessions;
+    if (r->sessions) {
+        r->sessions->prev = session;
+    }
+    r->sessions = session;
+    pthread_mutex_unlock(&r->lock);
+    return session;
+}
+
+static void session_free(ClientReactor* r, ClientSession* session) {
+    pthread_mutex_lock(&r->lock);
+    if (session->prev) {
+        session->prev->next = session->next;
+    } else {
+        r->sessions = session->next;
+    }
+    if (session->next) {
+        session->next->prev = session->prev;
+    }
+    pthread_mutex_unlock(&r->lock);
+    wire_reader_destroy(&session->rx);
+    free(session);
+}
+
+static void session_close(ClientReactor* r, ClientSession* session) {
+    // A client that went away mid-WRITE must not keep its sentences locked
+    lease_release_holder(r->ss, session->client_id, LEASE_DISCONNECTED);
+    epoll_ctl(r->epoll_fd, EPOLL_CTL_DEL, session->client_fd, NULL);
+    close(session->client_fd);
+    session_free(r, session);
+}
+
+// One-shot arming guarantees a session is serviced by at most one worker at a time
+static bool session_arm(ClientReactor* r, ClientSession* session, int op) {
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT;
+    ev.data.ptr = session;
+    return epoll_ctl(r->epoll_fd, op, session->client_fd, &ev) == 0;
+}
+
+static void enqueue_session(ClientReactor* r, ClientSession* session) {
+    pthread_mutex_lock(&r->lock);
+    if (r->ready_tail) {
+        r->ready_tail->next_ready = session;
+    } else {
+        r->ready_head = session;
+    }
+    r->ready_tail = session;
+    pthread_cond_signal(&r->ready_cond);
+    pthread_mutex_unlock(&r->lock);
+}
+
+// ==================== STREAM HAND-OFF ====================
+
+// Runs on a stream worker once the stream no longer owns the socket.
+// Requests that arrived behind the STREAM may already sit in rx, so the
+// session is queued for a worker rather than re-armed. Once the reactor is
+// stopping, the session stays marked as streaming and is closed here.
+static void client_stream_done(StorageServer* ss, void* ctx, bool completed) {
+    ClientSession* session = (ClientSession*)ctx;
+    ClientReactor* r = &g_reactor;
+    pthread_mutex_lock(&r->lock);
+    bool close_now = !completed || !ss->is_running || r->stopping;
+    if (!close_now) {
+        session->streaming = false;
+        session->resume = true;
+    }
+    pthread_mutex_unlock(&r->lock);
+
+    if (close_now) {
+        session_close(r, session);
+    } else {
+        enqueue_session(r, session);
+    }
+}
+
+// Returns true if the stream engine now owns the session
+static bool begin_client_stream(ClientReactor* r, ClientSession* session) {
+    session->stream_requested = false;
+    pthread_mutex_lock(&r->lock);
+    session->streaming = true;
+    pthread_mutex_unlock(&r->lock);
+
+    ErrorCode err = stream_file(r->ss, session->client_fd, session->stream_filename,
+                                session->stream_interval_ms, client_stream_done, session);
+    if (err != ERR_SUCCESS) {
+        pthread_mutex_lock(&r->lock);
+        session->streaming = false;
+        pthread_mutex_unlock(&r->lock);
+        send_error(session->client_fd, err);
+        return false;
+    }
+    return true;
+}
+
+// ==================== WORKER POOL ====================
+
+static void dispatch_client_message(StorageServer* ss, ClientSession* session, char* message) {
+    Command command;
+    if (!command_parse(message, &command)) {
+        send_response(session->client_fd, "ERROR:Out of memory\n");
+        return;
+    }
+
+    const ClientCommand* entry =
+        (const ClientCommand*)command_table_find(&client_command_table, command.name);
+    if (entry && command.arg_count >= entry->min_args) {
+        entry->handler(ss, session, command.args, command.arg_count);
+    } else if (session->in_write_mode && command.arg_count >= 1) {
+        client_write_words(ss, session, &command);
+    } else {
+        send_response(session->client_fd, "ERROR:Unknown command\n");
+    }
+    command_free(&command);
+}
+
+// Reads what is available and runs every complete framed command
+static SessionAction service_session(ClientReactor* r, ClientSession* session) {
+    StorageServer* ss = r->ss;
+    if (session->resume) {
+        // Anything new on the socket fires once the session is re-armed
+        session->resume = false;
+    } else {
+        if (!session_take_buffer(&r->buffers, session)) {
+            return SESSION_CLOSE;
         }
-        else if (strcmp(cmd, "STREAM") == 0 && arg_count >= 1) {
-            ErrorCode err = stream_file(ss, client_fd, args[0]);
-            if (err != ERR_SUCCESS) {
-                char error_msg[256];
-                snprintf(error_msg, sizeof(error_msg), "ERROR:%s\n", error_to_string(err));
-                send_response(client_fd, error_msg);
-            }
+        ssize_t bytes = wire_reader_fill(&session->rx, session->client_fd);
+        if (bytes == 0) {
+            return SESSION_CLOSE;
         }
-        else if (strcmp(cmd, "WRITE") == 0 && arg_count >= 2) {
-            // WRITE <filename> <sentence_num> - Locks the sentence for writing
-            strncpy(write_filename, args[0], MAX_FILENAME - 1);
-            write_filename[MAX_FILENAME - 1] = '\0';
-            write_sentence_num = atoi(args[1]);
-            
-            ErrorCode err = lock_sentence(ss, write_filename, write_sentence_num, client_id);
-            
-            if (err == ERR_SUCCESS) {
-                in_write_mode = true;
-                send_response(client_fd, "LOCKED\n");
-            } else {
-                char error_msg[256];
-                snprintf(error_msg, sizeof(error_msg), "ERROR:%s\n", error_to_string(err));
-                send_response(client_fd, error_msg);
-            }
+        if (bytes < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+            return SESSION_CLOSE;
         }
-        else if (strcmp(cmd, "ETIRW") == 0) {
-            // Finalize changes and unlock
-            if (in_write_mode) {
-                ErrorCode commit_err = commit_sentence_drafts(ss, write_filename, write_sentence_num);
-                if (commit_err != ERR_SUCCESS) {
-                    char error_msg[256];
-                    snprintf(error_msg, sizeof(error_msg), "ERROR:%s\n", error_to_string(commit_err));
-                    send_response(client_fd, error_msg);
-                    unlock_sentence(ss, write_filename, write_sentence_num, client_id);
-                    in_write_mode = false;
-                    write_sentence_num = -1;
-                } else {
-                    ErrorCode err = unlock_sentence(ss, write_filename, write_sentence_num, client_id);
-                    if (err == ERR_SUCCESS) {
-                        send_response(client_fd, "SUCCESS\n");
-                        in_write_mode = false;
-                        write_sentence_num = -1;
-                    } else {
-                        char error_msg[256];
-                        snprintf(error_msg, sizeof(error_msg), "ERROR:%s\n", error_to_string(err));
-                        send_response(client_fd, error_msg);
-                    }
-                }
-            } else {
-                send_response(client_fd, "ERROR:Not in write mode\n");
-            }
+    }
+
+    WireMessage msg;
+    int status;
+    while ((status = wire_reader_next(&session->rx, &msg)) == 1) {
+        dispatch_client_message(ss, session, msg.payload);
+        wire_message_free(&msg);
+
+        // The session must not be touched once the stream has it
+        if (session->stream_requested && begin_client_stream(r, session)) {
+            return SESSION_STREAMING;
         }
-        else if (in_write_mode && arg_count >= 1) {
-            // In write mode: <word_index> <content>
-            // cmd contains word_index as a string number
-            // Check if cmd is a number (word index)
-            char* endptr;
-            long word_index = strtol(cmd, &endptr, 10);
-            
-            // If cmd is a valid number and we have content in args
-            if (*endptr == '\0' && arg_count >= 1) {
-                // Reconstruct content from all args (args[0] onwards)
-                char content[BUFFER_SIZE] = {0};
-                for (int i = 0; i < arg_count; i++) {
-                    if (i > 0) strcat(content, " ");
-                    strcat(content, args[i]);
-                }
-                
-                ErrorCode err = write_sentence(ss, write_filename, write_sentence_num, 
-                                              (int)word_index, content, client_id);
-                
-                if (err == ERR_SUCCESS) {
-                    send_response(client_fd, "SUCCESS\n");
-                } else {
-                    char error_msg[256];
-                    snprintf(error_msg, sizeof(error_msg), "ERROR:%s\n", error_to_string(err));
-                    send_response(client_fd, error_msg);
-                }
-            } else {
-                send_response(client_fd, "ERROR:Invalid format. Use: <word_index> <content>\n");
-            }
+    }
+    if (status < 0) {
+        return SESSION_CLOSE;
+    }
+    session_return_buffer(&r->buffers, session);
+    return SESSION_KEEP;
+}
+
+static void* reactor_worker(void* arg) {
+    ClientReactor* r = (ClientReactor*)arg;
+    pthread_once(&client_command_once, init_client_command_table);
+
+    while (true) {
+        pthread_mutex_lock(&r->lock);
+        while (!r->ready_head && !r->stopping) {
+            pthread_cond_wait(&r->ready_cond, &r->lock);
         }
-        else {
-            send_response(client_fd, "ERROR:Unknown command\n");
+        if (r->stopping) {
+            pthread_mutex_unlock(&r->lock);
+            break;
+        }
+        ClientSession* session = r->ready_head;
+        r->ready_head = session->next_ready;
+        if (!r->ready_head) {
+            r->ready_tail = NULL;
         }
-        
-        // Free args
-        for (int i = 0; i < arg_count; i++) {
-            free(args[i]);
+        session->next_ready = NULL;
+        pthread_mutex_unlock(&r->lock);
+
+        SessionAction action = service_session(r, session);
+        if (action == SESSION_KEEP && !session_arm(r, session, EPOLL_CTL_MOD)) {
+            action = SESSION_CLOSE;
+        }
+        if (action == SESSION_CLOSE) {
+            session_close(r, session);
         }
     }
-    
-    close(client_fd);
     return NULL;
 }
 
+static void accept_connections(ClientReactor* r) {
+    StorageServer* ss = r->ss;
+    while (ss->is_running) {
+        struct sockaddr_in client_addr;
+        socklen_t client_len = sizeof(client_addr);
+        int client_fd = accept(ss->client_socket_fd, (struct sockaddr*)&client_addr, &client_len);
+        if (client_fd < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR && ss->is_running) {
+                perror("Accept failed");
+            }
+            return;
+        }
+
+        ClientSession* session = session_create(r, client_fd);
+        if (!session) {
+            close(client_fd);
+            continue;
+        }
+        if (!session_arm(r, session, EPOLL_CTL_ADD)) {
+            perror("Failed to watch connection");
+            close(client_fd);
+            session_free(r, session);
+        }
+    }
+}
+
 // ==================== CLIENT SERVER ====================
 
 void start_client_server(StorageServer* ss) {
+    ClientReactor* r = &g_reactor;
+    memset(r, 0, sizeof(*r));
+    r->ss = ss;
+    pthread_mutex_init(&r->lock, NULL);
+    pthread_cond_init(&r->ready_cond, NULL);
+
     // Create client socket
     ss->client_socket_fd = socket(AF_INET, SOCK_STREAM, 0);
     if (ss->client_socket_fd < 0) {
@@ -434,49 +1145,117 @@ void start_client_server(StorageServer* ss) {
     }
     
     // Listen
-    if (listen(ss->client_socket_fd, 10) < 0) {
+    int backlog = env_count("SS_LISTEN_BACKLOG", SS_LISTEN_BACKLOG);
+    if (listen(ss->client_socket_fd, backlog) < 0) {
         perror("Listen failed");
         close(ss->client_socket_fd);
         return;
     }
+
+    r->epoll_fd = epoll_create1(0);
+    if (r->epoll_fd < 0) {
+        perror("Failed to create epoll instance");
+        close(ss->client_socket_fd);
+        return;
+    }
+
+    // Non-blocking listener so a burst of connections is drained per wakeup
+    int flags = fcntl(ss->client_socket_fd, F_GETFL, 0);
+    fcntl(ss->client_socket_fd, F_SETFL, flags | O_NONBLOCK);
+
+    struct epoll_event listen_ev;
+    listen_ev.events = EPOLLIN;
+    listen_ev.data.ptr = NULL;
+    if (epoll_ctl(r->epoll_fd, EPOLL_CTL_ADD, ss->client_socket_fd, &listen_ev) < 0) {
+        perror("Failed to watch listening socket");
+        close(r->epoll_fd);
+        close(ss->client_socket_fd);
+        return;
+    }
+
+    // Handlers may wait on write-back, so keep a floor on small hosts
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    int workers = cores > SS_MIN_WORKERS ? (int)cores : SS_MIN_WORKERS;
+    r->worker_count = env_count("SS_CLIENT_WORKERS", workers);
+    io_buffer_pool_init(&r->buffers, r->worker_count * 2);
+    r->workers = (pthread_t*)calloc(r->worker_count, sizeof(pthread_t));
+    int started = 0;
+    for (int i = 0; r->workers && i < r->worker_count; i++) {
+        if (pthread_create(&r->workers[i], NULL, reactor_worker, r) != 0) {
+            perror("Failed to create worker thread");
+            break;
+        }
+        started++;
+    }
+    r->worker_count = started;
+    if (started == 0) {
+        fprintf(stderr, "No worker threads available\n");
+        free(r->workers);
+        io_buffer_pool_destroy(&r->buffers);
+        close(r->epoll_fd);
+        close(ss->client_socket_fd);
+        return;
+    }
     
-    printf("Storage Server listening for clients on port %d\n", ss->client_port);
-    log_message(ss, "INFO", "CLIENT_SERVER_START", "Listening for client connections");
+    printf("Storage Server listening for clients on port %d (%d workers, backlog %d)\n",
+           ss->client_port, r->worker_count, backlog);
+    char details[128];
+    snprintf(details, sizeof(details), "Workers=%d Backlog=%d", r->worker_count, backlog);
+    log_message(ss, "INFO", "CLIENT_SERVER_START", details);
     
-    // Accept client connections
+    struct epoll_event events[REACTOR_MAX_EVENTS];
     while (ss->is_running) {
-        struct sockaddr_in client_addr;
-        socklen_t client_len = sizeof(client_addr);
-        
-        int client_fd = accept(ss->client_socket_fd, (struct sockaddr*)&client_addr, &client_len);
-        
-        if (client_fd < 0) {
-            if (ss->is_running) {
-                perror("Accept failed");
+        int n = epoll_wait(r->epoll_fd, events, REACTOR_MAX_EVENTS, 1000);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
             }
-            continue;
+            perror("epoll_wait failed");
+            break;
         }
-        
-        char client_ip[16];
-        inet_ntop(AF_INET, &client_addr.sin_addr, client_ip, sizeof(client_ip));
-        printf("Client connected: %s:%d\n", client_ip, ntohs(client_addr.sin_port));
-        
-        // Create thread to handle client
-        pthread_t thread;
-        ConnectionArgs* args = (ConnectionArgs*)malloc(sizeof(ConnectionArgs));
-        args->ss = ss;
-        args->socket_fd = client_fd;
-        args->addr = client_addr;
-        
-        if (pthread_create(&thread, NULL, handle_client_connection, args) != 0) {
-            perror("Failed to create client thread");
-            free(args);
-            close(client_fd);
-            continue;
+
+        for (int i = 0; i < n; i++) {
+            if (events[i].data.ptr == NULL) {
+                accept_connections(r);
+            } else {
+                enqueue_session(r, (ClientSession*)events[i].data.ptr);
+            }
+        }
+    }
+
+    // Stop workers; queued sessions are released with the session list below
+    pthread_mutex_lock(&r->lock);
+    r->stopping = true;
+    pthread_cond_broadcast(&r->ready_cond);
+    pthread_mutex_unlock(&r->lock);
+    for (int i = 0; i < r->worker_count; i++) {
+        pthread_join(r->workers[i], NULL);
+    }
+    free(r->workers);
+
+    // Streams still in flight keep their sessions until stream_engine_stop
+    // ends them, so the epoll instance stays open for session_close
+    pthread_mutex_lock(&r->lock);
+    ClientSession* session = r->sessions;
+    while (session) {
+        ClientSession* next = session->next;
+        if (!session->streaming) {
+            if (session->prev) {
+                session->prev->next = next;
+            } else {
+                r->sessions = next;
+            }
+            if (next) {
+                next->prev = session->prev;
+            }
+            close(session->client_fd);
+            wire_reader_destroy(&session->rx);
+            free(session);
         }
-        
-        pthread_detach(thread);
+        session = next;
     }
+    pthread_mutex_unlock(&r->lock);
+    io_buffer_pool_destroy(&r->buffers);
 }
 
 // ==================== MAIN ====================
@@ -0,0 +1,234 @@
+#include "storage_server.h"
+
+// ==================== MEMORY BUDGET ====================
+// A parsed file costs its arena and slabs plus its published snapshot and
+// READ copy (file_resident_bytes). A background thread totals that over the
+// loaded files every MEMORY_SCAN_MS, or right after a load when a budget is
+// set. While the total is over SS_MEMORY_BUDGET_MB it unparses cold files
+// picked by CLOCK: find_file sets a file's referenced bit, the hand clears
+// it, and a file whose bit is still clear when the hand comes round again
+// goes to unload_file, which keeps anything pinned, locked, drafted or not
+// yet on disk. Streams hold their own copy of the content, not the file.
+
+static size_t budget_from_env(void) {
+    const char* value = getenv("SS_MEMORY_BUDGET_MB");
+    long long megabytes = value ? atoll(value) : 0;
+    return megabytes > 0 ? (size_t)megabytes * 1024 * 1024 : 0;
+}
+
+// ==================== SCAN ====================
+
+typedef struct ResidentFile {
+    char name[MAX_FILENAME];
+    size_t bytes;
+} ResidentFile;
+
+typedef struct ResidentList {
+    ResidentFile* files;
+    size_t count;
+    size_t capacity;
+    size_t total;
+} ResidentList;
+
+static void collect_resident(FileEntry* file, void* ctx) {
+    ResidentList* list = (ResidentList*)ctx;
+    if (!atomic_load(&file->loaded)) {
+        return;
+    }
+    size_t bytes = file_resident_bytes(file);
+    list->total += bytes;
+    if (list->count == list->capacity) {
+        size_t capacity = list->capacity ? list->capacity * 2 : 64;
+        void* grown = realloc(list->files, capacity * sizeof(*list->files));
+        if (!grown) {
+            return;
+        }
+        list->files = grown;
+        list->capacity = capacity;
+    }
+    ResidentFile* entry = &list->files[list->count++];
+    snprintf(entry->name, sizeof(entry->name), "%s", file->filename);
+    entry->bytes = bytes;
+}
+
+// ==================== EVICTION ====================
+
+// Returns the bytes released
+static size_t evict_file(StorageServer* ss, const char* filename) {
+    WriteBack* wb = &ss->writeback;
+
+    // Looked up under writeback.lock so a delete waits for us (writeback_forget)
+    pthread_mutex_lock(&wb->lock);
+    FileEntry* file = file_table_find(&ss->files, filename);
+    if (file) {
+        file->dirty.evicting = true;
+    }
+    pthread_mutex_unlock(&wb->lock);
+    if (!file) {
+        return 0;
+    }
+
+    // Used since the hand last passed: second chance
+    size_t released = 0;
+    if (!atomic_exchange(&file->referenced, false)) {
+        released = unload_file(ss, file);
+    }
+
+    pthread_mutex_lock(&wb->lock);
+    file->dirty.evicting = false;
+    pthread_cond_broadcast(&wb->done_cond);
+    pthread_mutex_unlock(&wb->lock);
+    return released;
+}
+
+static void enforce_budget(StorageServer* ss) {
+    MemoryBudget* memory = &ss->memory;
+    ResidentList list = { NULL, 0, 0, 0 };
+    file_table_foreach(&ss->files, collect_resident, &list);
+
+    size_t total = list.total;
+    size_t files = list.count;
+    // Two turns of the hand: the first may only clear referenced bits
+    for (size_t step = 0; memory->budget_bytes > 0 && total > memory->budget_bytes &&
+                          step < 2 * list.count; step++) {
+        const ResidentFile* candidate = &list.files[memory->hand++ % list.count];
+        size_t released = evict_file(ss, candidate->name);
+        if (released == 0) {
+            continue;
+        }
+        total -= released < total ? released : total;
+        files--;
+        atomic_fetch_add(&memory->evictions, 1);
+        atomic_fetch_add(&memory->evicted_bytes, released);
+
+        char details[MAX_FILENAME + 64];
+        snprintf(details, sizeof(details), "File=%s Bytes=%zu", candidate->name, released);
+        log_message(ss, "INFO", "EVICT", details);
+    }
+    free(list.files);
+
+    atomic_store(&memory->resident_bytes, total);
+    atomic_store(&memory->resident_files, files);
+}
+
+// ==================== THREAD ====================
+
+static void memory_report(StorageServer* ss) {
+    char details[256];
+    format_memory_stats(ss, details, sizeof(details));
+    log_message(ss, "INFO", "MEMORY", details);
+}
+
+static void* memory_main(void* arg) {
+    StorageServer* ss = (StorageServer*)arg;
+    MemoryBudget* memory = &ss->memory;
+    // Without a budget the total is only reported, so it is taken less often
+    long interval_ms = memory->budget_bytes > 0 ? MEMORY_SCAN_MS : MEMORY_REPORT_SECONDS * 1000L;
+    time_t last_report = time(NULL);
+    size_t reported_bytes = 0;
+    uint64_t reported_evictions = 0;
+
+    pthread_mutex_lock(&memory->lock);
+    while (memory->running) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += interval_ms / 1000;
+        deadline.tv_nsec += (interval_ms % 1000) * 1000000L;
+        deadline.tv_sec += deadline.tv_nsec / 1000000000L;
+        deadline.tv_nsec %= 1000000000L;
+        pthread_cond_timedwait(&memory->wake_cond, &memory->lock, &deadline);
+        if (!memory->running) {
+            break;
+        }
+        pthread_mutex_unlock(&memory->lock);
+
+        enforce_budget(ss);
+
+        time_t now = time(NULL);
+        size_t bytes = atomic_load(&memory->resident_bytes);
+        uint64_t evictions = atomic_load(&memory->evictions);
+        if (now - last_report >= MEMORY_REPORT_SECONDS &&
+            (bytes != reported_bytes || evictions != reported_evictions)) {
+            reported_bytes = bytes;
+            reported_evictions = evictions;
+            last_report = now;
+            memory_report(ss);
+        }
+
+        pthread_mutex_lock(&memory->lock);
+    }
+    pthread_mutex_unlock(&memory->lock);
+    return NULL;
+}
+
+bool memory_budget_start(StorageServer* ss) {
+    MemoryBudget* memory = &ss->memory;
+    memory->budget_bytes = budget_from_env();
+    memory->hand = 0;
+    atomic_init(&memory->resident_bytes, 0);
+    atomic_init(&memory->resident_files, 0);
+    atomic_init(&memory->evictions, 0);
+    atomic_init(&memory->evicted_bytes, 0);
+    atomic_init(&memory->reloads, 0);
+    pthread_mutex_init(&memory->lock, NULL);
+    pthread_cond_init(&memory->wake_cond, NULL);
+
+    memory->running = true;
+    if (pthread_create(&memory->thread, NULL, memory_main, ss) != 0) {
+        memory->running = false;
+        pthread_cond_destroy(&memory->wake_cond);
+        pthread_mutex_destroy(&memory->lock);
+        return false;
+    }
+    return true;
+}
+
+void memory_budget_stop(StorageServer* ss) {
+    MemoryBudget* memory = &ss->memory;
+    pthread_mutex_lock(&memory->lock);
+    memory->running = false;
+    pthread_cond_signal(&memory->wake_cond);
+    pthread_mutex_unlock(&memory->lock);
+    pthread_join(memory->thread, NULL);
+
+    // Final totals for the log
+    ResidentList list = { NULL, 0, 0, 0 };
+    file_table_foreach(&ss->files, collect_resident, &list);
+    free(list.files);
+    atomic_store(&memory->resident_bytes, list.total);
+    atomic_store(&memory->resident_files, list.count);
+    memory_report(ss);
+
+    pthread_cond_destroy(&memory->wake_cond);
+    pthread_mutex_destroy(&memory->lock);
+}
+
+// Called after every load. The signal may be lost to a scan in progress;
+// the next tick catches up.
+void memory_budget_note_load(StorageServer* ss, bool reload) {
+    MemoryBudget* memory = &ss->memory;
+    if (reload) {
+        atomic_fetch_add(&memory->reloads, 1);
+    }
+    if (memory->budget_bytes > 0) {
+        pthread_cond_signal(&memory->wake_cond);
+    }
+}
+
+// ==================== STATISTICS ====================
+
+void format_memory_stats(StorageServer* ss, char* buffer, size_t size) {
+    MemoryBudget* memory = &ss->memory;
+    char budget[32];
+    if (memory->budget_bytes > 0) {
+        snprintf(budget, sizeof(budget), "%zuB", memory->budget_bytes);
+    } else {
+        snprintf(budget, sizeof(budget), "none");
+    }
+    snprintf(buffer, size,
+             "Budget=%s Resident=%zuB Files=%zu/%zu Evictions=%llu EvictedBytes=%llu Reloads=%llu",
+             budget, atomic_load(&memory->resident_bytes), atomic_load(&memory->resident_files),
+             file_table_count(&ss->files), (unsigned long long)atomic_load(&memory->evictions),
+             (unsigned long long)atomic_load(&memory->evicted_bytes),
+             (unsigned long long)atomic_load(&memory->reloads));
+}
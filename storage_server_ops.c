@@ -2,31 +2,21 @@
 
 // ==================== DRAFT MANAGEMENT HELPERS ====================
 
-static DraftSentence* create_draft_sentence_from_words(char** words, int word_count, char delimiter) {
-    DraftSentence* draft = (DraftSentence*)calloc(1, sizeof(DraftSentence));
+// Words are arena strings owned by the file; drafts share the pointers
+static DraftSentence* create_draft_sentence_from_words(FileEntry* file, char** words, int word_count, char delimiter) {
+    DraftSentence* draft = (DraftSentence*)file_memory_alloc(file, &file->memory.drafts);
     if (!draft) {
         return NULL;
     }
 
     draft->word_capacity = (word_count > 0) ? word_count : 4;
-    if (draft->word_capacity > 0) {
-        draft->words = (char**)calloc(draft->word_capacity, sizeof(char*));
-        if (!draft->words) {
-            free(draft);
-            return NULL;
-        }
-
-        for (int i = 0; i < word_count; i++) {
-            draft->words[i] = strdup(words[i]);
-            if (!draft->words[i]) {
-                for (int j = 0; j < i; j++) {
-                    free(draft->words[j]);
-                }
-                free(draft->words);
-                free(draft);
-                return NULL;
-            }
-        }
+    draft->words = file_memory_words(file, draft->word_capacity);
+    if (!draft->words) {
+        file_memory_free(file, &file->memory.drafts, draft);
+        return NULL;
+    }
+    if (word_count > 0) {
+        memcpy(draft->words, words, sizeof(char*) * word_count);
     }
 
     draft->word_count = word_count;
@@ -35,11 +25,11 @@ static DraftSentence* create_draft_sentence_from_words(char** words, int word_co
     return draft;
 }
 
-static DraftSentence* clone_sentence_to_draft(SentenceNode* sentence) {
+static DraftSentence* clone_sentence_to_draft(FileEntry* file, SentenceNode* sentence) {
     if (!sentence) {
         return NULL;
     }
-    return create_draft_sentence_from_words(sentence->words, sentence->word_count, sentence->delimiter);
+    return create_draft_sentence_from_words(file, sentence->words, sentence->word_count, sentence->delimiter);
 }
 
 static void append_draft_sentence(DraftSentence** head, DraftSentence** tail, DraftSentence* node) {
@@ -53,15 +43,15 @@ static void append_draft_sentence(DraftSentence** head, DraftSentence** tail, Dr
     }
 }
 
-static bool ensure_sentence_draft(SentenceNode* sentence) {
+static bool ensure_sentence_draft(FileEntry* file, SentenceNode* sentence) {
     if (!sentence->draft_head) {
-        sentence->draft_head = clone_sentence_to_draft(sentence);
+        sentence->draft_head = clone_sentence_to_draft(file, sentence);
         sentence->draft_dirty = false;
     }
     return sentence->draft_head != NULL;
 }
 
-static bool draft_ensure_capacity(DraftSentence* draft, int needed) {
+static bool draft_ensure_capacity(FileEntry* file, DraftSentence* draft, int needed) {
     if (needed <= draft->word_capacity) {
         return true;
     }
@@ -71,35 +61,36 @@ static bool draft_ensure_capacity(DraftSentence* draft, int needed) {
         new_capacity *= 2;
     }
 
-    char** new_words = (char**)realloc(draft->words, new_capacity * sizeof(char*));
+    // The old array is abandoned in the arena until the next repack
+    char** new_words = file_memory_words(file, new_capacity);
     if (!new_words) {
         return false;
     }
+    memcpy(new_words, draft->words, sizeof(char*) * draft->word_count);
+    file_memory_abandon_words(file, draft->word_capacity);
     draft->words = new_words;
     draft->word_capacity = new_capacity;
     return true;
 }
 
-static bool insert_word_into_draft(DraftSentence* draft, int index, const char* word) {
+static bool insert_word_into_draft(FileEntry* file, DraftSentence* draft, int index, const char* word) {
     if (!draft || index < 0 || index > draft->word_count) {
         return false;
     }
 
-    if (!draft_ensure_capacity(draft, draft->word_count + 1)) {
+    if (!draft_ensure_capacity(file, draft, draft->word_count + 1)) {
         return false;
     }
 
-    for (int i = draft->word_count; i > index; i--) {
-        draft->words[i] = draft->words[i - 1];
+    char* stored = file_memory_text(file, word, strlen(word));
+    if (!stored) {
+        return false;
     }
 
-    draft->words[index] = strdup(word);
-    if (!draft->words[index]) {
-        for (int i = index; i < draft->word_count; i++) {
-            draft->words[i] = draft->words[i + 1];
-        }
-        return false;
+    for (int i = draft->word_count; i > index; i--) {
+        draft->words[i] = draft->words[i - 1];
     }
+    draft->words[index] = stored;
 
     draft->word_count++;
     return true;
@@ -115,7 +106,7 @@ static int total_draft_words(SentenceNode* sentence) {
     return total;
 }
 
-static bool insert_word_into_drafts(SentenceNode* sentence, int absolute_index, const char* word) {
+static bool insert_word_into_drafts(FileEntry* file, SentenceNode* sentence, int absolute_index, const char* word) {
     if (!sentence->draft_head) {
         return false;
     }
@@ -124,7 +115,7 @@ static bool insert_word_into_drafts(SentenceNode* sentence, int absolute_index,
 
     while (current) {
         if (idx < current->word_count) {
-            return insert_word_into_draft(current, idx, word);
+            return insert_word_into_draft(file, current, idx, word);
         }
         if (idx == current->word_count) {
             if (current->next) {
@@ -132,7 +123,7 @@ static bool insert_word_into_drafts(SentenceNode* sentence, int absolute_index,
                 idx = 0;
                 continue;
             }
-            return insert_word_into_draft(current, current->word_count, word);
+            return insert_word_into_draft(file, current, current->word_count, word);
         }
         idx -= current->word_count;
         current = current->next;
@@ -186,131 +177,75 @@ static void build_draft_text(SentenceNode* sentence, char* buffer, size_t bufsiz
     buffer[offset] = '\0';
 }
 
-static DraftSentence* parse_text_to_drafts(const char* text) {
-    size_t len = strlen(text);
-    size_t idx = 0;
-    DraftSentence* head = NULL;
-    DraftSentence* tail = NULL;
-
-    while (idx < len) {
-        while (idx < len && (text[idx] == ' ' || text[idx] == '\n' || text[idx] == '\t')) {
-            idx++;
-        }
-        if (idx >= len) {
-            break;
-        }
-
-        size_t start = idx;
-        while (idx < len && !is_sentence_delimiter(text[idx])) {
-            idx++;
-        }
+typedef struct DraftBuilder {
+    FileEntry* file;
+    DraftSentence* head;
+    DraftSentence* tail;
+} DraftBuilder;
 
-        char delimiter = '\0';
-        if (idx < len && is_sentence_delimiter(text[idx])) {
-            delimiter = text[idx];
-            idx++;
-        }
-
-        size_t sentence_len = (delimiter != '\0') ? (idx - start - 1) : (idx - start);
-        if ((int)sentence_len < 0) {
-            sentence_len = 0;
-        }
+static bool append_parsed_draft(char** words, int word_count, char delimiter, void* ctx) {
+    DraftBuilder* builder = (DraftBuilder*)ctx;
+    DraftSentence* draft = create_draft_sentence_from_words(builder->file, words, word_count, delimiter);
+    if (!draft) {
+        return false;
+    }
+    append_draft_sentence(&builder->head, &builder->tail, draft);
+    return true;
+}
 
-        char sentence_text[MAX_CONTENT_SIZE];
-        if (sentence_len >= MAX_CONTENT_SIZE) {
-            sentence_len = MAX_CONTENT_SIZE - 1;
-        }
-        memcpy(sentence_text, text + start, sentence_len);
-        sentence_text[sentence_len] = '\0';
-
-        char sentence_copy[MAX_CONTENT_SIZE];
-        strncpy(sentence_copy, sentence_text, MAX_CONTENT_SIZE - 1);
-        sentence_copy[MAX_CONTENT_SIZE - 1] = '\0';
-
-        char* words[1000];
-        int word_count = 0;
-        char* token = strtok(sentence_copy, " \t\n");
-        while (token && word_count < 1000) {
-            words[word_count++] = token;
-            token = strtok(NULL, " \t\n");
-        }
+static DraftSentence* parse_text_to_drafts(FileEntry* file, const char* text) {
+    DraftBuilder builder = {file, NULL, NULL};
 
-        DraftSentence* draft = create_draft_sentence_from_words(words, word_count, delimiter);
-        if (!draft) {
-            free_draft_sentences(head);
+    // Copy the text into the arena once; words are tokenized in place
+    size_t len = strlen(text);
+    if (len > 0) {
+        char* stored = file_memory_text(file, text, len);
+        if (!stored || !tokenize_sentences(stored, len, append_parsed_draft, &builder)) {
+            free_draft_sentences(file, builder.head);
             return NULL;
         }
-
-        append_draft_sentence(&head, &tail, draft);
     }
 
+    DraftSentence* head = builder.head;
+    DraftSentence* tail = builder.tail;
+
     if (!head) {
         // Ensure at least one empty draft node exists
-        DraftSentence* empty = (DraftSentence*)calloc(1, sizeof(DraftSentence));
-        if (!empty) {
-            return NULL;
-        }
-        empty->word_capacity = 4;
-        empty->words = (char**)calloc(empty->word_capacity, sizeof(char*));
-        head = empty;
+        head = create_draft_sentence_from_words(file, NULL, 0, '\0');
     } else if (tail && tail->delimiter != '\0') {
-        DraftSentence* empty = (DraftSentence*)calloc(1, sizeof(DraftSentence));
+        DraftSentence* empty = create_draft_sentence_from_words(file, NULL, 0, '\0');
         if (!empty) {
-            free_draft_sentences(head);
+            free_draft_sentences(file, head);
             return NULL;
         }
-        empty->word_capacity = 4;
-        empty->words = (char**)calloc(empty->word_capacity, sizeof(char*));
         tail->next = empty;
     }
 
     return head;
 }
 
-static bool rebuild_draft_structure(SentenceNode* sentence) {
+static bool rebuild_draft_structure(FileEntry* file, SentenceNode* sentence) {
     char buffer[MAX_CONTENT_SIZE];
     build_draft_text(sentence, buffer, sizeof(buffer));
 
-    DraftSentence* new_head = parse_text_to_drafts(buffer);
+    DraftSentence* new_head = parse_text_to_drafts(file, buffer);
     if (!new_head) {
         return false;
     }
 
-    free_draft_sentences(sentence->draft_head);
+    free_draft_sentences(file, sentence->draft_head);
     sentence->draft_head = new_head;
     return true;
 }
 
-static bool overwrite_sentence_with_draft(SentenceNode* sentence, DraftSentence* draft) {
-    int required_capacity = draft->word_count > 0 ? draft->word_count : 4;
-    char** new_words = (char**)calloc(required_capacity, sizeof(char*));
-    if (!new_words) {
-        return false;
-    }
-
-    for (int i = 0; i < draft->word_count; i++) {
-        new_words[i] = strdup(draft->words[i]);
-        if (!new_words[i]) {
-            for (int j = 0; j < i; j++) {
-                free(new_words[j]);
-            }
-            free(new_words);
-            return false;
-        }
-    }
-
-    if (sentence->words) {
-        for (int i = 0; i < sentence->word_count; i++) {
-            free(sentence->words[i]);
-        }
-        free(sentence->words);
-    }
-
-    sentence->words = new_words;
-    sentence->word_capacity = required_capacity;
-    sentence->word_count = draft->word_count;
-    sentence->delimiter = draft->delimiter;
-    return true;
+static void overwrite_sentence_with_draft(FileEntry* file, SentenceNode* sentence, DraftSentence* draft) {
+    // The draft is discarded after the commit, so the sentence adopts its
+    // word array; the sentence's old array stays behind in the arena
+    set_sentence_words(file, sentence, draft->words, draft->word_capacity, draft->word_count,
+                       draft->delimiter);
+    draft->words = NULL;
+    draft->word_count = 0;
+    draft->word_capacity = 0;
 }
 
 static bool apply_drafts_to_file(FileEntry* file, SentenceNode* sentence) {
@@ -324,13 +259,13 @@ static bool apply_drafts_to_file(FileEntry* file, SentenceNode* sentence) {
     SentenceNode* new_tail = NULL;
 
     while (cursor) {
-        SentenceNode* new_node = create_sentence_node((const char**)cursor->words, cursor->word_count, cursor->delimiter);
+        SentenceNode* new_node = create_sentence_node(file, cursor->words, cursor->word_count, cursor->delimiter);
         if (!new_node) {
             // Cleanup any nodes we already allocated
             SentenceNode* tmp = new_head;
             while (tmp) {
                 SentenceNode* next = tmp->next;
-                free_sentence_node(tmp);
+                free_sentence_node(file, tmp);
                 tmp = next;
             }
             return false;
@@ -347,42 +282,19 @@ static bool apply_drafts_to_file(FileEntry* file, SentenceNode* sentence) {
         cursor = cursor->next;
     }
 
-    if (!overwrite_sentence_with_draft(sentence, draft)) {
-        SentenceNode* tmp = new_head;
-        while (tmp) {
-            SentenceNode* next = tmp->next;
-            free_sentence_node(tmp);
-            tmp = next;
-        }
-        return false;
-    }
+    overwrite_sentence_with_draft(file, sentence, draft);
 
     // Insert new sentences directly (caller must hold structure_lock)
     SentenceNode* insertion_point = sentence;
     SentenceNode* iterator = new_head;
     while (iterator) {
         SentenceNode* next = iterator->next;
-        iterator->next = NULL;
-        iterator->prev = NULL;
-        
-        // Inline insertion without taking structure_lock (caller holds it)
-        iterator->next = insertion_point->next;
-        iterator->prev = insertion_point;
-        
-        if (insertion_point->next) {
-            insertion_point->next->prev = iterator;
-        } else {
-            file->tail = iterator;
-        }
-        
-        insertion_point->next = iterator;
-        file->sentence_count++;
-        
+        insert_sentence_after(file, insertion_point, iterator);
         insertion_point = iterator;
         iterator = next;
     }
 
-    free_draft_sentences(sentence->draft_head);
+    free_draft_sentences(file, sentence->draft_head);
     sentence->draft_head = NULL;
     sentence->draft_dirty = false;
     return true;
@@ -390,25 +302,23 @@ static bool apply_drafts_to_file(FileEntry* file, SentenceNode* sentence) {
 
 // ==================== UNDO HELPERS ====================
 
-static void destroy_sentence_undo_entry(SentenceUndoEntry* entry) {
+static void destroy_sentence_undo_entry(FileEntry* file, SentenceUndoEntry* entry) {
     if (!entry) {
         return;
     }
     if (entry->words_snapshot) {
-        for (int i = 0; i < entry->word_count; i++) {
-            free(entry->words_snapshot[i]);
-        }
-        free(entry->words_snapshot);
+        file_memory_abandon_words(file, entry->word_count);
     }
-    free(entry);
+    file_memory_free(file, &file->memory.undo_entries, entry);
 }
 
-static SentenceUndoEntry* create_sentence_undo_entry(SentenceNode* sentence) {
+// The snapshot shares the sentence's (immutable) words; only the array is copied
+static SentenceUndoEntry* create_sentence_undo_entry(FileEntry* file, SentenceNode* sentence) {
     if (!sentence) {
         return NULL;
     }
 
-    SentenceUndoEntry* entry = (SentenceUndoEntry*)calloc(1, sizeof(SentenceUndoEntry));
+    SentenceUndoEntry* entry = (SentenceUndoEntry*)file_memory_alloc(file, &file->memory.undo_entries);
     if (!entry) {
         return NULL;
     }
@@ -418,21 +328,12 @@ static SentenceUndoEntry* create_sentence_undo_entry(SentenceNode* sentence) {
     entry->delimiter = sentence->delimiter;
 
     if (entry->word_count > 0) {
-        entry->words_snapshot = (char**)calloc(entry->word_count, sizeof(char*));
+        entry->words_snapshot = file_memory_words(file, entry->word_count);
         if (!entry->words_snapshot) {
-            destroy_sentence_undo_entry(entry);
+            destroy_sentence_undo_entry(file, entry);
             return NULL;
         }
-
-        for (int i = 0; i < entry->word_count; i++) {
-            if (sentence->words && sentence->words[i]) {
-                entry->words_snapshot[i] = strdup(sentence->words[i]);
-                if (!entry->words_snapshot[i]) {
-                    destroy_sentence_undo_entry(entry);
-                    return NULL;
-                }
-            }
-        }
+        memcpy(entry->words_snapshot, sentence->words, sizeof(char*) * entry->word_count);
     }
 
     return entry;
@@ -455,7 +356,7 @@ static void trim_sentence_undo_history(FileEntry* file) {
         current->next = NULL;
         while (to_free) {
             SentenceUndoEntry* next = to_free->next;
-            destroy_sentence_undo_entry(to_free);
+            destroy_sentence_undo_entry(file, to_free);
             file->undo_depth--;
             to_free = next;
         }
@@ -489,91 +390,36 @@ static bool sentence_belongs_to_file(FileEntry* file, SentenceNode* sentence) {
     if (!file || !sentence) {
         return false;
     }
-    pthread_mutex_lock(&file->structure_lock);
-    SentenceNode* current = file->head;
-    while (current) {
-        if (current == sentence) {
-            pthread_mutex_unlock(&file->structure_lock);
-            return true;
-        }
-        current = current->next;
-    }
-    pthread_mutex_unlock(&file->structure_lock);
-    return false;
+    return get_sentence_index(file, sentence) >= 0;
 }
 
-static bool ensure_sentence_capacity(SentenceNode* sentence, int needed) {
-    if (!sentence) {
-        return false;
-    }
-    if (needed <= sentence->word_capacity) {
-        return true;
-    }
-
-    int new_capacity = sentence->word_capacity > 0 ? sentence->word_capacity : 4;
-    while (new_capacity < needed) {
-        new_capacity *= 2;
-    }
-
-    char** new_words = (char**)realloc(sentence->words, new_capacity * sizeof(char*));
-    if (!new_words) {
-        return false;
-    }
-    sentence->words = new_words;
-    sentence->word_capacity = new_capacity;
-    return true;
-}
-
-static bool apply_sentence_snapshot(SentenceNode* sentence, SentenceUndoEntry* entry) {
+static bool apply_sentence_snapshot(FileEntry* file, SentenceNode* sentence, SentenceUndoEntry* entry) {
     if (!sentence || !entry) {
         return false;
     }
 
-    for (int i = 0; i < sentence->word_count; i++) {
-        free(sentence->words[i]);
-        sentence->words[i] = NULL;
-    }
-
-    int needed = entry->word_count > 0 ? entry->word_count : 1;
-    if (!ensure_sentence_capacity(sentence, needed)) {
-        sentence->word_count = 0;
+    int capacity = entry->word_count > 0 ? entry->word_count : 4;
+    char** words = file_memory_words(file, capacity);
+    if (!words) {
         return false;
     }
-
-    for (int i = 0; i < entry->word_count; i++) {
-        const char* word = (entry->words_snapshot && entry->words_snapshot[i]) ? entry->words_snapshot[i] : "";
-        sentence->words[i] = strdup(word);
-        if (!sentence->words[i]) {
-            for (int j = 0; j < i; j++) {
-                free(sentence->words[j]);
-                sentence->words[j] = NULL;
-            }
-            sentence->word_count = 0;
-            return false;
-        }
+    if (entry->word_count > 0) {
+        memcpy(words, entry->words_snapshot, sizeof(char*) * entry->word_count);
     }
 
-    sentence->word_count = entry->word_count;
-    sentence->delimiter = entry->delimiter;
+    set_sentence_words(file, sentence, words, capacity, entry->word_count, entry->delimiter);
     sentence->draft_dirty = false;
     if (sentence->draft_head) {
-        free_draft_sentences(sentence->draft_head);
+        free_draft_sentences(file, sentence->draft_head);
         sentence->draft_head = NULL;
     }
-    for (int i = entry->word_count; i < sentence->word_capacity; i++) {
-        sentence->words[i] = NULL;
-    }
     return true;
 }
 
 // ==================== SENTENCE LOCKING AND WRITE OPERATIONS ====================
 
-ErrorCode lock_sentence(StorageServer* ss, const char* filename, int sentence_num, int client_id) {
-    FileEntry* file = find_file(ss, filename);
-    if (!file) {
-        return ERR_FILE_NOT_FOUND;
-    }
-
+static ErrorCode lock_file_sentence(StorageServer* ss, FileEntry* file, const char* filename,
+                                    int sentence_num, int client_id) {
     // Validate sentence number - must exist in file
     if (sentence_num < 0 || sentence_num >= file->sentence_count) {
         return ERR_INVALID_SENTENCE;
@@ -588,32 +434,36 @@ ErrorCode lock_sentence(StorageServer* ss, const char* filename, int sentence_nu
     // Try to lock the sentence
     pthread_mutex_lock(&sentence->lock);
 
-    if (sentence->is_locked) {
-        if (sentence->lock_holder_id == client_id) {
-            // Already locked by this client
-            pthread_mutex_unlock(&sentence->lock);
-            return ERR_SUCCESS;
-        }
+    if (sentence->is_locked && sentence->lock_holder_id != client_id) {
         // Locked by another client
         pthread_mutex_unlock(&sentence->lock);
         return ERR_FILE_LOCKED;
     }
 
-    // Lock it
+    // Lock it, or renew the lease if this client already holds it. The
+    // lease is taken under the sentence lock so an expiring lease sees
+    // either the old stamp or the new one.
     sentence->is_locked = true;
     sentence->lock_holder_id = client_id;
+    sentence->lock_lease = lease_acquire(ss, client_id, filename, sentence->lock_lease);
 
     pthread_mutex_unlock(&sentence->lock);
 
     return ERR_SUCCESS;
 }
 
-ErrorCode unlock_sentence(StorageServer* ss, const char* filename, int sentence_num, int client_id) {
+ErrorCode lock_sentence(StorageServer* ss, const char* filename, int sentence_num, int client_id) {
     FileEntry* file = find_file(ss, filename);
     if (!file) {
         return ERR_FILE_NOT_FOUND;
     }
-    
+    ErrorCode result = lock_file_sentence(ss, file, filename, sentence_num, client_id);
+    release_file(file);
+    return result;
+}
+
+static ErrorCode unlock_file_sentence(StorageServer* ss, FileEntry* file, const char* filename,
+                                      int sentence_num, int client_id) {
     if (sentence_num < 0 || sentence_num >= file->sentence_count) {
         return ERR_INVALID_SENTENCE;
     }
@@ -626,10 +476,12 @@ ErrorCode unlock_sentence(StorageServer* ss, const char* filename, int sentence_
     pthread_mutex_lock(&sent->lock);
     
     if (sent->is_locked && sent->lock_holder_id == client_id) {
+        lease_release(ss, client_id, filename, sent->lock_lease);
         sent->is_locked = false;
         sent->lock_holder_id = -1;
+        sent->lock_lease = 0;
         if (sent->draft_head) {
-            free_draft_sentences(sent->draft_head);
+            free_draft_sentences(file, sent->draft_head);
             sent->draft_head = NULL;
             sent->draft_dirty = false;
         }
@@ -640,13 +492,50 @@ ErrorCode unlock_sentence(StorageServer* ss, const char* filename, int sentence_
     return ERR_SUCCESS;
 }
 
-ErrorCode write_sentence(StorageServer* ss, const char* filename, int sentence_num, 
-                        int word_index, const char* new_content, int client_id) {
+ErrorCode unlock_sentence(StorageServer* ss, const char* filename, int sentence_num, int client_id) {
     FileEntry* file = find_file(ss, filename);
     if (!file) {
         return ERR_FILE_NOT_FOUND;
     }
-    
+    ErrorCode result = unlock_file_sentence(ss, file, filename, sentence_num, client_id);
+    release_file(file);
+    return result;
+}
+
+// Unlocks every sentence of the file that client_id holds under the given
+// lease, wherever commits by others have moved them; used when it ends
+int release_holder_locks(StorageServer* ss, const char* filename, int client_id,
+                         uint64_t lease_serial) {
+    FileEntry* file = find_file(ss, filename);
+    if (!file) {
+        return 0;
+    }
+    int released = 0;
+    pthread_rwlock_rdlock(&file->file_lock);
+    for (SentenceNode* sent = file->head; sent; sent = sent->next) {
+        pthread_mutex_lock(&sent->lock);
+        if (sent->is_locked && sent->lock_holder_id == client_id &&
+            sent->lock_lease == lease_serial) {
+            sent->is_locked = false;
+            sent->lock_holder_id = -1;
+            sent->lock_lease = 0;
+            if (sent->draft_head) {
+                free_draft_sentences(file, sent->draft_head);
+                sent->draft_head = NULL;
+                sent->draft_dirty = false;
+            }
+            released++;
+        }
+        pthread_mutex_unlock(&sent->lock);
+    }
+    pthread_rwlock_unlock(&file->file_lock);
+    release_file(file);
+    return released;
+}
+
+static ErrorCode write_file_sentence(StorageServer* ss, FileEntry* file, const char* filename,
+                                     int sentence_num, int word_index, const char* new_content,
+                                     int client_id) {
     // Acquire Read lock on file to prevent concurrent commits
     pthread_rwlock_rdlock(&file->file_lock);
     
@@ -661,14 +550,15 @@ ErrorCode write_sentence(StorageServer* ss, const char* filename, int sentence_n
         return ERR_INVALID_SENTENCE;
     }
     
+    // Also refused once the writer's lease has expired
     pthread_mutex_lock(&sent->lock);
-    if (sent->is_locked && sent->lock_holder_id != client_id) {
+    if (!sent->is_locked || sent->lock_holder_id != client_id) {
         pthread_mutex_unlock(&sent->lock);
         pthread_rwlock_unlock(&file->file_lock);
         return ERR_FILE_LOCKED;
     }
     
-    if (!ensure_sentence_draft(sent)) {
+    if (!ensure_sentence_draft(file, sent)) {
         pthread_mutex_unlock(&sent->lock);
         pthread_rwlock_unlock(&file->file_lock);
         return ERR_SYSTEM_ERROR;
@@ -692,7 +582,7 @@ ErrorCode write_sentence(StorageServer* ss, const char* filename, int sentence_n
     
     token = strtok_r(content_copy, " ", &saveptr);
     while (token && success) {
-        success = insert_word_into_drafts(sent, current_index, token);
+        success = insert_word_into_drafts(file, sent, current_index, token);
         if (success) {
             current_index++;
         }
@@ -708,7 +598,7 @@ ErrorCode write_sentence(StorageServer* ss, const char* filename, int sentence_n
     sent->draft_dirty = true;
     
     if (contains_sentence_delimiter(new_content)) {
-        if (!rebuild_draft_structure(sent)) {
+        if (!rebuild_draft_structure(file, sent)) {
             pthread_mutex_unlock(&sent->lock);
             pthread_rwlock_unlock(&file->file_lock);
             return ERR_SYSTEM_ERROR;
@@ -726,12 +616,24 @@ ErrorCode write_sentence(StorageServer* ss, const char* filename, int sentence_n
     return ERR_SUCCESS;
 }
 
-ErrorCode commit_sentence_drafts(StorageServer* ss, const char* filename, int sentence_num) {
+ErrorCode write_sentence(StorageServer* ss, const char* filename, int sentence_num, 
+                        int word_index, const char* new_content, int client_id) {
     FileEntry* file = find_file(ss, filename);
     if (!file) {
         return ERR_FILE_NOT_FOUND;
     }
+    ErrorCode result = write_file_sentence(ss, file, filename, sentence_num, word_index,
+                                           new_content, client_id);
+    release_file(file);
+    if (result == ERR_SUCCESS) {
+        lease_renew(ss, client_id, filename);
+    }
+    return result;
+}
 
+static ErrorCode commit_file_drafts(StorageServer* ss, FileEntry* file, const char* filename,
+                                    int sentence_num, int client_id,
+                                    const struct timespec* started) {
     pthread_rwlock_wrlock(&file->file_lock);
 
     if (sentence_num < 0 || sentence_num >= file->sentence_count) {
@@ -747,13 +649,20 @@ ErrorCode commit_sentence_drafts(StorageServer* ss, const char* filename, int se
 
     pthread_mutex_lock(&sentence->lock);
 
+    // Drafts staged after our lease expired belong to the next holder
+    if (!sentence->is_locked || sentence->lock_holder_id != client_id) {
+        pthread_mutex_unlock(&sentence->lock);
+        pthread_rwlock_unlock(&file->file_lock);
+        return ERR_FILE_LOCKED;
+    }
+
     if (!sentence->draft_dirty || !sentence->draft_head) {
         pthread_mutex_unlock(&sentence->lock);
         pthread_rwlock_unlock(&file->file_lock);
         return ERR_SUCCESS;
     }
 
-    SentenceUndoEntry* undo_entry = create_sentence_undo_entry(sentence);
+    SentenceUndoEntry* undo_entry = create_sentence_undo_entry(file, sentence);
     if (!undo_entry) {
         pthread_mutex_unlock(&sentence->lock);
         pthread_rwlock_unlock(&file->file_lock);
@@ -775,7 +684,7 @@ ErrorCode commit_sentence_drafts(StorageServer* ss, const char* filename, int se
     pthread_mutex_unlock(&file->structure_lock);
     
     if (!applied) {
-        destroy_sentence_undo_entry(undo_entry);
+        destroy_sentence_undo_entry(file, undo_entry);
         pthread_mutex_unlock(&sentence->lock);
         pthread_rwlock_unlock(&file->file_lock);
         return ERR_SYSTEM_ERROR;
@@ -788,107 +697,36 @@ ErrorCode commit_sentence_drafts(StorageServer* ss, const char* filename, int se
     undo_entry->appended_sentences = appended_count;
     push_sentence_undo_entry(file, undo_entry);
 
-    refresh_file_stats(file);
+    publish_file_stats(file);
     file->last_modified = time(NULL);
     file->last_accessed = file->last_modified;
-    save_file_to_disk(file);
+    uint64_t seq = save_sentence_edit(ss, file, sentence, 1, 1 + appended_count);
+
+    pthread_rwlock_unlock(&file->file_lock);
+
+    // Readers and writers proceed while the write-back thread persists it
+    ErrorCode persisted = writeback_wait(ss, file, seq);
+    durability_note_commit(ss, started);
 
     char details[256];
     snprintf(details, sizeof(details), "File=%s Sentence=%d", filename, sentence_num);
-    log_message(ss, "INFO", "COMMIT", details);
-
-    pthread_rwlock_unlock(&file->file_lock);
+    log_message(ss, persisted == ERR_SUCCESS ? "INFO" : "ERROR", "COMMIT", details);
 
-    return ERR_SUCCESS;
+    return persisted;
 }
 
-// ==================== STREAMING ====================
+ErrorCode commit_sentence_drafts(StorageServer* ss, const char* filename, int sentence_num,
+                                 int client_id) {
+    struct timespec started;
+    clock_gettime(CLOCK_MONOTONIC, &started);
 
-ErrorCode stream_file(StorageServer* ss, int client_fd, const char* filename) {
     FileEntry* file = find_file(ss, filename);
     if (!file) {
         return ERR_FILE_NOT_FOUND;
     }
-    
-    pthread_rwlock_rdlock(&file->file_lock);
-    
-    FILE* fp = fopen(file->filepath, "r");
-    if (!fp) {
-        pthread_rwlock_unlock(&file->file_lock);
-        return ERR_SYSTEM_ERROR;
-    }
-
-    char* buffer = (char*)malloc(MAX_CONTENT_SIZE);
-    if (!buffer) {
-        fclose(fp);
-        pthread_rwlock_unlock(&file->file_lock);
-        return ERR_SYSTEM_ERROR;
-    }
-
-    size_t bytes_read = fread(buffer, 1, MAX_CONTENT_SIZE - 1, fp);
-    buffer[bytes_read] = '\0';
-    fclose(fp);
-
-    // Stream word by word
-    char* saveptr;
-    char* token = strtok_r(buffer, " \t\n", &saveptr);
-    
-    while (token) {
-        // Check if token ends with a delimiter
-        size_t len = strlen(token);
-        bool has_delim = false;
-        char delim = '\0';
-        
-        if (len > 0 && is_sentence_delimiter(token[len-1])) {
-            has_delim = true;
-            delim = token[len-1];
-            token[len-1] = '\0'; // Remove delimiter for now
-            len--;
-        }
-        
-        if (len > 0) {
-            char msg[BUFFER_SIZE];
-            if (has_delim) {
-                snprintf(msg, sizeof(msg), "%s%c\n", token, delim);
-            } else {
-                snprintf(msg, sizeof(msg), "%s\n", token);
-            }
-            
-            if (send(client_fd, msg, strlen(msg), MSG_NOSIGNAL) <= 0) {
-                free(buffer);
-                pthread_rwlock_unlock(&file->file_lock);
-                return ERR_SYSTEM_ERROR;
-            }
-            usleep(100000); // 0.1s delay
-        } else if (has_delim) {
-            // Token was just a delimiter?
-            char msg[4];
-            snprintf(msg, sizeof(msg), "%c\n", delim);
-            if (send(client_fd, msg, strlen(msg), MSG_NOSIGNAL) <= 0) {
-                free(buffer);
-                pthread_rwlock_unlock(&file->file_lock);
-                return ERR_SYSTEM_ERROR;
-            }
-            usleep(100000);
-        }
-        
-        token = strtok_r(NULL, " \t\n", &saveptr);
-    }
-    
-    free(buffer);
-    
-    // Send STOP marker
-    send(client_fd, "STOP\n", 5, MSG_NOSIGNAL);
-    
-    file->last_accessed = time(NULL);
-    
-    pthread_rwlock_unlock(&file->file_lock);
-    
-    char details[256];
-    snprintf(details, sizeof(details), "File=%s", filename);
-    log_message(ss, "INFO", "STREAM", details);
-    
-    return ERR_SUCCESS;
+    ErrorCode result = commit_file_drafts(ss, file, filename, sentence_num, client_id, &started);
+    release_file(file);
+    return result;
 }
 
 // ==================== FILE INFO ====================
@@ -900,28 +738,20 @@ ErrorCode get_file_info(StorageServer* ss, const char* filename,
         return ERR_FILE_NOT_FOUND;
     }
     
-    pthread_rwlock_rdlock(&file->file_lock);
-    
-    *size = file->total_size;
-    *words = file->total_words;
-    *chars = file->total_chars;
+    // Published by the last commit; no file lock needed
+    read_file_stats(file, size, words, chars);
     if (last_accessed) {
         *last_accessed = file->last_accessed;
     }
-    
-    pthread_rwlock_unlock(&file->file_lock);
+    release_file(file);
     
     return ERR_SUCCESS;
 }
 
 // ==================== UNDO OPERATION ====================
 
-ErrorCode handle_undo(StorageServer* ss, const char* filename) {
-    FileEntry* file = find_file(ss, filename);
-    if (!file) {
-        return ERR_FILE_NOT_FOUND;
-    }
-
+static ErrorCode undo_file_edit(StorageServer* ss, FileEntry* file, const char* filename,
+                                const struct timespec* started) {
     pthread_rwlock_wrlock(&file->file_lock);
 
     SentenceUndoEntry* entry = pop_sentence_undo_entry(file);
@@ -931,44 +761,62 @@ ErrorCode handle_undo(StorageServer* ss, const char* filename) {
     }
 
     if (!sentence_belongs_to_file(file, entry->sentence)) {
-        destroy_sentence_undo_entry(entry);
+        destroy_sentence_undo_entry(file, entry);
         pthread_rwlock_unlock(&file->file_lock);
         return ERR_SYSTEM_ERROR;
     }
 
     SentenceNode* sentence = entry->sentence;
     pthread_mutex_lock(&sentence->lock);
-    bool applied = apply_sentence_snapshot(sentence, entry);
+    bool applied = apply_sentence_snapshot(file, sentence, entry);
     pthread_mutex_unlock(&sentence->lock);
 
     if (!applied) {
-        destroy_sentence_undo_entry(entry);
+        destroy_sentence_undo_entry(file, entry);
         pthread_rwlock_unlock(&file->file_lock);
         return ERR_SYSTEM_ERROR;
     }
 
+    int removed = 1;
     for (int i = 0; i < entry->appended_sentences; i++) {
         SentenceNode* extra = sentence->next;
         if (!extra) {
             break;
         }
         delete_sentence_node(file, extra);
+        removed++;
     }
 
-    refresh_file_stats(file);
+    publish_file_stats(file);
     file->last_modified = time(NULL);
     file->last_accessed = file->last_modified;
-    save_file_to_disk(file);
+    uint64_t seq = save_sentence_edit(ss, file, sentence, removed, 1);
 
     pthread_rwlock_unlock(&file->file_lock);
 
-    destroy_sentence_undo_entry(entry);
+    ErrorCode persisted = writeback_wait(ss, file, seq);
+    durability_note_commit(ss, started);
+
+    destroy_sentence_undo_entry(file, entry);
 
     char details[256];
     snprintf(details, sizeof(details), "File=%s", filename);
-    log_message(ss, "INFO", "UNDO", details);
+    log_message(ss, persisted == ERR_SUCCESS ? "INFO" : "ERROR", "UNDO", details);
 
-    return ERR_SUCCESS;
+    return persisted;
+}
+
+ErrorCode handle_undo(StorageServer* ss, const char* filename) {
+    struct timespec started;
+    clock_gettime(CLOCK_MONOTONIC, &started);
+
+    FileEntry* file = find_file(ss, filename);
+    if (!file) {
+        return ERR_FILE_NOT_FOUND;
+    }
+    ErrorCode result = undo_file_edit(ss, file, filename, &started);
+    release_file(file);
+    return result;
 }
 
 // ==================== INITIALIZATION ====================
@@ -987,18 +835,61 @@ StorageServer* init_storage_server(const char* nm_ip, int nm_port, int client_po
     ss->client_port = client_port;
     ss->nm_socket_fd = -1;
     ss->client_socket_fd = -1;
-    ss->file_count = 0;
     ss->is_running = true;
-    memset(ss->files, 0, sizeof(ss->files));
+    
+    if (!file_table_init(&ss->files)) {
+        perror("Failed to allocate file table");
+        free(ss);
+        return NULL;
+    }
     
     // Initialize locks
-    pthread_mutex_init(&ss->files_lock, NULL);
-    pthread_mutex_init(&ss->log_lock, NULL);
+    pthread_mutex_init(&ss->nm_send_lock, NULL);
     
-    // Open log file
-    ss->log_file = fopen(LOG_FILE, "a");
-    if (!ss->log_file) {
+    // Open log file and start the log writer
+    if (!async_log_open(&ss->log, LOG_FILE)) {
         perror("Failed to open log file");
+        file_table_destroy(&ss->files);
+        free(ss);
+        return NULL;
+    }
+    
+    // Start the write-back thread before anything can be saved
+    durability_init(ss);
+    if (!writeback_start(ss)) {
+        perror("Failed to start write-back thread");
+        async_log_close(&ss->log);
+        file_table_destroy(&ss->files);
+        free(ss);
+        return NULL;
+    }
+    
+    if (!stream_engine_start(ss)) {
+        perror("Failed to start stream workers");
+        writeback_stop(ss);
+        async_log_close(&ss->log);
+        file_table_destroy(&ss->files);
+        free(ss);
+        return NULL;
+    }
+    
+    if (!memory_budget_start(ss)) {
+        perror("Failed to start memory budget thread");
+        stream_engine_stop(ss);
+        writeback_stop(ss);
+        async_log_close(&ss->log);
+        file_table_destroy(&ss->files);
+        free(ss);
+        return NULL;
+    }
+    
+    if (!lease_table_start(ss)) {
+        perror("Failed to start lock lease timer");
+        memory_budget_stop(ss);
+        stream_engine_stop(ss);
+        writeback_stop(ss);
+        async_log_close(&ss->log);
+        file_table_destroy(&ss->files);
         free(ss);
         return NULL;
     }
@@ -1006,16 +897,20 @@ StorageServer* init_storage_server(const char* nm_ip, int nm_port, int client_po
     // Ensure storage directory exists
     ensure_storage_dir();
     
-    // Load existing files
+    // Register existing files; their contents load on first access
     load_all_files(ss);
     
     log_message(ss, "INFO", "INIT", "Storage Server initialized");
     printf("Storage Server initialized (Client port: %d)\n", client_port);
-    printf("Loaded %d files from storage\n", ss->file_count);
+    printf("Registered %zu files from storage\n", file_table_count(&ss->files));
     
     return ss;
 }
 
+static void free_file_entry(FileEntry* file, void* ctx __attribute__((unused))) {
+    destroy_file_entry(file);
+}
+
 void destroy_storage_server(StorageServer* ss) {
     if (!ss) return;
     
@@ -1029,24 +924,26 @@ void destroy_storage_server(StorageServer* ss) {
         close(ss->client_socket_fd);
     }
     
+    // Stop pre-warming before anything it loads into goes away
+    prewarm_stop(ss);
+    memory_budget_stop(ss);
+    
+    // End streams still in flight; they hold content, not files
+    stream_engine_stop(ss);
+    lease_table_stop(ss);
+    
+    // Flush dirty files and fold outstanding edit logs into the text files
+    writeback_stop(ss);
+    
     // Free files
-    for (int i = 0; i < ss->file_count; i++) {
-        if (ss->files[i]) {
-            free_all_sentences(ss->files[i]);
-            pthread_rwlock_destroy(&ss->files[i]->file_lock);
-            pthread_mutex_destroy(&ss->files[i]->structure_lock);
-            free(ss->files[i]);
-        }
-    }
+    file_table_foreach(&ss->files, free_file_entry, NULL);
+    file_table_destroy(&ss->files);
     
-    // Close log file
-    if (ss->log_file) {
-        fclose(ss->log_file);
-    }
+    // Drain pending log entries and close the log file
+    async_log_close(&ss->log);
     
     // Destroy locks
-    pthread_mutex_destroy(&ss->files_lock);
-    pthread_mutex_destroy(&ss->log_lock);
+    pthread_mutex_destroy(&ss->nm_send_lock);
     
     free(ss);
     printf("Storage Server destroyed\n");
@@ -0,0 +1,282 @@
+#include "storage_server.h"
+
+// ==================== SNAPSHOTS ====================
+// A FileSnapshot is the file's content at one version, as a list of chunks
+// of at most SNAPSHOT_CHUNK rendered sentences. Nothing in a published
+// snapshot changes again; it lives until the last reader releases it. A
+// commit or undo replaces a run of sentences, so the next snapshot copies
+// the chunk pointers before and after the run (taking a reference on each)
+// and builds new chunks only for the run itself and what remains of the
+// chunks it cut through. Small leftovers absorb the following chunk so the
+// chunk count stays near sentence_count / SNAPSHOT_CHUNK.
+
+// ==================== SENTENCE TEXT ====================
+
+// Caller holds file_lock for writing, so the words cannot change under us
+static SentenceText* render_sentence(const SentenceNode* node) {
+    SentenceText* text = (SentenceText*)malloc(sizeof(SentenceText) + (size_t)node->char_count);
+    if (!text) {
+        return NULL;
+    }
+    atomic_init(&text->refs, 1);
+    size_t offset = 0;
+    for (int i = 0; i < node->word_count; i++) {
+        if (i > 0) {
+            text->text[offset++] = ' ';
+        }
+        size_t length = strlen(node->words[i]);
+        memcpy(text->text + offset, node->words[i], length);
+        offset += length;
+    }
+    if (node->delimiter != '\0') {
+        text->text[offset++] = node->delimiter;
+    }
+    text->length = offset;
+    return text;
+}
+
+static void release_sentence_text(SentenceText* text) {
+    if (text && atomic_fetch_sub(&text->refs, 1) == 1) {
+        free(text);
+    }
+}
+
+// ==================== CHUNKS ====================
+
+// Takes ownership of one reference on each sentence
+static SnapshotChunk* make_chunk(SentenceText** sentences, int count) {
+    SnapshotChunk* chunk = (SnapshotChunk*)malloc(sizeof(SnapshotChunk) +
+                                                  (size_t)count * sizeof(SentenceText*));
+    if (!chunk) {
+        return NULL;
+    }
+    atomic_init(&chunk->refs, 1);
+    chunk->count = count;
+    chunk->length = 0;
+    for (int i = 0; i < count; i++) {
+        chunk->sentences[i] = sentences[i];
+        chunk->length += sentences[i]->length;
+    }
+    return chunk;
+}
+
+static void release_chunk(SnapshotChunk* chunk) {
+    if (chunk && atomic_fetch_sub(&chunk->refs, 1) == 1) {
+        for (int i = 0; i < chunk->count; i++) {
+            release_sentence_text(chunk->sentences[i]);
+        }
+        free(chunk);
+    }
+}
+
+static FileSnapshot* alloc_snapshot(int chunk_count) {
+    FileSnapshot* snapshot = (FileSnapshot*)calloc(1, sizeof(FileSnapshot) +
+                                                   (size_t)chunk_count * sizeof(SnapshotChunk*));
+    if (snapshot) {
+        atomic_init(&snapshot->refs, 1);
+        snapshot->chunk_count = chunk_count;
+    }
+    return snapshot;
+}
+
+static void finish_snapshot(FileSnapshot* snapshot) {
+    snapshot->sentence_count = 0;
+    snapshot->length_bound = 0;
+    for (int i = 0; i < snapshot->chunk_count; i++) {
+        snapshot->sentence_count += snapshot->chunks[i]->count;
+        snapshot->length_bound += snapshot->chunks[i]->length;
+    }
+    // One separator before every sentence but the first
+    if (snapshot->sentence_count > 1) {
+        snapshot->length_bound += (size_t)(snapshot->sentence_count - 1);
+    }
+}
+
+void snapshot_release(FileSnapshot* snapshot) {
+    if (snapshot && atomic_fetch_sub(&snapshot->refs, 1) == 1) {
+        for (int i = 0; i < snapshot->chunk_count; i++) {
+            release_chunk(snapshot->chunks[i]);
+        }
+        free(snapshot);
+    }
+}
+
+// Splits count sentences into evenly sized chunks stored at out (which has
+// room for (count + SNAPSHOT_CHUNK - 1) / SNAPSHOT_CHUNK). Consumes the
+// sentence references, also on failure. Returns the number of chunks or -1.
+static int chunk_sentences(SentenceText** sentences, int count, SnapshotChunk** out) {
+    int chunks = (count + SNAPSHOT_CHUNK - 1) / SNAPSHOT_CHUNK;
+    int offset = 0;
+    for (int i = 0; i < chunks; i++) {
+        int size = count / chunks + (i < count % chunks ? 1 : 0);
+        out[i] = make_chunk(sentences + offset, size);
+        if (!out[i]) {
+            for (int j = 0; j < i; j++) {
+                release_chunk(out[j]);
+            }
+            for (int j = offset; j < count; j++) {
+                release_sentence_text(sentences[j]);
+            }
+            return -1;
+        }
+        offset += size;
+    }
+    return chunks;
+}
+
+// ==================== BUILDING ====================
+
+FileSnapshot* snapshot_build(FileEntry* file) {
+    int count = file->sentence_count;
+    SentenceText** sentences = (SentenceText**)malloc((size_t)(count > 0 ? count : 1) *
+                                                      sizeof(SentenceText*));
+    if (!sentences) {
+        return NULL;
+    }
+    int built = 0;
+    for (SentenceNode* node = file->head; node && built < count; node = node->next) {
+        sentences[built] = render_sentence(node);
+        if (!sentences[built]) {
+            break;
+        }
+        built++;
+    }
+
+    FileSnapshot* snapshot = built == count ?
+        alloc_snapshot((count + SNAPSHOT_CHUNK - 1) / SNAPSHOT_CHUNK) : NULL;
+    if (!snapshot) {
+        for (int i = 0; i < built; i++) {
+            release_sentence_text(sentences[i]);
+        }
+        free(sentences);
+        return NULL;
+    }
+    if (chunk_sentences(sentences, count, snapshot->chunks) < 0) {
+        snapshot->chunk_count = 0;
+        snapshot_release(snapshot);
+        free(sentences);
+        return NULL;
+    }
+    free(sentences);
+    finish_snapshot(snapshot);
+    return snapshot;
+}
+
+// The next version after sentences index .. index+removed-1 of base were
+// replaced by the inserted sentences starting at first. NULL if base does
+// not match the edit or memory ran out; the caller rebuilds instead.
+FileSnapshot* snapshot_apply_edit(const FileSnapshot* base, int index, int removed,
+                                  SentenceNode* first, int inserted) {
+    if (!base || index < 0 || removed < 1 || inserted < 0 ||
+        index + removed > base->sentence_count) {
+        return NULL;
+    }
+
+    // Chunks first_chunk .. last_chunk hold the replaced run
+    int first_chunk = 0;
+    int first_start = 0;
+    while (first_start + base->chunks[first_chunk]->count <= index) {
+        first_start += base->chunks[first_chunk++]->count;
+    }
+    int last_chunk = first_chunk;
+    int last_start = first_start;
+    while (last_start + base->chunks[last_chunk]->count < index + removed) {
+        last_start += base->chunks[last_chunk++]->count;
+    }
+    int head = index - first_start;
+    int tail = last_start + base->chunks[last_chunk]->count - (index + removed);
+    int middle = head + inserted + tail;
+    if (middle < SNAPSHOT_CHUNK / 2 && last_chunk + 1 < base->chunk_count) {
+        tail += base->chunks[++last_chunk]->count;
+        middle += base->chunks[last_chunk]->count;
+    }
+
+    // The rebuilt run: kept head, new sentences, kept tail
+    SentenceText** sentences = (SentenceText**)malloc((size_t)(middle > 0 ? middle : 1) *
+                                                      sizeof(SentenceText*));
+    if (!sentences) {
+        return NULL;
+    }
+    int count = 0;
+    for (int c = first_chunk, i = 0; count < head; i++) {
+        if (i == base->chunks[c]->count) {
+            c++;
+            i = 0;
+        }
+        sentences[count] = base->chunks[c]->sentences[i];
+        atomic_fetch_add(&sentences[count++]->refs, 1);
+    }
+    SentenceNode* node = first;
+    for (int i = 0; i < inserted; i++, node = node ? node->next : NULL) {
+        sentences[count] = node ? render_sentence(node) : NULL;
+        if (!sentences[count]) {
+            for (int j = 0; j < count; j++) {
+                release_sentence_text(sentences[j]);
+            }
+            free(sentences);
+            return NULL;
+        }
+        count++;
+    }
+    // The tail ends exactly where last_chunk ends
+    int skip = tail;
+    for (int c = last_chunk; skip > 0; c--) {
+        int take = skip < base->chunks[c]->count ? skip : base->chunks[c]->count;
+        skip -= take;
+        for (int i = 0; i < take; i++) {
+            SentenceText* text = base->chunks[c]->sentences[base->chunks[c]->count - take + i];
+            sentences[count + skip + i] = text;
+            atomic_fetch_add(&text->refs, 1);
+        }
+    }
+    count += tail;
+
+    int rebuilt = (middle + SNAPSHOT_CHUNK - 1) / SNAPSHOT_CHUNK;
+    int after = base->chunk_count - last_chunk - 1;
+    FileSnapshot* snapshot = alloc_snapshot(first_chunk + rebuilt + after);
+    if (!snapshot) {
+        for (int j = 0; j < count; j++) {
+            release_sentence_text(sentences[j]);
+        }
+        free(sentences);
+        return NULL;
+    }
+    if (chunk_sentences(sentences, count, snapshot->chunks + first_chunk) < 0) {
+        free(sentences);
+        free(snapshot);
+        return NULL;
+    }
+    free(sentences);
+
+    for (int i = 0; i < first_chunk; i++) {
+        snapshot->chunks[i] = base->chunks[i];
+        atomic_fetch_add(&snapshot->chunks[i]->refs, 1);
+    }
+    for (int i = 0; i < after; i++) {
+        snapshot->chunks[first_chunk + rebuilt + i] = base->chunks[last_chunk + 1 + i];
+        atomic_fetch_add(&base->chunks[last_chunk + 1 + i]->refs, 1);
+    }
+    finish_snapshot(snapshot);
+    return snapshot;
+}
+
+// ==================== RENDERING ====================
+
+// Same layout as rebuild_file_content: sentences joined by one space unless
+// the text so far already ends in one
+size_t snapshot_render(const FileSnapshot* snapshot, char* out) {
+    size_t offset = 0;
+    bool first = true;
+    for (int c = 0; c < snapshot->chunk_count; c++) {
+        const SnapshotChunk* chunk = snapshot->chunks[c];
+        for (int i = 0; i < chunk->count; i++) {
+            if (!first && offset > 0 && out[offset - 1] != ' ') {
+                out[offset++] = ' ';
+            }
+            first = false;
+            memcpy(out + offset, chunk->sentences[i]->text, chunk->sentences[i]->length);
+            offset += chunk->sentences[i]->length;
+        }
+    }
+    return offset;
+}
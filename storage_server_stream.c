@@ -0,0 +1,405 @@
+#include "storage_server.h"
+#include <sys/uio.h>
+
+// ==================== STREAM ENGINE ====================
+// STREAM sends a file word by word, one WIRE_OP_STREAM frame per word,
+// interval_ms apart, then a "STOP" reply. Each stream works from the file's
+// immutable RenderedContent taken when it starts, so no file lock is held
+// while it runs. Streams never sleep on a thread: between words they wait
+// in the timer wheel, and a worker sends every word that is due in one
+// writev (several when the interval is short or the stream fell behind).
+// Sockets are written without blocking; bytes a full socket did not take
+// are kept and sent first on the next turn.
+
+typedef struct StreamJob {
+    int client_fd;
+    RenderedContent* content;        // Snapshot being streamed
+    size_t offset;                   // Next byte of content to scan
+    int interval_ms;
+    int64_t next_word_ms;            // When the next word is due
+    uint64_t due_tick;               // Wheel tick the stream waits for
+    char* pending;                   // Bytes the socket has not taken yet
+    size_t pending_length;
+    size_t pending_sent;
+    bool stopped;                    // STOP has been queued
+    char filename[MAX_FILENAME];
+    StreamDone done;
+    void* ctx;
+    struct StreamJob* next;
+} StreamJob;
+
+typedef enum {
+    STREAM_WAIT,                     // Scheduled again
+    STREAM_FINISHED,
+    STREAM_FAILED
+} StreamStatus;
+
+static int64_t monotonic_ms(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+// ==================== SCHEDULING ====================
+
+// Caller holds engine->lock
+static void push_ready(StreamEngine* engine, StreamJob* job) {
+    job->next = NULL;
+    if (engine->ready_tail) {
+        engine->ready_tail->next = job;
+    } else {
+        engine->ready_head = job;
+    }
+    engine->ready_tail = job;
+    pthread_cond_signal(&engine->ready_cond);
+}
+
+// Caller holds engine->lock
+static void schedule_job(StreamEngine* engine, StreamJob* job, int64_t due_ms) {
+    int64_t offset = due_ms - engine->start_ms;
+    uint64_t tick = offset > 0 ? (uint64_t)((offset + STREAM_TICK_MS - 1) / STREAM_TICK_MS) : 0;
+    if (tick <= engine->tick) {
+        push_ready(engine, job);
+        return;
+    }
+    job->due_tick = tick;
+    size_t slot = (size_t)(tick % STREAM_WHEEL_SLOTS);
+    job->next = engine->wheel[slot];
+    engine->wheel[slot] = job;
+}
+
+// Caller holds engine->lock. Moves the slot's due streams to the ready list;
+// streams a whole wheel turn or more away stay.
+static void expire_slot(StreamEngine* engine, uint64_t tick) {
+    StreamJob** link = &engine->wheel[tick % STREAM_WHEEL_SLOTS];
+    while (*link) {
+        StreamJob* job = *link;
+        if (job->due_tick <= tick) {
+            *link = job->next;
+            push_ready(engine, job);
+        } else {
+            link = &job->next;
+        }
+    }
+}
+
+static void* stream_timer_main(void* arg) {
+    StreamEngine* engine = &((StorageServer*)arg)->streams;
+    pthread_mutex_lock(&engine->lock);
+    while (engine->running) {
+        int64_t wake_ms = engine->start_ms + (int64_t)(engine->tick + 1) * STREAM_TICK_MS;
+        pthread_mutex_unlock(&engine->lock);
+
+        struct timespec wake = { (time_t)(wake_ms / 1000), (long)(wake_ms % 1000) * 1000000L };
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wake, NULL) == EINTR) {
+        }
+
+        pthread_mutex_lock(&engine->lock);
+        // Catch up on every tick that has passed, one slot each
+        uint64_t now_tick = (uint64_t)((monotonic_ms() - engine->start_ms) / STREAM_TICK_MS);
+        while (engine->tick < now_tick) {
+            engine->tick++;
+            expire_slot(engine, engine->tick);
+        }
+    }
+    pthread_mutex_unlock(&engine->lock);
+    return NULL;
+}
+
+// ==================== SENDING ====================
+
+// Sends what it can without blocking; keeps the rest in job->pending.
+// Returns false if the client is gone.
+static bool send_batch(StreamJob* job, struct iovec* iov, int iov_count) {
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = iov_count;
+
+    ssize_t sent;
+    do {
+        sent = sendmsg(job->client_fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+    } while (sent < 0 && errno == EINTR);
+    if (sent < 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            return false;
+        }
+        sent = 0;
+    }
+
+    size_t total = 0;
+    for (int i = 0; i < iov_count; i++) {
+        total += iov[i].iov_len;
+    }
+    if ((size_t)sent == total) {
+        return true;
+    }
+
+    job->pending = (char*)malloc(total - (size_t)sent);
+    if (!job->pending) {
+        return false;
+    }
+    job->pending_length = 0;
+    job->pending_sent = 0;
+    size_t skip = (size_t)sent;
+    for (int i = 0; i < iov_count; i++) {
+        if (skip >= iov[i].iov_len) {
+            skip -= iov[i].iov_len;
+            continue;
+        }
+        memcpy(job->pending + job->pending_length, (char*)iov[i].iov_base + skip,
+               iov[i].iov_len - skip);
+        job->pending_length += iov[i].iov_len - skip;
+        skip = 0;
+    }
+    return true;
+}
+
+// Returns false if the client is gone
+static bool flush_pending(StreamJob* job) {
+    while (job->pending_sent < job->pending_length) {
+        ssize_t sent = send(job->client_fd, job->pending + job->pending_sent,
+                            job->pending_length - job->pending_sent, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (sent < 0) {
+            if (errno == EINTR) continue;
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+        job->pending_sent += (size_t)sent;
+    }
+    free(job->pending);
+    job->pending = NULL;
+    job->pending_length = 0;
+    job->pending_sent = 0;
+    return true;
+}
+
+static bool next_word(StreamJob* job, const char** word, size_t* length) {
+    const char* data = job->content->data;
+    size_t end = job->content->length;
+    size_t pos = job->offset;
+    while (pos < end && (data[pos] == ' ' || data[pos] == '\t' || data[pos] == '\n')) {
+        pos++;
+    }
+    size_t start = pos;
+    while (pos < end && data[pos] != ' ' && data[pos] != '\t' && data[pos] != '\n') {
+        pos++;
+    }
+    job->offset = pos;
+    *word = data + start;
+    *length = pos - start;
+    return *length > 0;
+}
+
+// Sends every word that is due; *due_ms is when to come back
+static StreamStatus serve_job(StreamJob* job, int64_t* due_ms) {
+    int64_t now = monotonic_ms();
+    if (job->pending) {
+        if (!flush_pending(job)) {
+            return STREAM_FAILED;
+        }
+        if (job->pending) {
+            *due_ms = now + STREAM_TICK_MS;
+            return STREAM_WAIT;
+        }
+    }
+    if (job->stopped) {
+        return STREAM_FINISHED;
+    }
+
+    int due = STREAM_BATCH_WORDS;
+    if (job->interval_ms > 0) {
+        if (now < job->next_word_ms) {
+            *due_ms = job->next_word_ms;
+            return STREAM_WAIT;
+        }
+        int64_t behind = (now - job->next_word_ms) / job->interval_ms + 1;
+        if (behind < due) {
+            due = (int)behind;
+        }
+    }
+
+    unsigned char headers[STREAM_BATCH_WORDS + 1][WIRE_HEADER_SIZE];
+    struct iovec iov[2 * (STREAM_BATCH_WORDS + 1)];
+    int iov_count = 0;
+    int words = 0;
+    const char* word;
+    size_t length;
+    while (words < due && next_word(job, &word, &length)) {
+        wire_encode_header(headers[words], (uint32_t)length, WIRE_OP_STREAM, 0, 0);
+        iov[iov_count].iov_base = headers[words];
+        iov[iov_count++].iov_len = WIRE_HEADER_SIZE;
+        iov[iov_count].iov_base = (void*)word;
+        iov[iov_count++].iov_len = length;
+        words++;
+    }
+
+    // End of stream is a reply frame, so a word "STOP" in the file is just a word
+    if (words < due) {
+        static const char stop[] = "STOP";
+        wire_encode_header(headers[words], sizeof(stop) - 1, WIRE_OP_REPLY, 0, 0);
+        iov[iov_count].iov_base = headers[words];
+        iov[iov_count++].iov_len = WIRE_HEADER_SIZE;
+        iov[iov_count].iov_base = (void*)stop;
+        iov[iov_count++].iov_len = sizeof(stop) - 1;
+        job->stopped = true;
+    }
+
+    if (!send_batch(job, iov, iov_count)) {
+        return STREAM_FAILED;
+    }
+    if (job->stopped && !job->pending) {
+        return STREAM_FINISHED;
+    }
+
+    job->next_word_ms += (int64_t)words * job->interval_ms;
+    if (job->next_word_ms < now) {
+        // Do not burst to catch up after the client stalled
+        job->next_word_ms = now + job->interval_ms;
+    }
+    *due_ms = job->pending ? now + STREAM_TICK_MS : job->next_word_ms;
+    return STREAM_WAIT;
+}
+
+static void finish_job(StorageServer* ss, StreamJob* job, bool completed) {
+    if (completed) {
+        char details[MAX_FILENAME + 16];
+        snprintf(details, sizeof(details), "File=%s", job->filename);
+        log_message(ss, "INFO", "STREAM", details);
+    }
+    release_rendered_content(job->content);
+    free(job->pending);
+    job->done(ss, job->ctx, completed);
+    free(job);
+}
+
+static void* stream_worker_main(void* arg) {
+    StorageServer* ss = (StorageServer*)arg;
+    StreamEngine* engine = &ss->streams;
+    pthread_mutex_lock(&engine->lock);
+    for (;;) {
+        while (engine->running && !engine->ready_head) {
+            pthread_cond_wait(&engine->ready_cond, &engine->lock);
+        }
+        if (!engine->running) {
+            break;
+        }
+        StreamJob* job = engine->ready_head;
+        engine->ready_head = job->next;
+        if (!engine->ready_head) {
+            engine->ready_tail = NULL;
+        }
+        pthread_mutex_unlock(&engine->lock);
+
+        int64_t due_ms = 0;
+        StreamStatus status = serve_job(job, &due_ms);
+        if (status != STREAM_WAIT) {
+            finish_job(ss, job, status == STREAM_FINISHED);
+        }
+
+        pthread_mutex_lock(&engine->lock);
+        if (status == STREAM_WAIT) {
+            schedule_job(engine, job, due_ms);
+        } else {
+            engine->active--;
+        }
+    }
+    pthread_mutex_unlock(&engine->lock);
+    return NULL;
+}
+
+// ==================== LIFECYCLE ====================
+
+bool stream_engine_start(StorageServer* ss) {
+    StreamEngine* engine = &ss->streams;
+    memset(engine->wheel, 0, sizeof(engine->wheel));
+    engine->ready_head = NULL;
+    engine->ready_tail = NULL;
+    engine->tick = 0;
+    engine->start_ms = monotonic_ms();
+    engine->active = 0;
+    engine->worker_count = 0;
+    engine->running = true;
+    pthread_mutex_init(&engine->lock, NULL);
+    pthread_cond_init(&engine->ready_cond, NULL);
+
+    if (pthread_create(&engine->timer, NULL, stream_timer_main, ss) != 0) {
+        pthread_cond_destroy(&engine->ready_cond);
+        pthread_mutex_destroy(&engine->lock);
+        return false;
+    }
+    for (int i = 0; i < STREAM_WORKERS; i++) {
+        if (pthread_create(&engine->workers[i], NULL, stream_worker_main, ss) != 0) {
+            break;
+        }
+        engine->worker_count++;
+    }
+    if (engine->worker_count == 0) {
+        stream_engine_stop(ss);
+        return false;
+    }
+    return true;
+}
+
+void stream_engine_stop(StorageServer* ss) {
+    StreamEngine* engine = &ss->streams;
+    pthread_mutex_lock(&engine->lock);
+    engine->running = false;
+    pthread_cond_broadcast(&engine->ready_cond);
+    pthread_mutex_unlock(&engine->lock);
+
+    pthread_join(engine->timer, NULL);
+    for (int i = 0; i < engine->worker_count; i++) {
+        pthread_join(engine->workers[i], NULL);
+    }
+
+    // Streams still waiting end early
+    for (size_t slot = 0; slot <= STREAM_WHEEL_SLOTS; slot++) {
+        StreamJob* job = slot < STREAM_WHEEL_SLOTS ? engine->wheel[slot] : engine->ready_head;
+        while (job) {
+            StreamJob* next = job->next;
+            finish_job(ss, job, false);
+            job = next;
+        }
+    }
+    pthread_cond_destroy(&engine->ready_cond);
+    pthread_mutex_destroy(&engine->lock);
+}
+
+ErrorCode stream_file(StorageServer* ss, int client_fd, const char* filename, int interval_ms,
+                      StreamDone done, void* ctx) {
+    if (interval_ms < 0 || interval_ms > STREAM_MAX_INTERVAL_MS) {
+        return ERR_INVALID_OPERATION;
+    }
+
+    // From memory: the text file may not have caught up with the edit log
+    ErrorCode error;
+    RenderedContent* content = acquire_rendered_content(ss, filename, &error);
+    if (!content) {
+        return error;
+    }
+    StreamJob* job = (StreamJob*)calloc(1, sizeof(StreamJob));
+    if (!job) {
+        release_rendered_content(content);
+        return ERR_SYSTEM_ERROR;
+    }
+    job->client_fd = client_fd;
+    job->content = content;
+    job->interval_ms = interval_ms;
+    job->next_word_ms = monotonic_ms();
+    snprintf(job->filename, sizeof(job->filename), "%s", filename);
+    job->done = done;
+    job->ctx = ctx;
+
+    StreamEngine* engine = &ss->streams;
+    pthread_mutex_lock(&engine->lock);
+    if (!engine->running) {
+        pthread_mutex_unlock(&engine->lock);
+        release_rendered_content(content);
+        free(job);
+        return ERR_SYSTEM_ERROR;
+    }
+    engine->active++;
+    push_ready(engine, job);
+    pthread_mutex_unlock(&engine->lock);
+    return ERR_SUCCESS;
+}
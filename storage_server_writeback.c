@@ -0,0 +1,491 @@
+#include "storage_server.h"
+
+// ==================== WRITE-BACK ====================
+// Commits, undos and reverts change memory under the file's write lock and
+// queue the change here; the disk work happens on one background thread.
+// Each round takes the dirty files that are due, appends their queued
+// records to the edit logs (or rewrites the text file), then makes the whole
+// round durable at once (see storage_server_durability.c). Committers that
+// need durability wait for the round covering their sequence number after
+// releasing the file lock, and their waiting makes the next round start
+// immediately and take every dirty file.
+//
+// Lock order: file_lock -> dirty.persist_lock -> writeback.lock -> file table.
+
+static int env_milliseconds(const char* name, int fallback) {
+    const char* value = getenv(name);
+    int parsed = value ? atoi(value) : 0;
+    return parsed > 0 ? parsed : fallback;
+}
+
+static int64_t monotonic_ms(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+void dirty_state_init(FileEntry* file) {
+    DirtyState* dirty = &file->dirty;
+    dirty->edits = NULL;
+    dirty->length = 0;
+    dirty->capacity = 0;
+    dirty->records = 0;
+    dirty->rewrite = false;
+    dirty->queued = false;
+    dirty->in_round = false;
+    dirty->evicting = false;
+    dirty->since_ms = 0;
+    dirty->last_seq = 0;
+    dirty->failed_seq = 0;
+    dirty->next = NULL;
+    pthread_mutex_init(&dirty->persist_lock, NULL);
+}
+
+void dirty_state_destroy(FileEntry* file) {
+    free(file->dirty.edits);
+    file->dirty.edits = NULL;
+    pthread_mutex_destroy(&file->dirty.persist_lock);
+}
+
+// ==================== QUEUE ====================
+
+// Caller holds writeback.lock
+static uint64_t mark_dirty(WriteBack* wb, FileEntry* file) {
+    if (!file->dirty.queued) {
+        file->dirty.queued = true;
+        file->dirty.since_ms = monotonic_ms();
+        file->dirty.next = NULL;
+        if (wb->dirty_tail) {
+            wb->dirty_tail->dirty.next = file;
+        } else {
+            wb->dirty_head = file;
+        }
+        wb->dirty_tail = file;
+    }
+    file->dirty.last_seq = ++wb->next_seq;
+    return file->dirty.last_seq;
+}
+
+// Caller holds writeback.lock
+static void discard_edits(FileEntry* file) {
+    free(file->dirty.edits);
+    file->dirty.edits = NULL;
+    file->dirty.length = 0;
+    file->dirty.capacity = 0;
+    file->dirty.records = 0;
+}
+
+// Takes ownership of record. Caller holds file_lock for writing, which keeps
+// each file's records in commit order.
+uint64_t writeback_queue_edit(StorageServer* ss, FileEntry* file, char* record, size_t length) {
+    WriteBack* wb = &ss->writeback;
+    pthread_mutex_lock(&wb->lock);
+    DirtyState* dirty = &file->dirty;
+    if (dirty->rewrite) {
+        // The pending rewrite renders memory, so it will include this edit
+        free(record);
+    } else if (!dirty->edits) {
+        dirty->edits = record;
+        dirty->length = length;
+        dirty->capacity = length;
+        dirty->records = 1;
+    } else {
+        if (dirty->length + length > dirty->capacity) {
+            size_t capacity = dirty->capacity * 2;
+            while (capacity < dirty->length + length) {
+                capacity *= 2;
+            }
+            char* grown = (char*)realloc(dirty->edits, capacity);
+            if (!grown) {
+                // Fall back to rewriting the whole file
+                free(record);
+                discard_edits(file);
+                dirty->rewrite = true;
+                uint64_t seq = mark_dirty(wb, file);
+                pthread_mutex_unlock(&wb->lock);
+                return seq;
+            }
+            dirty->edits = grown;
+            dirty->capacity = capacity;
+        }
+        memcpy(dirty->edits + dirty->length, record, length);
+        dirty->length += length;
+        dirty->records++;
+        free(record);
+    }
+    uint64_t seq = mark_dirty(wb, file);
+    pthread_mutex_unlock(&wb->lock);
+    return seq;
+}
+
+uint64_t writeback_queue_rewrite(StorageServer* ss, FileEntry* file) {
+    WriteBack* wb = &ss->writeback;
+    pthread_mutex_lock(&wb->lock);
+    discard_edits(file);
+    file->dirty.rewrite = true;
+    uint64_t seq = mark_dirty(wb, file);
+    pthread_mutex_unlock(&wb->lock);
+    return seq;
+}
+
+// The caller has rendered everything queued so far. Caller holds file_lock.
+void writeback_drop_edits(StorageServer* ss, FileEntry* file) {
+    pthread_mutex_lock(&ss->writeback.lock);
+    discard_edits(file);
+    file->dirty.rewrite = false;
+    pthread_mutex_unlock(&ss->writeback.lock);
+}
+
+// ERR_SYSTEM_ERROR when the round that covered seq failed to write or sync
+// the file; the change stays in memory and a later round retries it
+ErrorCode writeback_wait(StorageServer* ss, FileEntry* file, uint64_t seq) {
+    WriteBack* wb = &ss->writeback;
+    if (seq == 0 || ss->durability.mode == DURABILITY_NONE) {
+        return ERR_SUCCESS;
+    }
+    pthread_mutex_lock(&wb->lock);
+    wb->waiters++;
+    pthread_cond_signal(&wb->work_cond);
+    while (wb->flushed_seq < seq && file->dirty.failed_seq < seq && wb->running) {
+        pthread_cond_wait(&wb->done_cond, &wb->lock);
+    }
+    wb->waiters--;
+    bool persisted = wb->flushed_seq >= seq && file->dirty.failed_seq < seq;
+    pthread_mutex_unlock(&wb->lock);
+    return persisted ? ERR_SUCCESS : ERR_SYSTEM_ERROR;
+}
+
+// Called once the file is out of the file table, before it is freed
+void writeback_forget(StorageServer* ss, FileEntry* file) {
+    WriteBack* wb = &ss->writeback;
+    pthread_mutex_lock(&wb->lock);
+    while (file->dirty.in_round || file->dirty.evicting) {
+        pthread_cond_wait(&wb->done_cond, &wb->lock);
+    }
+    if (file->dirty.queued) {
+        FileEntry* prev = NULL;
+        for (FileEntry* cursor = wb->dirty_head; cursor; cursor = cursor->dirty.next) {
+            if (cursor == file) {
+                if (prev) {
+                    prev->dirty.next = file->dirty.next;
+                } else {
+                    wb->dirty_head = file->dirty.next;
+                }
+                if (wb->dirty_tail == file) {
+                    wb->dirty_tail = prev;
+                }
+                break;
+            }
+            prev = cursor;
+        }
+        file->dirty.queued = false;
+    }
+    discard_edits(file);
+    pthread_mutex_unlock(&wb->lock);
+}
+
+// ==================== ROUNDS ====================
+
+typedef struct Round {
+    FileEntry** files;
+    size_t count;
+    size_t capacity;
+    int* fds;
+    size_t fd_count;
+} Round;
+
+static bool round_add(Round* round, FileEntry* file) {
+    if (round->count == round->capacity) {
+        size_t capacity = round->capacity ? round->capacity * 2 : 16;
+        FileEntry** files = (FileEntry**)realloc(round->files, capacity * sizeof(*files));
+        int* fds = (int*)realloc(round->fds, capacity * sizeof(*fds));
+        if (files) round->files = files;
+        if (fds) round->fds = fds;
+        if (!files || !fds) {
+            return false;
+        }
+        round->capacity = capacity;
+    }
+    round->files[round->count++] = file;
+    return true;
+}
+
+// Fails every change queued for the file so far; their committers get an
+// error instead of a durable commit
+static void mark_failed(StorageServer* ss, FileEntry* file) {
+    pthread_mutex_lock(&ss->writeback.lock);
+    file->dirty.failed_seq = file->dirty.last_seq;
+    pthread_mutex_unlock(&ss->writeback.lock);
+}
+
+// Appends the file's queued records to its edit log
+static void write_file_edits(StorageServer* ss, FileEntry* file, Round* round) {
+    WriteBack* wb = &ss->writeback;
+    pthread_mutex_lock(&file->dirty.persist_lock);
+    pthread_mutex_lock(&wb->lock);
+    char* edits = file->dirty.edits;
+    size_t length = file->dirty.length;
+    int records = file->dirty.records;
+    file->dirty.edits = NULL;
+    file->dirty.length = 0;
+    file->dirty.capacity = 0;
+    file->dirty.records = 0;
+    pthread_mutex_unlock(&wb->lock);
+
+    int fd = length > 0 ? edit_log_write(ss, file, edits, length, records) : -1;
+    pthread_mutex_unlock(&file->dirty.persist_lock);
+    free(edits);
+
+    if (fd >= 0) {
+        round->fds[round->fd_count++] = fd;
+    } else if (length > 0) {
+        // The log may now have a torn tail; start over from memory
+        char details[MAX_FILENAME + 32];
+        snprintf(details, sizeof(details), "File=%s Edits=%d", file->filename, records);
+        log_message(ss, "ERROR", "WRITEBACK", details);
+        mark_failed(ss, file);
+        writeback_queue_rewrite(ss, file);
+    }
+}
+
+// Called and returns with writeback.lock held
+static void run_round(StorageServer* ss, bool everything) {
+    WriteBack* wb = &ss->writeback;
+    Round round = { NULL, 0, 0, NULL, 0 };
+    int64_t now = monotonic_ms();
+    bool skipped = false;
+
+    FileEntry* prev = NULL;
+    FileEntry* file = wb->dirty_head;
+    while (file) {
+        FileEntry* next = file->dirty.next;
+        bool due = everything || now - file->dirty.since_ms >= wb->max_dirty_age_ms;
+        if (due && round_add(&round, file)) {
+            if (prev) {
+                prev->dirty.next = next;
+            } else {
+                wb->dirty_head = next;
+            }
+            if (wb->dirty_tail == file) {
+                wb->dirty_tail = prev;
+            }
+            file->dirty.queued = false;
+            file->dirty.in_round = true;
+        } else {
+            skipped = true;
+            prev = file;
+        }
+        file = next;
+    }
+    uint64_t round_seq = wb->next_seq;
+    pthread_mutex_unlock(&wb->lock);
+
+    for (size_t i = 0; i < round.count; i++) {
+        FileEntry* entry = round.files[i];
+        pthread_mutex_lock(&wb->lock);
+        bool rewrite = entry->dirty.rewrite;
+        pthread_mutex_unlock(&wb->lock);
+
+        if (rewrite) {
+            if (!save_file_to_disk(ss, entry)) {
+                char details[MAX_FILENAME + 32];
+                snprintf(details, sizeof(details), "File=%s", entry->filename);
+                log_message(ss, "ERROR", "WRITEBACK", details);
+                mark_failed(ss, entry);
+                writeback_queue_rewrite(ss, entry);
+            }
+        } else {
+            write_file_edits(ss, entry, &round);
+        }
+    }
+
+    // Which log failed to sync is unknown, so the whole round has failed
+    bool synced = durability_sync_batch(ss, round.fds, round.fd_count);
+    if (!synced) {
+        log_message(ss, "ERROR", "WRITEBACK", "fsync failed");
+    }
+    for (size_t i = 0; i < round.fd_count; i++) {
+        close(round.fds[i]);
+    }
+
+    pthread_mutex_lock(&wb->lock);
+    for (size_t i = 0; i < round.count; i++) {
+        FileEntry* entry = round.files[i];
+        if (!synced) {
+            // The page cache may have dropped the data; rewrite from memory
+            entry->dirty.failed_seq = entry->dirty.last_seq;
+            discard_edits(entry);
+            entry->dirty.rewrite = true;
+            mark_dirty(wb, entry);
+        }
+        entry->dirty.in_round = false;
+    }
+    if (!skipped && round_seq > wb->flushed_seq) {
+        wb->flushed_seq = round_seq;
+    }
+    pthread_cond_broadcast(&wb->done_cond);
+    free(round.files);
+    free(round.fds);
+}
+
+// ==================== COMPACTION ====================
+
+typedef struct CompactionList {
+    char (*names)[MAX_FILENAME];
+    size_t count;
+    size_t capacity;
+    time_t now;
+    bool everything;
+} CompactionList;
+
+static bool needs_compaction(FileEntry* file, time_t now) {
+    int records = atomic_load(&file->edit_log.records);
+    if (records == 0) {
+        return false;
+    }
+    return records >= EDIT_LOG_COMPACT_RECORDS ||
+           atomic_load(&file->edit_log.bytes) >= EDIT_LOG_COMPACT_BYTES ||
+           now - file->last_modified >= EDIT_LOG_IDLE_SECONDS;
+}
+
+static void collect_compaction(FileEntry* file, void* ctx) {
+    CompactionList* list = (CompactionList*)ctx;
+    if (list->everything ? atomic_load(&file->edit_log.records) == 0
+                         : !needs_compaction(file, list->now)) {
+        return;
+    }
+    if (list->count == list->capacity) {
+        size_t capacity = list->capacity ? list->capacity * 2 : 16;
+        void* grown = realloc(list->names, capacity * sizeof(*list->names));
+        if (!grown) {
+            return;
+        }
+        list->names = grown;
+        list->capacity = capacity;
+    }
+    snprintf(list->names[list->count++], MAX_FILENAME, "%s", file->filename);
+}
+
+// Folds long or idle edit logs into their text files. Candidates are
+// collected first: file_lock is never taken under the table's stripe locks.
+static void compact_files(StorageServer* ss, bool everything) {
+    WriteBack* wb = &ss->writeback;
+    CompactionList list = { NULL, 0, 0, time(NULL), everything };
+    file_table_foreach(&ss->files, collect_compaction, &list);
+
+    for (size_t i = 0; i < list.count; i++) {
+        // Looked up under writeback.lock so a delete waits for us (writeback_forget)
+        pthread_mutex_lock(&wb->lock);
+        FileEntry* file = file_table_find(&ss->files, list.names[i]);
+        if (file) {
+            file->dirty.in_round = true;
+        }
+        pthread_mutex_unlock(&wb->lock);
+        if (!file) {
+            continue;
+        }
+
+        int records = atomic_load(&file->edit_log.records);
+        bool saved = records == 0 || save_file_to_disk(ss, file);
+        if (records > 0) {
+            char details[MAX_FILENAME + 64];
+            snprintf(details, sizeof(details), "File=%s Edits=%d", list.names[i], records);
+            log_message(ss, saved ? "INFO" : "ERROR", "COMPACT", details);
+        }
+
+        pthread_mutex_lock(&wb->lock);
+        file->dirty.in_round = false;
+        pthread_cond_broadcast(&wb->done_cond);
+        pthread_mutex_unlock(&wb->lock);
+    }
+    free(list.names);
+}
+
+// ==================== THREAD ====================
+
+static void* writeback_main(void* arg) {
+    StorageServer* ss = (StorageServer*)arg;
+    WriteBack* wb = &ss->writeback;
+    int64_t last_scan = monotonic_ms();
+    time_t last_report = time(NULL);
+
+    pthread_mutex_lock(&wb->lock);
+    for (;;) {
+        bool urgent = wb->waiters > 0 && wb->flushed_seq < wb->next_seq;
+        if (wb->running && !urgent) {
+            struct timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_nsec += (long)wb->interval_ms * 1000000L;
+            deadline.tv_sec += deadline.tv_nsec / 1000000000L;
+            deadline.tv_nsec %= 1000000000L;
+            pthread_cond_timedwait(&wb->work_cond, &wb->lock, &deadline);
+        }
+        bool stopping = !wb->running;
+        run_round(ss, stopping || wb->waiters > 0);
+        pthread_mutex_unlock(&wb->lock);
+
+        int64_t now = monotonic_ms();
+        if (stopping || now - last_scan >= EDIT_LOG_SCAN_SECONDS * 1000) {
+            // Leave plain text files behind on a clean shutdown
+            compact_files(ss, stopping);
+            last_scan = now;
+        }
+
+        time_t wall = time(NULL);
+        uint64_t commits = atomic_load(&ss->durability.commits);
+        if (wall - last_report >= DURABILITY_REPORT_SECONDS &&
+            commits != ss->durability.reported_commits) {
+            ss->durability.reported_commits = commits;
+            last_report = wall;
+            durability_report(ss);
+        }
+
+        pthread_mutex_lock(&wb->lock);
+        if (stopping) {
+            break;
+        }
+    }
+    pthread_mutex_unlock(&wb->lock);
+    return NULL;
+}
+
+bool writeback_start(StorageServer* ss) {
+    WriteBack* wb = &ss->writeback;
+    wb->interval_ms = env_milliseconds("SS_FLUSH_INTERVAL_MS", WRITEBACK_INTERVAL_MS);
+    wb->max_dirty_age_ms = env_milliseconds("SS_MAX_DIRTY_AGE_MS", WRITEBACK_MAX_DIRTY_AGE_MS);
+    wb->dirty_head = NULL;
+    wb->dirty_tail = NULL;
+    wb->next_seq = 0;
+    wb->flushed_seq = 0;
+    wb->waiters = 0;
+    pthread_mutex_init(&wb->lock, NULL);
+    pthread_cond_init(&wb->work_cond, NULL);
+    pthread_cond_init(&wb->done_cond, NULL);
+
+    wb->running = true;
+    if (pthread_create(&wb->thread, NULL, writeback_main, ss) != 0) {
+        wb->running = false;
+        pthread_cond_destroy(&wb->done_cond);
+        pthread_cond_destroy(&wb->work_cond);
+        pthread_mutex_destroy(&wb->lock);
+        return false;
+    }
+    return true;
+}
+
+void writeback_stop(StorageServer* ss) {
+    WriteBack* wb = &ss->writeback;
+    pthread_mutex_lock(&wb->lock);
+    wb->running = false;
+    pthread_cond_signal(&wb->work_cond);
+    pthread_mutex_unlock(&wb->lock);
+
+    // The thread's last round takes every dirty file, then compacts every log
+    pthread_join(wb->thread, NULL);
+
+    pthread_mutex_lock(&wb->lock);
+    pthread_cond_broadcast(&wb->done_cond);
+    pthread_mutex_unlock(&wb->lock);
+
+    durability_report(ss);
+}
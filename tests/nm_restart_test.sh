@@ -0,0 +1,48 @@
+#!/bin/bash
+# Name Server restart: metadata replayed from nm_meta.wal must come back
+# with the same kind (plain file vs folder) it was created with.
+# Usage: tests/nm_restart_test.sh [bindir]   (run `make` first)
+set -u
+BIN=$(cd "${1:-$(dirname "$0")/..}" && pwd)
+PORT=$((20000 + RANDOM % 20000))
+WORK=$(mktemp -d /tmp/nm_restart.XXXX)
+trap 'kill $NM_PID $SS_PID 2>/dev/null; wait 2>/dev/null; rm -rf "$WORK"' EXIT
+mkdir -p "$WORK/nm" "$WORK/ss"
+
+fail() {
+    echo "FAIL: $1"
+    exit 1
+}
+
+# Fresh heap pages are zero; perturbing malloc exposes fields left unset
+start_nm() {
+    (cd "$WORK/nm" && MALLOC_PERTURB_=65 exec "$BIN/name_server" $PORT >> nm.out 2>&1) &
+    NM_PID=$!
+    sleep 0.5
+}
+
+client() {
+    printf '%s\nquit\n' "$1" | timeout 10 "$BIN/client" alice 127.0.0.1 $PORT 2>&1
+}
+
+start_nm
+(cd "$WORK/ss" && exec "$BIN/storage_server" 127.0.0.1 $PORT $((PORT + 1)) > ss.out 2>&1) &
+SS_PID=$!
+sleep 1
+
+client "create plain.txt" | grep -q "created" || fail "create plain.txt"
+client "createfolder dir" | grep -q "created" || fail "createfolder dir"
+
+# Kind as journaled: field 5 of an F record is is_directory
+grep -q " F plain.txt alice [0-9]* 0 " "$WORK/nm/nm_meta.wal" || fail "plain.txt journaled as a folder"
+grep -q " F dir alice [0-9]* 1 " "$WORK/nm/nm_meta.wal" || fail "dir journaled as a file"
+
+# Crash and replay
+kill -9 $NM_PID
+wait $NM_PID 2>/dev/null
+start_nm
+
+client "viewfolder plain.txt" | grep -q "Invalid operation" || fail "plain.txt replayed as a folder"
+client "viewfolder dir" | grep -q "Folder is empty" || fail "dir replayed as a file"
+
+echo "PASS: nm_restart_test"
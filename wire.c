@@ -0,0 +1,272 @@
+#include "wire.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+// ==================== FRAME ENCODING ====================
+
+void wire_encode_header(unsigned char* out, uint32_t length, uint16_t opcode,
+                        uint16_t flags, uint32_t request_id) {
+    uint32_t n_length = htonl(length);
+    uint16_t n_opcode = htons(opcode);
+    uint16_t n_flags = htons(flags);
+    uint32_t n_request = htonl(request_id);
+    memcpy(out, &n_length, 4);
+    memcpy(out + 4, &n_opcode, 2);
+    memcpy(out + 6, &n_flags, 2);
+    memcpy(out + 8, &n_request, 4);
+}
+
+static void decode_header(const unsigned char* in, uint32_t* length, uint16_t* opcode,
+                          uint16_t* flags, uint32_t* request_id) {
+    uint32_t n_length, n_request;
+    uint16_t n_opcode, n_flags;
+    memcpy(&n_length, in, 4);
+    memcpy(&n_opcode, in + 4, 2);
+    memcpy(&n_flags, in + 6, 2);
+    memcpy(&n_request, in + 8, 4);
+    *length = ntohl(n_length);
+    *opcode = ntohs(n_opcode);
+    *flags = ntohs(n_flags);
+    *request_id = ntohl(n_request);
+}
+
+static bool send_iov_all(int socket_fd, struct iovec* iov, int iov_count) {
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = iov_count;
+
+    while (msg.msg_iovlen > 0) {
+        ssize_t sent = sendmsg(socket_fd, &msg, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        while (sent > 0 && msg.msg_iovlen > 0) {
+            if ((size_t)sent >= msg.msg_iov->iov_len) {
+                sent -= msg.msg_iov->iov_len;
+                msg.msg_iov++;
+                msg.msg_iovlen--;
+            } else {
+                msg.msg_iov->iov_base = (char*)msg.msg_iov->iov_base + sent;
+                msg.msg_iov->iov_len -= sent;
+                sent = 0;
+            }
+        }
+        // Skip zero-length entries left at the front
+        while (msg.msg_iovlen > 0 && msg.msg_iov->iov_len == 0) {
+            msg.msg_iov++;
+            msg.msg_iovlen--;
+        }
+    }
+    return true;
+}
+
+bool wire_send(int socket_fd, uint16_t opcode, uint32_t request_id,
+               const void* payload, size_t length) {
+    if (socket_fd < 0 || length > WIRE_MAX_MESSAGE) {
+        return false;
+    }
+
+    const char* data = (const char*)payload;
+    size_t offset = 0;
+    do {
+        size_t chunk = length - offset;
+        uint16_t flags = 0;
+        if (chunk > WIRE_MAX_FRAME) {
+            chunk = WIRE_MAX_FRAME;
+            flags = WIRE_FLAG_MORE;
+        }
+
+        unsigned char header[WIRE_HEADER_SIZE];
+        wire_encode_header(header, (uint32_t)chunk, opcode, flags, request_id);
+        struct iovec iov[2] = {
+            { header, WIRE_HEADER_SIZE },
+            { (void*)(data + offset), chunk }
+        };
+        if (!send_iov_all(socket_fd, iov, chunk > 0 ? 2 : 1)) {
+            return false;
+        }
+        offset += chunk;
+    } while (offset < length);
+
+    return true;
+}
+
+bool wire_send_text(int socket_fd, uint16_t opcode, uint32_t request_id, const char* text) {
+    return wire_send(socket_fd, opcode, request_id, text, text ? strlen(text) : 0);
+}
+
+// ==================== BLOCKING RECEIVE ====================
+
+// 1 = filled, 0 = peer closed before any byte, -1 = error or short read
+static int recv_exact(int socket_fd, void* buffer, size_t length) {
+    size_t received = 0;
+    while (received < length) {
+        ssize_t bytes = recv(socket_fd, (char*)buffer + received, length - received, 0);
+        if (bytes == 0) {
+            return received == 0 ? 0 : -1;
+        }
+        if (bytes < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        received += (size_t)bytes;
+    }
+    return 1;
+}
+
+int wire_recv(int socket_fd, WireMessage* msg) {
+    memset(msg, 0, sizeof(*msg));
+    bool first = true;
+
+    while (true) {
+        unsigned char header[WIRE_HEADER_SIZE];
+        int status = recv_exact(socket_fd, header, WIRE_HEADER_SIZE);
+        if (status <= 0) {
+            wire_message_free(msg);
+            return (status == 0 && first) ? 0 : -1;
+        }
+
+        uint32_t length, request_id;
+        uint16_t opcode, flags;
+        decode_header(header, &length, &opcode, &flags, &request_id);
+        if (length > WIRE_MAX_FRAME || msg->length + length > WIRE_MAX_MESSAGE ||
+            (!first && request_id != msg->request_id)) {
+            wire_message_free(msg);
+            return -1;
+        }
+
+        char* grown = (char*)realloc(msg->payload, msg->length + length + 1);
+        if (!grown) {
+            wire_message_free(msg);
+            return -1;
+        }
+        msg->payload = grown;
+        if (length > 0 && recv_exact(socket_fd, msg->payload + msg->length, length) != 1) {
+            wire_message_free(msg);
+            return -1;
+        }
+        msg->length += length;
+        msg->payload[msg->length] = '\0';
+        msg->opcode = opcode;
+        msg->request_id = request_id;
+        first = false;
+
+        if (!(flags & WIRE_FLAG_MORE)) {
+            return 1;
+        }
+    }
+}
+
+void wire_message_free(WireMessage* msg) {
+    if (!msg) return;
+    free(msg->payload);
+    msg->payload = NULL;
+    msg->length = 0;
+}
+
+// ==================== NON-BLOCKING RECEIVE ====================
+
+void wire_reader_init(WireReader* reader) {
+    memset(reader, 0, sizeof(*reader));
+}
+
+void wire_reader_reset(WireReader* reader) {
+    free(reader->msg);
+    reader->msg = NULL;
+    reader->msg_len = 0;
+    reader->in_message = false;
+    reader->len = 0;
+}
+
+void wire_reader_destroy(WireReader* reader) {
+    free(reader->buf);
+    free(reader->msg);
+    memset(reader, 0, sizeof(*reader));
+}
+
+ssize_t wire_reader_fill(WireReader* reader, int socket_fd) {
+    if (reader->cap - reader->len < WIRE_HEADER_SIZE + 4096) {
+        size_t new_cap = reader->cap ? reader->cap * 2 : WIRE_MAX_FRAME;
+        if (new_cap > WIRE_MAX_FRAME * 4) {
+            // Never buffer more than a few frames; decode before reading more
+            if (reader->cap - reader->len == 0) {
+                errno = EAGAIN;
+                return -1;
+            }
+        } else {
+            char* grown = (char*)realloc(reader->buf, new_cap);
+            if (!grown) {
+                errno = ENOMEM;
+                return -1;
+            }
+            reader->buf = grown;
+            reader->cap = new_cap;
+        }
+    }
+
+    ssize_t bytes;
+    do {
+        bytes = recv(socket_fd, reader->buf + reader->len, reader->cap - reader->len, MSG_DONTWAIT);
+    } while (bytes < 0 && errno == EINTR);
+
+    if (bytes > 0) {
+        reader->len += (size_t)bytes;
+    }
+    return bytes;
+}
+
+int wire_reader_next(WireReader* reader, WireMessage* msg) {
+    size_t pos = 0;
+    int result = 0;
+
+    while (reader->len - pos >= WIRE_HEADER_SIZE) {
+        uint32_t length, request_id;
+        uint16_t opcode, flags;
+        decode_header((const unsigned char*)reader->buf + pos, &length, &opcode, &flags, &request_id);
+        if (length > WIRE_MAX_FRAME ||
+            (reader->in_message && request_id != reader->msg_request_id) ||
+            reader->msg_len + length > WIRE_MAX_MESSAGE) {
+            result = -1;
+            break;
+        }
+        if (reader->len - pos - WIRE_HEADER_SIZE < length) {
+            break;  // Frame body still in flight
+        }
+
+        char* grown = (char*)realloc(reader->msg, reader->msg_len + length + 1);
+        if (!grown) {
+            result = -1;
+            break;
+        }
+        reader->msg = grown;
+        memcpy(reader->msg + reader->msg_len, reader->buf + pos + WIRE_HEADER_SIZE, length);
+        reader->msg_len += length;
+        reader->msg[reader->msg_len] = '\0';
+        reader->msg_opcode = opcode;
+        reader->msg_request_id = request_id;
+        reader->in_message = true;
+        pos += WIRE_HEADER_SIZE + length;
+
+        if (!(flags & WIRE_FLAG_MORE)) {
+            msg->opcode = reader->msg_opcode;
+            msg->request_id = reader->msg_request_id;
+            msg->payload = reader->msg;
+            msg->length = reader->msg_len;
+            reader->msg = NULL;
+            reader->msg_len = 0;
+            reader->in_message = false;
+            result = 1;
+            break;
+        }
+    }
+
+    memmove(reader->buf, reader->buf + pos, reader->len - pos);
+    reader->len -= pos;
+    return result;
+}
@@ -0,0 +1,73 @@
+#ifndef WIRE_H
+#define WIRE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <sys/types.h>
+
+// Framed message layer shared by the Name Server, Storage Server and client.
+//
+// Every frame is a 12-byte header in network byte order followed by the
+// payload:
+//
+//   uint32 length | uint16 opcode | uint16 flags | uint32 request_id
+//
+// Payloads larger than WIRE_MAX_FRAME are split into consecutive frames
+// with WIRE_FLAG_MORE set on all but the last; receivers reassemble them
+// into one message. Frames of one message are never interleaved with
+// another message on the same socket (senders serialize whole messages).
+
+#define WIRE_HEADER_SIZE 12
+#define WIRE_FLAG_MORE 0x0001
+#define WIRE_MAX_FRAME (64 * 1024)
+#define WIRE_MAX_MESSAGE (16 * 1024 * 1024)
+
+typedef enum {
+    WIRE_OP_REQUEST = 1,             // Text command
+    WIRE_OP_REPLY = 2,               // Text response to a request
+    WIRE_OP_STREAM = 3               // One item of a streamed response
+} WireOpcode;
+
+typedef struct WireMessage {
+    uint16_t opcode;
+    uint32_t request_id;
+    char* payload;                   // Heap buffer, always NUL-terminated
+    size_t length;
+} WireMessage;
+
+// Incremental decoder for non-blocking sockets
+typedef struct WireReader {
+    char* buf;                       // Raw bytes not yet decoded
+    size_t len;
+    size_t cap;
+    char* msg;                       // Message being reassembled from MORE frames
+    size_t msg_len;
+    uint16_t msg_opcode;
+    uint32_t msg_request_id;
+    bool in_message;
+} WireReader;
+
+// Writes one frame header (WIRE_HEADER_SIZE bytes) for callers batching frames
+void wire_encode_header(unsigned char* out, uint32_t length, uint16_t opcode,
+                        uint16_t flags, uint32_t request_id);
+
+// Sending (blocking; retries partial writes)
+bool wire_send(int socket_fd, uint16_t opcode, uint32_t request_id,
+               const void* payload, size_t length);
+bool wire_send_text(int socket_fd, uint16_t opcode, uint32_t request_id, const char* text);
+
+// Blocking receive of one whole message: 1 = message, 0 = peer closed, -1 = error
+int wire_recv(int socket_fd, WireMessage* msg);
+void wire_message_free(WireMessage* msg);
+
+// Non-blocking receive
+void wire_reader_init(WireReader* reader);
+void wire_reader_reset(WireReader* reader);
+void wire_reader_destroy(WireReader* reader);
+// Reads what is available: >0 bytes read, 0 = peer closed, -1 = error (errno; EAGAIN = drained)
+ssize_t wire_reader_fill(WireReader* reader, int socket_fd);
+// 1 = msg holds a whole message, 0 = need more bytes, -1 = protocol error
+int wire_reader_next(WireReader* reader, WireMessage* msg);
+
+#endif // WIRE_H